@@ -0,0 +1,472 @@
+#include "lexer.h"
+#include "parser.h"
+#include "sema.h"
+#include "codegen.h"
+#include "driver.h"
+#include "ir.h"
+#include "backends/limn2k.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Compile-throughput benchmark. A deterministic generator writes a corpus of
+/// the requested shape, which is compiled through each phase on its own and
+/// end to end, at doubling sizes. Every measurement runs in a child process,
+/// so the peak resident size it reports belongs to that phase and size alone.
+///
+/// Results are printed as tab-separated rows, one per phase and size, after a
+/// `#` header naming the columns and the shape. Given a baseline in the same
+/// format, rows slower or larger than it by more than the tolerance are
+/// reported, and the exit status is 1.
+
+typedef struct {
+	unsigned int functions, statements, autos, identifier;
+	uint32_t seed;
+} bench_shape_t;
+
+typedef enum {
+	BENCH_LEX,
+	BENCH_PARSE,
+	BENCH_SEMA,
+	BENCH_CODEGEN,
+	BENCH_CODEGEN_VTABLE,
+	BENCH_COMPILE,
+	BENCH_STREAM,
+	BENCH_PHASES,
+} bench_phase_t;
+
+/// parse includes lexing, which the parser drives; sema and codegen run the
+/// phases before them as untimed setup. codegen-vtable is codegen calling
+/// limn2k through its vtable instead of the specialized walker. compile is
+/// seadragon_driver_compile on one thread, and stream is seadragon_driver_stream.
+static const char *bench_phase_names[BENCH_PHASES] = {
+	"lex", "parse", "sema", "codegen", "codegen-vtable", "compile", "stream",
+};
+
+typedef struct {
+	bench_phase_t phase;
+	unsigned int functions;
+	size_t bytes;
+	double seconds;
+	long peak_kib;
+} bench_row_t;
+
+static uint32_t bench_random(uint32_t *state) {
+	// xorshift32; the state must not be zero
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/// Writes an identifier of a prefix and a number, padded with underscores to
+/// the requested length. Numbers keep it clear of keywords.
+static void bench_identifier(FILE *out, char prefix, unsigned int n, unsigned int length) {
+	int written = fprintf(out, "%c%u", prefix, n);
+	for (unsigned int i = written; i < length; i += 1) {
+		fputc('_', out);
+	}
+}
+
+static void bench_auto(FILE *out, const bench_shape_t *shape, uint32_t *state) {
+	bench_identifier(out, 'v', bench_random(state) % shape->autos, shape->identifier);
+}
+
+static void bench_read(FILE *out, const bench_shape_t *shape, uint32_t *state) {
+	bench_auto(out, shape, state);
+	fputs("@ ", out);
+}
+
+static void bench_write(FILE *out, const bench_shape_t *shape, uint32_t *state) {
+	bench_auto(out, shape, state);
+	fputs(" ! ", out);
+}
+
+/// An address into the buffer, from a variable masked to its size.
+static void bench_address(FILE *out, const bench_shape_t *shape, uint32_t *state) {
+	bench_read(out, shape, state);
+	fputs("15 & 4 * ", out);
+	bench_identifier(out, 'b', 0, shape->identifier);
+	fputs(" + ", out);
+}
+
+static void bench_statement(FILE *out, const bench_shape_t *shape, uint32_t *state) {
+	static const char *operators[] = { "+", "-", "*", "&", "|", "<<", ">>" };
+	static const char *comparisons[] = { "<", ">", "<=", ">=", "==", "~=" };
+	switch (bench_random(state) % 6) {
+	case 0:
+	case 1:
+		bench_read(out, shape, state);
+		bench_read(out, shape, state);
+		fprintf(out, "%s %u %s ", operators[bench_random(state) % 7], bench_random(state) % 100 + 1, operators[bench_random(state) % 7]);
+		bench_write(out, shape, state);
+		break;
+	case 2:
+		bench_read(out, shape, state);
+		bench_address(out, shape, state);
+		fputs("! ", out);
+		break;
+	case 3:
+		bench_address(out, shape, state);
+		fputs("@ ", out);
+		bench_write(out, shape, state);
+		break;
+	case 4:
+		fputs("if (", out);
+		bench_read(out, shape, state);
+		bench_read(out, shape, state);
+		fprintf(out, "%s) ", comparisons[bench_random(state) % 6]);
+		bench_read(out, shape, state);
+		fputs("1 + ", out);
+		bench_write(out, shape, state);
+		fputs("else ", out);
+		bench_read(out, shape, state);
+		fprintf(out, "%u / ", bench_random(state) % 9 + 1);
+		bench_write(out, shape, state);
+		fputs("end ", out);
+		break;
+	default:
+		fputs("while (", out);
+		bench_read(out, shape, state);
+		fprintf(out, "%u <) ", bench_random(state) % 64);
+		bench_read(out, shape, state);
+		fputs("1 + ", out);
+		bench_write(out, shape, state);
+		fputs("end ", out);
+		break;
+	}
+	fputc('\n', out);
+}
+
+/// Generates a program of the given shape; the same shape always gives the
+/// same text. Returns NULL if it cannot be allocated.
+static char *bench_generate(const bench_shape_t *shape, size_t *length) {
+	char *text = NULL;
+	FILE *out = open_memstream(&text, length);
+	if (!out) {
+		return NULL;
+	}
+	uint32_t state = shape->seed ? shape->seed : 1;
+	fputs("buffer ", out);
+	bench_identifier(out, 'b', 0, shape->identifier);
+	fputs(" 64\n", out);
+	for (unsigned int f = 0; f < shape->functions; f += 1) {
+		fputs("fn ", out);
+		bench_identifier(out, 'f', f, shape->identifier);
+		fputs(" {-- ", out);
+		bench_identifier(out, 'r', 0, shape->identifier);
+		fputs("}", out);
+		for (unsigned int a = 0; a < shape->autos; a += 1) {
+			fputs(" auto ", out);
+			bench_identifier(out, 'v', a, shape->identifier);
+		}
+		fputc('\n', out);
+		for (unsigned int s = 0; s < shape->statements; s += 1) {
+			bench_statement(out, shape, &state);
+		}
+		bench_read(out, shape, &state);
+		bench_identifier(out, 'r', 0, shape->identifier);
+		fputs(" !\nend\n", out);
+	}
+	if (fclose(out)) {
+		free(text);
+		return NULL;
+	}
+	return text;
+}
+
+static double bench_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// Frees a program that has been through codegen. Only its functions are
+/// large enough to matter across repetitions.
+static void bench_free(seadragon_ast_t *ast) {
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_ir_free_function(ast->functions->items[i]);
+	}
+	list_free(ast->functions);
+}
+
+/// Constructs limn2k, but is not seadragon_backend_limn2k itself, so codegen
+/// calls it through the vtable.
+static seadragon_backend_t *bench_limn2k_vtable(seadragon_session_t *session, FILE *out) {
+	return seadragon_backend_limn2k(session, out);
+}
+
+static double bench_session_phase(seadragon_session_t *session, bench_phase_t phase, const char *text, size_t length, FILE *sink) {
+	seadragon_lexer_t lexer;
+	seadragon_ast_t ast;
+	seadragon_source_t source = { .name = "<bench>", .text = text, .length = length };
+	double start = bench_now();
+	if (phase == BENCH_COMPILE) {
+		return seadragon_driver_compile(session, &source, 1, sink, seadragon_backend_limn2k) ? bench_now() - start : -1;
+	}
+	if (phase == BENCH_STREAM) {
+		return seadragon_driver_stream(session, &source, 1, sink, seadragon_backend_limn2k) ? bench_now() - start : -1;
+	}
+	if (!seadragon_lexer_init(&lexer, source.name, text, length)) {
+		return -1;
+	}
+	if (phase == BENCH_LEX) {
+		seadragon_token_t token;
+		do {
+			token = seadragon_lexer_next(&lexer, SEADRAGON_LEXER_CATEGORY_PARSER);
+		} while (token.kind != SEADRAGON_TK_EOF && token.kind != SEADRAGON_TK_ERROR);
+		double seconds = bench_now() - start;
+		seadragon_lexer_deinit(&lexer);
+		return token.kind == SEADRAGON_TK_EOF ? seconds : -1;
+	}
+	double seconds = -1;
+	start = bench_now();
+	bool success = seadragon_parse(session, &ast, &lexer) != NULL;
+	seadragon_lexer_deinit(&lexer);
+	if (phase == BENCH_PARSE) {
+		seconds = bench_now() - start;
+	}
+	start = bench_now();
+	success = success && seadragon_sema(session, &ast);
+	if (phase == BENCH_SEMA) {
+		seconds = bench_now() - start;
+	}
+	start = bench_now();
+	success = success && seadragon_cg(session, &ast, sink, phase == BENCH_CODEGEN_VTABLE ? bench_limn2k_vtable : seadragon_backend_limn2k);
+	if (phase == BENCH_CODEGEN || phase == BENCH_CODEGEN_VTABLE) {
+		seconds = bench_now() - start;
+	}
+	if (success) {
+		bench_free(&ast);
+	}
+	return success ? seconds : -1;
+}
+
+/// Runs one phase once, returning the seconds it took, or a negative number on
+/// failure.
+static double bench_phase(bench_phase_t phase, const char *text, size_t length, FILE *sink) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	session.threads = 1;
+	double seconds = bench_session_phase(&session, phase, text, length, sink);
+	seadragon_session_deinit(&session);
+	return seconds;
+}
+
+/// Measures a phase at one size in a child process, keeping the fastest of
+/// the repetitions. Returns false if it fails.
+static bool bench_measure(bench_phase_t phase, const char *text, size_t length, unsigned int repeat, bench_row_t *row) {
+	int fds[2];
+	if (pipe(fds)) {
+		return false;
+	}
+	fflush(stdout);
+	pid_t child = fork();
+	if (child < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (child == 0) {
+		close(fds[0]);
+		// Codegen writes to the sink
+		FILE *sink = fopen("/dev/null", "w");
+		if (!sink) {
+			_exit(1);
+		}
+		double best = -1;
+		for (unsigned int i = 0; i < repeat; i += 1) {
+			double seconds = bench_phase(phase, text, length, sink);
+			if (seconds < 0) {
+				_exit(1);
+			}
+			best = best < 0 || seconds < best ? seconds : best;
+		}
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		row->seconds = best;
+		row->peak_kib = usage.ru_maxrss;
+		bool sent = write(fds[1], row, sizeof(*row)) == sizeof(*row);
+		_exit(sent ? 0 : 1);
+	}
+	close(fds[1]);
+	bool received = read(fds[0], row, sizeof(*row)) == sizeof(*row);
+	close(fds[0]);
+	int status;
+	waitpid(child, &status, 0);
+	return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void bench_print(FILE *out, const bench_row_t *row) {
+	fprintf(out, "%s\t%u\t%zu\t%.6f\t%.3f\t%ld\n", bench_phase_names[row->phase], row->functions, row->bytes, row->seconds,
+		row->bytes / row->seconds / 1e6, row->peak_kib);
+}
+
+/// Reads the rows of a previous run, skipping comments. Returns NULL if the
+/// file cannot be read or a row is malformed.
+static bench_row_t *bench_read_baseline(const char *path, unsigned int *count) {
+	FILE *in = fopen(path, "r");
+	if (!in) {
+		return NULL;
+	}
+	bench_row_t *rows = NULL;
+	unsigned int capacity = 0;
+	*count = 0;
+	char line[256], phase[32];
+	bool valid = true;
+	while (valid && fgets(line, sizeof(line), in)) {
+		if (line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 32;
+			rows = realloc(rows, capacity * sizeof(bench_row_t));
+		}
+		bench_row_t *row = &rows[*count];
+		double throughput;
+		valid = sscanf(line, "%31s %u %zu %lf %lf %ld", phase, &row->functions, &row->bytes, &row->seconds, &throughput, &row->peak_kib) == 6;
+		row->phase = BENCH_PHASES;
+		for (unsigned int p = 0; p < BENCH_PHASES; p += 1) {
+			if (!strcmp(phase, bench_phase_names[p])) {
+				row->phase = p;
+			}
+		}
+		valid = valid && row->phase != BENCH_PHASES;
+		*count += 1;
+	}
+	fclose(in);
+	if (!valid) {
+		free(rows);
+		return NULL;
+	}
+	return rows;
+}
+
+/// Compares a row with the baseline row for the same phase and corpus, if
+/// there is one. Returns false on a regression beyond tolerance (a fraction).
+static bool bench_compare(const bench_row_t *row, const bench_row_t *baseline, unsigned int count, double tolerance) {
+	for (unsigned int i = 0; i < count; i += 1) {
+		const bench_row_t *base = &baseline[i];
+		if (base->phase != row->phase || base->functions != row->functions || base->bytes != row->bytes) {
+			continue;
+		}
+		bool success = true;
+		if (row->seconds > base->seconds * (1 + tolerance)) {
+			fprintf(stderr, "regression: %s at %u functions took %.6fs, baseline %.6fs (%+.1f%%)\n", bench_phase_names[row->phase],
+				row->functions, row->seconds, base->seconds, (row->seconds / base->seconds - 1) * 100);
+			success = false;
+		}
+		if (row->peak_kib > base->peak_kib * (1 + tolerance)) {
+			fprintf(stderr, "regression: %s at %u functions peaked at %ld KiB, baseline %ld KiB\n", bench_phase_names[row->phase],
+				row->functions, row->peak_kib, base->peak_kib);
+			success = false;
+		}
+		return success;
+	}
+	return true;
+}
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "Usage: %s [-f FUNCTIONS] [-i STATEMENTS] [-a AUTOS] [-l IDENTIFIER_LENGTH] [-s SEED] [-n SIZES] [-r REPEAT]\n"
+		"\t[-c BASELINE [-t PERCENT]] [-g]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+	bench_shape_t shape = { .functions = 250, .statements = 20, .autos = 4, .identifier = 8, .seed = 1 };
+	unsigned int sizes = 4, repeat = 3;
+	double tolerance = 0.10;
+	const char *baseline_path = NULL;
+	bool generate = false;
+	int option;
+	while ((option = getopt(argc, argv, "f:i:a:l:s:n:r:c:t:gh")) != -1) {
+		switch (option) {
+		case 'f':
+			shape.functions = strtoul(optarg, NULL, 10);
+			break;
+		case 'i':
+			shape.statements = strtoul(optarg, NULL, 10);
+			break;
+		case 'a':
+			shape.autos = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			shape.identifier = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			shape.seed = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			sizes = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			repeat = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			baseline_path = optarg;
+			break;
+		case 't':
+			tolerance = strtod(optarg, NULL) / 100;
+			break;
+		case 'g':
+			generate = true;
+			break;
+		default:
+			usage(argv[0]);
+			return option == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc || !shape.functions || !shape.autos || !sizes || !repeat) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (generate) {
+		size_t length;
+		char *text = bench_generate(&shape, &length);
+		if (!text) {
+			return 1;
+		}
+		fwrite(text, 1, length, stdout);
+		free(text);
+		return 0;
+	}
+	bench_row_t *baseline = NULL;
+	unsigned int baseline_count = 0;
+	if (baseline_path && !(baseline = bench_read_baseline(baseline_path, &baseline_count))) {
+		fprintf(stderr, "%s: error: Unable to read baseline\n", baseline_path);
+		return 1;
+	}
+	printf("# functions=%u statements=%u autos=%u identifier=%u seed=%u repeat=%u\n", shape.functions, shape.statements, shape.autos,
+		shape.identifier, shape.seed, repeat);
+	printf("# phase\tfunctions\tbytes\tseconds\tmb_per_s\tpeak_kib\n");
+	bool success = true, regressed = false;
+	bench_shape_t scaled = shape;
+	for (unsigned int s = 0; success && s < sizes; s += 1, scaled.functions *= 2) {
+		size_t length;
+		char *text = bench_generate(&scaled, &length);
+		success = text != NULL;
+		for (unsigned int p = 0; success && p < BENCH_PHASES; p += 1) {
+			bench_row_t row = { .phase = p, .functions = scaled.functions, .bytes = length };
+			success = bench_measure(p, text, length, repeat, &row);
+			if (success) {
+				bench_print(stdout, &row);
+				regressed |= !bench_compare(&row, baseline, baseline_count, tolerance);
+			}
+			else {
+				fprintf(stderr, "error: Bench: %s failed at %u functions\n", bench_phase_names[p], scaled.functions);
+			}
+		}
+		free(text);
+	}
+	free(baseline);
+	return success && !regressed ? 0 : 1;
+}
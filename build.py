@@ -38,7 +38,7 @@ OBJ_DIR = os.path.join(BUILD_DIR, 'obj')
 EXE_EXT = '.exe' if os.name == 'nt' else ''
 BIN_NAME = PROJECT_NAME + EXE_EXT
 
-DEFAULT_FLAGS = {'-Wall', '-pedantic', '-D_POSIX_C_SOURCE=200809L' }
+DEFAULT_FLAGS = {'-Wall', '-pedantic', '-pthread', '-D_POSIX_C_SOURCE=200809L' }
 DEBUG_FLAGS = {'-g', '-Og', '-D_DEBUG'}
 # pixelherodev's personal flag set :P I'm insane, I know.
 PIXELS_DEVEL_FLAGS = { '-Werror', '-Wextra', '-Wno-error=reorder', '-Wno-error=pedantic', '-Wno-error=unused-parameter', '-Wno-error=missing-field-initializers', '-Wno-error=deprecated-declarations', '-pedantic', '-march=native', '-mtune=native', '-falign-functions=32' }
@@ -46,7 +46,7 @@ RELEASE_FLAGS = {'-O2'}
 
 # these *do* need to be in order, so no sets!
 # We don't need anything in BASE right now, but we might later.
-BASE_LDFLAGS = [ ]
+BASE_LDFLAGS = [ '-pthread' ]
 DEFAULT_LDFLAGS = ['-static', '-static-libgcc' ] + BASE_LDFLAGS
 
 # parse arguments
@@ -61,6 +61,8 @@ parser.add_argument('-B', dest='force_rebuild', action='store_true',
                     help='Force rebuilding the project')
 parser.add_argument('-r', dest='dynamic', action='store_true',
                     help='Build a dynamic executable')
+parser.add_argument('--dynamic-codegen', dest='dynamic_codegen', action='store_true',
+                    help='Only call backends through their vtable, without the codegen walker specialized for limn2k')
 parser.add_argument('-j', dest='num_threads', nargs='?',
                     type=int, default=max(multiprocessing.cpu_count() // 2, 1),
                     help='Number of threads to run `make` with')
@@ -69,6 +71,8 @@ args = parser.parse_args()
 if '-O2' not in args.cflags_mode:
     VERSION = VERSION + '-' + str(BUMP_VER)
 CFLAGS = DEFAULT_FLAGS | {'-std=c99'} | args.cflags_mode | (set(itertools.chain(*args.cflags)) if args.cflags else set()) | { '-DPROJECT_VERSION=' + VERSION }
+if args.dynamic_codegen:
+    CFLAGS.add('-DSEADRAGON_CG_DYNAMIC')
 LDFLAGS = DEFAULT_LDFLAGS
 if args.dynamic:
     LDFLAGS = BASE_LDFLAGS
@@ -145,17 +149,30 @@ class Executable(Target):
     def __init__(self, name):
         super().__init__(name, {name + EXE_EXT})
 
-with SourceLibrary(PROJECT_NAME) as ProjectLibrary:
+with SourceLibrary('lib' + PROJECT_NAME) as ProjectLibrary:
     # For now, we'll add all headers in src/ recursively
     ProjectLibrary.add_headers_glob('src/**/*.h')
     # For now, we'll add all .c sources in src/ recursively
     ProjectLibrary.add_sources_glob('src/**/*.c')
 
+with Executable(PROJECT_NAME) as Compiler:
+    Compiler.add_sources_glob('cli/main.c')
+    Compiler.add_dependencies(ProjectLibrary)
+    Compiler.add_includes('src/')
+
 with Executable('test') as Test:
     Test.add_sources_glob('test/main.c')
     Test.add_headers_glob('test/test.h')
-    Test.add_dependencies(PROJECT_NAME)
+    Test.add_dependencies(ProjectLibrary)
     Test.add_includes('src/')
+    # Benchmarks count allocations by replacing malloc, which needs dynamic linking
+    if args.dynamic:
+        Test.add_cflags('-DTEST_BENCH_COUNT_ALLOCS')
+
+with Executable('bench') as Bench:
+    Bench.add_sources_glob('bench/main.c')
+    Bench.add_dependencies(ProjectLibrary)
+    Bench.add_includes('src/')
 
 # create object directories
 for tgt in Target.all.values():
@@ -169,8 +186,8 @@ CFLAGS+={CFLAGS}
 LDFLAGS+={LDFLAGS}
 INCLUDES+={includes_all}
 
-.PHONY: default all test
-default: test
+.PHONY: default all test bench
+default: all
 \t./{BIN_DIR}/test
 
 all: {targets_all}
@@ -183,7 +200,7 @@ HEADERS={headers_all}
     LDFLAGS=' '.join(LDFLAGS),
     BIN_DIR=BIN_DIR,
     OBJ_DIR=OBJ_DIR,
-    targets_all=' '.join(Target.all),
+    targets_all=' '.join(name for name, tgt in Target.all.items() if tgt.artifacts),
     # TODO: These should be per-target (but currently cannot be because of %.o: %.c rules)
     includes_all=' '.join(sorted({'-I' + inc for inc in itertools.chain.from_iterable(tgt.includes for tgt in Target.all.values())})),
     headers_all=' '.join(sorted(set(itertools.chain.from_iterable(tgt.headers for tgt in Target.all.values())))),
@@ -0,0 +1,318 @@
+#include "driver.h"
+#include "codegen.h"
+#include "interp.h"
+#include "module.h"
+#include "profile.h"
+#include "sema.h"
+#include "server.h"
+#include "backends/limn2k.h"
+#include "backends/c99.h"
+#include "backends/limn2k_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "Usage: %s [-b limn2k|c99 | -x FUNCTION | -S FUNCTION] [-s | -j THREADS] [-g MAP | -p PROFILE] [-m MODULE]... [-f] [-e FUNCTION]... [-o OUTPUT] SOURCE...\n"
+		"       %s -D SOCKET [-m MODULE]...\n"
+		"       %s -c SOCKET [OPTION]... SOURCE...\n", argv0, argv0, argv0);
+}
+
+typedef struct {
+	struct stat st;
+	seadragon_module_t module;
+} preloaded_module_t;
+
+/// Modules mapped by the compile server before it started serving, which the
+/// requests it forks share.
+static list_t *preloaded;
+
+/// Maps a module, or finds it among the preloaded ones if the file is unchanged
+/// since. Modules that were mapped here are flagged in owned.
+static seadragon_module_t *load_module(const char *path, bool *owned) {
+	struct stat st;
+	for (unsigned int i = 0; preloaded && !stat(path, &st) && i < preloaded->length; i += 1) {
+		preloaded_module_t *entry = preloaded->items[i];
+		if (entry->st.st_dev == st.st_dev && entry->st.st_ino == st.st_ino && entry->st.st_size == st.st_size
+				&& entry->st.st_mtime == st.st_mtime) {
+			*owned = false;
+			return &entry->module;
+		}
+	}
+	seadragon_module_t *module = malloc(sizeof(seadragon_module_t));
+	if (!seadragon_module_map(module, path)) {
+		fprintf(stderr, "%s: error: Unable to load module\n", path);
+		free(module);
+		return NULL;
+	}
+	*owned = true;
+	return module;
+}
+
+/// Interprets a function of a checked program, printing its outputs.
+static bool execute(seadragon_ast_t *program, const char *name, FILE *out) {
+	seadragon_interp_t *interp = seadragon_interp_compile(program, SEADRAGON_INTERP_MEMORY);
+	unsigned int count;
+	if (!interp || !seadragon_interp_lookup(interp, name, &count)) {
+		fprintf(stderr, "%s: error: Unknown function\n", name);
+		if (interp) {
+			seadragon_interp_free(interp);
+		}
+		return false;
+	}
+	uint32_t *outputs = calloc(count + 1, sizeof(uint32_t));
+	bool success = seadragon_interp_run(interp, name, outputs);
+	for (unsigned int i = 0; success && i < count; i += 1) {
+		fprintf(out, "%u\n", outputs[i]);
+	}
+	free(outputs);
+	seadragon_interp_free(interp);
+	return success;
+}
+
+/// Generates limn2k code for a checked program and runs a function of it on
+/// the simulator, printing its two output registers, then the cycle report to
+/// stderr.
+static bool simulate(seadragon_session_t *session, seadragon_ast_t *program, const char *name, FILE *out) {
+	char *text = NULL;
+	size_t length = 0;
+	FILE *assembly = open_memstream(&text, &length);
+	bool success = assembly && seadragon_cg(session, program, assembly, seadragon_backend_limn2k);
+	if (assembly) {
+		fclose(assembly);
+	}
+	seadragon_limn2k_sim_t *sim = success ? seadragon_limn2k_sim_assemble(text, length, SEADRAGON_INTERP_MEMORY, NULL) : NULL;
+	free(text);
+	if (!sim) {
+		return false;
+	}
+	uint32_t outputs[2];
+	success = seadragon_limn2k_sim_run(sim, name, outputs);
+	if (success) {
+		fprintf(out, "%u\n%u\n", outputs[0], outputs[1]);
+		seadragon_limn2k_sim_report(sim, stderr, 10);
+	}
+	seadragon_limn2k_sim_free(sim);
+	return success;
+}
+
+/// Compiles the whole program against the modules, instrumented if map is
+/// set, or optimized for the profile if it is set. If run is set, that
+/// function is interpreted instead of generating code, or simulated if sim is
+/// also set.
+static bool compile(seadragon_session_t *session, seadragon_source_t *sources, unsigned int count, FILE *out, FILE *map,
+		seadragon_profile_t *profile, list_t *modules, seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out),
+		const char *run, bool sim) {
+	seadragon_ast_t program;
+	if (!seadragon_driver_parse(session, &program, sources, count)) {
+		return false;
+	}
+	list_cat(program.modules, modules);
+	program.profile = profile;
+	if (!seadragon_sema(session, &program) || (map && !seadragon_profile_instrument(&program, map))) {
+		return false;
+	}
+	if (run) {
+		return sim ? simulate(session, &program, run, out) : execute(&program, run, out);
+	}
+	return seadragon_cg(session, &program, out, backend);
+}
+
+/// Loads the modules at paths into modules, listing those mapped here, rather
+/// than preloaded, in owned.
+static bool load_modules(list_t *paths, list_t *modules, list_t *owned) {
+	for (unsigned int i = 0; i < paths->length; i += 1) {
+		bool mapped;
+		seadragon_module_t *module = load_module(paths->items[i], &mapped);
+		if (!module) {
+			return false;
+		}
+		list_add(modules, module);
+		if (mapped) {
+			list_add(owned, module);
+		}
+	}
+	return true;
+}
+
+/// The command line, which the compile server also runs for its clients.
+static int compiler(int argc, char **argv) {
+	unsigned int threads = 0;
+	bool stream = false, sim = false;
+	const char *output = NULL, *map_path = NULL, *profile_path = NULL, *run = NULL;
+	seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out) = seadragon_backend_limn2k;
+	list_t *module_paths = list_create(), *roots = list_create();
+	bool fold = false;
+	int option;
+	while ((option = getopt(argc, argv, "b:j:o:sg:p:x:S:m:fe:h")) != -1) {
+		switch (option) {
+		case 'b':
+			if (!strcmp(optarg, "limn2k")) {
+				backend = seadragon_backend_limn2k;
+			}
+			else if (!strcmp(optarg, "c99")) {
+				backend = seadragon_backend_c99;
+			}
+			else {
+				fprintf(stderr, "%s: error: Unknown backend\n", optarg);
+				list_free(module_paths);
+				list_free(roots);
+				return 1;
+			}
+			break;
+		case 'j':
+			threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 's':
+			stream = true;
+			break;
+		case 'g':
+			map_path = optarg;
+			break;
+		case 'p':
+			profile_path = optarg;
+			break;
+		case 'x':
+		case 'S':
+			run = optarg;
+			sim = option == 'S';
+			break;
+		case 'm':
+			list_add(module_paths, optarg);
+			break;
+		case 'f':
+			fold = true;
+			break;
+		case 'e':
+			list_add(roots, optarg);
+			break;
+		default:
+			usage(argv[0]);
+			list_free(module_paths);
+			list_free(roots);
+			return option == 'h' ? 0 : 1;
+		}
+	}
+	bool streamable = !map_path && !profile_path && !run && !module_paths->length;
+	// Only limn2k output is linked
+	bool linkable = backend == seadragon_backend_limn2k && !run;
+	if (optind >= argc || (stream && !streamable) || (map_path && profile_path) || ((fold || roots->length) && !linkable)) {
+		usage(argv[0]);
+		list_free(module_paths);
+		list_free(roots);
+		return 1;
+	}
+	seadragon_profile_t *profile = NULL;
+	if (profile_path) {
+		FILE *in = fopen(profile_path, "r");
+		profile = in ? seadragon_profile_read(in) : NULL;
+		if (in) {
+			fclose(in);
+		}
+		if (!profile) {
+			fprintf(stderr, "%s: error: Unable to read profile\n", profile_path);
+			list_free(module_paths);
+			list_free(roots);
+			return 1;
+		}
+	}
+	FILE *map = map_path ? fopen(map_path, "w") : NULL;
+	if (map_path && !map) {
+		fprintf(stderr, "%s: error: Unable to open counter map\n", map_path);
+		list_free(module_paths);
+		list_free(roots);
+		return 1;
+	}
+	unsigned int count = argc - optind;
+	seadragon_source_t *sources = calloc(count, sizeof(seadragon_source_t));
+	for (unsigned int i = 0; i < count; i += 1) {
+		sources[i].name = argv[optind + i];
+	}
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "%s: error: Unable to open output\n", output);
+		free(sources);
+		list_free(module_paths);
+		list_free(roots);
+		return 1;
+	}
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	session.threads = threads;
+	session.roots = roots->length ? roots : NULL;
+	session.fold = fold;
+	list_t *modules = list_create(), *owned = list_create();
+	bool success = load_modules(module_paths, modules, owned);
+	success = success && (stream ? seadragon_driver_stream(&session, sources, count, out, backend)
+		: compile(&session, sources, count, out, map, profile, modules, backend, run, sim));
+	seadragon_session_deinit(&session);
+	if (out != stdout) {
+		fclose(out);
+	}
+	if (map) {
+		fclose(map);
+	}
+	if (profile) {
+		seadragon_profile_free(profile);
+	}
+	for (unsigned int i = 0; i < owned->length; i += 1) {
+		seadragon_module_unmap(owned->items[i]);
+		free(owned->items[i]);
+	}
+	list_free(owned);
+	list_free(modules);
+	list_free(module_paths);
+	list_free(roots);
+	free(sources);
+	return success ? 0 : 1;
+}
+
+/// Preloads the modules named by `-m` options, then serves requests forever.
+static int serve(const char *path, int argc, char **argv) {
+	preloaded = list_create();
+	int option;
+	while ((option = getopt(argc, argv, "m:")) != -1) {
+		preloaded_module_t *entry = malloc(sizeof(preloaded_module_t));
+		if (option != 'm' || stat(optarg, &entry->st) || !seadragon_module_map(&entry->module, optarg)) {
+			if (option == 'm') {
+				fprintf(stderr, "%s: error: Unable to load module\n", optarg);
+			}
+			else {
+				usage(argv[0]);
+			}
+			free(entry);
+			return 1;
+		}
+		list_add(preloaded, entry);
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	seadragon_server_serve(path, compiler);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	// The server and its clients take the socket first, leaving the rest of
+	// the command line as the compiler sees it
+	if (argc >= 3 && (!strcmp(argv[1], "-D") || !strcmp(argv[1], "-c"))) {
+		bool serving = argv[1][1] == 'D';
+		const char *path = argv[2];
+		argv[2] = argv[0];
+		if (serving) {
+			return serve(path, argc - 2, argv + 2);
+		}
+		// Without a server, compile here, with the same results
+		int status = seadragon_server_forward(path, argc - 2, argv + 2);
+		return status >= 0 ? status : compiler(argc - 2, argv + 2);
+	}
+	return compiler(argc, argv);
+}
@@ -4,26 +4,66 @@
 #include "lexer.h"
 #include "list.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/// A single field of a structure. `size` and `alignment` are in bytes; `offset`
+/// is only valid once the structure has been laid out.
+typedef struct {
+	char *name;
+	uint32_t size;
+	uint32_t alignment;
+	uint32_t offset;
+	/// Number of references to the field seen by sema, used for reordering.
+	uint32_t uses;
+	/// Hash of the set of functions referencing the field; fields with equal
+	/// signatures are accessed together.
+	uint64_t signature;
+} seadragon_field_t;
+
 /// Structure layout
 /// name is owned by the struct_t, and must be freed when the structure is.
-// TODO
+/// fields is a list of seadragon_field_t, in declaration order until laid out
+/// and in memory order afterwards.
 typedef struct {
 	char *name;
+	list_t *fields;
+	uint32_t size;
+	uint32_t alignment;
+	/// Opt-in: the layout engine may reorder fields to minimize padding and
+	/// group fields that are accessed together.
+	bool reorder;
 } seadragon_struct_t;
 
+typedef struct seadragon_buffer seadragon_buffer_t;
+typedef struct seadragon_profile seadragon_profile_t;
+
 typedef struct {
 	enum {
 		VALUE_TYPE_IDENTIFIER,
 		VALUE_TYPE_LITERAL,
+		/// The address of a buffer; identifiers naming buffers are resolved to
+		/// this by sema.
+		VALUE_TYPE_BUFFER,
 	} type;
 	union {
 		uint32_t literal;
 		char *identifier;
+		seadragon_buffer_t *buffer;
 	} u;
 } seadragon_value_t;
 
+/// Zero-initialized storage, declared with `buffer NAME SIZE`. Only the size
+/// and alignment are emitted, never the contents. declared_size is a literal
+/// or the name of a constant; sema resolves it into size, and alignment is
+/// derived from the size by layout.
+struct seadragon_buffer {
+	char *name;
+	seadragon_value_t *declared_size;
+	uint32_t size;
+	uint32_t alignment;
+};
+
 typedef enum {
 	INSTRUCTION_TYPE_PUSH,
 	INSTRUCTION_TYPE_GLONG,
@@ -34,7 +74,28 @@ typedef enum {
 	INSTRUCTION_TYPE_SBYTE,
 	INSTRUCTION_TYPE_DROP,
 	INSTRUCTION_TYPE_SUB,
+	INSTRUCTION_TYPE_ADD,
+	INSTRUCTION_TYPE_MUL,
+	INSTRUCTION_TYPE_DIV,
+	INSTRUCTION_TYPE_AND,
+	INSTRUCTION_TYPE_OR,
+	INSTRUCTION_TYPE_LSH,
+	INSTRUCTION_TYPE_RSH,
+	INSTRUCTION_TYPE_CLT,
+	INSTRUCTION_TYPE_CGT,
+	INSTRUCTION_TYPE_CLE,
+	INSTRUCTION_TYPE_CGE,
+	INSTRUCTION_TYPE_EQ,
+	INSTRUCTION_TYPE_NE,
 	INSTRUCTION_TYPE_RETURN,
+	/// Structured control flow: `if (cond) ... [else ...] end` is
+	/// IF [cond...] THEN [...] [ELSE [...]] END, and `while (cond) ... end` is
+	/// WHILE [cond...] THEN [...] END.
+	INSTRUCTION_TYPE_IF,
+	INSTRUCTION_TYPE_WHILE,
+	INSTRUCTION_TYPE_THEN,
+	INSTRUCTION_TYPE_ELSE,
+	INSTRUCTION_TYPE_END,
 } seadragon_instruction_type_t;
 
 typedef struct {
@@ -42,38 +103,100 @@ typedef struct {
 	seadragon_value_t *argument;
 } seadragon_instruction_t;
 
-// 0 ret !
-// OPERATION_SLONG { {value=ret} {value=0} } 
+/// A compile-time constant. expression is a list of seadragon_instruction_t in
+/// the same stack form as a function body, restricted to literals, other
+/// constants and arithmetic; sema evaluates it into value.
+typedef struct {
+	char *name;
+	list_t *expression;
+	uint32_t value;
+	enum {
+		CONSTANT_UNEVALUATED,
+		/// Set while the expression is being evaluated, to detect cycles.
+		CONSTANT_EVALUATING,
+		CONSTANT_EVALUATED,
+	} state;
+} seadragon_constant_t;
 
-// { op = OPERATION_SLONG, left = { type = LEAF_VALUE, u.value = { identifier = ret } } }
+typedef enum {
+	/// A value, with no operands: a literal, a buffer address, or the location
+	/// of a variable.
+	OPERATION_NONE,
+	/// Stores the RHS value to the LHS. An identifier LHS names a variable, any
+	/// other LHS is the address of a long in memory.
+	OPERATION_SLONG,
+	/// Stores the RHS value to the address in the LHS.
+	OPERATION_SINT,
+	OPERATION_SBYTE,
+	/// Loads from the address in the LHS; there is no RHS.
+	OPERATION_GLONG,
+	OPERATION_GINT,
+	OPERATION_GBYTE,
+	OPERATION_ADD,
+	OPERATION_SUB,
+	OPERATION_MUL,
+	OPERATION_DIV,
+	OPERATION_AND,
+	OPERATION_OR,
+	OPERATION_LSH,
+	OPERATION_RSH,
+	/// Comparisons; only valid as the condition of a branch.
+	OPERATION_CLT,
+	OPERATION_CGT,
+	OPERATION_CLE,
+	OPERATION_CGE,
+	OPERATION_EQ,
+	OPERATION_NE,
+	OPERATION_RETURN,
+} seadragon_operation_t;
 
-typedef struct seadragon_instruction_leaf seadragon_instruction_leaf_t;
+/// Marks an absent operand, statement or condition.
+#define SEADRAGON_IR_NONE UINT32_MAX
 
+/// The IR of a function: the expression trees of its statements and branch
+/// conditions, stored as parallel arrays with one entry per node and addressed
+/// by index. A value is a node with the operation OPERATION_NONE, and a
+/// statement is the node storing its result. The pool holds no pointers into
+/// itself, so it is copied or released as a handful of arrays. See ir.h.
 typedef struct {
+	/// Per node: the operation, or OPERATION_NONE for a value
+	uint8_t *op;
+	/// Per node: the operands, or SEADRAGON_IR_NONE
+	uint32_t *left, *right;
+	/// Per node: the value of OPERATION_NONE nodes
+	seadragon_value_t *value;
+	uint32_t length, capacity;
+} seadragon_ir_pool_t;
+
+typedef struct seadragon_block seadragon_block_t;
+
+/// A basic block: straight-line statements followed by a single terminator.
+struct seadragon_block {
+	/// Unique within the function, in creation order; used for labels.
+	unsigned int id;
+	/// Roots of the statements in the function's pool, in execution order
+	uint32_t *statements;
+	uint32_t statement_count, statement_capacity;
 	enum {
-		/// For internal use only, should never reach codegen.
-		/// in sema, when a NONE node is encountered, it is overwritten directly with
-		/// an operation.
-		OPERATION_NONE,
-		/// Stores the RHS value to the LHS.
-		OPERATION_SLONG,
-		OPERATION_RETURN,
-	} op;
-	seadragon_instruction_leaf_t *left, *right;
-} seadragon_instruction_node_t;
-
-struct seadragon_instruction_leaf {
-	enum {
-		LEAF_NODE,
-		LEAF_VALUE,
-		LEAF_CODEGENED,
-	} type;
-	union {
-		seadragon_instruction_node_t node;
-		seadragon_value_t *value;
-		// The backend-specific register in which this leaf is stored
-		void *mcval;
-	} u;
+		TERMINATOR_RETURN,
+		TERMINATOR_JUMP,
+		/// Goes to target if the condition holds (a comparison node, or any value
+		/// that is nonzero), and to fallback otherwise.
+		TERMINATOR_BRANCH,
+	} terminator;
+	/// Root of the condition in the function's pool
+	uint32_t condition;
+	seadragon_block_t *target, *fallback;
+	/// Set for `while` headers, which hold the loop's exit test.
+	bool loop_header;
+	/// Set when the block ends in a `return` nested in control flow, which is
+	/// assumed to be an error path.
+	bool early_return;
+	/// Set by layout for blocks that only lead to early returns, or that never
+	/// ran according to the profile.
+	bool cold;
+	/// Times the block ran, if the function is profiled; otherwise 0.
+	uint64_t count;
 };
 
 typedef struct {
@@ -83,8 +206,15 @@ typedef struct {
 	list_t *autos;
 	union {
 		list_t *instructions;
-		seadragon_instruction_node_t root;
+		/// After sema: list of seadragon_block_t in layout order; the first block
+		/// is the entry.
+		list_t *blocks;
 	} u;
+	/// After sema: the nodes of the blocks' statements and conditions
+	seadragon_ir_pool_t pool;
+	/// Set by sema when block counts were taken from a profile, which then
+	/// replaces the static heuristics of layout.
+	bool profiled;
 } seadragon_function_t;
 
 /// All lists are owned by the ast_t and must be freed when the tree is.
@@ -92,6 +222,14 @@ typedef struct {
 	list_t *structures;
 	list_t *functions;
 	list_t *constants;
+	/// list of seadragon_buffer_t, in declaration order until sema, which sorts
+	/// them into the order they are emitted in.
+	list_t *buffers;
+	/// list of seadragon_module_t, precompiled modules whose constants and
+	/// structures may be referenced. The modules are borrowed.
+	list_t *modules;
+	/// Execution counts to optimize for, or NULL; borrowed. See profile.h.
+	seadragon_profile_t *profile;
 } seadragon_ast_t;
 
 #endif // SEADRAGON_AST_H_
@@ -6,12 +6,53 @@
 
 #include "ast.h"
 
+/// Registers are opaque to codegen; every register passed to a backend was
+/// returned by the same backend's register_allocate or register_temporary.
+///
+/// Backends are constructed with the session of the compile, and report
+/// errors through it, returning without emitting anything; codegen checks
+/// the session rather than each call. Running out of registers is not
+/// reported: the register functions return NULL instead.
 typedef struct {
 	void(*begin_function)(void *backend, seadragon_function_t *func);
+	/// Called once all of the current function's code has been generated, so
+	/// backends may buffer it. Optional.
+	void (*end_function)(void *backend);
 	void* (*register_allocate)(void *backend, char *identifier);
+	/// Reserves a scratch register until it is passed to register_free.
+	void* (*register_temporary)(void *backend);
+	/// Releases a scratch register; registers bound to an identifier are unaffected.
+	void (*register_free)(void *backend, void *reg);
+	/// Sets reg to a literal, or to the address of a buffer.
 	void (*set_long)(void *backend, void *reg, seadragon_value_t *val);
+	void (*move)(void *backend, void *dst, void *src);
+	/// dst = lhs op rhs, for the arithmetic operations (OPERATION_ADD, ...)
+	void (*arith)(void *backend, seadragon_operation_t op, void *dst, void *lhs, void *rhs);
+	void (*arith_immediate)(void *backend, seadragon_operation_t op, void *dst, void *lhs, uint32_t imm);
+	/// Memory accesses, op is one of OPERATION_G* / OPERATION_S*. The address is
+	/// base + offset, or just offset if base is NULL; a load writes val, a store
+	/// reads it.
+	void (*memory)(void *backend, seadragon_operation_t op, void *val, void *base, uint32_t offset);
+	/// Control flow between the blocks of the current function, identified by
+	/// their ids. A NULL rhs compares against zero.
+	void (*label)(void *backend, unsigned int block);
+	void (*jump)(void *backend, unsigned int block);
+	/// Branches if `lhs op rhs` holds, op being one of the comparisons.
+	void (*branch)(void *backend, seadragon_operation_t op, void *lhs, void *rhs, unsigned int block);
 	void (*ret)(void *backend);
+	/// Reserves zero-initialized storage for a buffer, after all functions.
+	/// Buffers are passed in decreasing order of alignment. Only required if
+	/// the program declares buffers.
+	void (*buffer)(void *backend, seadragon_buffer_t *buffer);
+	/// Called once, after the last function and buffer. Optional.
+	void (*end)(void *backend);
+	/// Frees the backend. Optional, for backends only freed by their creator.
+	void (*deinit)(void *backend);
 } seadragon_backend_t;
 
-#endif // SEADRAGON_BACKEND_H_
+/// The members every backend provides, as an X-macro: X(member) is expanded
+/// for each of them in turn.
+#define SEADRAGON_BACKEND_REQUIRED(X) X(begin_function) X(register_allocate) X(register_temporary) X(register_free) \
+	X(set_long) X(move) X(arith) X(arith_immediate) X(memory) X(label) X(jump) X(branch) X(ret)
 
+#endif // SEADRAGON_BACKEND_H_
@@ -0,0 +1,335 @@
+#include "c99.h"
+#include "list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ERROR(msg) seadragon_session_error(backend->session, "%s:%d: error: c99: %s", __FILE__, __LINE__, msg)
+
+/// A local of the current function; registers handed to codegen point to one.
+typedef struct {
+	char *name;
+	/// The variable's identifier, or NULL for a temporary
+	const char *identifier;
+	/// Set while a temporary is reserved
+	bool busy;
+} seadragon_c99_variable;
+
+typedef struct {
+	seadragon_backend_t base;
+	seadragon_function_t *function;
+	/// list of seadragon_c99_variable, the variables first, in declaration order
+	list_t *variables;
+	/// list of seadragon_buffer_t referenced by the current function
+	list_t *buffers;
+	/// The current function's statements; its locals are only known once all
+	/// of it has been generated
+	char *body;
+	size_t body_length;
+	FILE *code;
+	/// Next free offset from SEADRAGON_BSS
+	uint32_t bss;
+	FILE *out;
+	seadragon_session_t *session;
+} seadragon_c99;
+
+static const char seadragon_c99_prelude[] =
+	"/* Generated by seadragon */\n"
+	"#include <stdint.h>\n"
+	"#include <stdlib.h>\n"
+	"#include <string.h>\n"
+	"\n"
+	"extern uint8_t *seadragon_memory;\n"
+	"#ifndef SEADRAGON_BSS\n"
+	"#define SEADRAGON_BSS 0x80000000u\n"
+	"#endif\n"
+	"\n"
+	"static inline uint32_t df_l_l(uint32_t a) { uint32_t v; memcpy(&v, seadragon_memory + a, 4); return v; }\n"
+	"static inline uint32_t df_l_i(uint32_t a) { uint16_t v; memcpy(&v, seadragon_memory + a, 2); return v; }\n"
+	"static inline uint32_t df_l_b(uint32_t a) { return seadragon_memory[a]; }\n"
+	"static inline void df_s_l(uint32_t a, uint32_t v) { memcpy(seadragon_memory + a, &v, 4); }\n"
+	"static inline void df_s_i(uint32_t a, uint32_t v) { uint16_t w = (uint16_t)v; memcpy(seadragon_memory + a, &w, 2); }\n"
+	"static inline void df_s_b(uint32_t a, uint32_t v) { seadragon_memory[a] = (uint8_t)v; }\n"
+	"static inline uint32_t df_div(uint32_t a, uint32_t b) { if (!b) abort(); return a / b; }\n"
+	"static inline uint32_t df_lsh(uint32_t a, uint32_t b) { return b < 32 ? a << b : 0; }\n"
+	"static inline uint32_t df_rsh(uint32_t a, uint32_t b) { return b < 32 ? a >> b : 0; }\n";
+
+static seadragon_c99_variable *c99_variable(seadragon_c99 *backend, const char *identifier) {
+	seadragon_c99_variable *variable = malloc(sizeof(seadragon_c99_variable));
+	size_t length = identifier ? strlen(identifier) : 0;
+	variable->name = malloc(length + 16);
+	if (!identifier) {
+		sprintf(variable->name, "t%u", backend->variables->length);
+	}
+	else if (identifier[0] == '$') {
+		// Introduced by the optimizer; `$` is not valid in C identifiers
+		sprintf(variable->name, "x_%s", identifier + 1);
+	}
+	else {
+		sprintf(variable->name, "l_%s", identifier);
+	}
+	variable->identifier = identifier;
+	variable->busy = true;
+	list_add(backend->variables, variable);
+	return variable;
+}
+
+static void c99_reset(seadragon_c99 *backend) {
+	for (unsigned int i = 0; i < backend->variables->length; i += 1) {
+		seadragon_c99_variable *variable = backend->variables->items[i];
+		free(variable->name);
+		free(variable);
+	}
+	backend->variables->length = 0;
+	backend->buffers->length = 0;
+}
+
+static const char *c99_name(void *reg) {
+	return ((seadragon_c99_variable*)reg)->name;
+}
+
+static void c99_begin_function(void *_backend, seadragon_function_t *func) {
+	seadragon_c99 *backend = _backend;
+	c99_reset(backend);
+	backend->function = func;
+	list_t *lists[] = { func->inputs, func->outputs, func->autos };
+	for (unsigned int i = 0; i < sizeof(lists) / sizeof(*lists); i += 1) {
+		for (unsigned int j = 0; j < lists[i]->length; j += 1) {
+			c99_variable(backend, lists[i]->items[j]);
+		}
+	}
+	backend->code = open_memstream(&backend->body, &backend->body_length);
+	if (!backend->code) {
+		ERROR("Unable to buffer function");
+		return;
+	}
+}
+
+static void c99_end_function(void *_backend) {
+	seadragon_c99 *backend = _backend;
+	seadragon_function_t *func = backend->function;
+	fclose(backend->code);
+	FILE *out = backend->out;
+	fprintf(out, "\nvoid df_%s(", func->name);
+	for (unsigned int i = 0; i < func->outputs->length; i += 1) {
+		fprintf(out, "%suint32_t *o_%s", i ? ", " : "", (char*)func->outputs->items[i]);
+	}
+	fprintf(out, "%s) {\n", func->outputs->length ? "" : "void");
+	for (unsigned int i = 0; i < backend->buffers->length; i += 1) {
+		fprintf(out, "\textern const uint32_t df_buffer_%s;\n", ((seadragon_buffer_t*)backend->buffers->items[i])->name);
+	}
+	for (unsigned int i = 0; i < backend->variables->length; i += 1) {
+		seadragon_c99_variable *variable = backend->variables->items[i];
+		fprintf(out, variable->identifier ? "\tuint32_t %s = 0;\n" : "\tuint32_t %s;\n", variable->name);
+	}
+	fwrite(backend->body, 1, backend->body_length, out);
+	fprintf(out, "}\n");
+	free(backend->body);
+	backend->body = NULL;
+}
+
+static void *c99_register_allocate(void *_backend, char *ident) {
+	seadragon_c99 *backend = _backend;
+	for (unsigned int i = 0; i < backend->variables->length; i += 1) {
+		seadragon_c99_variable *variable = backend->variables->items[i];
+		if (variable->identifier && !strcmp(variable->identifier, ident)) {
+			return variable;
+		}
+	}
+	return c99_variable(backend, ident);
+}
+
+static void *c99_register_temporary(void *_backend) {
+	seadragon_c99 *backend = _backend;
+	for (unsigned int i = 0; i < backend->variables->length; i += 1) {
+		seadragon_c99_variable *variable = backend->variables->items[i];
+		if (!variable->identifier && !variable->busy) {
+			variable->busy = true;
+			return variable;
+		}
+	}
+	return c99_variable(backend, NULL);
+}
+
+static void c99_register_free(void *_backend, void *reg) {
+	(void)_backend;
+	seadragon_c99_variable *variable = reg;
+	if (!variable->identifier) {
+		variable->busy = false;
+	}
+}
+
+static void c99_set_long(void *_backend, void *reg, seadragon_value_t *val) {
+	seadragon_c99 *backend = _backend;
+	switch (val->type) {
+	case VALUE_TYPE_LITERAL:
+		fprintf(backend->code, "\t%s = %uu;\n", c99_name(reg), val->u.literal);
+		break;
+	case VALUE_TYPE_BUFFER: {
+		bool declared = false;
+		for (unsigned int i = 0; i < backend->buffers->length && !declared; i += 1) {
+			declared = backend->buffers->items[i] == val->u.buffer;
+		}
+		if (!declared) {
+			list_add(backend->buffers, val->u.buffer);
+		}
+		fprintf(backend->code, "\t%s = df_buffer_%s;\n", c99_name(reg), val->u.buffer->name);
+		break;}
+	default:
+		ERROR("Unsupported value");
+		return;
+	}
+}
+
+static void c99_move(void *_backend, void *dst, void *src) {
+	seadragon_c99 *backend = _backend;
+	fprintf(backend->code, "\t%s = %s;\n", c99_name(dst), c99_name(src));
+}
+
+/// Prints `dst = lhs op rhs;`, where rhs is already formatted.
+static void c99_arith_print(seadragon_c99 *backend, seadragon_operation_t op, void *dst, void *lhs, const char *rhs) {
+	const char *name = c99_name(dst), *a = c99_name(lhs);
+	switch (op) {
+	case OPERATION_ADD: fprintf(backend->code, "\t%s = %s + %s;\n", name, a, rhs); break;
+	case OPERATION_SUB: fprintf(backend->code, "\t%s = %s - %s;\n", name, a, rhs); break;
+	case OPERATION_MUL: fprintf(backend->code, "\t%s = %s * %s;\n", name, a, rhs); break;
+	case OPERATION_AND: fprintf(backend->code, "\t%s = %s & %s;\n", name, a, rhs); break;
+	case OPERATION_OR: fprintf(backend->code, "\t%s = %s | %s;\n", name, a, rhs); break;
+	case OPERATION_DIV: fprintf(backend->code, "\t%s = df_div(%s, %s);\n", name, a, rhs); break;
+	case OPERATION_LSH: fprintf(backend->code, "\t%s = df_lsh(%s, %s);\n", name, a, rhs); break;
+	case OPERATION_RSH: fprintf(backend->code, "\t%s = df_rsh(%s, %s);\n", name, a, rhs); break;
+	default:
+		ERROR("Unsupported arithmetic operation");
+		return;
+	}
+}
+
+static void c99_arith(void *_backend, seadragon_operation_t op, void *dst, void *lhs, void *rhs) {
+	c99_arith_print(_backend, op, dst, lhs, c99_name(rhs));
+}
+
+static void c99_arith_immediate(void *_backend, seadragon_operation_t op, void *dst, void *lhs, uint32_t imm) {
+	char rhs[16];
+	sprintf(rhs, "%uu", imm);
+	c99_arith_print(_backend, op, dst, lhs, rhs);
+}
+
+static void c99_memory(void *_backend, seadragon_operation_t op, void *val, void *base, uint32_t offset) {
+	seadragon_c99 *backend = _backend;
+	const char *access;
+	switch (op) {
+	case OPERATION_GLONG: access = "l_l"; break;
+	case OPERATION_GINT: access = "l_i"; break;
+	case OPERATION_GBYTE: access = "l_b"; break;
+	case OPERATION_SLONG: access = "s_l"; break;
+	case OPERATION_SINT: access = "s_i"; break;
+	case OPERATION_SBYTE: access = "s_b"; break;
+	default:
+		ERROR("Unsupported memory operation");
+		return;
+	}
+	char address[64];
+	if (!base) {
+		sprintf(address, "%uu", offset);
+	}
+	else if (!offset) {
+		sprintf(address, "%s", c99_name(base));
+	}
+	else {
+		sprintf(address, "%s + %uu", c99_name(base), offset);
+	}
+	if (access[0] == 'l') {
+		fprintf(backend->code, "\t%s = df_%s(%s);\n", c99_name(val), access, address);
+	}
+	else {
+		fprintf(backend->code, "\tdf_%s(%s, %s);\n", access, address, c99_name(val));
+	}
+}
+
+static void c99_label(void *_backend, unsigned int block) {
+	seadragon_c99 *backend = _backend;
+	fprintf(backend->code, "L%u:;\n", block);
+}
+
+static void c99_jump(void *_backend, unsigned int block) {
+	seadragon_c99 *backend = _backend;
+	fprintf(backend->code, "\tgoto L%u;\n", block);
+}
+
+static void c99_branch(void *_backend, seadragon_operation_t op, void *lhs, void *rhs, unsigned int block) {
+	seadragon_c99 *backend = _backend;
+	const char *comparison;
+	switch (op) {
+	case OPERATION_CLT: comparison = "<"; break;
+	case OPERATION_CGT: comparison = ">"; break;
+	case OPERATION_CLE: comparison = "<="; break;
+	case OPERATION_CGE: comparison = ">="; break;
+	case OPERATION_EQ: comparison = "=="; break;
+	case OPERATION_NE: comparison = "!="; break;
+	default:
+		ERROR("Unsupported branch condition");
+		return;
+	}
+	fprintf(backend->code, "\tif (%s %s %s) goto L%u;\n", c99_name(lhs), comparison, rhs ? c99_name(rhs) : "0", block);
+}
+
+static void c99_ret(void *_backend) {
+	seadragon_c99 *backend = _backend;
+	seadragon_function_t *func = backend->function;
+	for (unsigned int i = 0; i < func->outputs->length; i += 1) {
+		const char *output = func->outputs->items[i];
+		fprintf(backend->code, "\t*o_%s = %s;\n", output, c99_name(c99_register_allocate(backend, (char*)output)));
+	}
+	fprintf(backend->code, "\treturn;\n");
+}
+
+static void c99_buffer(void *_backend, seadragon_buffer_t *buffer) {
+	seadragon_c99 *backend = _backend;
+	backend->bss = (backend->bss + buffer->alignment - 1) & ~(buffer->alignment - 1);
+	fprintf(backend->out, "\nconst uint32_t df_buffer_%s = SEADRAGON_BSS + %uu;\n", buffer->name, backend->bss);
+	backend->bss += buffer->size;
+}
+
+static void c99_deinit(void *_backend) {
+	seadragon_backend_c99_deinit(_backend);
+}
+
+seadragon_backend_t *seadragon_backend_c99(seadragon_session_t *session, FILE *out) {
+	seadragon_c99 *backend = malloc(sizeof(seadragon_c99));
+	backend->out = out;
+	backend->session = session;
+	backend->function = NULL;
+	backend->variables = list_create();
+	backend->buffers = list_create();
+	backend->body = NULL;
+	backend->body_length = 0;
+	backend->code = NULL;
+	backend->bss = 0;
+	memset(&backend->base, 0, sizeof(seadragon_backend_t));
+	backend->base.begin_function = c99_begin_function;
+	backend->base.end_function = c99_end_function;
+	backend->base.register_allocate = c99_register_allocate;
+	backend->base.register_temporary = c99_register_temporary;
+	backend->base.register_free = c99_register_free;
+	backend->base.set_long = c99_set_long;
+	backend->base.move = c99_move;
+	backend->base.arith = c99_arith;
+	backend->base.arith_immediate = c99_arith_immediate;
+	backend->base.memory = c99_memory;
+	backend->base.label = c99_label;
+	backend->base.jump = c99_jump;
+	backend->base.branch = c99_branch;
+	backend->base.ret = c99_ret;
+	backend->base.buffer = c99_buffer;
+	backend->base.deinit = c99_deinit;
+	fputs(seadragon_c99_prelude, out);
+	return &backend->base;
+}
+
+void seadragon_backend_c99_deinit(seadragon_backend_t *_backend) {
+	seadragon_c99 *backend = (seadragon_c99*)_backend;
+	c99_reset(backend);
+	list_free(backend->variables);
+	list_free(backend->buffers);
+	free(backend);
+}
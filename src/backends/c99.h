@@ -0,0 +1,20 @@
+#ifndef SEADRAGON_BACKEND_C99_H_
+#define SEADRAGON_BACKEND_C99_H_
+
+#include "../backend.h"
+#include "../session.h"
+
+/// Emits portable C99, for running programs on the host and checking other
+/// backends against.
+///
+/// `fn name {-- a b}` becomes `void df_name(uint32_t *o_a, uint32_t *o_b)`, with
+/// every variable a zero-initialized local. Memory is accessed through
+/// `uint8_t *seadragon_memory`, which the program linking the output defines,
+/// pointing at a zero-filled 4 GiB address space (e.g. an anonymous mapping).
+/// Buffers are placed from the address SEADRAGON_BSS, which may be defined when
+/// compiling the output. Accesses are little-endian, as on limn2k, so the host
+/// must be too; a division by zero aborts.
+seadragon_backend_t *seadragon_backend_c99(seadragon_session_t *session, FILE *out);
+void seadragon_backend_c99_deinit(seadragon_backend_t *backend);
+
+#endif // SEADRAGON_BACKEND_C99_H_
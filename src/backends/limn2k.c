@@ -1,26 +1,174 @@
 #include "limn2k.h"
+#include "limn2k_peephole.h"
+#include "limn2k_schedule.h"
 #include "list.h"
+#include "map.h"
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define ERROR(msg) do { fprintf(stderr, "%s:%d: error: limn2k: %s\n", __FILE__, __LINE__, msg); longjmp(*backend->env, 1); } while(0);
+#define ERROR(msg) seadragon_session_error(backend->session, "%s:%d: error: limn2k: %s", __FILE__, __LINE__, msg)
+
+typedef uint8_t seadragon_limn2k_register;
+
+/// Register numbers handed out to codegen; index is register number.
+static seadragon_limn2k_register limn2k_register_names[27] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+	14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,
+};
+
+/// Marks a register holding a scratch value rather than an identifier.
+static char limn2k_temporary[] = "";
+
+/// The final code of a function emitted in full, which later functions with
+/// the same code become aliases of.
+typedef struct {
+	char *name;
+	/// Hash of the code, in hex, keying the backend's bodies
+	char key[17];
+	seadragon_limn2k_insn_t *insns;
+	unsigned int length;
+} seadragon_limn2k_body_t;
 
 typedef struct {
 	seadragon_backend_t base;
 	// Contains strings of autos currently assigned to registers. Index + 1 is register number.
 	char *registers[26];
+	/// Name of the current function, which prefixes its block labels
+	char *function;
+	/// The current function's code, which is only printed once the peephole
+	/// pass has run over all of it
+	seadragon_limn2k_insn_t *insns;
+	unsigned int length, capacity;
+	/// Set once the bss section has been started
+	bool bss;
+	/// When folding: list of seadragon_limn2k_body_t, and the same by key
+	list_t *bodies;
+	map_t *hashes;
+	/// Functions folded into aliases and dropped as unreachable, and the bytes
+	/// of code that saved
+	unsigned int folded, dropped;
+	uint64_t folded_bytes, dropped_bytes;
+	/// Times each peephole rule applied, indexed like seadragon_limn2k_peephole_rules
+	unsigned long *peephole_hits;
 	FILE *out;
-	jmp_buf *env;
+	seadragon_session_t *session;
 } seadragon_limn2k;
 
-typedef uint8_t seadragon_limn2k_register;
+static void limn2k_emit(seadragon_limn2k *backend, seadragon_limn2k_insn_t insn) {
+	if (backend->length == backend->capacity) {
+		backend->capacity += 64;
+		backend->insns = realloc(backend->insns, sizeof(seadragon_limn2k_insn_t) * backend->capacity);
+	}
+	backend->insns[backend->length] = insn;
+	backend->length += 1;
+}
+
+static const char *limn2k_arith_mnemonic(seadragon_limn2k *backend, seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_ADD:
+		return "add";
+	case OPERATION_SUB:
+		return "sub";
+	case OPERATION_MUL:
+		return "mul";
+	case OPERATION_DIV:
+		return "div";
+	case OPERATION_AND:
+		return "and";
+	case OPERATION_OR:
+		return "or";
+	case OPERATION_LSH:
+		return "lsh";
+	case OPERATION_RSH:
+		return "rsh";
+	default:
+		ERROR("Unsupported arithmetic operation");
+		return NULL;
+	}
+}
+
+static const char *limn2k_memory_mnemonic(seadragon_limn2k *backend, seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_GLONG: return "l.l";
+	case OPERATION_GINT: return "l.i";
+	case OPERATION_GBYTE: return "l.b";
+	case OPERATION_SLONG: return "s.l";
+	case OPERATION_SINT: return "s.i";
+	case OPERATION_SBYTE: return "s.b";
+	default:
+		ERROR("Unsupported memory operation");
+		return NULL;
+	}
+}
+
+static const char *limn2k_branch_mnemonic(seadragon_limn2k *backend, seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_CLT: return "blt";
+	case OPERATION_CGT: return "bgt";
+	case OPERATION_CLE: return "ble";
+	case OPERATION_CGE: return "bge";
+	case OPERATION_EQ: return "beq";
+	case OPERATION_NE: return "bne";
+	default:
+		ERROR("Unsupported branch condition");
+		return NULL;
+	}
+}
+
+static void limn2k_print(seadragon_limn2k *backend, seadragon_limn2k_insn_t *insn) {
+	FILE *out = backend->out;
+	switch (insn->kind) {
+	case LIMN2K_INSN_NOP:
+		break;
+	case LIMN2K_INSN_LI:
+		fprintf(out, "\tli %u, %u\n", insn->rd, insn->imm);
+		break;
+	case LIMN2K_INSN_LUI:
+		fprintf(out, "\tlui %u, %u\n", insn->rd, insn->imm);
+		break;
+	case LIMN2K_INSN_LA:
+		fprintf(out, "\tla %u, %s\n", insn->rd, insn->symbol);
+		break;
+	case LIMN2K_INSN_MOV:
+		fprintf(out, "\tmov %u, %u\n", insn->rd, insn->ra);
+		break;
+	case LIMN2K_INSN_ARITH:
+		fprintf(out, "\t%s %u, %u, %u\n", limn2k_arith_mnemonic(backend, insn->op), insn->rd, insn->ra, insn->rb);
+		break;
+	case LIMN2K_INSN_ARITH_IMMEDIATE:
+		fprintf(out, "\t%si %u, %u, %u\n", limn2k_arith_mnemonic(backend, insn->op), insn->rd, insn->ra, insn->imm);
+		break;
+	// Loads are `l.X dst, base, offset`, stores are `s.X base, offset, src`
+	case LIMN2K_INSN_LOAD:
+		fprintf(out, "\t%s %u, %u, %u\n", limn2k_memory_mnemonic(backend, insn->op), insn->rd, insn->ra, insn->imm);
+		break;
+	case LIMN2K_INSN_STORE:
+		fprintf(out, "\t%s %u, %u, %u\n", limn2k_memory_mnemonic(backend, insn->op), insn->ra, insn->imm, insn->rb);
+		break;
+	case LIMN2K_INSN_LABEL:
+		fprintf(out, ".%s.%u:\n", backend->function, insn->imm);
+		break;
+	case LIMN2K_INSN_JUMP:
+		fprintf(out, "\tb .%s.%u\n", backend->function, insn->imm);
+		break;
+	case LIMN2K_INSN_BRANCH:
+		fprintf(out, "\t%s %u, %u, .%s.%u\n", limn2k_branch_mnemonic(backend, insn->op), insn->ra, insn->rb, backend->function, insn->imm);
+		break;
+	case LIMN2K_INSN_RET:
+		fprintf(out, "\tret\n");
+		break;
+	}
+}
 
 static void limn2k_begin_function(void *_backend, seadragon_function_t *func) {
 	seadragon_limn2k *backend = _backend;
 	memset(backend->registers, 0, sizeof(backend->registers));
+	backend->length = 0;
 	if (func->outputs->length > 2) {
 		ERROR("TODO: outputs.length > 2");
+		return;
 	}
 	if (func->outputs->length > 0) {
 		backend->registers[9] = func->outputs->items[0];
@@ -28,7 +176,103 @@ static void limn2k_begin_function(void *_backend, seadragon_function_t *func) {
 			backend->registers[10] = func->outputs->items[1];
 		}
 	}
-	fprintf(backend->out, "%s:\n", func->name);
+	backend->function = func->name;
+}
+
+/// Bytes of code, at four per instruction.
+static uint64_t limn2k_size(seadragon_limn2k_insn_t *insns, unsigned int length) {
+	uint64_t size = 0;
+	for (unsigned int i = 0; i < length; i += 1) {
+		size += insns[i].kind != LIMN2K_INSN_NOP && insns[i].kind != LIMN2K_INSN_LABEL ? 4 : 0;
+	}
+	return size;
+}
+
+/// FNV-1a over the instructions and the symbols they relocate against. Block
+/// labels are numbered within the function, so they hash the same anywhere.
+static uint64_t limn2k_hash(seadragon_limn2k_insn_t *insns, unsigned int length) {
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+#define LIMN2K_HASH(value) (hash = (hash ^ (uint64_t)(value)) * UINT64_C(0x100000001b3))
+	for (unsigned int i = 0; i < length; i += 1) {
+		seadragon_limn2k_insn_t *insn = &insns[i];
+		LIMN2K_HASH(insn->kind);
+		LIMN2K_HASH(insn->op);
+		LIMN2K_HASH(insn->rd | insn->ra << 8 | insn->rb << 16);
+		LIMN2K_HASH(insn->imm);
+		for (const char *c = insn->kind == LIMN2K_INSN_LA ? insn->symbol : ""; *c; c += 1) {
+			LIMN2K_HASH(*c);
+		}
+	}
+#undef LIMN2K_HASH
+	return hash;
+}
+
+static bool limn2k_same_code(seadragon_limn2k_insn_t *a, unsigned int a_length, seadragon_limn2k_insn_t *b, unsigned int b_length) {
+	if (a_length != b_length) {
+		return false;
+	}
+	for (unsigned int i = 0; i < a_length; i += 1) {
+		if (a[i].kind != b[i].kind || a[i].op != b[i].op || a[i].rd != b[i].rd || a[i].ra != b[i].ra || a[i].rb != b[i].rb
+				|| a[i].imm != b[i].imm || (a[i].kind == LIMN2K_INSN_LA && strcmp(a[i].symbol, b[i].symbol))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool limn2k_root(seadragon_limn2k *backend, const char *name) {
+	list_t *roots = backend->session->roots;
+	for (unsigned int i = 0; roots && i < roots->length; i += 1) {
+		if (!strcmp(roots->items[i], name)) {
+			return true;
+		}
+	}
+	return !roots;
+}
+
+/// Emits an alias instead of the current function if an identical one has
+/// been emitted, and otherwise remembers it. Returns whether it was folded.
+static bool limn2k_fold(seadragon_limn2k *backend) {
+	char key[17];
+	snprintf(key, sizeof(key), "%016" PRIx64, limn2k_hash(backend->insns, backend->length));
+	seadragon_limn2k_body_t *body = map_get(backend->hashes, key);
+	if (body) {
+		// On the rare collision, the function is simply emitted in full
+		if (!limn2k_same_code(body->insns, body->length, backend->insns, backend->length)) {
+			return false;
+		}
+		fprintf(backend->out, ".alias %s %s\n", backend->function, body->name);
+		backend->folded += 1;
+		backend->folded_bytes += limn2k_size(backend->insns, backend->length);
+		return true;
+	}
+	body = malloc(sizeof(seadragon_limn2k_body_t));
+	body->name = strdup(backend->function);
+	memcpy(body->key, key, sizeof(key));
+	body->insns = malloc(sizeof(seadragon_limn2k_insn_t) * (backend->length ? backend->length : 1));
+	memcpy(body->insns, backend->insns, sizeof(seadragon_limn2k_insn_t) * backend->length);
+	body->length = backend->length;
+	list_add(backend->bodies, body);
+	map_set(backend->hashes, body->key, body);
+	return false;
+}
+
+static void limn2k_end_function(void *_backend) {
+	seadragon_limn2k *backend = _backend;
+	backend->length = seadragon_limn2k_peephole(backend->insns, backend->length, SEADRAGON_LIMN2K_PEEPHOLE_WINDOW,
+		backend->peephole_hits);
+	seadragon_limn2k_schedule(backend->insns, backend->length, SEADRAGON_LIMN2K_SCHEDULE_WINDOW, NULL);
+	if (!limn2k_root(backend, backend->function)) {
+		backend->dropped += 1;
+		backend->dropped_bytes += limn2k_size(backend->insns, backend->length);
+	}
+	else if (!backend->session->fold || !limn2k_fold(backend)) {
+		fprintf(backend->out, "%s:\n", backend->function);
+		for (unsigned int i = 0; i < backend->length; i += 1) {
+			limn2k_print(backend, &backend->insns[i]);
+		}
+	}
+	backend->length = 0;
 }
 
 static void limn2k_set_long(void *_backend, void *reg, seadragon_value_t *val) {
@@ -37,58 +281,245 @@ static void limn2k_set_long(void *_backend, void *reg, seadragon_value_t *val) {
 	switch (val->type) {
 	case VALUE_TYPE_LITERAL:
 		if (val->u.literal <= UINT16_MAX) {
-			fprintf(backend->out, "\tli %u, %u\n", *r, val->u.literal);
+			limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_LI, .rd = *r, .imm = val->u.literal });
 		}
 		else {
-			ERROR("TODO: slong >u16");
+			limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_LUI, .rd = *r, .imm = val->u.literal >> 16 });
+			if (val->u.literal & UINT16_MAX) {
+				limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_ARITH_IMMEDIATE, .op = OPERATION_OR,
+					.rd = *r, .ra = *r, .imm = val->u.literal & UINT16_MAX });
+			}
 		}
 		break;
+	case VALUE_TYPE_BUFFER:
+		limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_LA, .rd = *r, .symbol = val->u.buffer->name });
+		break;
 	default:
 		ERROR("TODO: slong");
+		return;
+	}
+}
+
+static void limn2k_move(void *_backend, void *dst, void *src) {
+	seadragon_limn2k *backend = _backend;
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_MOV,
+		.rd = *(seadragon_limn2k_register*)dst, .ra = *(seadragon_limn2k_register*)src });
+}
+
+static void limn2k_arith(void *_backend, seadragon_operation_t op, void *dst, void *lhs, void *rhs) {
+	seadragon_limn2k *backend = _backend;
+	if (!limn2k_arith_mnemonic(backend, op)) {
+		return;
+	}
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_ARITH, .op = op, .rd = *(seadragon_limn2k_register*)dst,
+		.ra = *(seadragon_limn2k_register*)lhs, .rb = *(seadragon_limn2k_register*)rhs });
+}
+
+static void *limn2k_register_temporary(void *_backend);
+static void limn2k_register_free(void *_backend, void *reg);
+
+static void limn2k_arith_immediate(void *_backend, seadragon_operation_t op, void *dst, void *lhs, uint32_t imm) {
+	seadragon_limn2k *backend = _backend;
+	if (imm > UINT16_MAX) {
+		// Wide masks and sizes don't fit the immediate field
+		void *reg = limn2k_register_temporary(backend);
+		if (!reg) {
+			ERROR("Out of registers for a wide immediate");
+			return;
+		}
+		seadragon_value_t val = { .type = VALUE_TYPE_LITERAL, .u.literal = imm };
+		limn2k_set_long(backend, reg, &val);
+		limn2k_arith(backend, op, dst, lhs, reg);
+		limn2k_register_free(backend, reg);
+		return;
+	}
+	if (!limn2k_arith_mnemonic(backend, op)) {
+		return;
+	}
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_ARITH_IMMEDIATE, .op = op, .rd = *(seadragon_limn2k_register*)dst,
+		.ra = *(seadragon_limn2k_register*)lhs, .imm = imm });
+}
+
+static void limn2k_memory(void *_backend, seadragon_operation_t op, void *val, void *base, uint32_t offset) {
+	seadragon_limn2k *backend = _backend;
+	if (!limn2k_memory_mnemonic(backend, op)) {
+		return;
+	}
+	// Absolute addresses are relative to r0, which always reads as zero
+	seadragon_limn2k_register r = base ? *(seadragon_limn2k_register*)base : 0;
+	void *wide = NULL;
+	if (offset > UINT16_MAX) {
+		// The offset doesn't fit the immediate field; compute the address
+		wide = limn2k_register_temporary(backend);
+		if (!wide) {
+			ERROR("Out of registers for a wide offset");
+			return;
+		}
+		if (base) {
+			limn2k_arith_immediate(backend, OPERATION_ADD, wide, base, offset);
+		}
+		else {
+			seadragon_value_t address = { .type = VALUE_TYPE_LITERAL, .u.literal = offset };
+			limn2k_set_long(backend, wide, &address);
+		}
+		r = *(seadragon_limn2k_register*)wide;
+		offset = 0;
+	}
+	if (op == OPERATION_GLONG || op == OPERATION_GINT || op == OPERATION_GBYTE) {
+		limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_LOAD, .op = op,
+			.rd = *(seadragon_limn2k_register*)val, .ra = r, .imm = offset });
+	}
+	else {
+		limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_STORE, .op = op,
+			.ra = r, .rb = *(seadragon_limn2k_register*)val, .imm = offset });
+	}
+	if (wide) {
+		limn2k_register_free(backend, wide);
 	}
 }
 
 static void *limn2k_register_allocate(void *_backend, char *ident) {
 	seadragon_limn2k *backend = _backend;
-	seadragon_limn2k_register *reg = malloc(sizeof(seadragon_limn2k_register));
-	*reg = 0;
 	unsigned int first_unused = 27;
 	for (unsigned int i = 0; i < 26; i += 1) {
-		if (backend->registers[i] && !strcmp(backend->registers[i], ident)) {
-			*reg = i + 1;
-			break;
+		if (backend->registers[i] && backend->registers[i] != limn2k_temporary && !strcmp(backend->registers[i], ident)) {
+			return &limn2k_register_names[i + 1];
 		}
 		if (!backend->registers[i] && first_unused == 27) {
 			first_unused = i;
 		}
 	}
-	if (!*reg) {
-		if (first_unused == 27) {
-			ERROR("TODO: register spilling or error.");
+	if (first_unused == 27) {
+		return NULL;
+	}
+	backend->registers[first_unused] = ident;
+	return &limn2k_register_names[first_unused + 1];
+}
+
+static void *limn2k_register_temporary(void *_backend) {
+	seadragon_limn2k *backend = _backend;
+	for (unsigned int i = 0; i < 26; i += 1) {
+		if (!backend->registers[i]) {
+			backend->registers[i] = limn2k_temporary;
+			return &limn2k_register_names[i + 1];
 		}
-		backend->registers[first_unused] = ident;
-		*reg = first_unused + 1;
 	}
-	return reg;
+	return NULL;
 }
 
-static void seadragon_limn2k_ret(void *_backend) {
+static void limn2k_register_free(void *_backend, void *reg) {
 	seadragon_limn2k *backend = _backend;
-	fprintf(backend->out, "\tret\n");
+	seadragon_limn2k_register r = *(seadragon_limn2k_register*)reg;
+	if (backend->registers[r - 1] == limn2k_temporary) {
+		backend->registers[r - 1] = NULL;
+	}
+}
+
+static void limn2k_label(void *_backend, unsigned int block) {
+	seadragon_limn2k *backend = _backend;
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_LABEL, .imm = block });
+}
+
+static void limn2k_jump(void *_backend, unsigned int block) {
+	seadragon_limn2k *backend = _backend;
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_JUMP, .imm = block });
+}
+
+static void limn2k_branch(void *_backend, seadragon_operation_t op, void *lhs, void *rhs, unsigned int block) {
+	seadragon_limn2k *backend = _backend;
+	if (!limn2k_branch_mnemonic(backend, op)) {
+		return;
+	}
+	// r0 always reads as zero
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_BRANCH, .op = op, .ra = *(seadragon_limn2k_register*)lhs,
+		.rb = rhs ? *(seadragon_limn2k_register*)rhs : 0, .imm = block });
+}
+
+static void limn2k_buffer(void *_backend, seadragon_buffer_t *buffer) {
+	seadragon_limn2k *backend = _backend;
+	// Buffers come sorted by alignment, so only the first needs aligning
+	if (!backend->bss) {
+		fprintf(backend->out, ".section bss\n.align %u\n", buffer->alignment);
+		backend->bss = true;
+	}
+	fprintf(backend->out, "%s:\n\t.bytes %u 0\n", buffer->name, buffer->size);
 }
 
-seadragon_backend_t *seadragon_backend_limn2k(jmp_buf *env, FILE *out) {
+/// Reports what linking saved, as a comment after everything else.
+static void limn2k_end(void *_backend) {
+	seadragon_limn2k *backend = _backend;
+	if (backend->session->fold) {
+		fprintf(backend->out, "; Folded %u identical functions, saving %" PRIu64 " bytes\n", backend->folded, backend->folded_bytes);
+	}
+	if (backend->session->roots) {
+		fprintf(backend->out, "; Dropped %u unreachable functions, saving %" PRIu64 " bytes\n", backend->dropped,
+			backend->dropped_bytes);
+	}
+}
+
+static void limn2k_ret(void *_backend) {
+	seadragon_limn2k *backend = _backend;
+	limn2k_emit(backend, (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_RET });
+}
+
+static void limn2k_deinit(void *_backend) {
+	seadragon_backend_limn2k_deinit(_backend);
+}
+
+seadragon_backend_t *seadragon_backend_limn2k(seadragon_session_t *session, FILE *out) {
 	seadragon_limn2k *backend = malloc(sizeof(seadragon_limn2k));
+	if (!backend) {
+		return NULL;
+	}
+	backend->peephole_hits = calloc(seadragon_limn2k_peephole_rule_count, sizeof(unsigned long));
+	if (!backend->peephole_hits) {
+		free(backend);
+		return NULL;
+	}
 	backend->out = out;
-	backend->env = env;
+	backend->session = session;
+	backend->insns = NULL;
+	backend->length = backend->capacity = 0;
+	backend->bss = false;
+	backend->bodies = list_create();
+	backend->hashes = map_create();
+	backend->folded = backend->dropped = 0;
+	backend->folded_bytes = backend->dropped_bytes = 0;
 	memset(&backend->base, 0, sizeof(seadragon_backend_t));
-	backend->base.begin_function = &limn2k_begin_function;
-	backend->base.register_allocate = limn2k_register_allocate;
-	backend->base.set_long = limn2k_set_long;
-	backend->base.ret = seadragon_limn2k_ret;
+#define LIMN2K_HOOK(hook) backend->base.hook = limn2k_##hook;
+	SEADRAGON_BACKEND_REQUIRED(LIMN2K_HOOK)
+#undef LIMN2K_HOOK
+	backend->base.end_function = limn2k_end_function;
+	backend->base.buffer = limn2k_buffer;
+	backend->base.end = limn2k_end;
+	backend->base.deinit = limn2k_deinit;
 	return &backend->base;
 }
 
-void seadragon_backend_limn2k_deinit(seadragon_backend_t *backend) {
+void seadragon_backend_limn2k_deinit(seadragon_backend_t *_backend) {
+	seadragon_limn2k *backend = (seadragon_limn2k*)_backend;
+	for (unsigned int i = 0; i < backend->bodies->length; i += 1) {
+		seadragon_limn2k_body_t *body = backend->bodies->items[i];
+		free(body->name);
+		free(body->insns);
+		free(body);
+	}
+	list_free(backend->bodies);
+	map_free(backend->hashes);
+	free(backend->insns);
+	free(backend->peephole_hits);
 	free(backend);
 }
+
+const unsigned long *seadragon_backend_limn2k_peephole_hits(seadragon_backend_t *_backend) {
+	return ((seadragon_limn2k*)_backend)->peephole_hits;
+}
+
+#ifndef SEADRAGON_CG_DYNAMIC
+// The walker with the hooks above called directly; codegen uses it in place of
+// the vtable for limn2k
+#define SEADRAGON_CG_WALK seadragon_backend_limn2k_walk
+#define SEADRAGON_CG_HOOK(hook) limn2k_##hook
+#define SEADRAGON_CG_HAS(hook) true
+#include "../codegen_walk.h"
+#endif
@@ -2,11 +2,19 @@
 #define SEADRAGON_BACKEND_LIMN2K_H_
 
 #include "../backend.h"
-#include <setjmp.h>
+#include "../codegen_walk.h"
+#include "../session.h"
 
-seadragon_backend_t *seadragon_backend_limn2k(jmp_buf *env, FILE *out);
+seadragon_backend_t *seadragon_backend_limn2k(seadragon_session_t *session, FILE *out);
 seadragon_backend_t *seadragon_backend_limn2k();
 void seadragon_backend_limn2k_deinit(seadragon_backend_t *backend);
+/// Times each of seadragon_limn2k_peephole_rules has applied in the functions
+/// generated so far, indexed like the rules; owned by the backend.
+const unsigned long *seadragon_backend_limn2k_peephole_hits(seadragon_backend_t *backend);
+
+/// The codegen walker specialized for limn2k, which seadragon_cg_begin picks
+/// for seadragon_backend_limn2k unless built with SEADRAGON_CG_DYNAMIC.
+bool seadragon_backend_limn2k_walk(seadragon_cg_walker_t *ctx, seadragon_function_t *func);
 
 #endif // SEADRAGON_BACKEND_LIMN2K_H_
 
@@ -0,0 +1,208 @@
+#include "limn2k_peephole.h"
+
+uint8_t seadragon_limn2k_insn_writes(seadragon_limn2k_insn_t *insn) {
+	switch (insn->kind) {
+	case LIMN2K_INSN_LI:
+	case LIMN2K_INSN_LUI:
+	case LIMN2K_INSN_LA:
+	case LIMN2K_INSN_MOV:
+	case LIMN2K_INSN_ARITH:
+	case LIMN2K_INSN_ARITH_IMMEDIATE:
+	case LIMN2K_INSN_LOAD:
+		return insn->rd;
+	default:
+		return 0;
+	}
+}
+
+/// Returns the first instruction a rule looking back from i may inspect. Other
+/// paths join the stream at labels, and nothing falls through a jump or ret.
+static unsigned int seadragon_limn2k_peephole_floor(seadragon_limn2k_insn_t *insns, unsigned int i, unsigned int window) {
+	while (i > 0 && window > 0) {
+		seadragon_limn2k_insn_t *insn = &insns[i - 1];
+		if (insn->kind == LIMN2K_INSN_LABEL || insn->kind == LIMN2K_INSN_JUMP || insn->kind == LIMN2K_INSN_RET) {
+			break;
+		}
+		if (insn->kind != LIMN2K_INSN_NOP) {
+			window -= 1;
+		}
+		i -= 1;
+	}
+	return i;
+}
+
+static bool seadragon_limn2k_fold(seadragon_operation_t op, uint32_t a, uint32_t b, uint32_t *out) {
+	switch (op) {
+	case OPERATION_ADD: *out = a + b; return true;
+	case OPERATION_SUB: *out = a - b; return true;
+	case OPERATION_MUL: *out = a * b; return true;
+	case OPERATION_AND: *out = a & b; return true;
+	case OPERATION_OR: *out = a | b; return true;
+	case OPERATION_LSH: *out = b < 32 ? a << b : 0; return true;
+	case OPERATION_RSH: *out = b < 32 ? a >> b : 0; return true;
+	default: return false;
+	}
+}
+
+/// Finds the constant held by reg just before insns[i], if it was set within
+/// [floor, i).
+static bool seadragon_limn2k_known(seadragon_limn2k_insn_t *insns, unsigned int floor, unsigned int i, uint8_t reg, uint32_t *out) {
+	if (reg == 0) {
+		*out = 0;
+		return true;
+	}
+	while (i > floor) {
+		i -= 1;
+		seadragon_limn2k_insn_t *insn = &insns[i];
+		if (seadragon_limn2k_insn_writes(insn) != reg) {
+			continue;
+		}
+		uint32_t a;
+		switch (insn->kind) {
+		case LIMN2K_INSN_LI:
+			*out = insn->imm;
+			return true;
+		case LIMN2K_INSN_LUI:
+			*out = insn->imm << 16;
+			return true;
+		case LIMN2K_INSN_MOV:
+			return seadragon_limn2k_known(insns, floor, i, insn->ra, out);
+		case LIMN2K_INSN_ARITH_IMMEDIATE:
+			return seadragon_limn2k_known(insns, floor, i, insn->ra, &a) && seadragon_limn2k_fold(insn->op, a, insn->imm, out);
+		default:
+			return false;
+		}
+	}
+	return false;
+}
+
+/// Returns whether reg is written by any instruction in [from, to).
+static bool seadragon_limn2k_written(seadragon_limn2k_insn_t *insns, unsigned int from, unsigned int to, uint8_t reg) {
+	for (unsigned int i = from; i < to; i += 1) {
+		if (seadragon_limn2k_insn_writes(&insns[i]) == reg) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// `s.X b, o, v` ... `l.X d, b, o` => `mov d, v`, masked for narrow accesses.
+static bool seadragon_limn2k_peephole_forward(seadragon_limn2k_insn_t *insns, unsigned int i, unsigned int window) {
+	seadragon_limn2k_insn_t *load = &insns[i];
+	if (load->kind != LIMN2K_INSN_LOAD) {
+		return false;
+	}
+	unsigned int floor = seadragon_limn2k_peephole_floor(insns, i, window);
+	for (unsigned int j = i; j > floor; j -= 1) {
+		seadragon_limn2k_insn_t *insn = &insns[j - 1];
+		if (insn->kind == LIMN2K_INSN_STORE) {
+			// Any other store may alias the loaded address
+			if (insn->ra != load->ra || insn->imm != load->imm || insn->op != load->op - OPERATION_GLONG + OPERATION_SLONG
+					|| seadragon_limn2k_written(insns, j, i, insn->rb)) {
+				return false;
+			}
+			uint8_t dst = load->rd, src = insn->rb;
+			if (load->op == OPERATION_GLONG) {
+				*load = (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_MOV, .rd = dst, .ra = src };
+			}
+			else {
+				*load = (seadragon_limn2k_insn_t){ .kind = LIMN2K_INSN_ARITH_IMMEDIATE, .op = OPERATION_AND, .rd = dst, .ra = src,
+					.imm = load->op == OPERATION_GINT ? 0xFFFF : 0xFF };
+			}
+			return true;
+		}
+		if (seadragon_limn2k_insn_writes(insn) == load->ra) {
+			return false;
+		}
+	}
+	return false;
+}
+
+/// Drops constants materialized into a register already holding them. The
+/// two halves of a lui/ori pair are matched together.
+static bool seadragon_limn2k_peephole_constant(seadragon_limn2k_insn_t *insns, unsigned int i, unsigned int window) {
+	seadragon_limn2k_insn_t *insn = &insns[i];
+	unsigned int floor = seadragon_limn2k_peephole_floor(insns, i, window);
+	uint32_t value, held;
+	switch (insn->kind) {
+	case LIMN2K_INSN_LI:
+		value = insn->imm;
+		break;
+	case LIMN2K_INSN_LUI:
+		value = insn->imm << 16;
+		break;
+	case LIMN2K_INSN_MOV:
+		if (!seadragon_limn2k_known(insns, floor, i, insn->ra, &value)) {
+			return false;
+		}
+		break;
+	case LIMN2K_INSN_ARITH_IMMEDIATE:
+		if (insn->op == OPERATION_OR && insn->ra == insn->rd) {
+			// Look for the lui this completes
+			unsigned int j = i;
+			while (j > floor && insns[j - 1].kind == LIMN2K_INSN_NOP) {
+				j -= 1;
+			}
+			if (j > floor && insns[j - 1].kind == LIMN2K_INSN_LUI && insns[j - 1].rd == insn->rd) {
+				value = insns[j - 1].imm << 16 | insn->imm;
+				if (seadragon_limn2k_known(insns, floor, j - 1, insn->rd, &held) && held == value) {
+					insns[j - 1].kind = LIMN2K_INSN_NOP;
+					insn->kind = LIMN2K_INSN_NOP;
+					return true;
+				}
+			}
+		}
+		if (!seadragon_limn2k_known(insns, floor, i, insn->ra, &held) || !seadragon_limn2k_fold(insn->op, held, insn->imm, &value)) {
+			return false;
+		}
+		break;
+	default:
+		return false;
+	}
+	if (!seadragon_limn2k_known(insns, floor, i, insn->rd, &held) || held != value) {
+		return false;
+	}
+	insn->kind = LIMN2K_INSN_NOP;
+	return true;
+}
+
+/// `mov r, r`
+static bool seadragon_limn2k_peephole_self_move(seadragon_limn2k_insn_t *insns, unsigned int i, unsigned int window) {
+	(void)window;
+	seadragon_limn2k_insn_t *insn = &insns[i];
+	if (insn->kind != LIMN2K_INSN_MOV || insn->rd != insn->ra) {
+		return false;
+	}
+	insn->kind = LIMN2K_INSN_NOP;
+	return true;
+}
+
+const seadragon_limn2k_peephole_rule_t seadragon_limn2k_peephole_rules[] = {
+	{ "store-to-load forwarding", seadragon_limn2k_peephole_forward },
+	{ "redundant constant", seadragon_limn2k_peephole_constant },
+	{ "self move", seadragon_limn2k_peephole_self_move },
+};
+
+const unsigned int seadragon_limn2k_peephole_rule_count = sizeof(seadragon_limn2k_peephole_rules) / sizeof(seadragon_limn2k_peephole_rules[0]);
+
+unsigned int seadragon_limn2k_peephole(seadragon_limn2k_insn_t *insns, unsigned int length, unsigned int window,
+		unsigned long *hits) {
+	if (window == 0) {
+		return length;
+	}
+	for (unsigned int i = 0; i < length; i += 1) {
+		for (unsigned int r = 0; r < seadragon_limn2k_peephole_rule_count && insns[i].kind != LIMN2K_INSN_NOP; r += 1) {
+			if (seadragon_limn2k_peephole_rules[r].apply(insns, i, window) && hits) {
+				hits[r] += 1;
+			}
+		}
+	}
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < length; i += 1) {
+		if (insns[i].kind != LIMN2K_INSN_NOP) {
+			insns[kept] = insns[i];
+			kept += 1;
+		}
+	}
+	return kept;
+}
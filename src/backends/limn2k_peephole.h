@@ -0,0 +1,70 @@
+#ifndef SEADRAGON_BACKEND_LIMN2K_PEEPHOLE_H_
+#define SEADRAGON_BACKEND_LIMN2K_PEEPHOLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../ast.h"
+
+/// Number of earlier instructions a rule may look at; 0 disables the pass.
+#ifndef SEADRAGON_LIMN2K_PEEPHOLE_WINDOW
+#define SEADRAGON_LIMN2K_PEEPHOLE_WINDOW 8
+#endif
+
+typedef enum {
+	/// Deleted by a rule, never emitted
+	LIMN2K_INSN_NOP,
+	/// li rd, imm
+	LIMN2K_INSN_LI,
+	/// lui rd, imm
+	LIMN2K_INSN_LUI,
+	/// la rd, symbol
+	LIMN2K_INSN_LA,
+	/// mov rd, ra
+	LIMN2K_INSN_MOV,
+	/// rd = ra op rb
+	LIMN2K_INSN_ARITH,
+	/// rd = ra op imm
+	LIMN2K_INSN_ARITH_IMMEDIATE,
+	/// rd = [ra + imm], op is the OPERATION_G* giving the width
+	LIMN2K_INSN_LOAD,
+	/// [ra + imm] = rb, op is the OPERATION_S* giving the width
+	LIMN2K_INSN_STORE,
+	/// Label, jump or `ra op rb` branch to the block imm
+	LIMN2K_INSN_LABEL,
+	LIMN2K_INSN_JUMP,
+	LIMN2K_INSN_BRANCH,
+	LIMN2K_INSN_RET,
+} seadragon_limn2k_insn_kind_t;
+
+typedef struct {
+	seadragon_limn2k_insn_kind_t kind;
+	seadragon_operation_t op;
+	uint8_t rd, ra, rb;
+	uint32_t imm;
+	const char *symbol;
+} seadragon_limn2k_insn_t;
+
+typedef struct {
+	const char *name;
+	/// Tries to rewrite insns[i], which is never a NOP. Up to window earlier
+	/// instructions may be inspected, and deleted along with insns[i]. Returns
+	/// whether anything was changed.
+	bool (*apply)(seadragon_limn2k_insn_t *insns, unsigned int i, unsigned int window);
+} seadragon_limn2k_peephole_rule_t;
+
+/// The rules, in the order they are tried on each instruction. Rules are
+/// added here; the backend and codegen need no changes.
+extern const seadragon_limn2k_peephole_rule_t seadragon_limn2k_peephole_rules[];
+extern const unsigned int seadragon_limn2k_peephole_rule_count;
+
+/// Returns the register written by insn, or 0.
+uint8_t seadragon_limn2k_insn_writes(seadragon_limn2k_insn_t *insn);
+
+/// Runs every rule over the instructions of one function, front to back,
+/// then drops the deleted instructions. Returns the new length. If hits is not
+/// NULL, the number of times each rule applied is added to its entry.
+unsigned int seadragon_limn2k_peephole(seadragon_limn2k_insn_t *insns, unsigned int length, unsigned int window,
+	unsigned long *hits);
+
+#endif // SEADRAGON_BACKEND_LIMN2K_PEEPHOLE_H_
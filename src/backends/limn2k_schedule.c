@@ -0,0 +1,254 @@
+#include "limn2k_schedule.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Memory is tracked as one more register, read by loads and written by stores.
+#define LIMN2K_SCHEDULE_MEMORY 256
+
+seadragon_limn2k_class_t seadragon_limn2k_insn_class(seadragon_limn2k_insn_t *insn) {
+	switch (insn->kind) {
+	case LIMN2K_INSN_ARITH:
+	case LIMN2K_INSN_ARITH_IMMEDIATE:
+		return insn->op == OPERATION_MUL ? LIMN2K_CLASS_MUL : insn->op == OPERATION_DIV ? LIMN2K_CLASS_DIV : LIMN2K_CLASS_ALU;
+	case LIMN2K_INSN_LOAD:
+		return LIMN2K_CLASS_LOAD;
+	case LIMN2K_INSN_STORE:
+		return LIMN2K_CLASS_STORE;
+	case LIMN2K_INSN_LABEL:
+	case LIMN2K_INSN_JUMP:
+	case LIMN2K_INSN_BRANCH:
+	case LIMN2K_INSN_RET:
+		return LIMN2K_CLASS_BRANCH;
+	default:
+		return LIMN2K_CLASS_ALU;
+	}
+}
+
+/// Stores the registers insn reads, memory included, and returns how many.
+/// r0 always reads as zero, so it is left out.
+static unsigned int seadragon_limn2k_schedule_reads(seadragon_limn2k_insn_t *insn, unsigned int reads[3]) {
+	unsigned int count = 0;
+	switch (insn->kind) {
+	case LIMN2K_INSN_MOV:
+	case LIMN2K_INSN_ARITH_IMMEDIATE:
+		reads[count++] = insn->ra;
+		break;
+	case LIMN2K_INSN_LOAD:
+		reads[count++] = insn->ra;
+		reads[count++] = LIMN2K_SCHEDULE_MEMORY;
+		break;
+	case LIMN2K_INSN_ARITH:
+	case LIMN2K_INSN_STORE:
+	case LIMN2K_INSN_BRANCH:
+		reads[count++] = insn->ra;
+		reads[count++] = insn->rb;
+		break;
+	default:
+		break;
+	}
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < count; i += 1) {
+		if (reads[i]) {
+			reads[kept++] = reads[i];
+		}
+	}
+	return kept;
+}
+
+/// Returns the register insn writes, LIMN2K_SCHEDULE_MEMORY for stores, or 0.
+static unsigned int seadragon_limn2k_schedule_writes(seadragon_limn2k_insn_t *insn) {
+	return insn->kind == LIMN2K_INSN_STORE ? LIMN2K_SCHEDULE_MEMORY : seadragon_limn2k_insn_writes(insn);
+}
+
+static bool seadragon_limn2k_schedule_uses(seadragon_limn2k_insn_t *insn, unsigned int reg) {
+	unsigned int reads[3];
+	unsigned int count = seadragon_limn2k_schedule_reads(insn, reads);
+	for (unsigned int i = 0; i < count; i += 1) {
+		if (reads[i] == reg) {
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t seadragon_limn2k_schedule_cycles(seadragon_limn2k_insn_t *insns, unsigned int length, const seadragon_limn2k_model_t *model) {
+	if (!model) {
+		model = &seadragon_limn2k_default_model;
+	}
+	uint64_t ready[LIMN2K_SCHEDULE_MEMORY] = { 0 };
+	uint64_t issue = 0, end = 0;
+	for (unsigned int i = 0; i < length; i += 1) {
+		unsigned int reads[3];
+		unsigned int count = seadragon_limn2k_schedule_reads(&insns[i], reads);
+		uint64_t start = issue;
+		for (unsigned int j = 0; j < count; j += 1) {
+			// Memory is ready as soon as the store issues
+			if (reads[j] != LIMN2K_SCHEDULE_MEMORY && ready[reads[j]] > start) {
+				start = ready[reads[j]];
+			}
+		}
+		issue = start + 1;
+		end = issue > end ? issue : end;
+		uint8_t rd = seadragon_limn2k_insn_writes(&insns[i]);
+		if (rd) {
+			ready[rd] = start + model->latency[seadragon_limn2k_insn_class(&insns[i])];
+			end = ready[rd] > end ? ready[rd] : end;
+		}
+	}
+	return end;
+}
+
+/// Scratch space for scheduling stretches of up to window instructions.
+typedef struct {
+	unsigned int window;
+	/// latency[i * window + j] is the cycles j must issue after i, or 0 if j
+	/// does not depend on i
+	unsigned int *latency;
+	unsigned int *preds, *height, *order;
+	uint64_t *earliest;
+	seadragon_limn2k_insn_t *scheduled;
+} seadragon_limn2k_schedule_t;
+
+/// Builds the dependences between the instructions of a stretch. Every
+/// dependence costs at least the cycle the earlier instruction issues in.
+static void seadragon_limn2k_schedule_depend(seadragon_limn2k_schedule_t *s, seadragon_limn2k_insn_t *insns, unsigned int length,
+		const seadragon_limn2k_model_t *model) {
+	memset(s->latency, 0, sizeof(unsigned int) * s->window * s->window);
+	for (unsigned int j = 0; j < length; j += 1) {
+		unsigned int reads[3];
+		unsigned int count = seadragon_limn2k_schedule_reads(&insns[j], reads);
+		// A read depends on the last instruction writing the register
+		for (unsigned int r = 0; r < count; r += 1) {
+			for (unsigned int i = j; i > 0; i -= 1) {
+				if (seadragon_limn2k_schedule_writes(&insns[i - 1]) == reads[r]) {
+					unsigned int latency = reads[r] == LIMN2K_SCHEDULE_MEMORY ? 1
+						: model->latency[seadragon_limn2k_insn_class(&insns[i - 1])];
+					unsigned int *edge = &s->latency[(i - 1) * s->window + j];
+					*edge = latency > *edge ? latency : *edge;
+					break;
+				}
+			}
+		}
+		// A write stays after every earlier use of the register
+		unsigned int written = seadragon_limn2k_schedule_writes(&insns[j]);
+		for (unsigned int i = 0; written && i < j; i += 1) {
+			unsigned int *edge = &s->latency[i * s->window + j];
+			if (!*edge && (seadragon_limn2k_schedule_writes(&insns[i]) == written || seadragon_limn2k_schedule_uses(&insns[i], written))) {
+				*edge = 1;
+			}
+		}
+	}
+}
+
+/// Schedules a stretch of straight-line code, returning whether it was reordered.
+static bool seadragon_limn2k_schedule_stretch(seadragon_limn2k_schedule_t *s, seadragon_limn2k_insn_t *insns, unsigned int length,
+		const seadragon_limn2k_model_t *model) {
+	if (length < 2) {
+		return false;
+	}
+	seadragon_limn2k_schedule_depend(s, insns, length, model);
+	// Dependences only point forwards, so heights are found back to front
+	for (unsigned int i = length; i > 0; i -= 1) {
+		unsigned int height = model->latency[seadragon_limn2k_insn_class(&insns[i - 1])];
+		for (unsigned int j = i; j < length; j += 1) {
+			unsigned int latency = s->latency[(i - 1) * s->window + j];
+			if (latency && latency + s->height[j] > height) {
+				height = latency + s->height[j];
+			}
+		}
+		s->height[i - 1] = height;
+	}
+	for (unsigned int j = 0; j < length; j += 1) {
+		s->preds[j] = 0;
+		s->earliest[j] = 0;
+		for (unsigned int i = 0; i < j; i += 1) {
+			s->preds[j] += s->latency[i * s->window + j] != 0;
+		}
+	}
+
+	uint64_t cycle = 0;
+	for (unsigned int n = 0; n < length; n += 1) {
+		// Of the instructions whose operands are ready, the one on the longest
+		// path; failing that, the one ready soonest. Ties keep the old order.
+		unsigned int best = length;
+		for (unsigned int i = 0; i < length; i += 1) {
+			if (s->preds[i]) {
+				continue;
+			}
+			if (best == length) {
+				best = i;
+				continue;
+			}
+			bool ready = s->earliest[i] <= cycle, best_ready = s->earliest[best] <= cycle;
+			if (ready != best_ready) {
+				best = ready ? i : best;
+			}
+			else if (!ready && s->earliest[i] != s->earliest[best]) {
+				best = s->earliest[i] < s->earliest[best] ? i : best;
+			}
+			else if (s->height[i] > s->height[best]) {
+				best = i;
+			}
+		}
+		uint64_t issue = s->earliest[best] > cycle ? s->earliest[best] : cycle;
+		cycle = issue + 1;
+		s->order[n] = best;
+		// Never picked again
+		s->preds[best] = UINT32_MAX;
+		for (unsigned int j = best + 1; j < length; j += 1) {
+			unsigned int latency = s->latency[best * s->window + j];
+			if (latency) {
+				s->preds[j] -= 1;
+				s->earliest[j] = issue + latency > s->earliest[j] ? issue + latency : s->earliest[j];
+			}
+		}
+	}
+
+	bool moved = false;
+	for (unsigned int n = 0; n < length; n += 1) {
+		s->scheduled[n] = insns[s->order[n]];
+		moved |= s->order[n] != n;
+	}
+	if (!moved || seadragon_limn2k_schedule_cycles(s->scheduled, length, model) >= seadragon_limn2k_schedule_cycles(insns, length, model)) {
+		return false;
+	}
+	memcpy(insns, s->scheduled, sizeof(seadragon_limn2k_insn_t) * length);
+	return true;
+}
+
+unsigned int seadragon_limn2k_schedule(seadragon_limn2k_insn_t *insns, unsigned int length, unsigned int window,
+		const seadragon_limn2k_model_t *model) {
+	if (!window || !length) {
+		return 0;
+	}
+	if (!model) {
+		model = &seadragon_limn2k_default_model;
+	}
+	window = window < length ? window : length;
+	seadragon_limn2k_schedule_t s = {
+		.window = window,
+		.latency = malloc(sizeof(unsigned int) * window * window),
+		.preds = malloc(sizeof(unsigned int) * window),
+		.height = malloc(sizeof(unsigned int) * window),
+		.order = malloc(sizeof(unsigned int) * window),
+		.earliest = malloc(sizeof(uint64_t) * window),
+		.scheduled = malloc(sizeof(seadragon_limn2k_insn_t) * window),
+	};
+	unsigned int reordered = 0, start = 0;
+	for (unsigned int i = 0; i <= length; i += 1) {
+		// Labels and control flow stay where they are, and bound the stretches
+		bool boundary = i == length || seadragon_limn2k_insn_class(&insns[i]) == LIMN2K_CLASS_BRANCH;
+		if (boundary || i - start == window) {
+			reordered += seadragon_limn2k_schedule_stretch(&s, insns + start, i - start, model);
+			start = boundary ? i + 1 : i;
+		}
+	}
+	free(s.latency);
+	free(s.preds);
+	free(s.height);
+	free(s.order);
+	free(s.earliest);
+	free(s.scheduled);
+	return reordered;
+}
@@ -0,0 +1,37 @@
+#ifndef SEADRAGON_BACKEND_LIMN2K_SCHEDULE_H_
+#define SEADRAGON_BACKEND_LIMN2K_SCHEDULE_H_
+
+#include "limn2k_peephole.h"
+#include "limn2k_sim.h"
+
+/// A list scheduler for the straight-line stretches of limn2k code between
+/// labels and control flow, which reorders independent instructions so that
+/// latencies are hidden under the machine model the simulator times code
+/// with. It runs after register allocation and keeps every register the
+/// instruction uses, so it never needs more registers than codegen did; reuse
+/// of a register orders the instructions involved, as does any store with
+/// every other memory access.
+///
+/// Each stretch is scheduled greedily: of the instructions whose operands
+/// are ready, the one on the longest latency path to the end of the stretch
+/// issues first. The new order is only kept if it takes fewer cycles than the
+/// old one on the in-order pipeline of the simulator.
+
+/// Longest stretch scheduled at once; longer ones are split. 0 disables the pass.
+#ifndef SEADRAGON_LIMN2K_SCHEDULE_WINDOW
+#define SEADRAGON_LIMN2K_SCHEDULE_WINDOW 64
+#endif
+
+/// Returns the class timing insn in the machine model.
+seadragon_limn2k_class_t seadragon_limn2k_insn_class(seadragon_limn2k_insn_t *insn);
+
+/// Estimates the cycles a stretch of straight-line code takes, counting until
+/// the last instruction issues and every result it wrote is ready.
+uint64_t seadragon_limn2k_schedule_cycles(seadragon_limn2k_insn_t *insns, unsigned int length, const seadragon_limn2k_model_t *model);
+
+/// Schedules the instructions of one function in place. model may be NULL for
+/// the default. Returns the number of stretches that were reordered.
+unsigned int seadragon_limn2k_schedule(seadragon_limn2k_insn_t *insns, unsigned int length, unsigned int window,
+	const seadragon_limn2k_model_t *model);
+
+#endif // SEADRAGON_BACKEND_LIMN2K_SCHEDULE_H_
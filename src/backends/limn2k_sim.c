@@ -0,0 +1,705 @@
+#include "limn2k_sim.h"
+#include "../ast.h"
+#include "list.h"
+#include "map.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+const seadragon_limn2k_model_t seadragon_limn2k_default_model = {
+	.latency = {
+		[LIMN2K_CLASS_ALU] = 1,
+		[LIMN2K_CLASS_MUL] = 3,
+		[LIMN2K_CLASS_DIV] = 20,
+		[LIMN2K_CLASS_LOAD] = 2,
+		[LIMN2K_CLASS_STORE] = 1,
+		[LIMN2K_CLASS_BRANCH] = 1,
+	},
+	.taken_penalty = 2,
+};
+
+#define LIMN2K_SIM_REGISTERS 32
+
+typedef enum {
+	LIMN2K_SIM_LI,
+	LIMN2K_SIM_LUI,
+	LIMN2K_SIM_LA,
+	LIMN2K_SIM_MOV,
+	LIMN2K_SIM_ARITH,
+	LIMN2K_SIM_ARITH_IMMEDIATE,
+	LIMN2K_SIM_LOAD,
+	LIMN2K_SIM_STORE,
+	LIMN2K_SIM_JUMP,
+	LIMN2K_SIM_BRANCH,
+	LIMN2K_SIM_RET,
+} seadragon_limn2k_sim_kind_t;
+
+static const struct {
+	const char *name;
+	seadragon_limn2k_sim_kind_t kind;
+	seadragon_operation_t op;
+	seadragon_limn2k_class_t class;
+} limn2k_sim_mnemonics[] = {
+	{ "li", LIMN2K_SIM_LI, OPERATION_NONE, LIMN2K_CLASS_ALU },
+	{ "lui", LIMN2K_SIM_LUI, OPERATION_NONE, LIMN2K_CLASS_ALU },
+	{ "la", LIMN2K_SIM_LA, OPERATION_NONE, LIMN2K_CLASS_ALU },
+	{ "mov", LIMN2K_SIM_MOV, OPERATION_NONE, LIMN2K_CLASS_ALU },
+	{ "add", LIMN2K_SIM_ARITH, OPERATION_ADD, LIMN2K_CLASS_ALU },
+	{ "sub", LIMN2K_SIM_ARITH, OPERATION_SUB, LIMN2K_CLASS_ALU },
+	{ "mul", LIMN2K_SIM_ARITH, OPERATION_MUL, LIMN2K_CLASS_MUL },
+	{ "div", LIMN2K_SIM_ARITH, OPERATION_DIV, LIMN2K_CLASS_DIV },
+	{ "and", LIMN2K_SIM_ARITH, OPERATION_AND, LIMN2K_CLASS_ALU },
+	{ "or", LIMN2K_SIM_ARITH, OPERATION_OR, LIMN2K_CLASS_ALU },
+	{ "lsh", LIMN2K_SIM_ARITH, OPERATION_LSH, LIMN2K_CLASS_ALU },
+	{ "rsh", LIMN2K_SIM_ARITH, OPERATION_RSH, LIMN2K_CLASS_ALU },
+	{ "addi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_ADD, LIMN2K_CLASS_ALU },
+	{ "subi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_SUB, LIMN2K_CLASS_ALU },
+	{ "muli", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_MUL, LIMN2K_CLASS_MUL },
+	{ "divi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_DIV, LIMN2K_CLASS_DIV },
+	{ "andi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_AND, LIMN2K_CLASS_ALU },
+	{ "ori", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_OR, LIMN2K_CLASS_ALU },
+	{ "lshi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_LSH, LIMN2K_CLASS_ALU },
+	{ "rshi", LIMN2K_SIM_ARITH_IMMEDIATE, OPERATION_RSH, LIMN2K_CLASS_ALU },
+	{ "l.l", LIMN2K_SIM_LOAD, OPERATION_GLONG, LIMN2K_CLASS_LOAD },
+	{ "l.i", LIMN2K_SIM_LOAD, OPERATION_GINT, LIMN2K_CLASS_LOAD },
+	{ "l.b", LIMN2K_SIM_LOAD, OPERATION_GBYTE, LIMN2K_CLASS_LOAD },
+	{ "s.l", LIMN2K_SIM_STORE, OPERATION_SLONG, LIMN2K_CLASS_STORE },
+	{ "s.i", LIMN2K_SIM_STORE, OPERATION_SINT, LIMN2K_CLASS_STORE },
+	{ "s.b", LIMN2K_SIM_STORE, OPERATION_SBYTE, LIMN2K_CLASS_STORE },
+	{ "b", LIMN2K_SIM_JUMP, OPERATION_NONE, LIMN2K_CLASS_BRANCH },
+	{ "blt", LIMN2K_SIM_BRANCH, OPERATION_CLT, LIMN2K_CLASS_BRANCH },
+	{ "bgt", LIMN2K_SIM_BRANCH, OPERATION_CGT, LIMN2K_CLASS_BRANCH },
+	{ "ble", LIMN2K_SIM_BRANCH, OPERATION_CLE, LIMN2K_CLASS_BRANCH },
+	{ "bge", LIMN2K_SIM_BRANCH, OPERATION_CGE, LIMN2K_CLASS_BRANCH },
+	{ "beq", LIMN2K_SIM_BRANCH, OPERATION_EQ, LIMN2K_CLASS_BRANCH },
+	{ "bne", LIMN2K_SIM_BRANCH, OPERATION_NE, LIMN2K_CLASS_BRANCH },
+	{ "ret", LIMN2K_SIM_RET, OPERATION_NONE, LIMN2K_CLASS_BRANCH },
+};
+
+typedef struct {
+	seadragon_limn2k_sim_kind_t kind;
+	seadragon_operation_t op;
+	seadragon_limn2k_class_t class;
+	uint8_t rd, ra, rb;
+	/// Immediate, address of an la symbol, or index of a branch target
+	uint32_t imm;
+	/// Symbol or label operand, until resolved
+	char *symbol;
+	unsigned int function;
+	/// 1-based line in the assembly, and its text
+	unsigned int line;
+	const char *text;
+	int text_length;
+	/// Times executed, and cycles charged, stalls included
+	uint64_t count, cycles;
+} seadragon_limn2k_sim_insn_t;
+
+typedef struct {
+	char *name;
+	unsigned int entry;
+	seadragon_limn2k_sim_stats_t stats;
+} seadragon_limn2k_sim_function_t;
+
+typedef struct {
+	char *name;
+	uint32_t address;
+} seadragon_limn2k_sim_symbol_t;
+
+struct seadragon_limn2k_sim {
+	seadragon_limn2k_model_t model;
+	char *text;
+	seadragon_limn2k_sim_insn_t *code;
+	unsigned int length, capacity;
+	/// list of seadragon_limn2k_sim_function_t, in order of appearance
+	list_t *functions;
+	/// list of seadragon_limn2k_sim_symbol_t
+	list_t *symbols;
+	uint8_t *memory;
+	size_t size;
+	seadragon_limn2k_sim_stats_t stats;
+};
+
+static bool limn2k_sim_error(unsigned int line, const char *msg) {
+	fprintf(stderr, "<asm>:%u: error: limn2k sim: %s\n", line, msg);
+	return false;
+}
+
+/// Splits the operands after a mnemonic, which are separated by commas, in
+/// place. Returns the number found, or -1 if there are too many.
+static int limn2k_sim_operands(char *s, char **operands, int max) {
+	int count = 0;
+	while (*s) {
+		while (isspace((unsigned char)*s)) {
+			s += 1;
+		}
+		if (!*s) {
+			break;
+		}
+		if (count == max) {
+			return -1;
+		}
+		operands[count] = s;
+		count += 1;
+		char *end = strchr(s, ',');
+		char *next = end ? end + 1 : s + strlen(s);
+		if (!end) {
+			end = next;
+		}
+		while (end > s && isspace((unsigned char)end[-1])) {
+			end -= 1;
+		}
+		*end = 0;
+		s = next;
+	}
+	return count;
+}
+
+static bool limn2k_sim_number(const char *s, uint32_t max, uint32_t *out) {
+	char *end;
+	unsigned long value = strtoul(s, &end, 0);
+	if (end == s || *end || value > max) {
+		return false;
+	}
+	*out = value;
+	return true;
+}
+
+static bool limn2k_sim_register(const char *s, uint8_t *out) {
+	uint32_t value;
+	if (!limn2k_sim_number(s, LIMN2K_SIM_REGISTERS - 1, &value)) {
+		return false;
+	}
+	*out = value;
+	return true;
+}
+
+static seadragon_limn2k_sim_insn_t *limn2k_sim_emit(seadragon_limn2k_sim_t *sim) {
+	if (sim->length == sim->capacity) {
+		sim->capacity = sim->capacity ? sim->capacity * 2 : 256;
+		sim->code = realloc(sim->code, sim->capacity * sizeof(seadragon_limn2k_sim_insn_t));
+	}
+	seadragon_limn2k_sim_insn_t *insn = &sim->code[sim->length];
+	memset(insn, 0, sizeof(*insn));
+	sim->length += 1;
+	return insn;
+}
+
+/// Parses one instruction; line is modified in place.
+static bool limn2k_sim_instruction(seadragon_limn2k_sim_t *sim, char *line, unsigned int number) {
+	char *operands[3];
+	char *mnemonic = line;
+	while (*line && !isspace((unsigned char)*line)) {
+		line += 1;
+	}
+	if (*line) {
+		*line = 0;
+		line += 1;
+	}
+	unsigned int m = 0;
+	while (m < sizeof(limn2k_sim_mnemonics) / sizeof(limn2k_sim_mnemonics[0]) && strcmp(limn2k_sim_mnemonics[m].name, mnemonic)) {
+		m += 1;
+	}
+	if (m == sizeof(limn2k_sim_mnemonics) / sizeof(limn2k_sim_mnemonics[0])) {
+		return limn2k_sim_error(number, "Unknown instruction");
+	}
+	int count = limn2k_sim_operands(line, operands, 3);
+	seadragon_limn2k_sim_insn_t *insn = limn2k_sim_emit(sim);
+	insn->kind = limn2k_sim_mnemonics[m].kind;
+	insn->op = limn2k_sim_mnemonics[m].op;
+	insn->class = limn2k_sim_mnemonics[m].class;
+	insn->function = sim->functions->length - 1;
+	insn->line = number;
+	bool valid = false;
+	switch (insn->kind) {
+	case LIMN2K_SIM_LI:
+	case LIMN2K_SIM_LUI:
+		valid = count == 2 && limn2k_sim_register(operands[0], &insn->rd) && limn2k_sim_number(operands[1], UINT16_MAX, &insn->imm);
+		break;
+	case LIMN2K_SIM_LA:
+		valid = count == 2 && limn2k_sim_register(operands[0], &insn->rd);
+		insn->symbol = valid ? strdup(operands[1]) : NULL;
+		break;
+	case LIMN2K_SIM_MOV:
+		valid = count == 2 && limn2k_sim_register(operands[0], &insn->rd) && limn2k_sim_register(operands[1], &insn->ra);
+		break;
+	case LIMN2K_SIM_ARITH:
+		valid = count == 3 && limn2k_sim_register(operands[0], &insn->rd) && limn2k_sim_register(operands[1], &insn->ra)
+			&& limn2k_sim_register(operands[2], &insn->rb);
+		break;
+	case LIMN2K_SIM_ARITH_IMMEDIATE:
+	case LIMN2K_SIM_LOAD:
+		valid = count == 3 && limn2k_sim_register(operands[0], &insn->rd) && limn2k_sim_register(operands[1], &insn->ra)
+			&& limn2k_sim_number(operands[2], UINT16_MAX, &insn->imm);
+		break;
+	case LIMN2K_SIM_STORE:
+		valid = count == 3 && limn2k_sim_register(operands[0], &insn->ra) && limn2k_sim_number(operands[1], UINT16_MAX, &insn->imm)
+			&& limn2k_sim_register(operands[2], &insn->rb);
+		break;
+	case LIMN2K_SIM_JUMP:
+		valid = count == 1;
+		insn->symbol = valid ? strdup(operands[0]) : NULL;
+		break;
+	case LIMN2K_SIM_BRANCH:
+		valid = count == 3 && limn2k_sim_register(operands[0], &insn->ra) && limn2k_sim_register(operands[1], &insn->rb);
+		insn->symbol = valid ? strdup(operands[2]) : NULL;
+		break;
+	case LIMN2K_SIM_RET:
+		valid = count == 0;
+		break;
+	}
+	return valid ? true : limn2k_sim_error(number, "Invalid operands");
+}
+
+/// Resolves labels and symbols, once the whole text has been read.
+static bool limn2k_sim_link(seadragon_limn2k_sim_t *sim, map_t *labels) {
+	for (unsigned int i = 0; i < sim->length; i += 1) {
+		seadragon_limn2k_sim_insn_t *insn = &sim->code[i];
+		if (!insn->symbol) {
+			continue;
+		}
+		if (insn->kind == LIMN2K_SIM_LA) {
+			if (!seadragon_limn2k_sim_symbol(sim, insn->symbol, &insn->imm)) {
+				return limn2k_sim_error(insn->line, "Unknown symbol");
+			}
+		}
+		else {
+			uintptr_t target = (uintptr_t)map_get(labels, insn->symbol);
+			if (!target) {
+				return limn2k_sim_error(insn->line, "Unknown label");
+			}
+			insn->imm = target - 1;
+		}
+		free(insn->symbol);
+		insn->symbol = NULL;
+	}
+	return true;
+}
+
+/// Lays the bss out at the end of memory, aligned to its largest alignment.
+static bool limn2k_sim_layout(seadragon_limn2k_sim_t *sim, uint64_t bss, uint64_t alignment) {
+	if (bss > sim->size) {
+		return limn2k_sim_error(0, "The bss section does not fit in memory");
+	}
+	uint64_t base = (sim->size - bss) & ~(alignment - 1);
+	for (unsigned int i = 0; i < sim->symbols->length; i += 1) {
+		((seadragon_limn2k_sim_symbol_t*)sim->symbols->items[i])->address += base;
+	}
+	return true;
+}
+
+static bool limn2k_sim_parse(seadragon_limn2k_sim_t *sim, char *text, map_t *labels, list_t *names) {
+	bool in_bss = false;
+	uint64_t bss = 0, alignment = 1;
+	unsigned int number = 0;
+	for (char *line = text, *next; line; line = next) {
+		number += 1;
+		next = strchr(line, '\n');
+		if (next) {
+			*next = 0;
+			next += 1;
+		}
+		char *comment = strchr(line, ';');
+		if (comment) {
+			*comment = 0;
+		}
+		while (isspace((unsigned char)*line)) {
+			line += 1;
+		}
+		size_t length = strlen(line);
+		while (length && isspace((unsigned char)line[length - 1])) {
+			length -= 1;
+		}
+		line[length] = 0;
+		if (!length) {
+			continue;
+		}
+		if (line[length - 1] == ':') {
+			line[length - 1] = 0;
+			char *name = strdup(line);
+			list_add(names, name);
+			if (map_get(labels, name)) {
+				return limn2k_sim_error(number, "Duplicate label");
+			}
+			if (in_bss) {
+				seadragon_limn2k_sim_symbol_t *symbol = malloc(sizeof(seadragon_limn2k_sim_symbol_t));
+				symbol->name = strdup(name);
+				symbol->address = bss;
+				list_add(sim->symbols, symbol);
+			}
+			else if (name[0] != '.') {
+				seadragon_limn2k_sim_function_t *function = calloc(1, sizeof(seadragon_limn2k_sim_function_t));
+				function->name = strdup(name);
+				function->entry = sim->length;
+				list_add(sim->functions, function);
+			}
+			map_set(labels, name, (void*)(uintptr_t)(sim->length + 1));
+			continue;
+		}
+		if (line[0] == '.') {
+			char *operands[2];
+			char *directive = line;
+			while (*line && !isspace((unsigned char)*line)) {
+				line += 1;
+			}
+			if (*line) {
+				*line = 0;
+				line += 1;
+			}
+			// `.bytes N V` separates its operands with a space
+			for (char *c = line; *c; c += 1) {
+				*c = *c == ' ' ? ',' : *c;
+			}
+			int count = limn2k_sim_operands(line, operands, 2);
+			uint32_t value, fill;
+			if (!strcmp(directive, ".section")) {
+				if (count != 1) {
+					return limn2k_sim_error(number, "Invalid section");
+				}
+				in_bss = !strcmp(operands[0], "bss");
+			}
+			// `.alias NAME TARGET` is another name for an earlier function
+			else if (!strcmp(directive, ".alias")) {
+				seadragon_limn2k_sim_function_t *target = NULL;
+				for (unsigned int i = 0; count == 2 && !in_bss && i < sim->functions->length; i += 1) {
+					seadragon_limn2k_sim_function_t *function = sim->functions->items[i];
+					target = strcmp(function->name, operands[1]) ? target : function;
+				}
+				if (!target) {
+					return limn2k_sim_error(number, "Invalid alias");
+				}
+				if (map_get(labels, operands[0])) {
+					return limn2k_sim_error(number, "Duplicate label");
+				}
+				char *name = strdup(operands[0]);
+				list_add(names, name);
+				seadragon_limn2k_sim_function_t *function = calloc(1, sizeof(seadragon_limn2k_sim_function_t));
+				function->name = strdup(name);
+				function->entry = target->entry;
+				list_add(sim->functions, function);
+				map_set(labels, name, (void*)(uintptr_t)(target->entry + 1));
+			}
+			else if (!in_bss) {
+				return limn2k_sim_error(number, "Data outside of bss is unsupported");
+			}
+			else if (!strcmp(directive, ".align")) {
+				if (count != 1 || !limn2k_sim_number(operands[0], UINT32_MAX, &value) || !value || (value & (value - 1))) {
+					return limn2k_sim_error(number, "Invalid alignment");
+				}
+				bss = (bss + value - 1) & ~(uint64_t)(value - 1);
+				alignment = value > alignment ? value : alignment;
+			}
+			else if (!strcmp(directive, ".bytes")) {
+				if (count != 2 || !limn2k_sim_number(operands[0], UINT32_MAX, &value) || !limn2k_sim_number(operands[1], 0, &fill)) {
+					return limn2k_sim_error(number, "Only zero-filled .bytes are supported");
+				}
+				bss += value;
+			}
+			else {
+				return limn2k_sim_error(number, "Unknown directive");
+			}
+			continue;
+		}
+		if (in_bss || !sim->functions->length) {
+			return limn2k_sim_error(number, "Instruction outside of a function");
+		}
+		if (!limn2k_sim_instruction(sim, line, number)) {
+			return false;
+		}
+		seadragon_limn2k_sim_insn_t *insn = &sim->code[sim->length - 1];
+		// The parsed copy was cut apart, so point into the pristine one
+		insn->text = sim->text + (line - text);
+		insn->text_length = length;
+	}
+	return limn2k_sim_layout(sim, bss, alignment) && limn2k_sim_link(sim, labels);
+}
+
+seadragon_limn2k_sim_t *seadragon_limn2k_sim_assemble(const char *text, size_t length, size_t memory_size, const seadragon_limn2k_model_t *model) {
+	if (memory_size > (size_t)UINT32_MAX + 1) {
+		return NULL;
+	}
+	seadragon_limn2k_sim_t *sim = calloc(1, sizeof(seadragon_limn2k_sim_t));
+	sim->model = model ? *model : seadragon_limn2k_default_model;
+	sim->functions = list_create();
+	sim->symbols = list_create();
+	sim->size = memory_size;
+	sim->memory = calloc(memory_size ? memory_size : 1, 1);
+	// Parsing cuts a copy of the text apart; the report quotes another
+	sim->text = malloc(length + 1);
+	memcpy(sim->text, text, length);
+	sim->text[length] = 0;
+	char *scratch = strdup(sim->text);
+	map_t *labels = map_create();
+	list_t *names = list_create();
+	bool success = sim->memory && limn2k_sim_parse(sim, scratch, labels, names);
+	free(scratch);
+	map_free(labels);
+	for (unsigned int i = 0; i < names->length; i += 1) {
+		free(names->items[i]);
+	}
+	list_free(names);
+	if (!success) {
+		seadragon_limn2k_sim_free(sim);
+		return NULL;
+	}
+	return sim;
+}
+
+void seadragon_limn2k_sim_free(seadragon_limn2k_sim_t *sim) {
+	for (unsigned int i = 0; i < sim->length; i += 1) {
+		free(sim->code[i].symbol);
+	}
+	for (unsigned int i = 0; i < sim->functions->length; i += 1) {
+		seadragon_limn2k_sim_function_t *function = sim->functions->items[i];
+		free(function->name);
+		free(function);
+	}
+	for (unsigned int i = 0; i < sim->symbols->length; i += 1) {
+		seadragon_limn2k_sim_symbol_t *symbol = sim->symbols->items[i];
+		free(symbol->name);
+		free(symbol);
+	}
+	list_free(sim->functions);
+	list_free(sim->symbols);
+	free(sim->code);
+	free(sim->text);
+	free(sim->memory);
+	free(sim);
+}
+
+static seadragon_limn2k_sim_function_t *limn2k_sim_function(seadragon_limn2k_sim_t *sim, const char *name) {
+	for (unsigned int i = 0; i < sim->functions->length; i += 1) {
+		seadragon_limn2k_sim_function_t *function = sim->functions->items[i];
+		if (!strcmp(function->name, name)) {
+			return function;
+		}
+	}
+	return NULL;
+}
+
+static uint32_t limn2k_sim_arith(seadragon_operation_t op, uint32_t a, uint32_t b) {
+	switch (op) {
+	case OPERATION_ADD: return a + b;
+	case OPERATION_SUB: return a - b;
+	case OPERATION_MUL: return a * b;
+	case OPERATION_DIV: return a / b;
+	case OPERATION_AND: return a & b;
+	case OPERATION_OR: return a | b;
+	case OPERATION_LSH: return b < 32 ? a << b : 0;
+	case OPERATION_RSH: return b < 32 ? a >> b : 0;
+	default: return 0;
+	}
+}
+
+static bool limn2k_sim_compare(seadragon_operation_t op, uint32_t a, uint32_t b) {
+	switch (op) {
+	case OPERATION_CLT: return a < b;
+	case OPERATION_CGT: return a > b;
+	case OPERATION_CLE: return a <= b;
+	case OPERATION_CGE: return a >= b;
+	case OPERATION_EQ: return a == b;
+	default: return a != b;
+	}
+}
+
+static void limn2k_sim_account(seadragon_limn2k_sim_stats_t *stats, uint64_t cycles, uint64_t stall, bool taken) {
+	stats->instructions += 1;
+	stats->cycles += cycles;
+	stats->stalls += stall;
+	stats->taken_branches += taken;
+}
+
+bool seadragon_limn2k_sim_run(seadragon_limn2k_sim_t *sim, const char *name, uint32_t outputs[2]) {
+	seadragon_limn2k_sim_function_t *function = limn2k_sim_function(sim, name);
+	if (!function) {
+		fprintf(stderr, "error: limn2k sim: Unknown function `%s`\n", name);
+		return false;
+	}
+	uint32_t r[LIMN2K_SIM_REGISTERS] = { 0 };
+	uint64_t ready[LIMN2K_SIM_REGISTERS] = { 0 };
+	uint64_t cycle = 0;
+	unsigned int pc = function->entry;
+	const char *error = NULL;
+	while (!error) {
+		if (pc >= sim->length) {
+			error = "Ran past the end of the code";
+			break;
+		}
+		seadragon_limn2k_sim_insn_t *insn = &sim->code[pc];
+		uint64_t start = cycle;
+		bool reads_a = insn->kind != LIMN2K_SIM_LI && insn->kind != LIMN2K_SIM_LUI && insn->kind != LIMN2K_SIM_LA
+			&& insn->kind != LIMN2K_SIM_JUMP && insn->kind != LIMN2K_SIM_RET;
+		bool reads_b = insn->kind == LIMN2K_SIM_ARITH || insn->kind == LIMN2K_SIM_STORE || insn->kind == LIMN2K_SIM_BRANCH;
+		if (reads_a && ready[insn->ra] > start) {
+			start = ready[insn->ra];
+		}
+		if (reads_b && ready[insn->rb] > start) {
+			start = ready[insn->rb];
+		}
+		bool writes = false, taken = false, done = false;
+		uint32_t value = 0, address = r[insn->ra] + insn->imm;
+		unsigned int next = pc + 1;
+		switch (insn->kind) {
+		case LIMN2K_SIM_LI:
+		case LIMN2K_SIM_LA:
+			value = insn->imm;
+			writes = true;
+			break;
+		case LIMN2K_SIM_LUI:
+			value = insn->imm << 16;
+			writes = true;
+			break;
+		case LIMN2K_SIM_MOV:
+			value = r[insn->ra];
+			writes = true;
+			break;
+		case LIMN2K_SIM_ARITH:
+		case LIMN2K_SIM_ARITH_IMMEDIATE:{
+			uint32_t b = insn->kind == LIMN2K_SIM_ARITH ? r[insn->rb] : insn->imm;
+			if (insn->op == OPERATION_DIV && !b) {
+				error = "Division by zero";
+				break;
+			}
+			value = limn2k_sim_arith(insn->op, r[insn->ra], b);
+			writes = true;
+			break;}
+		case LIMN2K_SIM_LOAD:
+		case LIMN2K_SIM_STORE:{
+			unsigned int width = insn->op == OPERATION_GLONG || insn->op == OPERATION_SLONG ? 4
+				: insn->op == OPERATION_GINT || insn->op == OPERATION_SINT ? 2 : 1;
+			if ((uint64_t)address + width > sim->size) {
+				error = "Memory access out of bounds";
+				break;
+			}
+			uint8_t *memory = sim->memory + address;
+			if (insn->kind == LIMN2K_SIM_LOAD) {
+				for (unsigned int i = 0; i < width; i += 1) {
+					value |= (uint32_t)memory[i] << (i * 8);
+				}
+				writes = true;
+			}
+			else {
+				for (unsigned int i = 0; i < width; i += 1) {
+					memory[i] = r[insn->rb] >> (i * 8);
+				}
+			}
+			break;}
+		case LIMN2K_SIM_JUMP:
+			next = insn->imm;
+			taken = true;
+			break;
+		case LIMN2K_SIM_BRANCH:
+			taken = limn2k_sim_compare(insn->op, r[insn->ra], r[insn->rb]);
+			next = taken ? insn->imm : next;
+			break;
+		case LIMN2K_SIM_RET:
+			done = true;
+			break;
+		}
+		if (error) {
+			break;
+		}
+		// r0 always reads as zero
+		if (writes && insn->rd) {
+			r[insn->rd] = value;
+			ready[insn->rd] = start + sim->model.latency[insn->class];
+		}
+		uint64_t after = start + 1 + (taken ? sim->model.taken_penalty : 0);
+		insn->count += 1;
+		insn->cycles += after - cycle;
+		limn2k_sim_account(&sim->stats, after - cycle, start - cycle, taken);
+		limn2k_sim_account(&((seadragon_limn2k_sim_function_t*)sim->functions->items[insn->function])->stats, after - cycle, start - cycle, taken);
+		cycle = after;
+		if (done) {
+			// Outputs are returned in r10 and r11
+			outputs[0] = r[10];
+			outputs[1] = r[11];
+			return true;
+		}
+		pc = next;
+	}
+	unsigned int line = pc < sim->length ? sim->code[pc].line : 0;
+	fprintf(stderr, "<asm>:%u: error: limn2k sim: %s in %s\n", line, error, name);
+	return false;
+}
+
+bool seadragon_limn2k_sim_stats(seadragon_limn2k_sim_t *sim, const char *name, seadragon_limn2k_sim_stats_t *stats) {
+	if (!name) {
+		*stats = sim->stats;
+		return true;
+	}
+	seadragon_limn2k_sim_function_t *function = limn2k_sim_function(sim, name);
+	if (function) {
+		*stats = function->stats;
+	}
+	return function != NULL;
+}
+
+/// Orders instruction indices by decreasing cycles, then by position.
+static int limn2k_sim_hotter(const void *a, const void *b, void *code) {
+	const seadragon_limn2k_sim_insn_t *x = (seadragon_limn2k_sim_insn_t*)code + *(const unsigned int*)a;
+	const seadragon_limn2k_sim_insn_t *y = (seadragon_limn2k_sim_insn_t*)code + *(const unsigned int*)b;
+	if (x->cycles != y->cycles) {
+		return x->cycles < y->cycles ? 1 : -1;
+	}
+	return x->line < y->line ? -1 : x->line > y->line;
+}
+
+void seadragon_limn2k_sim_report(seadragon_limn2k_sim_t *sim, FILE *out, unsigned int hotspots) {
+	seadragon_limn2k_sim_stats_t *stats = &sim->stats;
+	fprintf(out, "instructions: %llu\n", (unsigned long long)stats->instructions);
+	fprintf(out, "cycles: %llu (%.2f per instruction)\n", (unsigned long long)stats->cycles,
+		stats->instructions ? (double)stats->cycles / stats->instructions : 0.0);
+	fprintf(out, "stalls: %llu\n", (unsigned long long)stats->stalls);
+	fprintf(out, "taken branches: %llu\n", (unsigned long long)stats->taken_branches);
+	fprintf(out, "\n%-24s %12s %12s\n", "function", "instructions", "cycles");
+	for (unsigned int i = 0; i < sim->functions->length; i += 1) {
+		seadragon_limn2k_sim_function_t *function = sim->functions->items[i];
+		if (function->stats.instructions) {
+			fprintf(out, "%-24s %12llu %12llu\n", function->name, (unsigned long long)function->stats.instructions,
+				(unsigned long long)function->stats.cycles);
+		}
+	}
+	unsigned int *order = malloc((sim->length + 1) * sizeof(unsigned int));
+	unsigned int ran = 0;
+	for (unsigned int i = 0; i < sim->length; i += 1) {
+		if (sim->code[i].count) {
+			order[ran] = i;
+			ran += 1;
+		}
+	}
+	// Insertion sort, as qsort has no context argument in C99
+	for (unsigned int i = 1; i < ran; i += 1) {
+		unsigned int index = order[i], j = i;
+		while (j > 0 && limn2k_sim_hotter(&order[j - 1], &index, sim->code) > 0) {
+			order[j] = order[j - 1];
+			j -= 1;
+		}
+		order[j] = index;
+	}
+	fprintf(out, "\n%12s %12s  line\n", "cycles", "count");
+	for (unsigned int i = 0; i < ran && i < hotspots; i += 1) {
+		seadragon_limn2k_sim_insn_t *insn = &sim->code[order[i]];
+		fprintf(out, "%12llu %12llu  %u: %.*s\n", (unsigned long long)insn->cycles, (unsigned long long)insn->count,
+			insn->line, insn->text_length, insn->text);
+	}
+	free(order);
+}
+
+uint8_t *seadragon_limn2k_sim_memory(seadragon_limn2k_sim_t *sim, size_t *size) {
+	if (size) {
+		*size = sim->size;
+	}
+	return sim->memory;
+}
+
+bool seadragon_limn2k_sim_symbol(seadragon_limn2k_sim_t *sim, const char *name, uint32_t *address) {
+	for (unsigned int i = 0; i < sim->symbols->length; i += 1) {
+		seadragon_limn2k_sim_symbol_t *symbol = sim->symbols->items[i];
+		if (!strcmp(symbol->name, name)) {
+			*address = symbol->address;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,71 @@
+#ifndef SEADRAGON_BACKEND_LIMN2K_SIM_H_
+#define SEADRAGON_BACKEND_LIMN2K_SIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// A limn2k simulator for measuring generated code: it assembles the text the
+/// limn2k backend prints, runs it, and counts instructions and estimated
+/// cycles per function and per line of assembly.
+///
+/// Timing follows an in-order, single-issue pipeline: an instruction issues
+/// one cycle after the previous one, or once the registers it reads are
+/// ready, whichever is later, and a taken branch costs a refetch penalty.
+/// Memory is a zero-filled array with the bss section laid out at its end;
+/// accesses outside it and division by zero stop the run with an error.
+/// `.alias NAME TARGET` names an earlier function again, and what runs through
+/// the alias is counted towards the target.
+
+typedef enum {
+	LIMN2K_CLASS_ALU,
+	LIMN2K_CLASS_MUL,
+	LIMN2K_CLASS_DIV,
+	LIMN2K_CLASS_LOAD,
+	LIMN2K_CLASS_STORE,
+	LIMN2K_CLASS_BRANCH,
+	LIMN2K_CLASS_COUNT,
+} seadragon_limn2k_class_t;
+
+typedef struct {
+	/// Cycles after issue until the result may be read, by instruction class
+	unsigned int latency[LIMN2K_CLASS_COUNT];
+	/// Cycles lost when a branch or jump is taken
+	unsigned int taken_penalty;
+} seadragon_limn2k_model_t;
+
+/// A small in-order core: single-cycle ALU, 3-cycle multiply, 20-cycle
+/// divide, 2-cycle loads and a 2-cycle taken-branch penalty.
+extern const seadragon_limn2k_model_t seadragon_limn2k_default_model;
+
+typedef struct {
+	uint64_t instructions, cycles;
+	/// Cycles spent waiting for operands
+	uint64_t stalls;
+	uint64_t taken_branches;
+} seadragon_limn2k_sim_stats_t;
+
+typedef struct seadragon_limn2k_sim seadragon_limn2k_sim_t;
+
+/// Assembles limn2k text. memory_size may be up to 4 GiB; model is copied, and
+/// may be NULL for the default. Returns NULL, after printing the offending
+/// line, on failure.
+seadragon_limn2k_sim_t *seadragon_limn2k_sim_assemble(const char *text, size_t length, size_t memory_size, const seadragon_limn2k_model_t *model);
+void seadragon_limn2k_sim_free(seadragon_limn2k_sim_t *sim);
+
+/// Runs a function until it returns, storing its two output registers.
+/// Statistics accumulate over all runs.
+bool seadragon_limn2k_sim_run(seadragon_limn2k_sim_t *sim, const char *function, uint32_t outputs[2]);
+
+/// Retrieves the statistics of a function, or of all runs if function is NULL.
+bool seadragon_limn2k_sim_stats(seadragon_limn2k_sim_t *sim, const char *function, seadragon_limn2k_sim_stats_t *stats);
+/// Prints the totals, a line per function that ran, and the given number of
+/// lines of assembly that took the most cycles.
+void seadragon_limn2k_sim_report(seadragon_limn2k_sim_t *sim, FILE *out, unsigned int hotspots);
+
+uint8_t *seadragon_limn2k_sim_memory(seadragon_limn2k_sim_t *sim, size_t *size);
+/// Finds the address a bss symbol was placed at.
+bool seadragon_limn2k_sim_symbol(seadragon_limn2k_sim_t *sim, const char *name, uint32_t *address);
+
+#endif // SEADRAGON_BACKEND_LIMN2K_SIM_H_
@@ -0,0 +1,733 @@
+// MAP_ANONYMOUS and MAP_NORESERVE
+#define _DEFAULT_SOURCE
+
+#include "x86_64.h"
+#include "../codegen.h"
+#include "list.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define ERROR(msg) seadragon_session_error(backend->session, "%s:%d: error: x86_64: %s", __FILE__, __LINE__, msg)
+
+enum {
+	X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+	X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+/// Host registers handed out to codegen, in order. rax, rcx and rdx are
+/// scratch for the backend itself, as division and shifts need them; rdi holds
+/// the outputs pointer and r15 the memory base.
+static const uint8_t x86_64_registers[] = {
+	X86_RBX, X86_RBP, X86_RSI, X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14,
+};
+
+/// Saved on entry, as the System V ABI requires of the callee.
+static const uint8_t x86_64_saved[] = {
+	X86_RBX, X86_RBP, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+/// Where a value lives; registers handed to codegen point to one.
+typedef struct {
+	/// The variable's identifier, or NULL for a temporary
+	const char *identifier;
+	/// Set while a temporary is reserved
+	bool busy;
+	/// Host register, or -1 if spilled to the stack slot
+	int reg;
+	uint32_t slot;
+} seadragon_x86_64_location;
+
+/// A 32-bit field at the given code offset, to be filled in once its target
+/// is known: a rel32 to a block, the frame size, or a buffer's address.
+typedef struct {
+	size_t at;
+	union {
+		unsigned int block;
+		seadragon_buffer_t *buffer;
+	} u;
+} seadragon_x86_64_fixup;
+
+typedef struct {
+	char *name;
+	/// Code offset of a function, or address of a buffer
+	uint32_t offset;
+	uint32_t size;
+} seadragon_x86_64_symbol;
+
+typedef struct {
+	seadragon_backend_t base;
+	seadragon_function_t *function;
+	/// list of seadragon_x86_64_location for the current function
+	list_t *locations;
+	unsigned int registers_used, slots_used;
+	/// Code of all functions so far, only made executable once complete
+	uint8_t *code;
+	size_t length, capacity;
+	size_t function_start;
+	/// Code offset of each block of the current function, or SIZE_MAX
+	size_t *labels;
+	unsigned int label_capacity;
+	/// Fixups of the current function's jumps and frame size, and of every
+	/// function's buffer addresses
+	seadragon_x86_64_fixup *jumps, *frames, *buffer_fixups;
+	unsigned int jump_count, frame_count, buffer_fixup_count;
+	unsigned int jump_capacity, frame_capacity, buffer_fixup_capacity;
+	/// list of seadragon_x86_64_symbol
+	list_t *functions, *buffers;
+	uint32_t bss;
+	seadragon_session_t *session;
+} seadragon_x86_64;
+
+struct seadragon_jit {
+	uint8_t *code;
+	size_t size;
+	/// list of seadragon_x86_64_symbol
+	list_t *functions, *buffers;
+};
+
+static void x86_byte(seadragon_x86_64 *backend, uint8_t byte) {
+	if (backend->length == backend->capacity) {
+		size_t capacity = backend->capacity ? backend->capacity * 2 : 4096;
+		uint8_t *code = realloc(backend->code, capacity);
+		if (!code) {
+			ERROR("Out of memory");
+			return;
+		}
+		backend->code = code;
+		backend->capacity = capacity;
+	}
+	backend->code[backend->length] = byte;
+	backend->length += 1;
+}
+
+static void x86_u32(seadragon_x86_64 *backend, uint32_t value) {
+	for (int i = 0; i < 4; i += 1) {
+		x86_byte(backend, value >> (i * 8));
+	}
+}
+
+static void x86_patch(seadragon_x86_64 *backend, size_t at, uint32_t value) {
+	for (int i = 0; i < 4; i += 1) {
+		backend->code[at + i] = value >> (i * 8);
+	}
+}
+
+/// Records a fixup for the 32-bit field that was just emitted. Returns NULL
+/// if out of memory.
+static seadragon_x86_64_fixup *x86_fixup(seadragon_x86_64 *backend, seadragon_x86_64_fixup **fixups, unsigned int *count, unsigned int *capacity) {
+	if (*count == *capacity) {
+		unsigned int grown_capacity = *capacity ? *capacity * 2 : 16;
+		seadragon_x86_64_fixup *grown = realloc(*fixups, grown_capacity * sizeof(seadragon_x86_64_fixup));
+		if (!grown) {
+			ERROR("Out of memory");
+			return NULL;
+		}
+		*fixups = grown;
+		*capacity = grown_capacity;
+	}
+	seadragon_x86_64_fixup *fixup = &(*fixups)[*count];
+	*count += 1;
+	fixup->at = backend->length - 4;
+	return fixup;
+}
+
+static void x86_rex(seadragon_x86_64 *backend, bool w, int reg, int index, int rm, bool force) {
+	uint8_t rex = 0x40 | w << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | rm >> 3;
+	if (rex != 0x40 || force) {
+		x86_byte(backend, rex);
+	}
+}
+
+static void x86_opcode(seadragon_x86_64 *backend, const char *opcode) {
+	for (; *opcode; opcode += 1) {
+		x86_byte(backend, *opcode);
+	}
+}
+
+/// `op reg, rm` between registers; which one is the destination depends on op.
+static void x86_rr(seadragon_x86_64 *backend, const char *opcode, int reg, int rm) {
+	x86_rex(backend, false, reg, 0, rm, false);
+	x86_opcode(backend, opcode);
+	x86_byte(backend, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/// `op reg, [rsp + disp]`
+static void x86_stack(seadragon_x86_64 *backend, const char *opcode, int reg, uint32_t disp) {
+	x86_rex(backend, false, reg, 0, X86_RSP, false);
+	x86_opcode(backend, opcode);
+	x86_byte(backend, 0x80 | (reg & 7) << 3 | 4);
+	x86_byte(backend, 0x24);
+	x86_u32(backend, disp);
+}
+
+/// `op reg, [r15 + rax]`, the Dragonfruit address in eax. The REX prefix is
+/// always present so that the byte registers of rsi and rbp can be named.
+static void x86_memory(seadragon_x86_64 *backend, bool word, const char *opcode, int reg) {
+	if (word) {
+		x86_byte(backend, 0x66);
+	}
+	x86_rex(backend, false, reg, X86_RAX, X86_R15, true);
+	x86_opcode(backend, opcode);
+	x86_byte(backend, (reg & 7) << 3 | 4);
+	x86_byte(backend, X86_RAX << 3 | (X86_R15 & 7));
+}
+
+static void x86_mov_imm(seadragon_x86_64 *backend, int reg, uint32_t imm) {
+	x86_rex(backend, false, 0, 0, reg, false);
+	x86_byte(backend, 0xB8 | (reg & 7));
+	x86_u32(backend, imm);
+}
+
+static void x86_mov(seadragon_x86_64 *backend, int dst, int src) {
+	if (dst != src) {
+		x86_rr(backend, "\x89", src, dst);
+	}
+}
+
+/// The 0x81 group: `op reg, imm32`, where ext selects add, or, and, sub or cmp.
+static void x86_alu_imm(seadragon_x86_64 *backend, int ext, int reg, uint32_t imm) {
+	x86_rr(backend, "\x81", ext, reg);
+	x86_u32(backend, imm);
+}
+
+/// Loads a location into a register, using scratch if it was spilled.
+static int x86_read(seadragon_x86_64 *backend, seadragon_x86_64_location *location, int scratch) {
+	if (location->reg >= 0) {
+		return location->reg;
+	}
+	x86_stack(backend, "\x8B", scratch, location->slot * 4);
+	return scratch;
+}
+
+/// Returns the register a result for location should be computed in.
+static int x86_target(seadragon_x86_64_location *location) {
+	return location->reg >= 0 ? location->reg : X86_RAX;
+}
+
+/// Stores a result computed in reg to location.
+static void x86_write(seadragon_x86_64 *backend, seadragon_x86_64_location *location, int reg) {
+	if (location->reg >= 0) {
+		x86_mov(backend, location->reg, reg);
+	}
+	else {
+		x86_stack(backend, "\x89", reg, location->slot * 4);
+	}
+}
+
+static seadragon_x86_64_location *x86_64_location(seadragon_x86_64 *backend, const char *identifier) {
+	for (unsigned int i = 0; i < backend->locations->length; i += 1) {
+		seadragon_x86_64_location *location = backend->locations->items[i];
+		if (!location->identifier && !location->busy) {
+			location->identifier = identifier;
+			location->busy = true;
+			return location;
+		}
+	}
+	seadragon_x86_64_location *location = malloc(sizeof(seadragon_x86_64_location));
+	location->identifier = identifier;
+	location->busy = true;
+	if (backend->registers_used < sizeof(x86_64_registers)) {
+		location->reg = x86_64_registers[backend->registers_used];
+		backend->registers_used += 1;
+	}
+	else {
+		location->reg = -1;
+		location->slot = backend->slots_used;
+		backend->slots_used += 1;
+	}
+	list_add(backend->locations, location);
+	return location;
+}
+
+static void *x86_64_register_allocate(void *_backend, char *ident) {
+	seadragon_x86_64 *backend = _backend;
+	for (unsigned int i = 0; i < backend->locations->length; i += 1) {
+		seadragon_x86_64_location *location = backend->locations->items[i];
+		if (location->identifier && !strcmp(location->identifier, ident)) {
+			return location;
+		}
+	}
+	return x86_64_location(backend, ident);
+}
+
+static void x86_64_begin_function(void *_backend, seadragon_function_t *func) {
+	seadragon_x86_64 *backend = _backend;
+	for (unsigned int i = 0; i < backend->locations->length; i += 1) {
+		free(backend->locations->items[i]);
+	}
+	backend->locations->length = 0;
+	backend->registers_used = backend->slots_used = 0;
+	backend->jump_count = backend->frame_count = 0;
+	for (unsigned int i = 0; i < backend->label_capacity; i += 1) {
+		backend->labels[i] = SIZE_MAX;
+	}
+	backend->function = func;
+	backend->function_start = backend->length;
+	for (unsigned int i = 0; i < sizeof(x86_64_saved); i += 1) {
+		x86_rex(backend, false, 0, 0, x86_64_saved[i], false);
+		x86_byte(backend, 0x50 | (x86_64_saved[i] & 7));
+	}
+	// sub rsp, frame
+	x86_byte(backend, 0x48);
+	x86_alu_imm(backend, 5, X86_RSP, 0);
+	x86_fixup(backend, &backend->frames, &backend->frame_count, &backend->frame_capacity);
+	// mov r15, rsi
+	x86_rex(backend, true, X86_RSI, 0, X86_R15, false);
+	x86_byte(backend, 0x89);
+	x86_byte(backend, 0xC0 | (X86_RSI & 7) << 3 | (X86_R15 & 7));
+	// Variables start out zero, as in the interpreter and the C backend, so
+	// every one is placed up front
+	x86_mov_imm(backend, X86_RAX, 0);
+	list_t *lists[] = { func->inputs, func->outputs, func->autos };
+	for (unsigned int i = 0; i < sizeof(lists) / sizeof(*lists); i += 1) {
+		for (unsigned int j = 0; j < lists[i]->length; j += 1) {
+			x86_write(backend, x86_64_register_allocate(backend, lists[i]->items[j]), X86_RAX);
+		}
+	}
+}
+
+static void x86_64_end_function(void *_backend) {
+	seadragon_x86_64 *backend = _backend;
+	for (unsigned int i = 0; i < backend->jump_count; i += 1) {
+		seadragon_x86_64_fixup *jump = &backend->jumps[i];
+		if (jump->u.block >= backend->label_capacity || backend->labels[jump->u.block] == SIZE_MAX) {
+			ERROR("Internal error: jump to a block without a label");
+			return;
+		}
+		x86_patch(backend, jump->at, backend->labels[jump->u.block] - (jump->at + 4));
+	}
+	for (unsigned int i = 0; i < backend->frame_count; i += 1) {
+		x86_patch(backend, backend->frames[i].at, backend->slots_used * 4);
+	}
+	seadragon_x86_64_symbol *symbol = malloc(sizeof(seadragon_x86_64_symbol));
+	symbol->name = strdup(backend->function->name);
+	symbol->offset = backend->function_start;
+	symbol->size = backend->length - backend->function_start;
+	list_add(backend->functions, symbol);
+}
+
+static void *x86_64_register_temporary(void *_backend) {
+	return x86_64_location(_backend, NULL);
+}
+
+static void x86_64_register_free(void *_backend, void *reg) {
+	(void)_backend;
+	seadragon_x86_64_location *location = reg;
+	if (!location->identifier) {
+		location->busy = false;
+	}
+}
+
+static void x86_64_set_long(void *_backend, void *reg, seadragon_value_t *val) {
+	seadragon_x86_64 *backend = _backend;
+	int dst = x86_target(reg);
+	switch (val->type) {
+	case VALUE_TYPE_LITERAL:
+		x86_mov_imm(backend, dst, val->u.literal);
+		break;
+	case VALUE_TYPE_BUFFER:{
+		x86_mov_imm(backend, dst, 0);
+		seadragon_x86_64_fixup *fixup = x86_fixup(backend, &backend->buffer_fixups, &backend->buffer_fixup_count, &backend->buffer_fixup_capacity);
+		if (fixup) {
+			fixup->u.buffer = val->u.buffer;
+		}
+		break;}
+	default:
+		ERROR("Unsupported value");
+		return;
+	}
+	x86_write(backend, reg, dst);
+}
+
+static void x86_64_move(void *_backend, void *dst, void *src) {
+	seadragon_x86_64 *backend = _backend;
+	x86_write(backend, dst, x86_read(backend, src, X86_RAX));
+}
+
+/// `eax = eax op ecx` for the operations x86 has no plain form of, with the
+/// Dragonfruit semantics: shifts by 32 or more give 0.
+static void x86_64_arith_special(seadragon_x86_64 *backend, seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_DIV:
+		// xor edx, edx; div ecx
+		x86_rr(backend, "\x31", X86_RDX, X86_RDX);
+		x86_rr(backend, "\xF7", 6, X86_RCX);
+		break;
+	case OPERATION_LSH:
+	case OPERATION_RSH:
+		// x86 masks the count, so the result is replaced when it is too large
+		x86_rr(backend, "\x31", X86_RDX, X86_RDX);
+		x86_rr(backend, "\xD3", op == OPERATION_LSH ? 4 : 5, X86_RAX);
+		x86_alu_imm(backend, 7, X86_RCX, 32);
+		x86_rr(backend, "\x0F\x43", X86_RAX, X86_RDX);
+		break;
+	default:
+		ERROR("Unsupported arithmetic operation");
+		return;
+	}
+}
+
+/// Returns the 0x01-style opcode of op, or NULL if it has none.
+static const char *x86_64_alu_opcode(seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_ADD: return "\x01";
+	case OPERATION_SUB: return "\x29";
+	case OPERATION_AND: return "\x21";
+	case OPERATION_OR: return "\x09";
+	default: return NULL;
+	}
+}
+
+static void x86_64_arith(void *_backend, seadragon_operation_t op, void *dst, void *lhs, void *rhs) {
+	seadragon_x86_64 *backend = _backend;
+	const char *opcode = x86_64_alu_opcode(op);
+	if (opcode || op == OPERATION_MUL) {
+		int a = x86_read(backend, lhs, X86_RAX);
+		int b = x86_read(backend, rhs, X86_RCX);
+		int d = x86_target(dst);
+		if (d == b && d != a) {
+			// Moving lhs into place would overwrite rhs
+			d = X86_RAX;
+		}
+		x86_mov(backend, d, a);
+		if (opcode) {
+			x86_rr(backend, opcode, b, d);
+		}
+		else {
+			x86_rr(backend, "\x0F\xAF", d, b);
+		}
+		x86_write(backend, dst, d);
+		return;
+	}
+	x86_mov(backend, X86_RCX, x86_read(backend, rhs, X86_RCX));
+	x86_mov(backend, X86_RAX, x86_read(backend, lhs, X86_RAX));
+	x86_64_arith_special(backend, op);
+	x86_write(backend, dst, X86_RAX);
+}
+
+static void x86_64_arith_immediate(void *_backend, seadragon_operation_t op, void *dst, void *lhs, uint32_t imm) {
+	seadragon_x86_64 *backend = _backend;
+	int d = x86_target(dst);
+	switch (op) {
+	case OPERATION_ADD:
+	case OPERATION_SUB:
+	case OPERATION_AND:
+	case OPERATION_OR:
+		x86_mov(backend, d, x86_read(backend, lhs, X86_RAX));
+		x86_alu_imm(backend, op == OPERATION_ADD ? 0 : op == OPERATION_OR ? 1 : op == OPERATION_AND ? 4 : 5, d, imm);
+		break;
+	case OPERATION_MUL:
+		x86_rr(backend, "\x69", d, x86_read(backend, lhs, X86_RAX));
+		x86_u32(backend, imm);
+		break;
+	case OPERATION_LSH:
+	case OPERATION_RSH:
+		if (imm >= 32) {
+			x86_mov_imm(backend, d, 0);
+			break;
+		}
+		x86_mov(backend, d, x86_read(backend, lhs, X86_RAX));
+		x86_rr(backend, "\xC1", op == OPERATION_LSH ? 4 : 5, d);
+		x86_byte(backend, imm);
+		break;
+	default:
+		x86_mov_imm(backend, X86_RCX, imm);
+		x86_mov(backend, X86_RAX, x86_read(backend, lhs, X86_RAX));
+		x86_64_arith_special(backend, op);
+		d = X86_RAX;
+		break;
+	}
+	x86_write(backend, dst, d);
+}
+
+static void x86_64_memory(void *_backend, seadragon_operation_t op, void *val, void *base, uint32_t offset) {
+	seadragon_x86_64 *backend = _backend;
+	// The address is computed in eax; 32-bit operations wrap around as
+	// Dragonfruit addresses do, and clear the upper half of rax.
+	if (base) {
+		x86_mov(backend, X86_RAX, x86_read(backend, base, X86_RAX));
+		if (offset) {
+			x86_alu_imm(backend, 0, X86_RAX, offset);
+		}
+	}
+	else {
+		x86_mov_imm(backend, X86_RAX, offset);
+	}
+	int reg;
+	switch (op) {
+	case OPERATION_GLONG:
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:
+		reg = x86_target(val);
+		x86_memory(backend, false, op == OPERATION_GLONG ? "\x8B" : op == OPERATION_GINT ? "\x0F\xB7" : "\x0F\xB6", reg);
+		x86_write(backend, val, reg);
+		break;
+	case OPERATION_SLONG:
+	case OPERATION_SINT:
+	case OPERATION_SBYTE:
+		reg = x86_read(backend, val, X86_RCX);
+		x86_memory(backend, op == OPERATION_SINT, op == OPERATION_SBYTE ? "\x88" : "\x89", reg);
+		break;
+	default:
+		ERROR("Unsupported memory operation");
+		return;
+	}
+}
+
+static void x86_64_label(void *_backend, unsigned int block) {
+	seadragon_x86_64 *backend = _backend;
+	if (block >= backend->label_capacity) {
+		unsigned int capacity = backend->label_capacity ? backend->label_capacity : 16;
+		while (capacity <= block) {
+			capacity *= 2;
+		}
+		size_t *labels = realloc(backend->labels, capacity * sizeof(size_t));
+		if (!labels) {
+			ERROR("Out of memory");
+			return;
+		}
+		for (unsigned int i = backend->label_capacity; i < capacity; i += 1) {
+			labels[i] = SIZE_MAX;
+		}
+		backend->labels = labels;
+		backend->label_capacity = capacity;
+	}
+	backend->labels[block] = backend->length;
+}
+
+static void x86_64_jump(void *_backend, unsigned int block) {
+	seadragon_x86_64 *backend = _backend;
+	x86_byte(backend, 0xE9);
+	x86_u32(backend, 0);
+	seadragon_x86_64_fixup *fixup = x86_fixup(backend, &backend->jumps, &backend->jump_count, &backend->jump_capacity);
+	if (fixup) {
+		fixup->u.block = block;
+	}
+}
+
+static void x86_64_branch(void *_backend, seadragon_operation_t op, void *lhs, void *rhs, unsigned int block) {
+	seadragon_x86_64 *backend = _backend;
+	uint8_t condition;
+	// Comparisons are unsigned
+	switch (op) {
+	case OPERATION_CLT: condition = 0x2; break;
+	case OPERATION_CGT: condition = 0x7; break;
+	case OPERATION_CLE: condition = 0x6; break;
+	case OPERATION_CGE: condition = 0x3; break;
+	case OPERATION_EQ: condition = 0x4; break;
+	case OPERATION_NE: condition = 0x5; break;
+	default:
+		ERROR("Unsupported branch condition");
+		return;
+	}
+	int a = x86_read(backend, lhs, X86_RAX);
+	if (rhs) {
+		x86_rr(backend, "\x39", x86_read(backend, rhs, X86_RCX), a);
+	}
+	else {
+		x86_rr(backend, "\x85", a, a);
+	}
+	x86_byte(backend, 0x0F);
+	x86_byte(backend, 0x80 | condition);
+	x86_u32(backend, 0);
+	seadragon_x86_64_fixup *fixup = x86_fixup(backend, &backend->jumps, &backend->jump_count, &backend->jump_capacity);
+	if (fixup) {
+		fixup->u.block = block;
+	}
+}
+
+static void x86_64_ret(void *_backend) {
+	seadragon_x86_64 *backend = _backend;
+	seadragon_function_t *func = backend->function;
+	for (unsigned int i = 0; i < func->outputs->length; i += 1) {
+		// mov [rdi + 4i], output
+		int reg = x86_read(backend, x86_64_register_allocate(backend, func->outputs->items[i]), X86_RAX);
+		x86_rex(backend, false, reg, 0, X86_RDI, false);
+		x86_byte(backend, 0x89);
+		x86_byte(backend, 0x80 | (reg & 7) << 3 | X86_RDI);
+		x86_u32(backend, i * 4);
+	}
+	// add rsp, frame
+	x86_byte(backend, 0x48);
+	x86_alu_imm(backend, 0, X86_RSP, 0);
+	x86_fixup(backend, &backend->frames, &backend->frame_count, &backend->frame_capacity);
+	for (unsigned int i = sizeof(x86_64_saved); i > 0; i -= 1) {
+		x86_rex(backend, false, 0, 0, x86_64_saved[i - 1], false);
+		x86_byte(backend, 0x58 | (x86_64_saved[i - 1] & 7));
+	}
+	x86_byte(backend, 0xC3);
+}
+
+static void x86_64_buffer(void *_backend, seadragon_buffer_t *buffer) {
+	seadragon_x86_64 *backend = _backend;
+	backend->bss = (backend->bss + buffer->alignment - 1) & ~(buffer->alignment - 1);
+	uint32_t address = SEADRAGON_JIT_BSS + backend->bss;
+	backend->bss += buffer->size;
+	for (unsigned int i = 0; i < backend->buffer_fixup_count; i += 1) {
+		if (backend->buffer_fixups[i].u.buffer == buffer) {
+			x86_patch(backend, backend->buffer_fixups[i].at, address);
+		}
+	}
+	seadragon_x86_64_symbol *symbol = malloc(sizeof(seadragon_x86_64_symbol));
+	symbol->name = strdup(buffer->name);
+	symbol->offset = address;
+	symbol->size = buffer->size;
+	list_add(backend->buffers, symbol);
+}
+
+static void x86_64_symbols_free(list_t *symbols) {
+	for (unsigned int i = 0; i < symbols->length; i += 1) {
+		seadragon_x86_64_symbol *symbol = symbols->items[i];
+		free(symbol->name);
+		free(symbol);
+	}
+	list_free(symbols);
+}
+
+/// Frees the backend, leaving its symbols to the caller if keep is set.
+static void x86_64_free(seadragon_x86_64 *backend, bool keep) {
+	for (unsigned int i = 0; i < backend->locations->length; i += 1) {
+		free(backend->locations->items[i]);
+	}
+	list_free(backend->locations);
+	if (!keep) {
+		x86_64_symbols_free(backend->functions);
+		x86_64_symbols_free(backend->buffers);
+	}
+	free(backend->code);
+	free(backend->labels);
+	free(backend->jumps);
+	free(backend->frames);
+	free(backend->buffer_fixups);
+	free(backend);
+}
+
+static void x86_64_deinit(void *_backend) {
+	x86_64_free(_backend, false);
+}
+
+seadragon_backend_t *seadragon_backend_x86_64(seadragon_session_t *session, FILE *out) {
+	(void)out;
+	seadragon_x86_64 *backend = calloc(1, sizeof(seadragon_x86_64));
+	backend->session = session;
+	backend->locations = list_create();
+	backend->functions = list_create();
+	backend->buffers = list_create();
+	backend->base.begin_function = x86_64_begin_function;
+	backend->base.end_function = x86_64_end_function;
+	backend->base.register_allocate = x86_64_register_allocate;
+	backend->base.register_temporary = x86_64_register_temporary;
+	backend->base.register_free = x86_64_register_free;
+	backend->base.set_long = x86_64_set_long;
+	backend->base.move = x86_64_move;
+	backend->base.arith = x86_64_arith;
+	backend->base.arith_immediate = x86_64_arith_immediate;
+	backend->base.memory = x86_64_memory;
+	backend->base.label = x86_64_label;
+	backend->base.jump = x86_64_jump;
+	backend->base.branch = x86_64_branch;
+	backend->base.ret = x86_64_ret;
+	backend->base.buffer = x86_64_buffer;
+	backend->base.deinit = x86_64_deinit;
+	return &backend->base;
+}
+
+seadragon_jit_t *seadragon_jit_compile(seadragon_session_t *session, seadragon_ast_t *ast, FILE *map) {
+#ifndef __x86_64__
+	// The code could still be generated, but not run
+	seadragon_session_error(session, "error: x86_64: The host is not x86-64");
+	return NULL;
+#endif
+	if (!ast || !ast->functions || !ast->buffers) {
+		return NULL;
+	}
+	seadragon_cg_ctx_t *ctx = seadragon_cg_begin(session, NULL, seadragon_backend_x86_64);
+	if (!ctx) {
+		return NULL;
+	}
+	seadragon_x86_64 *backend = (seadragon_x86_64*)seadragon_cg_backend(ctx);
+	bool success = true;
+	for (unsigned int i = 0; i < ast->functions->length && success; i += 1) {
+		success = seadragon_cg_function(ctx, ast->functions->items[i]);
+	}
+	success = seadragon_cg_end(ctx, ast->buffers) && success;
+	seadragon_jit_t *jit = NULL;
+	if (success && backend->length) {
+		// Written while writable, then made executable; never both at once
+		void *code = mmap(NULL, backend->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code != MAP_FAILED) {
+			memcpy(code, backend->code, backend->length);
+			if (mprotect(code, backend->length, PROT_READ | PROT_EXEC) == 0) {
+				jit = malloc(sizeof(seadragon_jit_t));
+				jit->code = code;
+				jit->size = backend->length;
+			}
+			else {
+				munmap(code, backend->length);
+			}
+		}
+	}
+	else if (success) {
+		jit = malloc(sizeof(seadragon_jit_t));
+		jit->code = NULL;
+		jit->size = 0;
+	}
+	if (!jit) {
+		x86_64_free(backend, false);
+		return NULL;
+	}
+	jit->functions = backend->functions;
+	jit->buffers = backend->buffers;
+	x86_64_free(backend, true);
+	for (unsigned int i = 0; map && i < jit->functions->length; i += 1) {
+		seadragon_x86_64_symbol *symbol = jit->functions->items[i];
+		fprintf(map, "%lx %x %s\n", (unsigned long)(uintptr_t)(jit->code + symbol->offset), symbol->size, symbol->name);
+	}
+	return jit;
+}
+
+seadragon_jit_function_t seadragon_jit_lookup(seadragon_jit_t *jit, const char *name) {
+	for (unsigned int i = 0; i < jit->functions->length; i += 1) {
+		seadragon_x86_64_symbol *symbol = jit->functions->items[i];
+		if (!strcmp(symbol->name, name)) {
+			// Function pointers cannot be converted from data pointers in ISO C,
+			// but POSIX requires it to work, as for dlsym
+			seadragon_jit_function_t function;
+			void *address = jit->code + symbol->offset;
+			memcpy(&function, &address, sizeof(function));
+			return function;
+		}
+	}
+	return NULL;
+}
+
+bool seadragon_jit_buffer(seadragon_jit_t *jit, const char *name, uint32_t *address) {
+	for (unsigned int i = 0; i < jit->buffers->length; i += 1) {
+		seadragon_x86_64_symbol *symbol = jit->buffers->items[i];
+		if (!strcmp(symbol->name, name)) {
+			*address = symbol->offset;
+			return true;
+		}
+	}
+	return false;
+}
+
+void seadragon_jit_free(seadragon_jit_t *jit) {
+	if (jit->code) {
+		munmap(jit->code, jit->size);
+	}
+	x86_64_symbols_free(jit->functions);
+	x86_64_symbols_free(jit->buffers);
+	free(jit);
+}
+
+uint8_t *seadragon_jit_memory(void) {
+	void *memory = mmap(NULL, (size_t)1 << 32, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return memory == MAP_FAILED ? NULL : memory;
+}
+
+void seadragon_jit_memory_free(uint8_t *memory) {
+	munmap(memory, (size_t)1 << 32);
+}
@@ -0,0 +1,42 @@
+#ifndef SEADRAGON_BACKEND_X86_64_H_
+#define SEADRAGON_BACKEND_X86_64_H_
+
+#include "../backend.h"
+#include "../session.h"
+#include <stdint.h>
+
+/// Encodes x86-64 machine code in memory, to run programs on the host without
+/// going through an assembler. Values are 32-bit, and memory is addressed
+/// relative to a base pointer given at each call, which must point to a
+/// zero-filled 4 GiB address space such as one from seadragon_jit_memory.
+/// Buffers are placed from SEADRAGON_JIT_BSS in that space. Variables live in
+/// callee-saved and caller-saved host registers and spill to the stack once
+/// those run out; a division by zero raises SIGFPE, as on the host.
+///
+/// The backend writes nothing to its FILE, and is only useful through
+/// seadragon_jit_compile.
+#define SEADRAGON_JIT_BSS 0x80000000u
+seadragon_backend_t *seadragon_backend_x86_64(seadragon_session_t *session, FILE *out);
+
+typedef struct seadragon_jit seadragon_jit_t;
+/// `fn f {-- a b}` is called as `f(outputs, memory)`, and stores a to outputs[0]
+/// and b to outputs[1].
+typedef void (*seadragon_jit_function_t)(uint32_t *outputs, uint8_t *memory);
+
+/// Compiles an AST that has passed sema into executable memory, or returns
+/// NULL on failure. Like seadragon_cg, it only reads the IR, which the caller
+/// still owns. If map is set, a `START SIZE NAME` line is written to it for
+/// each function, the format perf reads from /tmp/perf-PID.map.
+seadragon_jit_t *seadragon_jit_compile(seadragon_session_t *session, seadragon_ast_t *ast, FILE *map);
+/// Returns the function, or NULL if there is none by that name.
+seadragon_jit_function_t seadragon_jit_lookup(seadragon_jit_t *jit, const char *name);
+/// Finds the address a buffer was placed at.
+bool seadragon_jit_buffer(seadragon_jit_t *jit, const char *name, uint32_t *address);
+void seadragon_jit_free(seadragon_jit_t *jit);
+
+/// Reserves a zero-filled 4 GiB address space for compiled code to run in.
+/// Pages are only committed when touched. Returns NULL on failure.
+uint8_t *seadragon_jit_memory(void);
+void seadragon_jit_memory_free(uint8_t *memory);
+
+#endif // SEADRAGON_BACKEND_X86_64_H_
@@ -0,0 +1,277 @@
+#include "cfg.h"
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+seadragon_block_t *seadragon_cfg_block(list_t *blocks) {
+	seadragon_block_t *block = malloc(sizeof(seadragon_block_t));
+	block->id = blocks->length ? ((seadragon_block_t*)list_last(blocks))->id + 1 : 0;
+	block->statements = NULL;
+	block->statement_count = block->statement_capacity = 0;
+	block->terminator = TERMINATOR_RETURN;
+	block->condition = SEADRAGON_IR_NONE;
+	block->target = block->fallback = NULL;
+	block->loop_header = false;
+	block->early_return = false;
+	block->cold = false;
+	block->count = 0;
+	list_add(blocks, block);
+	return block;
+}
+
+unsigned int seadragon_cfg_max_id(list_t *blocks) {
+	unsigned int max = 0;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (block->id > max) {
+			max = block->id;
+		}
+	}
+	return max;
+}
+
+unsigned int seadragon_cfg_successors(seadragon_block_t *block, seadragon_block_t *succ[2]) {
+	switch (block->terminator) {
+	case TERMINATOR_JUMP:
+		succ[0] = block->target;
+		return 1;
+	case TERMINATOR_BRANCH:
+		// Prefer the branch taken more often, if profiled; then the one that
+		// doesn't only lead to an error path; otherwise the loop body or the
+		// `then` arm.
+		if (block->target->count != block->fallback->count ? block->fallback->count > block->target->count
+				: block->target->cold && !block->fallback->cold) {
+			succ[0] = block->fallback;
+			succ[1] = block->target;
+		}
+		else {
+			succ[0] = block->target;
+			succ[1] = block->fallback;
+		}
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static seadragon_block_t *seadragon_cfg_thread(seadragon_block_t *block, unsigned int limit) {
+	// The limit stops on cycles of empty blocks, e.g. `while (1) end`
+	for (unsigned int i = 0; i < limit && block->terminator == TERMINATOR_JUMP && !block->statement_count; i += 1) {
+		block = block->target;
+	}
+	return block;
+}
+
+void seadragon_cfg_simplify(seadragon_function_t *func) {
+	list_t *blocks = func->u.blocks;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (block->terminator != TERMINATOR_BRANCH) {
+			continue;
+		}
+		uint32_t literal;
+		if (seadragon_ir_is_literal(&func->pool, block->condition, &literal)) {
+			if (!literal) {
+				block->target = block->fallback;
+			}
+			block->terminator = TERMINATOR_JUMP;
+		}
+		else if (block->target == block->fallback) {
+			block->terminator = TERMINATOR_JUMP;
+		}
+	}
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (block->terminator != TERMINATOR_RETURN) {
+			block->target = seadragon_cfg_thread(block->target, blocks->length);
+		}
+		if (block->terminator == TERMINATOR_BRANCH) {
+			block->fallback = seadragon_cfg_thread(block->fallback, blocks->length);
+		}
+	}
+
+	unsigned int max = seadragon_cfg_max_id(blocks);
+	bool *reachable = calloc(max + 1, sizeof(bool));
+	list_t *worklist = list_create();
+	list_add(worklist, blocks->items[0]);
+	reachable[((seadragon_block_t*)blocks->items[0])->id] = true;
+	while (worklist->length) {
+		seadragon_block_t *block = list_pop(worklist);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(block, succ);
+		for (unsigned int i = 0; i < count; i += 1) {
+			if (!reachable[succ[i]->id]) {
+				reachable[succ[i]->id] = true;
+				list_add(worklist, succ[i]);
+			}
+		}
+	}
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (reachable[block->id]) {
+			blocks->items[kept++] = block;
+		}
+		else {
+			free(block->statements);
+			free(block);
+		}
+	}
+	blocks->length = kept;
+	list_free(worklist);
+	free(reachable);
+}
+
+/// A block is cold if it never ran, when profiled, or else if every path from
+/// it ends in an early return.
+static void seadragon_cfg_mark_cold(seadragon_function_t *func) {
+	list_t *blocks = func->u.blocks;
+	if (func->profiled) {
+		for (unsigned int i = 0; i < blocks->length; i += 1) {
+			seadragon_block_t *block = blocks->items[i];
+			block->cold = !block->count;
+		}
+		return;
+	}
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 0; i < blocks->length; i += 1) {
+			seadragon_block_t *block = blocks->items[i];
+			if (block->cold) {
+				continue;
+			}
+			bool cold = block->early_return;
+			if (block->terminator == TERMINATOR_JUMP) {
+				cold = block->target->cold;
+			}
+			else if (block->terminator == TERMINATOR_BRANCH) {
+				cold = block->target->cold && block->fallback->cold;
+			}
+			if (cold) {
+				block->cold = changed = true;
+			}
+		}
+	}
+}
+
+/// Marks the back edges of the CFG (edges to a block on the DFS stack); bit 0 is
+/// the likely successor and bit 1 the other one.
+static void seadragon_cfg_back_edges(list_t *blocks, unsigned int max, uint8_t *back) {
+	// 0 = unvisited, 1 = on stack, 2 = done
+	uint8_t *state = calloc(max + 1, 1);
+	list_t *stack = list_create();
+	list_add(stack, blocks->items[0]);
+	state[((seadragon_block_t*)blocks->items[0])->id] = 1;
+	while (stack->length) {
+		seadragon_block_t *block = list_last(stack);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(block, succ);
+		bool descended = false;
+		for (unsigned int i = 0; i < count && !descended; i += 1) {
+			if (state[succ[i]->id] == 0) {
+				state[succ[i]->id] = 1;
+				list_add(stack, succ[i]);
+				descended = true;
+			}
+		}
+		if (descended) {
+			continue;
+		}
+		for (unsigned int i = 0; i < count; i += 1) {
+			if (state[succ[i]->id] == 1) {
+				back[block->id] |= 1 << i;
+			}
+		}
+		state[block->id] = 2;
+		list_pop(stack);
+	}
+	list_free(stack);
+	free(state);
+}
+
+void seadragon_cfg_layout(seadragon_function_t *func) {
+	list_t *blocks = func->u.blocks;
+	unsigned int max = seadragon_cfg_max_id(blocks);
+	seadragon_cfg_mark_cold(func);
+	uint8_t *back = calloc(max + 1, 1);
+	seadragon_cfg_back_edges(blocks, max, back);
+
+	// A block is ready to be placed once all of its forward predecessors are.
+	unsigned int *preds = calloc(max + 1, sizeof(unsigned int));
+	bool *placed = calloc(max + 1, sizeof(bool));
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(block, succ);
+		for (unsigned int j = 0; j < count; j += 1) {
+			if (!(back[block->id] & (1 << j))) {
+				preds[succ[j]->id] += 1;
+			}
+		}
+	}
+
+	list_t *order = list_create();
+	list_t *ready = list_create();
+	list_t *cold = list_create();
+	seadragon_block_t *block = blocks->items[0];
+	while (block) {
+		placed[block->id] = true;
+		list_add(order, block);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(block, succ);
+		// Push the likely successor last so that it is placed next
+		for (unsigned int j = count; j-- > 0;) {
+			if (back[block->id] & (1 << j)) {
+				continue;
+			}
+			if (--preds[succ[j]->id] == 0) {
+				list_add(succ[j]->cold ? cold : ready, succ[j]);
+			}
+		}
+		block = NULL;
+		while (!block && (ready->length || cold->length)) {
+			block = list_pop(ready->length ? ready : cold);
+			if (placed[block->id]) {
+				block = NULL;
+			}
+		}
+	}
+	// Irreducible leftovers keep their original order
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (!placed[block->id]) {
+			list_add(order, block);
+		}
+	}
+
+	// Rotate loops: move the header after the last latch, so that the body falls
+	// into the exit test and each iteration takes a single branch.
+	for (unsigned int i = 1; i + 1 < order->length; i += 1) {
+		seadragon_block_t *header = order->items[i];
+		if (!header->loop_header || header->terminator != TERMINATOR_BRANCH || order->items[i + 1] != header->target) {
+			continue;
+		}
+		unsigned int latch = 0;
+		for (unsigned int j = i + 1; j < order->length; j += 1) {
+			seadragon_block_t *block = order->items[j];
+			if (block->terminator == TERMINATOR_JUMP && block->target == header) {
+				latch = j;
+			}
+		}
+		if (latch) {
+			memmove(&order->items[i], &order->items[i + 1], sizeof(void*) * (latch - i));
+			order->items[latch] = header;
+			i = latch;
+		}
+	}
+
+	list_free(blocks);
+	func->u.blocks = order;
+	list_free(ready);
+	list_free(cold);
+	free(placed);
+	free(preds);
+	free(back);
+}
@@ -0,0 +1,27 @@
+#ifndef SEADRAGON_CFG_H_
+#define SEADRAGON_CFG_H_
+
+#include "ast.h"
+
+/// Creates an empty block terminated by a return, and appends it to blocks.
+seadragon_block_t *seadragon_cfg_block(list_t *blocks);
+
+/// The largest block id in blocks, for sizing arrays indexed by id.
+unsigned int seadragon_cfg_max_id(list_t *blocks);
+
+/// Fills succ with the block's successors, likely one first; returns the count.
+unsigned int seadragon_cfg_successors(seadragon_block_t *block, seadragon_block_t *succ[2]);
+
+/// Turns branches on constant conditions into jumps, threads jumps through
+/// empty blocks, and drops blocks that are unreachable from the entry.
+void seadragon_cfg_simplify(seadragon_function_t *func);
+
+/// Orders func->u.blocks to maximize fallthrough on the expected path: the
+/// likely successor of each block is placed right after it, blocks that only
+/// lead to early returns are moved to the end of the function, and loops are
+/// rotated so that the exit test sits at the bottom of a contiguous body. In a
+/// profiled function, the likely successor is the one that ran more often, and
+/// the blocks that never ran are the ones moved to the end.
+void seadragon_cfg_layout(seadragon_function_t *func);
+
+#endif // SEADRAGON_CFG_H_
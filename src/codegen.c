@@ -1,115 +1,115 @@
 #include "codegen.h"
+#include "ir.h"
+#ifndef SEADRAGON_CG_DYNAMIC
+#include "backends/limn2k.h"
+#endif
 
-#include <setjmp.h>
 #include <stdlib.h>
 
-#define ERRORF(msg, ...) do { fprintf(stderr, "%s:%d: error: Codegen: " msg "\n", __FILE__, __LINE__, __VA_ARGS__); longjmp(ctx.env, 1); } while(0);
-#define ERROR(msg) do { fprintf(stderr, "%s:%d: error: Codegen: %s\n", __FILE__, __LINE__, msg); longjmp(ctx.env, 1); } while(0);
+#define ERROR(msg) seadragon_session_error(ctx->walker.session, "%s:%d: error: Codegen: %s", __FILE__, __LINE__, msg)
 
-typedef struct {
-	jmp_buf env;
-	seadragon_backend_t *backend;
+#define SEADRAGON_CG_WALK seadragon_cg_walk
+#define SEADRAGON_CG_HOOK(hook) ctx->backend->hook
+#define SEADRAGON_CG_HAS(hook) (ctx->backend->hook != NULL)
+#include "codegen_walk.h"
+
+struct seadragon_cg_ctx {
+	seadragon_cg_walker_t walker;
+	/// The walker instance for the backend: specialized if there is one
+	bool (*walk)(seadragon_cg_walker_t *walker, seadragon_function_t *func);
 	FILE *out;
-} seadragon_cg_ctx_t;
+};
 
-static void *seadragon_cg_node(seadragon_cg_ctx_t ctx, seadragon_instruction_node_t node);
+#define SEADRAGON_CG_MISSING(hook) || !backend->hook
 
-static void seadragon_cg_leaf_node(seadragon_cg_ctx_t ctx, seadragon_instruction_leaf_t **leaf) {
-	void *reg = seadragon_cg_node(ctx, (*leaf)->u.node);
-	if (reg) {
-		(*leaf)->type = LEAF_CODEGENED;
-		(*leaf)->u.mcval = reg;
+seadragon_cg_ctx_t *seadragon_cg_begin(seadragon_session_t *session, FILE *out, seadragon_backend_t *(*_backend)(seadragon_session_t*, FILE*)) {
+	if (!_backend) {
+		return NULL;
 	}
-	else {
-		*leaf = NULL;
+	seadragon_backend_t *backend = _backend(session, out);
+	if (!backend) {
+		return NULL;
 	}
-}
-
-static void seadragon_cg_leaf(seadragon_cg_ctx_t ctx, seadragon_instruction_leaf_t **leaf) {
-	if (*leaf) {
-		switch ((*leaf)->type) {
-		case LEAF_NODE:
-			seadragon_cg_leaf_node(ctx, leaf);
-			break;
-		case LEAF_VALUE:{
-			seadragon_value_t *val = (*leaf)->u.value;
-			switch (val->type) {
-			case VALUE_TYPE_IDENTIFIER:{
-				void *reg = ctx.backend->register_allocate(ctx.backend, val->u.identifier);
-				if (!reg) {
-					ERROR("Register allocation failed.");
-				}
-				free(val);
-				(*leaf)->type = LEAF_CODEGENED;
-				(*leaf)->u.mcval = reg;
-				break;}
-			case VALUE_TYPE_LITERAL:
-				break;
-			}
-			break;}
-		default:
-			ERROR("TODO: cg leaf !node");
+	seadragon_cg_ctx_t *ctx = malloc(sizeof(seadragon_cg_ctx_t));
+	ctx->walker.session = session;
+	ctx->walker.backend = backend;
+	ctx->walker.labeled = NULL;
+	ctx->walker.mcval = NULL;
+	ctx->walker.use = NULL;
+	ctx->walker.capacity = 0;
+	ctx->walk = seadragon_cg_walk;
+	ctx->out = out;
+#ifndef SEADRAGON_CG_DYNAMIC
+	// Specialized backends provide every hook, and are not checked
+	if (_backend == seadragon_backend_limn2k) {
+		ctx->walk = seadragon_backend_limn2k_walk;
+		return ctx;
+	}
+#endif
+	if (false SEADRAGON_BACKEND_REQUIRED(SEADRAGON_CG_MISSING)) {
+		ERROR("Backend is missing required functionality!");
+		if (backend->deinit) {
+			backend->deinit(backend);
 		}
+		free(ctx);
+		return NULL;
 	}
+	return ctx;
+}
+
+seadragon_backend_t *seadragon_cg_backend(seadragon_cg_ctx_t *ctx) {
+	return ctx->walker.backend;
 }
 
-static void *seadragon_cg_node(seadragon_cg_ctx_t ctx, seadragon_instruction_node_t node) {
-	seadragon_cg_leaf(ctx, &node.left);
-	seadragon_cg_leaf(ctx, &node.right);
-	switch (node.op) {
-		case OPERATION_NONE:
-			ERROR("Internal error: OPERATION_NONE propagated to codegen");
-		case OPERATION_SLONG:
-			// lhs should be a LEAF_CODEGENED, rhs should be LEAF_CODEGENED or LEAF_VALUE
-			if (node.left->type != LEAF_CODEGENED) {
-				ERROR("Expected backend machine code value as slong target!");
-			}
-			switch (node.right->type) {
-			case LEAF_NODE:
-				ERROR("Internal error: leaf node not overwritten");
-			case LEAF_VALUE:
-				ctx.backend->set_long(ctx.backend, node.left->u.mcval, node.right->u.value);
-				break;
-			default:
-				ERROR("TODO cg slong");
-				break;
-			}
-			return NULL;
-		default:
-			ERROR("Unknown operation??");
+bool seadragon_cg_function(seadragon_cg_ctx_t *ctx, seadragon_function_t *func) {
+	return ctx->walk(&ctx->walker, func);
+}
+
+static void seadragon_cg_free(seadragon_cg_ctx_t *ctx) {
+	free(ctx->walker.mcval);
+	free(ctx->walker.use);
+	free(ctx);
+}
+
+bool seadragon_cg_end(seadragon_cg_ctx_t *ctx, list_t *buffers) {
+	bool success = true;
+	if (buffers->length && !ctx->walker.backend->buffer) {
+		ERROR("Backend does not support buffers");
+		success = false;
+	}
+	for (unsigned int i = 0; success && i < buffers->length; i += 1) {
+		ctx->walker.backend->buffer(ctx->walker.backend, buffers->items[i]);
+	}
+	if (success && ctx->walker.backend->end) {
+		ctx->walker.backend->end(ctx->walker.backend);
 	}
+	success = success && !seadragon_session_failed(ctx->walker.session);
+	seadragon_cg_free(ctx);
+	return success;
 }
 
-bool seadragon_cg(seadragon_ast_t *ast, FILE *out, seadragon_backend_t *(*_backend)(jmp_buf*, FILE*)) {
-	seadragon_cg_ctx_t ctx;
-	if (setjmp(ctx.env) == 0) {
-		if (!ast || !out || !_backend) {
-			return false;
-		}
-		if (!ast->constants || !ast->functions || !ast->structures) {
-			return false;
-		}
-		if (ast->constants->length || ast->structures->length) {
-			return false;
-		}
-		seadragon_backend_t *backend = _backend(&ctx.env, out);
-		if (!backend->begin_function || !backend->register_allocate || !backend->set_long || !backend->ret) {
-			ERROR("Backend is missing required functionality!");
-		}
-		ctx.backend = backend;
-		ctx.out = out;
-		for (unsigned int i = 0; i < ast->functions->length; i += 1) {
-			seadragon_function_t *func = ast->functions->items[i];
-			backend->begin_function(backend, func);
-			if (seadragon_cg_node(ctx, func->u.root)) {
-				ERROR("Unexpectedly received value for function's root node");
-			}
-			if (func->u.root.op != OPERATION_RETURN) {
-				backend->ret(backend);
-			}
-		}
-		return true;
-	} else {
+bool seadragon_cg(seadragon_session_t *session, seadragon_ast_t *ast, FILE *out, seadragon_backend_t *(*backend)(seadragon_session_t*, FILE*)) {
+	if (!ast || !ast->constants || !ast->functions || !ast->structures || !ast->buffers) {
+		return false;
+	}
+	seadragon_cg_ctx_t *ctx = seadragon_cg_begin(session, out, backend);
+	if (!ctx) {
 		return false;
 	}
+	// Nothing outside is handed the backend, so it is freed here
+	seadragon_backend_t *_backend = ctx->walker.backend;
+	bool success = true;
+	for (unsigned int i = 0; success && i < ast->functions->length; i += 1) {
+		success = seadragon_cg_function(ctx, ast->functions->items[i]);
+	}
+	if (success) {
+		success = seadragon_cg_end(ctx, ast->buffers);
+	}
+	else {
+		seadragon_cg_free(ctx);
+	}
+	if (_backend->deinit) {
+		_backend->deinit(_backend);
+	}
+	return success;
 }
@@ -4,13 +4,29 @@
 #include "ast.h"
 #include <stdbool.h>
 #include <stdio.h>
-#include <setjmp.h>
 
 #include "backend.h"
+#include "session.h"
 
 /// Takes in an AST - which *must* have already passed through semantic analysis
 /// - and generates machine code to the given FILE for the specified backend.
-bool seadragon_cg(seadragon_ast_t *ast, FILE *out, seadragon_backend_t *(*backend)(jmp_buf *env, FILE *out));
+/// Fails once the session has, including on errors the backend reports. The
+/// backend is freed once done.
+bool seadragon_cg(seadragon_session_t *session, seadragon_ast_t *ast, FILE *out,
+	seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out));
+
+/// The steps of seadragon_cg, for generating code one function at a time:
+/// begin returns NULL if the backend is unusable, and end emits the buffers
+/// and frees the context, whether or not it succeeds. out may be NULL for
+/// backends that generate code in memory.
+typedef struct seadragon_cg_ctx seadragon_cg_ctx_t;
+seadragon_cg_ctx_t *seadragon_cg_begin(seadragon_session_t *session, FILE *out,
+	seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out));
+/// Returns the backend constructed by begin, which outlives the context; the
+/// caller frees it, through its deinit if it has one.
+seadragon_backend_t *seadragon_cg_backend(seadragon_cg_ctx_t *ctx);
+bool seadragon_cg_function(seadragon_cg_ctx_t *ctx, seadragon_function_t *func);
+bool seadragon_cg_end(seadragon_cg_ctx_t *ctx, list_t *buffers);
 
 #endif // SEADRAGON_CODEGEN_H_
 
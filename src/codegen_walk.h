@@ -0,0 +1,494 @@
+/// The codegen walker, which lowers the IR of a function through a backend's
+/// hooks. It is instantiated once calling the hooks through the vtable, in
+/// codegen.c, and once for each backend specialized with its hooks called
+/// directly, so that the compiler may inline them into the walk. Besides
+/// including this header, an instance defines:
+///
+/// - SEADRAGON_CG_WALK, the name of the function generating a function.
+/// - SEADRAGON_CG_HOOK(hook), the backend's function for a member of
+///   seadragon_backend_t; each is called with ctx->backend.
+/// - SEADRAGON_CG_HAS(hook), whether the backend provides an optional member.
+///
+/// Everything else the instance holds is static, so it is instantiated at most
+/// once per translation unit. Without SEADRAGON_CG_WALK, only the declarations
+/// below are included.
+
+#ifndef SEADRAGON_CODEGEN_WALK_H_
+#define SEADRAGON_CODEGEN_WALK_H_
+
+#include "backend.h"
+#include "ir.h"
+#include "session.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// How a node's user consumes its value, which decides what the walk does with
+/// the node when it reaches it.
+typedef enum {
+	/// In a register, materializing literals and buffer addresses
+	SEADRAGON_CG_USE_REGISTER,
+	/// Encoded in the user's instruction
+	SEADRAGON_CG_USE_IMMEDIATE,
+	/// An address folded into the user's memory operand as base + offset
+	SEADRAGON_CG_USE_ADDRESS,
+	/// Generated straight into the register of the variable assigned
+	SEADRAGON_CG_USE_ASSIGNED,
+} seadragon_cg_use_t;
+
+/// What the walker needs of a codegen context; labeled marks the blocks of
+/// the current function that need a label. The walk only reads the function:
+/// it scans the linearized pool in order, recording, per node, how its value
+/// is used in use and the register holding it in mcval. Both have room for
+/// capacity nodes and are reused from one function to the next.
+typedef struct {
+	seadragon_session_t *session;
+	seadragon_backend_t *backend;
+	bool *labeled;
+	void **mcval;
+	uint8_t *use;
+	uint32_t capacity;
+} seadragon_cg_walker_t;
+
+/// The instance calling the hooks through the vtable.
+bool seadragon_cg_walk(seadragon_cg_walker_t *ctx, seadragon_function_t *func);
+
+#endif // SEADRAGON_CODEGEN_WALK_H_
+
+#ifdef SEADRAGON_CG_WALK
+
+#define SEADRAGON_CG_ERROR(msg) seadragon_session_error(ctx->session, "%s:%d: error: Codegen: %s", __FILE__, __LINE__, msg)
+
+/// Whether a node is a value of the given type.
+static bool seadragon_cg_is_value(seadragon_ir_pool_t *pool, uint32_t node, unsigned int type) {
+	return node != SEADRAGON_IR_NONE && pool->op[node] == OPERATION_NONE && pool->value[node].type == type;
+}
+
+/// Records how node's operands are used. Nodes are only used once, so this
+/// may visit them in any order.
+static void seadragon_cg_uses(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool, uint32_t node) {
+	uint32_t left = pool->left[node], right = pool->right[node];
+	switch (pool->op[node]) {
+	case OPERATION_SLONG:
+		if (seadragon_cg_is_value(pool, left, VALUE_TYPE_IDENTIFIER)) {
+			if (right != SEADRAGON_IR_NONE) {
+				ctx->use[right] = pool->op[right] == OPERATION_NONE ? SEADRAGON_CG_USE_IMMEDIATE : SEADRAGON_CG_USE_ASSIGNED;
+			}
+			return;
+		}
+		// fallthrough
+	case OPERATION_SINT:
+	case OPERATION_SBYTE:
+	case OPERATION_GLONG:
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:
+		// Constant addresses have no base, and a literal displacement
+		// becomes the memory operand's offset
+		if (seadragon_cg_is_value(pool, left, VALUE_TYPE_LITERAL)) {
+			ctx->use[left] = SEADRAGON_CG_USE_IMMEDIATE;
+		}
+		else if (pool->op[left] == OPERATION_ADD && seadragon_cg_is_value(pool, pool->right[left], VALUE_TYPE_LITERAL)) {
+			ctx->use[left] = SEADRAGON_CG_USE_ADDRESS;
+			ctx->use[pool->right[left]] = SEADRAGON_CG_USE_IMMEDIATE;
+		}
+		return;
+	case OPERATION_ADD:
+	case OPERATION_SUB:
+	case OPERATION_MUL:
+	case OPERATION_DIV:
+	case OPERATION_AND:
+	case OPERATION_OR:
+	case OPERATION_LSH:
+	case OPERATION_RSH:
+		if (right != SEADRAGON_IR_NONE && pool->op[right] == OPERATION_NONE) {
+			ctx->use[right] = SEADRAGON_CG_USE_IMMEDIATE;
+		}
+		return;
+	case OPERATION_CLT:
+	case OPERATION_CGT:
+	case OPERATION_CLE:
+	case OPERATION_CGE:
+	case OPERATION_EQ:
+	case OPERATION_NE:
+		// Comparisons against zero use the backend's zero register
+		if (seadragon_cg_is_value(pool, right, VALUE_TYPE_LITERAL) && !pool->value[right].u.literal) {
+			ctx->use[right] = SEADRAGON_CG_USE_IMMEDIATE;
+		}
+		return;
+	default:
+		return;
+	}
+}
+
+/// Releases the register holding an operand once it has been consumed.
+static void seadragon_cg_release(seadragon_cg_walker_t *ctx, uint32_t node) {
+	if (node != SEADRAGON_IR_NONE && ctx->mcval[node]) {
+		SEADRAGON_CG_HOOK(register_free)(ctx->backend, ctx->mcval[node]);
+	}
+}
+
+static void *seadragon_cg_result(seadragon_cg_walker_t *ctx, void *dst) {
+	if (dst) {
+		return dst;
+	}
+	void *reg = SEADRAGON_CG_HOOK(register_temporary)(ctx->backend);
+	if (!reg) {
+		SEADRAGON_CG_ERROR("Register allocation failed.");
+	}
+	return reg;
+}
+
+/// The register holding an operand that its user needs in one.
+static void *seadragon_cg_register(seadragon_cg_walker_t *ctx, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE || !ctx->mcval[node]) {
+		SEADRAGON_CG_ERROR("Internal error: operand produced no value");
+		return NULL;
+	}
+	return ctx->mcval[node];
+}
+
+/// Splits an address into base register + constant offset, as recorded by
+/// seadragon_cg_uses. Stores the node holding the base, which the caller must
+/// release, in base_node.
+static bool seadragon_cg_address(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool, uint32_t address, void **base, uint32_t *offset,
+		uint32_t *base_node) {
+	switch (ctx->use[address]) {
+	case SEADRAGON_CG_USE_IMMEDIATE:
+		*offset = pool->value[address].u.literal;
+		*base = NULL;
+		*base_node = SEADRAGON_IR_NONE;
+		return true;
+	case SEADRAGON_CG_USE_ADDRESS:
+		*offset = pool->value[pool->right[address]].u.literal;
+		*base_node = pool->left[address];
+		break;
+	default:
+		*offset = 0;
+		*base_node = address;
+		break;
+	}
+	*base = seadragon_cg_register(ctx, *base_node);
+	return *base != NULL;
+}
+
+/// Generates a node whose operands have been generated, recording the
+/// register holding its value, if any, in mcval. Returns false on failure,
+/// which the session records.
+static bool seadragon_cg_node(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool, uint32_t node, void *dst) {
+	seadragon_operation_t op = pool->op[node];
+	uint32_t left = pool->left[node], right = pool->right[node];
+	ctx->mcval[node] = NULL;
+	switch (op) {
+		case OPERATION_NONE:{
+			seadragon_value_t *val = &pool->value[node];
+			if (val->type == VALUE_TYPE_IDENTIFIER) {
+				ctx->mcval[node] = SEADRAGON_CG_HOOK(register_allocate)(ctx->backend, val->u.identifier);
+			}
+			else if (ctx->use[node] == SEADRAGON_CG_USE_REGISTER) {
+				ctx->mcval[node] = SEADRAGON_CG_HOOK(register_temporary)(ctx->backend);
+				if (ctx->mcval[node]) {
+					SEADRAGON_CG_HOOK(set_long)(ctx->backend, ctx->mcval[node], val);
+				}
+			}
+			else {
+				return true;
+			}
+			if (!ctx->mcval[node]) {
+				SEADRAGON_CG_ERROR("Register allocation failed.");
+				return false;
+			}
+			return true;}
+		case OPERATION_SLONG:
+			if (seadragon_cg_is_value(pool, left, VALUE_TYPE_IDENTIFIER)) {
+				if (right == SEADRAGON_IR_NONE) {
+					SEADRAGON_CG_ERROR("TODO cg slong");
+				}
+				else if (pool->op[right] == OPERATION_NONE) {
+					SEADRAGON_CG_HOOK(set_long)(ctx->backend, ctx->mcval[left], &pool->value[right]);
+				}
+				// Otherwise the value was generated into the variable
+				return true;
+			}
+			// fallthrough
+		case OPERATION_SINT:
+		case OPERATION_SBYTE:{
+			void *val = seadragon_cg_register(ctx, right);
+			void *base;
+			uint32_t offset, base_node;
+			if (!val || !seadragon_cg_address(ctx, pool, left, &base, &offset, &base_node)) {
+				return false;
+			}
+			SEADRAGON_CG_HOOK(memory)(ctx->backend, op, val, base, offset);
+			seadragon_cg_release(ctx, base_node);
+			seadragon_cg_release(ctx, right);
+			return true;}
+		case OPERATION_GLONG:
+			if (seadragon_cg_is_value(pool, left, VALUE_TYPE_IDENTIFIER)) {
+				if (dst) {
+					SEADRAGON_CG_HOOK(move)(ctx->backend, dst, ctx->mcval[left]);
+					ctx->mcval[node] = dst;
+				}
+				else {
+					ctx->mcval[node] = ctx->mcval[left];
+				}
+				return true;
+			}
+			// fallthrough
+		case OPERATION_GINT:
+		case OPERATION_GBYTE:{
+			void *base;
+			uint32_t offset, base_node;
+			if (!seadragon_cg_address(ctx, pool, left, &base, &offset, &base_node)) {
+				return false;
+			}
+			seadragon_cg_release(ctx, base_node);
+			void *reg = seadragon_cg_result(ctx, dst);
+			if (!reg) {
+				return false;
+			}
+			SEADRAGON_CG_HOOK(memory)(ctx->backend, op, reg, base, offset);
+			ctx->mcval[node] = reg;
+			return true;}
+		case OPERATION_ADD:
+		case OPERATION_SUB:
+		case OPERATION_MUL:
+		case OPERATION_DIV:
+		case OPERATION_AND:
+		case OPERATION_OR:
+		case OPERATION_LSH:
+		case OPERATION_RSH:{
+			if (ctx->use[node] == SEADRAGON_CG_USE_ADDRESS) {
+				// Folded into the user's memory operand
+				return true;
+			}
+			void *lhs = seadragon_cg_register(ctx, left);
+			if (!lhs) {
+				return false;
+			}
+			seadragon_cg_release(ctx, left);
+			void *reg;
+			if (ctx->use[right] == SEADRAGON_CG_USE_IMMEDIATE) {
+				reg = seadragon_cg_result(ctx, dst);
+				if (!reg) {
+					return false;
+				}
+				SEADRAGON_CG_HOOK(arith_immediate)(ctx->backend, op, reg, lhs, pool->value[right].u.literal);
+			}
+			else {
+				void *rhs = seadragon_cg_register(ctx, right);
+				if (!rhs) {
+					return false;
+				}
+				seadragon_cg_release(ctx, right);
+				reg = seadragon_cg_result(ctx, dst);
+				if (!reg) {
+					return false;
+				}
+				SEADRAGON_CG_HOOK(arith)(ctx->backend, op, reg, lhs, rhs);
+			}
+			ctx->mcval[node] = reg;
+			return true;}
+		default:
+			SEADRAGON_CG_ERROR("Unknown operation??");
+			return false;
+	}
+}
+
+/// Generates the nodes from *cursor up to root, the last node of a statement
+/// or condition, leaving the cursor after it. Nodes used as an assignment's
+/// value are generated into the variable's register.
+static bool seadragon_cg_range(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool, uint32_t *cursor, uint32_t root) {
+	if (root < *cursor || root >= pool->length) {
+		SEADRAGON_CG_ERROR("Internal error: IR is not linearized");
+		return false;
+	}
+	for (uint32_t k = *cursor; k < root; k += 1) {
+		void *dst = ctx->use[k] == SEADRAGON_CG_USE_ASSIGNED ? ctx->mcval[pool->left[root]] : NULL;
+		if (!seadragon_cg_node(ctx, pool, k, dst)) {
+			return false;
+		}
+	}
+	*cursor = root + 1;
+	return true;
+}
+
+static seadragon_operation_t seadragon_cg_invert(seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_CLT: return OPERATION_CGE;
+	case OPERATION_CGE: return OPERATION_CLT;
+	case OPERATION_CGT: return OPERATION_CLE;
+	case OPERATION_CLE: return OPERATION_CGT;
+	case OPERATION_EQ: return OPERATION_NE;
+	default: return OPERATION_EQ;
+	}
+}
+
+/// Emits a block's conditional branch, using a single branch when either
+/// successor is the next block in the layout. The condition's operands, or
+/// the condition itself if it isn't a comparison, have been generated.
+static bool seadragon_cg_branch(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool, seadragon_block_t *block, seadragon_block_t *next) {
+	uint32_t condition = block->condition;
+	seadragon_operation_t op = OPERATION_NE;
+	void *lhs, *rhs = NULL;
+	uint32_t released[2] = { condition, SEADRAGON_IR_NONE };
+	if (seadragon_ir_is_comparison(pool, condition)) {
+		uint32_t right = pool->right[condition];
+		op = pool->op[condition];
+		released[0] = pool->left[condition];
+		lhs = seadragon_cg_register(ctx, released[0]);
+		if (lhs && ctx->use[right] != SEADRAGON_CG_USE_IMMEDIATE) {
+			rhs = seadragon_cg_register(ctx, right);
+			released[1] = right;
+			if (!rhs) {
+				return false;
+			}
+		}
+	}
+	else {
+		lhs = seadragon_cg_register(ctx, condition);
+	}
+	if (!lhs) {
+		return false;
+	}
+	if (block->fallback == next) {
+		SEADRAGON_CG_HOOK(branch)(ctx->backend, op, lhs, rhs, block->target->id);
+	}
+	else if (block->target == next) {
+		SEADRAGON_CG_HOOK(branch)(ctx->backend, seadragon_cg_invert(op), lhs, rhs, block->fallback->id);
+	}
+	else {
+		SEADRAGON_CG_HOOK(branch)(ctx->backend, op, lhs, rhs, block->target->id);
+		SEADRAGON_CG_HOOK(jump)(ctx->backend, block->fallback->id);
+	}
+	seadragon_cg_release(ctx, released[0]);
+	seadragon_cg_release(ctx, released[1]);
+	return true;
+}
+
+/// Jumps to an empty returning block are emitted as the return itself.
+static bool seadragon_cg_is_return(seadragon_block_t *block) {
+	return block->terminator == TERMINATOR_RETURN && !block->statement_count;
+}
+
+/// Marks the blocks that are reached by an explicit branch, and so need a label.
+static bool *seadragon_cg_labels(list_t *blocks) {
+	unsigned int max = 0;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (block->id > max) {
+			max = block->id;
+		}
+	}
+	bool *labeled = calloc(max + 1, sizeof(bool));
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		seadragon_block_t *next = i + 1 < blocks->length ? blocks->items[i + 1] : NULL;
+		switch (block->terminator) {
+		case TERMINATOR_JUMP:
+			labeled[block->target->id] |= block->target != next && !seadragon_cg_is_return(block->target);
+			break;
+		case TERMINATOR_BRANCH:
+			labeled[block->target->id] |= block->target != next;
+			labeled[block->fallback->id] |= block->fallback != next;
+			break;
+		case TERMINATOR_RETURN:
+			break;
+		}
+	}
+	return labeled;
+}
+
+/// Generates the statements and terminators of a function's blocks, scanning
+/// the pool once in order.
+static bool seadragon_cg_blocks(seadragon_cg_walker_t *ctx, seadragon_function_t *func) {
+	seadragon_ir_pool_t *pool = &func->pool;
+	uint32_t cursor = 0;
+	for (unsigned int j = 0; j < func->u.blocks->length; j += 1) {
+		seadragon_block_t *block = func->u.blocks->items[j];
+		seadragon_block_t *next = j + 1 < func->u.blocks->length ? func->u.blocks->items[j + 1] : NULL;
+		if (ctx->labeled[block->id]) {
+			SEADRAGON_CG_HOOK(label)(ctx->backend, block->id);
+		}
+		for (uint32_t k = 0; k < block->statement_count; k += 1) {
+			uint32_t root = block->statements[k];
+			if (!seadragon_cg_range(ctx, pool, &cursor, root) || !seadragon_cg_node(ctx, pool, root, NULL)) {
+				return false;
+			}
+			if (ctx->mcval[root]) {
+				SEADRAGON_CG_ERROR("Unexpectedly received value for statement");
+				return false;
+			}
+			// Backends report their own errors through the session
+			if (seadragon_session_failed(ctx->session)) {
+				return false;
+			}
+		}
+		switch (block->terminator) {
+		case TERMINATOR_RETURN:
+			SEADRAGON_CG_HOOK(ret)(ctx->backend);
+			break;
+		case TERMINATOR_JUMP:
+			if (seadragon_cg_is_return(block->target) && block->target != next) {
+				SEADRAGON_CG_HOOK(ret)(ctx->backend);
+			}
+			else if (block->target != next) {
+				SEADRAGON_CG_HOOK(jump)(ctx->backend, block->target->id);
+			}
+			break;
+		case TERMINATOR_BRANCH:
+			if (!seadragon_cg_range(ctx, pool, &cursor, block->condition)) {
+				return false;
+			}
+			// A comparison is left for the branch to encode
+			if (!seadragon_ir_is_comparison(pool, block->condition) && !seadragon_cg_node(ctx, pool, block->condition, NULL)) {
+				return false;
+			}
+			if (!seadragon_cg_branch(ctx, pool, block, next)) {
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+/// Sizes the side tables for the function's pool and records the use of
+/// every node.
+static void seadragon_cg_prepare(seadragon_cg_walker_t *ctx, seadragon_ir_pool_t *pool) {
+	if (pool->length > ctx->capacity) {
+		ctx->capacity = pool->length;
+		free(ctx->mcval);
+		free(ctx->use);
+		ctx->mcval = malloc(ctx->capacity * sizeof(*ctx->mcval));
+		ctx->use = malloc(ctx->capacity * sizeof(*ctx->use));
+	}
+	if (!pool->length) {
+		return;
+	}
+	memset(ctx->use, SEADRAGON_CG_USE_REGISTER, pool->length * sizeof(*ctx->use));
+	for (uint32_t i = 0; i < pool->length; i += 1) {
+		seadragon_cg_uses(ctx, pool, i);
+	}
+}
+
+bool SEADRAGON_CG_WALK(seadragon_cg_walker_t *ctx, seadragon_function_t *func) {
+	SEADRAGON_CG_HOOK(begin_function)(ctx->backend, func);
+	if (seadragon_session_failed(ctx->session)) {
+		return false;
+	}
+	seadragon_cg_prepare(ctx, &func->pool);
+	ctx->labeled = seadragon_cg_labels(func->u.blocks);
+	bool success = seadragon_cg_blocks(ctx, func);
+	free(ctx->labeled);
+	ctx->labeled = NULL;
+	if (success && SEADRAGON_CG_HAS(end_function)) {
+		SEADRAGON_CG_HOOK(end_function)(ctx->backend);
+	}
+	// Backends report their own errors through the session
+	return success && !seadragon_session_failed(ctx->session);
+}
+
+#undef SEADRAGON_CG_ERROR
+
+#endif // SEADRAGON_CG_WALK
@@ -0,0 +1,283 @@
+#include "document.h"
+#include "parser.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	char *text;
+	size_t length;
+	/// Newlines in text, and the bytes after the last of them
+	uint32_t lines, tail;
+	/// The keyword the declaration starts with; SEADRAGON_TK_EOF if the text
+	/// holds none, and SEADRAGON_TK_ERROR if it failed to parse.
+	seadragon_token_kind_t kind;
+	void *declaration;
+} seadragon_document_segment_t;
+
+struct seadragon_document {
+	char *name;
+	seadragon_document_segment_t *segments;
+	size_t count, capacity;
+	size_t length;
+	/// Segments that failed to parse
+	size_t broken;
+	/// The declarations of every segment, rebuilt when stale
+	seadragon_ast_t ast;
+	bool stale;
+};
+
+seadragon_document_t *seadragon_document_create(const char *name) {
+	seadragon_document_t *document = calloc(1, sizeof(seadragon_document_t));
+	if (!document) {
+		return NULL;
+	}
+	document->name = strdup(name);
+	seadragon_parse_init(&document->ast);
+	return document;
+}
+
+static void seadragon_document_segment_free(seadragon_document_segment_t *segment) {
+	seadragon_parse_free_declaration(segment->kind, segment->declaration);
+	free(segment->text);
+}
+
+void seadragon_document_free(seadragon_document_t *document) {
+	for (size_t i = 0; i < document->count; i += 1) {
+		seadragon_document_segment_free(&document->segments[i]);
+	}
+	free(document->segments);
+	// The lists only borrow the segments' declarations
+	list_free(document->ast.functions);
+	list_free(document->ast.constants);
+	list_free(document->ast.buffers);
+	list_free(document->ast.structures);
+	list_free(document->ast.modules);
+	free(document->name);
+	free(document);
+}
+
+static list_t *seadragon_document_list(seadragon_ast_t *ast, seadragon_token_kind_t kind) {
+	switch (kind) {
+	case SEADRAGON_TK_FN:
+		return ast->functions;
+	case SEADRAGON_TK_CONST:
+		return ast->constants;
+	case SEADRAGON_TK_BUFFER:
+		return ast->buffers;
+	case SEADRAGON_TK_STRUCT:
+		return ast->structures;
+	default:
+		return NULL;
+	}
+}
+
+/// Copies a piece of text into a segment.
+static void seadragon_document_segment_init(seadragon_document_segment_t *segment, const char *text, size_t length) {
+	segment->text = malloc(length ? length : 1);
+	memcpy(segment->text, text, length);
+	segment->length = length;
+	segment->lines = 0;
+	segment->tail = 0;
+	for (size_t i = 0; i < length; i += 1) {
+		if (text[i] == '\n') {
+			segment->lines += 1;
+			segment->tail = 0;
+		}
+		else {
+			segment->tail += 1;
+		}
+	}
+}
+
+/// Moves pos past the text of a segment, as the lexer would.
+static void seadragon_document_advance(seadragon_source_pos_t *pos, const seadragon_document_segment_t *segment) {
+	pos->line += segment->lines;
+	pos->col = segment->lines ? segment->tail : pos->col + segment->tail;
+}
+
+/// Lexes and parses a stretch of text starting at pos, cutting it into a
+/// segment per declaration. On failure, nothing is stored, and *cut is set if
+/// the text ended before the last declaration did.
+static bool seadragon_document_parse(seadragon_session_t *session, const char *name, const char *text, size_t length,
+		seadragon_source_pos_t pos, seadragon_document_segment_t **segments, size_t *count, bool *cut) {
+	*segments = NULL;
+	*count = 0;
+	*cut = false;
+	seadragon_lexer_t lexer;
+	if (!seadragon_lexer_init(&lexer, name, text, length)) {
+		seadragon_session_error(session, "%s: error: Document: Out of memory", name);
+		return false;
+	}
+	lexer.pos = pos;
+	list_t *tokens = list_create();
+	seadragon_ast_t ast;
+	seadragon_parse_init(&ast);
+	bool success = seadragon_parse_lex(session, &lexer, tokens);
+	size_t capacity = 0;
+	unsigned int index = 0;
+	while (success && index + 1 < tokens->length) {
+		seadragon_token_t *token = tokens->items[index];
+		size_t start = token->ptr - lexer.src;
+		success = seadragon_parse_declaration(session, &ast, tokens, &index);
+		if (!success) {
+			*cut = ((seadragon_token_t*)tokens->items[index])->kind == SEADRAGON_TK_EOF;
+			break;
+		}
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 4;
+			*segments = realloc(*segments, capacity * sizeof(seadragon_document_segment_t));
+		}
+		// length holds where the declaration starts until the text is cut
+		(*segments)[*count] = (seadragon_document_segment_t){ .length = start, .kind = token->kind,
+			.declaration = list_pop(seadragon_document_list(&ast, token->kind)) };
+		*count += 1;
+	}
+
+	if (success && !*count && length) {
+		*segments = malloc(sizeof(seadragon_document_segment_t));
+		(*segments)[0] = (seadragon_document_segment_t){ .kind = SEADRAGON_TK_EOF };
+		*count = 1;
+	}
+	for (size_t i = 0; success && i < *count; i += 1) {
+		// The first segment takes in whatever precedes its declaration, and each
+		// the whitespace after its own
+		size_t start = i ? (*segments)[i].length : 0;
+		size_t end = i + 1 < *count ? (*segments)[i + 1].length : length;
+		seadragon_document_segment_init(&(*segments)[i], text + start, end - start);
+	}
+	if (!success) {
+		for (size_t i = 0; i < *count; i += 1) {
+			seadragon_parse_free_declaration((*segments)[i].kind, (*segments)[i].declaration);
+		}
+		free(*segments);
+		*segments = NULL;
+		*count = 0;
+	}
+
+	for (unsigned int i = 0; i < tokens->length; i += 1) {
+		free(tokens->items[i]);
+	}
+	list_free(tokens);
+	seadragon_parse_free(&ast);
+	seadragon_lexer_deinit(&lexer);
+	return success;
+}
+
+bool seadragon_document_edit(seadragon_session_t *session, seadragon_document_t *document, size_t offset, size_t length,
+		const char *text, size_t text_length) {
+	if (offset > document->length || length > document->length - offset) {
+		seadragon_session_error(session, "%s: error: Document: Edit of %zu bytes at %zu is outside the document", document->name,
+			length, offset);
+		return false;
+	}
+	// The segments holding the bytes on either side of the edit, whose tokens
+	// may be joined to or split by it. Every other segment still starts and
+	// ends on the same token boundaries.
+	size_t before = offset ? offset - 1 : 0, after = offset + length;
+	size_t first = 0, start = 0;
+	seadragon_source_pos_t pos = { 0, 0 };
+	while (first < document->count && start + document->segments[first].length <= before) {
+		seadragon_document_advance(&pos, &document->segments[first]);
+		start += document->segments[first].length;
+		first += 1;
+	}
+	size_t last = first, end = start;
+	while (last < document->count && end <= after) {
+		end += document->segments[last].length;
+		last += 1;
+	}
+
+	size_t region_length = end - start - length + text_length;
+	char *region = malloc(end - start + text_length + 1);
+	size_t at = 0;
+	for (size_t i = first; i < last; i += 1) {
+		memcpy(region + at, document->segments[i].text, document->segments[i].length);
+		at += document->segments[i].length;
+	}
+	memmove(region + offset - start + text_length, region + after - start, end - after);
+	memcpy(region + offset - start, text, text_length);
+
+	seadragon_session_t quiet;
+	seadragon_session_init(&quiet, NULL);
+	seadragon_document_segment_t *segments;
+	size_t count;
+	bool success, cut;
+	while (true) {
+		// Failures that later segments may yet fix are not worth reporting
+		bool final = last == document->count;
+		success = seadragon_document_parse(final ? session : &quiet, document->name, region, region_length, pos, &segments, &count, &cut);
+		if (success || final || !cut) {
+			if (!success && !final) {
+				seadragon_document_parse(session, document->name, region, region_length, pos, &segments, &count, &cut);
+			}
+			break;
+		}
+		// The last declaration runs on into the next segment
+		seadragon_document_segment_t *next = &document->segments[last];
+		region = realloc(region, region_length + next->length);
+		memcpy(region + region_length, next->text, next->length);
+		region_length += next->length;
+		last += 1;
+	}
+	seadragon_session_deinit(&quiet);
+	if (!success) {
+		segments = malloc(sizeof(seadragon_document_segment_t));
+		seadragon_document_segment_init(&segments[0], region, region_length);
+		segments[0].kind = SEADRAGON_TK_ERROR;
+		segments[0].declaration = NULL;
+		count = 1;
+	}
+	free(region);
+
+	for (size_t i = first; i < last; i += 1) {
+		document->broken -= document->segments[i].kind == SEADRAGON_TK_ERROR;
+		seadragon_document_segment_free(&document->segments[i]);
+	}
+	size_t total = document->count - (last - first) + count;
+	if (total > document->capacity) {
+		document->capacity = total > document->capacity * 2 ? total : document->capacity * 2;
+		document->segments = realloc(document->segments, document->capacity * sizeof(seadragon_document_segment_t));
+	}
+	memmove(&document->segments[first + count], &document->segments[last],
+		(document->count - last) * sizeof(seadragon_document_segment_t));
+	memcpy(&document->segments[first], segments, count * sizeof(seadragon_document_segment_t));
+	free(segments);
+	document->count = total;
+	document->broken += !success;
+	document->length = document->length - length + text_length;
+	document->stale = true;
+	return !document->broken;
+}
+
+size_t seadragon_document_length(seadragon_document_t *document) {
+	return document->length;
+}
+
+void seadragon_document_text(seadragon_document_t *document, char *out) {
+	for (size_t i = 0; i < document->count; i += 1) {
+		memcpy(out, document->segments[i].text, document->segments[i].length);
+		out += document->segments[i].length;
+	}
+}
+
+seadragon_ast_t *seadragon_document_ast(seadragon_document_t *document) {
+	if (document->broken) {
+		return NULL;
+	}
+	if (document->stale) {
+		document->ast.functions->length = 0;
+		document->ast.constants->length = 0;
+		document->ast.buffers->length = 0;
+		document->ast.structures->length = 0;
+		for (size_t i = 0; i < document->count; i += 1) {
+			list_t *list = seadragon_document_list(&document->ast, document->segments[i].kind);
+			if (list) {
+				list_add(list, document->segments[i].declaration);
+			}
+		}
+		document->stale = false;
+	}
+	return &document->ast;
+}
@@ -0,0 +1,46 @@
+#ifndef SEADRAGON_DOCUMENT_H_
+#define SEADRAGON_DOCUMENT_H_
+
+#include "ast.h"
+#include "session.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// A source kept parsed while it is edited, for editor integrations.
+///
+/// The text is held in segments, one per top-level declaration along with the
+/// whitespace that follows it, each with the declaration parsed from it. There
+/// are no comments or strings, so lexing may restart at the first token of any
+/// declaration: an edit re-lexes and re-parses only the segments holding the
+/// bytes on either side of it, so that tokens joined or split across the edit
+/// are seen, and keeps every other declaration as it is. If the last of those
+/// declarations no longer ends where it did, the following segments are taken
+/// in until it does.
+///
+/// A document that fails to parse keeps its text so that later edits may fix
+/// it: the stretch that failed is held as a single segment without
+/// declarations, and is parsed again by any edit touching it.
+typedef struct seadragon_document seadragon_document_t;
+
+/// Creates an empty document; name is used in diagnostics.
+seadragon_document_t *seadragon_document_create(const char *name);
+void seadragon_document_free(seadragon_document_t *document);
+
+/// Replaces length bytes at offset with text, reporting errors to session.
+/// Loading a document is an edit inserting its whole text. Returns whether
+/// the document parses afterwards; a range outside the document is an error
+/// that leaves it unchanged.
+bool seadragon_document_edit(seadragon_session_t *session, seadragon_document_t *document, size_t offset, size_t length,
+	const char *text, size_t text_length);
+
+size_t seadragon_document_length(seadragon_document_t *document);
+/// Copies the text, which is seadragon_document_length bytes long, into out.
+void seadragon_document_text(seadragon_document_t *document, char *out);
+
+/// The declarations of the document in source order, or NULL if it does not
+/// parse. They belong to the document and last until the next edit; sema
+/// rewrites what it checks in place, so check a copy parsed from the text.
+seadragon_ast_t *seadragon_document_ast(seadragon_document_t *document);
+
+#endif // SEADRAGON_DOCUMENT_H_
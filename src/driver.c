@@ -0,0 +1,325 @@
+#include "driver.h"
+#include "codegen.h"
+#include "ir.h"
+#include "map.h"
+#include "parser.h"
+#include "pool.h"
+#include "sema.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	seadragon_source_t *source;
+	/// Owned copy of the source, if it had to be read from disk
+	char *contents;
+	const char *text;
+	size_t length;
+	seadragon_lexer_split_t *splits;
+	size_t split_count;
+	/// Index of the file's first chunk
+	unsigned int chunks;
+	bool read;
+} seadragon_driver_file_t;
+
+/// A piece of a file, starting at a top-level `fn` (or the start of the file)
+/// and running to the next piece.
+typedef struct {
+	seadragon_driver_file_t *file;
+	size_t offset, length;
+	seadragon_source_pos_t pos;
+	seadragon_ast_t ast;
+	bool parsed;
+} seadragon_driver_unit_t;
+
+typedef struct {
+	seadragon_session_t *session;
+	seadragon_driver_file_t *files;
+} seadragon_driver_scan_t;
+
+typedef struct {
+	seadragon_session_t *session;
+	seadragon_driver_unit_t *units;
+} seadragon_driver_parse_t;
+
+static char *seadragon_driver_read(const char *path, size_t *length) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return NULL;
+	}
+	char *text = NULL;
+	long size;
+	if (!fseek(file, 0, SEEK_END) && (size = ftell(file)) >= 0 && !fseek(file, 0, SEEK_SET)) {
+		text = malloc(size + 1);
+		if (fread(text, 1, size, file) != (size_t)size) {
+			free(text);
+			text = NULL;
+		}
+		*length = size;
+	}
+	fclose(file);
+	return text;
+}
+
+static void seadragon_driver_scan_file(void *context, unsigned int index) {
+	seadragon_driver_scan_t *scan = context;
+	seadragon_driver_file_t *file = &scan->files[index];
+	seadragon_source_t *source = file->source;
+	file->text = source->text;
+	file->length = source->length;
+	if (!file->text) {
+		file->text = file->contents = seadragon_driver_read(source->name, &file->length);
+		if (!file->text) {
+			seadragon_session_error(scan->session, "%s: error: Driver: Unable to read file", source->name);
+			return;
+		}
+	}
+	file->read = true;
+	size_t chunk_size = scan->session->chunk_size;
+	if (chunk_size && file->length > chunk_size) {
+		size_t max = file->length / chunk_size;
+		file->splits = malloc(max * sizeof(seadragon_lexer_split_t));
+		file->split_count = seadragon_lexer_split(file->text, file->length, chunk_size, file->splits, max);
+	}
+}
+
+static void seadragon_driver_parse_unit(void *context, unsigned int index) {
+	seadragon_driver_parse_t *parse = context;
+	seadragon_driver_unit_t *unit = &parse->units[index];
+	seadragon_lexer_t lexer;
+	if (seadragon_lexer_init(&lexer, unit->file->source->name, unit->file->text + unit->offset, unit->length)) {
+		// Positions continue from where the previous chunk left off
+		lexer.pos = unit->pos;
+		unit->parsed = seadragon_parse(parse->session, &unit->ast, &lexer) != NULL;
+		seadragon_lexer_deinit(&lexer);
+	}
+}
+
+/// Appends the items of source to destination, and frees source.
+static void seadragon_driver_append(list_t *destination, list_t *source) {
+	list_cat(destination, source);
+	list_free(source);
+}
+
+/// Moves the items of source to the end of destination, checking that the
+/// names (the first member of each item) are unique.
+static bool seadragon_driver_merge(seadragon_session_t *session, list_t *destination, list_t *source, map_t *names, const char *kind,
+		const char *file) {
+	bool success = true;
+	for (unsigned int i = 0; i < source->length; i += 1) {
+		char *name = *(char**)source->items[i];
+		const char *previous = map_get(names, name);
+		if (previous) {
+			seadragon_session_error(session, "%s: error: Driver: %s `%s` is also declared in %s", file, kind, name, previous);
+			success = false;
+		}
+		map_set(names, name, (void*)file);
+		list_add(destination, source->items[i]);
+	}
+	list_free(source);
+	return success;
+}
+
+bool seadragon_driver_parse(seadragon_session_t *session, seadragon_ast_t *program, seadragon_source_t *sources, unsigned int count) {
+	seadragon_driver_file_t *files = calloc(count + 1, sizeof(seadragon_driver_file_t));
+	for (unsigned int i = 0; i < count; i += 1) {
+		files[i].source = &sources[i];
+	}
+	seadragon_pool_t *pool = seadragon_pool_create(session->threads);
+	seadragon_driver_scan_t scan = { session, files };
+	seadragon_pool_run(pool, count, seadragon_driver_scan_file, &scan);
+
+	unsigned int unit_count = 0;
+	for (unsigned int i = 0; i < count; i += 1) {
+		files[i].chunks = unit_count;
+		unit_count += files[i].read ? files[i].split_count + 1 : 0;
+	}
+	seadragon_driver_unit_t *units = calloc(unit_count + 1, sizeof(seadragon_driver_unit_t));
+	for (unsigned int i = 0; i < count; i += 1) {
+		seadragon_driver_file_t *file = &files[i];
+		if (!file->read) {
+			continue;
+		}
+		for (size_t j = 0; j <= file->split_count; j += 1) {
+			seadragon_driver_unit_t *unit = &units[file->chunks + j];
+			unit->file = file;
+			if (j > 0) {
+				unit->offset = file->splits[j - 1].offset;
+				unit->pos = file->splits[j - 1].pos;
+			}
+			unit->length = (j < file->split_count ? file->splits[j].offset : file->length) - unit->offset;
+		}
+	}
+	seadragon_driver_parse_t parse = { session, units };
+	seadragon_pool_run(pool, unit_count, seadragon_driver_parse_unit, &parse);
+	seadragon_pool_destroy(pool);
+
+	program->structures = list_create();
+	program->functions = list_create();
+	program->constants = list_create();
+	program->buffers = list_create();
+	program->modules = list_create();
+	program->profile = NULL;
+	// Functions, and constants and buffers (which share the value namespace)
+	map_t *functions = map_create(), *values = map_create(), *structures = map_create();
+	bool success = true;
+	for (unsigned int i = 0; i < count; i += 1) {
+		seadragon_driver_file_t *file = &files[i];
+		bool parsed = file->read;
+		for (size_t j = 0; parsed && j <= file->split_count; j += 1) {
+			parsed = units[file->chunks + j].parsed;
+		}
+		if (!parsed) {
+			success = false;
+			continue;
+		}
+		// A file's chunks are stitched back together first, so that they are
+		// checked exactly as the file would be if parsed whole
+		seadragon_ast_t *ast = &units[file->chunks].ast;
+		for (size_t j = 1; j <= file->split_count; j += 1) {
+			seadragon_ast_t *chunk = &units[file->chunks + j].ast;
+			seadragon_driver_append(ast->functions, chunk->functions);
+			seadragon_driver_append(ast->constants, chunk->constants);
+			seadragon_driver_append(ast->buffers, chunk->buffers);
+			seadragon_driver_append(ast->structures, chunk->structures);
+			seadragon_driver_append(ast->modules, chunk->modules);
+		}
+		const char *name = file->source->name;
+		success &= seadragon_driver_merge(session, program->functions, ast->functions, functions, "Function", name);
+		success &= seadragon_driver_merge(session, program->constants, ast->constants, values, "Constant", name);
+		success &= seadragon_driver_merge(session, program->buffers, ast->buffers, values, "Buffer", name);
+		success &= seadragon_driver_merge(session, program->structures, ast->structures, structures, "Structure", name);
+		list_free(ast->modules);
+	}
+	map_free(functions);
+	map_free(values);
+	map_free(structures);
+	for (unsigned int i = 0; i < count; i += 1) {
+		free(files[i].contents);
+		free(files[i].splits);
+	}
+	free(files);
+	free(units);
+	return success;
+}
+
+bool seadragon_driver_compile(seadragon_session_t *session, seadragon_source_t *sources, unsigned int count, FILE *out,
+		seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out)) {
+	seadragon_ast_t program;
+	return seadragon_driver_parse(session, &program, sources, count) && seadragon_sema(session, &program)
+		&& seadragon_cg(session, &program, out, backend);
+}
+
+/// Streaming state: the text read but not yet compiled, which starts at pos.
+typedef struct {
+	FILE *in;
+	char *text;
+	size_t length, capacity;
+	seadragon_source_pos_t pos;
+} seadragon_driver_stream_t;
+
+/// Lexes, parses, checks and generates code for one piece of a source, then
+/// frees its functions. Its declarations are kept in program.
+static bool seadragon_driver_stream_chunk(seadragon_driver_stream_t *stream, size_t length, const char *name, seadragon_ast_t *program,
+		seadragon_sema_ctx_t *sema, seadragon_cg_ctx_t *cg) {
+	seadragon_lexer_t lexer;
+	seadragon_ast_t chunk;
+	if (!seadragon_lexer_init(&lexer, name, stream->text, length)) {
+		return false;
+	}
+	lexer.pos = stream->pos;
+	bool success = seadragon_parse(sema->session, &chunk, &lexer) != NULL;
+	seadragon_lexer_deinit(&lexer);
+	if (!success) {
+		return false;
+	}
+	seadragon_driver_append(program->structures, chunk.structures);
+	seadragon_driver_append(program->constants, chunk.constants);
+	seadragon_driver_append(program->buffers, chunk.buffers);
+	seadragon_driver_append(program->modules, chunk.modules);
+	success = seadragon_sema_declarations(sema);
+	for (unsigned int i = 0; success && i < chunk.functions->length; i += 1) {
+		seadragon_function_t *func = chunk.functions->items[i];
+		success = seadragon_sema_function(sema, func) && seadragon_cg_function(cg, func);
+		if (success) {
+			seadragon_ir_free_function(func);
+		}
+	}
+	list_free(chunk.functions);
+	return success;
+}
+
+/// Reads more of the source, doubling what is buffered so that rescanning the
+/// buffer for a split point stays linear overall. Returns false at the end.
+static bool seadragon_driver_stream_read(seadragon_driver_stream_t *stream) {
+	if (stream->length == stream->capacity) {
+		stream->capacity = stream->capacity ? stream->capacity * 2 : SEADRAGON_DRIVER_STREAM_READ;
+		stream->text = realloc(stream->text, stream->capacity);
+	}
+	size_t read = fread(stream->text + stream->length, 1, stream->capacity - stream->length, stream->in);
+	stream->length += read;
+	return read > 0;
+}
+
+static bool seadragon_driver_stream_source(seadragon_source_t *source, seadragon_ast_t *program, seadragon_sema_ctx_t *sema,
+		seadragon_cg_ctx_t *cg) {
+	seadragon_driver_stream_t stream = { 0 };
+	stream.in = source->text ? fmemopen((void*)source->text, source->length, "r") : fopen(source->name, "rb");
+	if (!stream.in) {
+		seadragon_session_error(sema->session, "%s: error: Driver: Unable to read file", source->name);
+		return false;
+	}
+	bool success = true, more = true;
+	while (success && (more || stream.length)) {
+		seadragon_lexer_split_t split;
+		// The next function may start right at the beginning of the buffer
+		if (seadragon_lexer_split(stream.text, stream.length, 1, &split, 1)) {
+			success = seadragon_driver_stream_chunk(&stream, split.offset, source->name, program, sema, cg);
+			// Positions of the split are relative to the buffer
+			if (split.pos.line == 0) {
+				split.pos.col += stream.pos.col;
+			}
+			split.pos.line += stream.pos.line;
+			stream.pos = split.pos;
+			stream.length -= split.offset;
+			memmove(stream.text, stream.text + split.offset, stream.length);
+		}
+		else if (more) {
+			more = seadragon_driver_stream_read(&stream);
+		}
+		else {
+			success = seadragon_driver_stream_chunk(&stream, stream.length, source->name, program, sema, cg);
+			stream.length = 0;
+		}
+	}
+	fclose(stream.in);
+	free(stream.text);
+	return success;
+}
+
+bool seadragon_driver_stream(seadragon_session_t *session, seadragon_source_t *sources, unsigned int count, FILE *out,
+		seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out)) {
+	seadragon_ast_t program;
+	program.structures = list_create();
+	program.functions = list_create();
+	program.constants = list_create();
+	program.buffers = list_create();
+	program.modules = list_create();
+	program.profile = NULL;
+	seadragon_sema_ctx_t sema;
+	seadragon_sema_init(&sema, session, &program);
+	seadragon_cg_ctx_t *cg = seadragon_cg_begin(session, out, backend);
+	bool success = cg != NULL;
+	for (unsigned int i = 0; success && i < count; i += 1) {
+		success = seadragon_driver_stream_source(&sources[i], &program, &sema, cg);
+	}
+	if (cg) {
+		seadragon_backend_t *_backend = seadragon_cg_backend(cg);
+		success = seadragon_cg_end(cg, program.buffers) && success;
+		if (_backend->deinit) {
+			_backend->deinit(_backend);
+		}
+	}
+	seadragon_sema_deinit(&sema);
+	return success;
+}
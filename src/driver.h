@@ -0,0 +1,55 @@
+#ifndef SEADRAGON_DRIVER_H_
+#define SEADRAGON_DRIVER_H_
+
+#include "ast.h"
+#include "backend.h"
+#include "session.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/// One source file of a program.
+typedef struct {
+	/// Used in diagnostics, and read from if text is NULL
+	const char *name;
+	const char *text;
+	size_t length;
+} seadragon_source_t;
+
+/// Files longer than this are cut at top-level `fn`s into chunks of about
+/// this size, which are parsed in parallel like separate files. This is the
+/// default of a session's chunk_size.
+#ifndef SEADRAGON_DRIVER_CHUNK_SIZE
+#define SEADRAGON_DRIVER_CHUNK_SIZE (1 << 20)
+#endif
+
+/// Lexes and parses every source into its own AST, concurrently on the
+/// session's threads, then merges their declarations into program in source
+/// order. Fails if any source fails to parse, or if two sources declare the
+/// same name. The result does not depend on the session's chunk size: the
+/// chunks of a file are stitched back into one AST in source order, with the
+/// same token positions, before merging.
+bool seadragon_driver_parse(seadragon_session_t *session, seadragon_ast_t *program, seadragon_source_t *sources, unsigned int count);
+
+/// Parses the sources as above, then checks and generates code for the whole
+/// program.
+bool seadragon_driver_compile(seadragon_session_t *session, seadragon_source_t *sources, unsigned int count, FILE *out,
+	seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out));
+
+/// Bytes first read by seadragon_driver_stream; the buffer doubles whenever it
+/// holds no complete function.
+#ifndef SEADRAGON_DRIVER_STREAM_READ
+#define SEADRAGON_DRIVER_STREAM_READ (64 << 10)
+#endif
+
+/// Compiles the sources in order, one function at a time: each is lexed,
+/// parsed, checked, generated and written to out, then freed before the next
+/// is read, so memory use is bounded by the largest function rather than the
+/// input. Only declarations (and the buffers, emitted at the end) are kept,
+/// and a function can only reference what is declared before the next one. See
+/// seadragon_sema_ctx_t for how the result may differ from
+/// seadragon_driver_compile.
+bool seadragon_driver_stream(seadragon_session_t *session, seadragon_source_t *sources, unsigned int count, FILE *out,
+	seadragon_backend_t *(*backend)(seadragon_session_t *session, FILE *out));
+
+#endif // SEADRAGON_DRIVER_H_
@@ -0,0 +1,646 @@
+#include "interp.h"
+#include "ir.h"
+#include "map.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ERROR(msg) do { fprintf(stderr, "%s:%d: error: Interp: %s\n", __FILE__, __LINE__, msg); longjmp(ctx->env, 1); } while(0);
+
+#if defined(__GNUC__)
+/// Dispatch through label addresses stored in each instruction, rather than a
+/// switch, so that every handler ends in its own indirect branch.
+#define SEADRAGON_INTERP_THREADED
+#endif
+
+typedef enum {
+	INTERP_MOVE,
+	INTERP_ADD,
+	INTERP_SUB,
+	INTERP_MUL,
+	INTERP_DIV,
+	INTERP_AND,
+	INTERP_OR,
+	INTERP_LSH,
+	INTERP_RSH,
+	/// dst = [a + imm]
+	INTERP_LOAD_LONG,
+	INTERP_LOAD_INT,
+	INTERP_LOAD_BYTE,
+	/// [a + imm] = b
+	INTERP_STORE_LONG,
+	INTERP_STORE_INT,
+	INTERP_STORE_BYTE,
+	/// Goes to the instruction imm, unconditionally or if `a op b` holds
+	INTERP_JUMP,
+	INTERP_BRANCH_LT,
+	INTERP_BRANCH_GT,
+	INTERP_BRANCH_LE,
+	INTERP_BRANCH_GE,
+	INTERP_BRANCH_EQ,
+	INTERP_BRANCH_NE,
+	INTERP_RET,
+	INTERP_OPCODE_COUNT,
+} seadragon_interp_opcode_t;
+
+/// Operands are frame slots, decoded once at translation.
+typedef struct {
+#ifdef SEADRAGON_INTERP_THREADED
+	const void *handler;
+#endif
+	seadragon_interp_opcode_t op;
+	uint32_t dst, a, b;
+	/// Memory offset, or index of the branch target
+	uint32_t imm;
+} seadragon_interp_insn_t;
+
+typedef struct {
+	char *name;
+	seadragon_interp_insn_t *code;
+	unsigned int length, capacity;
+	/// The frame, and its contents on entry: literals and zeroed variables
+	uint32_t *frame, *initial;
+	unsigned int slots;
+	/// Slots of the outputs, in declaration order
+	uint32_t *outputs;
+	unsigned int output_count;
+} seadragon_interp_function_t;
+
+typedef struct {
+	char *name;
+	uint32_t address;
+} seadragon_interp_buffer_t;
+
+struct seadragon_interp {
+	uint8_t *memory;
+	size_t size;
+	/// list of seadragon_interp_function_t
+	list_t *functions;
+	/// list of seadragon_interp_buffer_t
+	list_t *buffers;
+};
+
+typedef enum {
+	SLOT_VARIABLE,
+	SLOT_TEMPORARY,
+	SLOT_CONSTANT,
+} seadragon_interp_slot_t;
+
+typedef struct {
+	jmp_buf env;
+	seadragon_interp_t *interp;
+	seadragon_interp_function_t *func;
+	/// The IR of the function being translated
+	seadragon_ir_pool_t *pool;
+	/// Kind of each slot of func
+	seadragon_interp_slot_t *kinds;
+	unsigned int capacity;
+	/// Variable names to slot + 1, borrowed from the AST
+	map_t *variables;
+	/// Free temporaries, as slot + 1
+	list_t *free;
+	/// Code index of each block by id, to resolve branch targets
+	uint32_t *blocks;
+} seadragon_interp_ctx_t;
+
+static uint32_t seadragon_interp_new_slot(seadragon_interp_ctx_t *ctx, seadragon_interp_slot_t kind, uint32_t initial) {
+	seadragon_interp_function_t *func = ctx->func;
+	if (func->slots == ctx->capacity) {
+		ctx->capacity = ctx->capacity ? ctx->capacity * 2 : 16;
+		func->initial = realloc(func->initial, ctx->capacity * sizeof(uint32_t));
+		ctx->kinds = realloc(ctx->kinds, ctx->capacity * sizeof(seadragon_interp_slot_t));
+		if (!func->initial || !ctx->kinds) {
+			ERROR("Out of memory");
+		}
+	}
+	func->initial[func->slots] = initial;
+	ctx->kinds[func->slots] = kind;
+	func->slots += 1;
+	return func->slots - 1;
+}
+
+static uint32_t seadragon_interp_constant(seadragon_interp_ctx_t *ctx, uint32_t value) {
+	for (unsigned int i = 0; i < ctx->func->slots; i += 1) {
+		if (ctx->kinds[i] == SLOT_CONSTANT && ctx->func->initial[i] == value) {
+			return i;
+		}
+	}
+	return seadragon_interp_new_slot(ctx, SLOT_CONSTANT, value);
+}
+
+static uint32_t seadragon_interp_variable(seadragon_interp_ctx_t *ctx, const char *name) {
+	uintptr_t slot = (uintptr_t)map_get(ctx->variables, name);
+	if (!slot) {
+		slot = seadragon_interp_new_slot(ctx, SLOT_VARIABLE, 0) + 1;
+		map_set(ctx->variables, name, (void*)slot);
+	}
+	return slot - 1;
+}
+
+static uint32_t seadragon_interp_temporary(seadragon_interp_ctx_t *ctx) {
+	if (ctx->free->length) {
+		return (uintptr_t)list_pop(ctx->free) - 1;
+	}
+	return seadragon_interp_new_slot(ctx, SLOT_TEMPORARY, 0);
+}
+
+/// Frees a slot once its value has been consumed, if it is a temporary.
+static void seadragon_interp_release(seadragon_interp_ctx_t *ctx, uint32_t slot) {
+	if (ctx->kinds[slot] == SLOT_TEMPORARY) {
+		list_add(ctx->free, (void*)(uintptr_t)(slot + 1));
+	}
+}
+
+static void seadragon_interp_emit(seadragon_interp_ctx_t *ctx, seadragon_interp_opcode_t op, uint32_t dst, uint32_t a, uint32_t b, uint32_t imm) {
+	seadragon_interp_function_t *func = ctx->func;
+	if (func->length == func->capacity) {
+		func->capacity = func->capacity ? func->capacity * 2 : 64;
+		func->code = realloc(func->code, func->capacity * sizeof(seadragon_interp_insn_t));
+		if (!func->code) {
+			ERROR("Out of memory");
+		}
+	}
+	func->code[func->length] = (seadragon_interp_insn_t){ .op = op, .dst = dst, .a = a, .b = b, .imm = imm };
+	func->length += 1;
+}
+
+static uint32_t seadragon_interp_buffer_address(seadragon_interp_ctx_t *ctx, seadragon_buffer_t *buffer) {
+	uint32_t address;
+	if (!seadragon_interp_buffer(ctx->interp, buffer->name, &address)) {
+		ERROR("Internal error: unknown buffer");
+	}
+	return address;
+}
+
+static uint32_t seadragon_interp_node(seadragon_interp_ctx_t *ctx, uint32_t node, bool has_dst, uint32_t dst);
+
+/// Returns the slot holding an operand's value, which the caller must release.
+static uint32_t seadragon_interp_leaf(seadragon_interp_ctx_t *ctx, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE) {
+		ERROR("Internal error: missing operand");
+	}
+	if (ctx->pool->op[node] != OPERATION_NONE) {
+		return seadragon_interp_node(ctx, node, false, 0);
+	}
+	seadragon_value_t *value = &ctx->pool->value[node];
+	switch (value->type) {
+	case VALUE_TYPE_LITERAL:
+		return seadragon_interp_constant(ctx, value->u.literal);
+	case VALUE_TYPE_BUFFER:
+		return seadragon_interp_constant(ctx, seadragon_interp_buffer_address(ctx, value->u.buffer));
+	case VALUE_TYPE_IDENTIFIER:
+		return seadragon_interp_variable(ctx, value->u.identifier);
+	}
+	ERROR("Internal error: unknown value");
+}
+
+/// Splits an address into a slot and constant offset, as codegen does.
+static uint32_t seadragon_interp_address(seadragon_interp_ctx_t *ctx, uint32_t node, uint32_t *offset) {
+	*offset = 0;
+	if (ctx->pool->op[node] == OPERATION_ADD && seadragon_ir_is_literal(ctx->pool, ctx->pool->right[node], offset)) {
+		node = ctx->pool->left[node];
+	}
+	return seadragon_interp_leaf(ctx, node);
+}
+
+/// Translates a node, into dst if has_dst is set. Returns the slot holding the
+/// result, which is dst if set.
+static uint32_t seadragon_interp_node(seadragon_interp_ctx_t *ctx, uint32_t node, bool has_dst, uint32_t dst) {
+	seadragon_ir_pool_t *pool = ctx->pool;
+	seadragon_operation_t op = pool->op[node];
+	uint32_t left = pool->left[node], right = pool->right[node];
+	uint32_t a, b, offset;
+	switch (op) {
+	case OPERATION_SLONG:
+		if (seadragon_ir_is_location(pool, left, NULL)) {
+			uint32_t variable = seadragon_interp_leaf(ctx, left);
+			if (pool->op[right] != OPERATION_NONE) {
+				seadragon_interp_node(ctx, right, true, variable);
+			}
+			else {
+				seadragon_interp_emit(ctx, INTERP_MOVE, variable, seadragon_interp_leaf(ctx, right), 0, 0);
+			}
+			return 0;
+		}
+		// fallthrough
+	case OPERATION_SINT:
+	case OPERATION_SBYTE:
+		b = seadragon_interp_leaf(ctx, right);
+		a = seadragon_interp_address(ctx, left, &offset);
+		seadragon_interp_emit(ctx, op == OPERATION_SLONG ? INTERP_STORE_LONG : op == OPERATION_SINT ? INTERP_STORE_INT : INTERP_STORE_BYTE,
+			0, a, b, offset);
+		seadragon_interp_release(ctx, a);
+		seadragon_interp_release(ctx, b);
+		return 0;
+	case OPERATION_GLONG:
+		if (seadragon_ir_is_location(pool, left, NULL)) {
+			a = seadragon_interp_leaf(ctx, left);
+			if (has_dst && dst != a) {
+				seadragon_interp_emit(ctx, INTERP_MOVE, dst, a, 0, 0);
+			}
+			return has_dst ? dst : a;
+		}
+		// fallthrough
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:
+		a = seadragon_interp_address(ctx, left, &offset);
+		seadragon_interp_release(ctx, a);
+		dst = has_dst ? dst : seadragon_interp_temporary(ctx);
+		seadragon_interp_emit(ctx, op == OPERATION_GLONG ? INTERP_LOAD_LONG : op == OPERATION_GINT ? INTERP_LOAD_INT : INTERP_LOAD_BYTE,
+			dst, a, 0, offset);
+		return dst;
+	case OPERATION_ADD:
+	case OPERATION_SUB:
+	case OPERATION_MUL:
+	case OPERATION_DIV:
+	case OPERATION_AND:
+	case OPERATION_OR:
+	case OPERATION_LSH:
+	case OPERATION_RSH:
+		a = seadragon_interp_leaf(ctx, left);
+		b = seadragon_interp_leaf(ctx, right);
+		// Operands are read before the result is written, so it may reuse them
+		seadragon_interp_release(ctx, a);
+		seadragon_interp_release(ctx, b);
+		dst = has_dst ? dst : seadragon_interp_temporary(ctx);
+		seadragon_interp_emit(ctx, INTERP_ADD + (op - OPERATION_ADD), dst, a, b, 0);
+		return dst;
+	default:
+		ERROR("Unsupported operation");
+	}
+}
+
+/// Emits a block's conditional branch, falling through when either successor
+/// is the next block.
+static void seadragon_interp_branch(seadragon_interp_ctx_t *ctx, seadragon_block_t *block, seadragon_block_t *next) {
+	uint32_t condition = block->condition;
+	seadragon_operation_t op = OPERATION_NE;
+	uint32_t a, b;
+	if (seadragon_ir_is_comparison(ctx->pool, condition)) {
+		op = ctx->pool->op[condition];
+		a = seadragon_interp_leaf(ctx, ctx->pool->left[condition]);
+		b = seadragon_interp_leaf(ctx, ctx->pool->right[condition]);
+	}
+	else {
+		a = seadragon_interp_leaf(ctx, condition);
+		b = seadragon_interp_constant(ctx, 0);
+	}
+	seadragon_interp_release(ctx, a);
+	seadragon_interp_release(ctx, b);
+	static const seadragon_operation_t inverse[] = {
+		[OPERATION_CLT] = OPERATION_CGE, [OPERATION_CGE] = OPERATION_CLT,
+		[OPERATION_CGT] = OPERATION_CLE, [OPERATION_CLE] = OPERATION_CGT,
+		[OPERATION_EQ] = OPERATION_NE, [OPERATION_NE] = OPERATION_EQ,
+	};
+	seadragon_block_t *target = block->target;
+	if (target == next) {
+		op = inverse[op];
+		target = block->fallback;
+	}
+	seadragon_interp_emit(ctx, INTERP_BRANCH_LT + (op - OPERATION_CLT), 0, a, b, target->id);
+	if (block->fallback != next && target != block->fallback) {
+		seadragon_interp_emit(ctx, INTERP_JUMP, 0, 0, 0, block->fallback->id);
+	}
+}
+
+static void seadragon_interp_function(seadragon_interp_ctx_t *ctx, seadragon_function_t *func) {
+	list_t *blocks = func->u.blocks;
+	ctx->pool = &func->pool;
+	unsigned int max = 0;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		max = block->id > max ? block->id : max;
+	}
+	ctx->blocks = malloc((max + 1) * sizeof(uint32_t));
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		seadragon_block_t *next = i + 1 < blocks->length ? blocks->items[i + 1] : NULL;
+		ctx->blocks[block->id] = ctx->func->length;
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			seadragon_interp_node(ctx, block->statements[j], false, 0);
+		}
+		switch (block->terminator) {
+		case TERMINATOR_RETURN:
+			seadragon_interp_emit(ctx, INTERP_RET, 0, 0, 0, 0);
+			break;
+		case TERMINATOR_JUMP:
+			if (block->target != next) {
+				seadragon_interp_emit(ctx, INTERP_JUMP, 0, 0, 0, block->target->id);
+			}
+			break;
+		case TERMINATOR_BRANCH:
+			seadragon_interp_branch(ctx, block, next);
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < ctx->func->length; i += 1) {
+		seadragon_interp_insn_t *insn = &ctx->func->code[i];
+		if (insn->op >= INTERP_JUMP && insn->op <= INTERP_BRANCH_NE) {
+			insn->imm = ctx->blocks[insn->imm];
+		}
+	}
+	ctx->func->output_count = func->outputs->length;
+	ctx->func->outputs = malloc((func->outputs->length + 1) * sizeof(uint32_t));
+	for (unsigned int i = 0; i < func->outputs->length; i += 1) {
+		ctx->func->outputs[i] = seadragon_interp_variable(ctx, func->outputs->items[i]);
+	}
+	ctx->func->frame = malloc((ctx->func->slots + 1) * sizeof(uint32_t));
+}
+
+static void seadragon_interp_function_free(seadragon_interp_function_t *func) {
+	free(func->name);
+	free(func->code);
+	free(func->frame);
+	free(func->initial);
+	free(func->outputs);
+	free(func);
+}
+
+static seadragon_interp_function_t *seadragon_interp_find(seadragon_interp_t *interp, const char *name) {
+	for (unsigned int i = 0; i < interp->functions->length; i += 1) {
+		seadragon_interp_function_t *func = interp->functions->items[i];
+		if (!strcmp(func->name, name)) {
+			return func;
+		}
+	}
+	return NULL;
+}
+
+#ifdef SEADRAGON_INTERP_THREADED
+// Label addresses and computed gotos are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/// Runs func. If func is NULL, stores the handler of each opcode in handlers
+/// instead, for translation to resolve.
+static bool seadragon_interp_execute(seadragon_interp_t *interp, seadragon_interp_function_t *func, uint32_t *outputs, const void *const **handlers) {
+#ifdef SEADRAGON_INTERP_THREADED
+	static const void *const table[INTERP_OPCODE_COUNT] = {
+		[INTERP_MOVE] = &&op_MOVE, [INTERP_ADD] = &&op_ADD, [INTERP_SUB] = &&op_SUB, [INTERP_MUL] = &&op_MUL,
+		[INTERP_DIV] = &&op_DIV, [INTERP_AND] = &&op_AND, [INTERP_OR] = &&op_OR, [INTERP_LSH] = &&op_LSH,
+		[INTERP_RSH] = &&op_RSH, [INTERP_LOAD_LONG] = &&op_LOAD_LONG, [INTERP_LOAD_INT] = &&op_LOAD_INT,
+		[INTERP_LOAD_BYTE] = &&op_LOAD_BYTE, [INTERP_STORE_LONG] = &&op_STORE_LONG, [INTERP_STORE_INT] = &&op_STORE_INT,
+		[INTERP_STORE_BYTE] = &&op_STORE_BYTE, [INTERP_JUMP] = &&op_JUMP, [INTERP_BRANCH_LT] = &&op_BRANCH_LT,
+		[INTERP_BRANCH_GT] = &&op_BRANCH_GT, [INTERP_BRANCH_LE] = &&op_BRANCH_LE, [INTERP_BRANCH_GE] = &&op_BRANCH_GE,
+		[INTERP_BRANCH_EQ] = &&op_BRANCH_EQ, [INTERP_BRANCH_NE] = &&op_BRANCH_NE, [INTERP_RET] = &&op_RET,
+	};
+	if (!func) {
+		*handlers = table;
+		return true;
+	}
+#define HANDLER(op) op_##op:
+#define DISPATCH() goto *pc->handler
+#else
+	if (!func) {
+		*handlers = NULL;
+		return true;
+	}
+#define HANDLER(op) case INTERP_##op:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { pc += 1; DISPATCH(); } while (0)
+#define BRANCH(cond) do { pc = (cond) ? code + pc->imm : pc + 1; DISPATCH(); } while (0)
+// Bounds checks are against the size, which is at most 4 GiB, in 64 bits
+#define ADDRESS(width) uint32_t address = f[pc->a] + pc->imm; if ((uint64_t)address + (width) > size) goto fault;
+	const seadragon_interp_insn_t *code = func->code, *pc = code;
+	uint32_t *f = func->frame;
+	uint8_t *memory = interp->memory;
+	uint64_t size = interp->size;
+	const char *error;
+	memcpy(f, func->initial, func->slots * sizeof(uint32_t));
+#ifdef SEADRAGON_INTERP_THREADED
+	DISPATCH();
+#else
+dispatch:
+	switch (pc->op) {
+#endif
+	HANDLER(MOVE) { f[pc->dst] = f[pc->a]; NEXT(); }
+	HANDLER(ADD) { f[pc->dst] = f[pc->a] + f[pc->b]; NEXT(); }
+	HANDLER(SUB) { f[pc->dst] = f[pc->a] - f[pc->b]; NEXT(); }
+	HANDLER(MUL) { f[pc->dst] = f[pc->a] * f[pc->b]; NEXT(); }
+	HANDLER(DIV) {
+		if (!f[pc->b]) {
+			error = "Division by zero";
+			goto trap;
+		}
+		f[pc->dst] = f[pc->a] / f[pc->b];
+		NEXT();
+	}
+	HANDLER(AND) { f[pc->dst] = f[pc->a] & f[pc->b]; NEXT(); }
+	HANDLER(OR) { f[pc->dst] = f[pc->a] | f[pc->b]; NEXT(); }
+	HANDLER(LSH) { f[pc->dst] = f[pc->b] < 32 ? f[pc->a] << f[pc->b] : 0; NEXT(); }
+	HANDLER(RSH) { f[pc->dst] = f[pc->b] < 32 ? f[pc->a] >> f[pc->b] : 0; NEXT(); }
+	// Memory is little-endian, as on limn2k, whatever the host
+	HANDLER(LOAD_LONG) {
+		ADDRESS(4)
+		f[pc->dst] = memory[address] | memory[address + 1] << 8 | memory[address + 2] << 16 | (uint32_t)memory[address + 3] << 24;
+		NEXT();
+	}
+	HANDLER(LOAD_INT) {
+		ADDRESS(2)
+		f[pc->dst] = memory[address] | memory[address + 1] << 8;
+		NEXT();
+	}
+	HANDLER(LOAD_BYTE) {
+		ADDRESS(1)
+		f[pc->dst] = memory[address];
+		NEXT();
+	}
+	HANDLER(STORE_LONG) {
+		ADDRESS(4)
+		uint32_t value = f[pc->b];
+		memory[address] = value;
+		memory[address + 1] = value >> 8;
+		memory[address + 2] = value >> 16;
+		memory[address + 3] = value >> 24;
+		NEXT();
+	}
+	HANDLER(STORE_INT) {
+		ADDRESS(2)
+		memory[address] = f[pc->b];
+		memory[address + 1] = f[pc->b] >> 8;
+		NEXT();
+	}
+	HANDLER(STORE_BYTE) {
+		ADDRESS(1)
+		memory[address] = f[pc->b];
+		NEXT();
+	}
+	HANDLER(JUMP) { pc = code + pc->imm; DISPATCH(); }
+	HANDLER(BRANCH_LT) { BRANCH(f[pc->a] < f[pc->b]); }
+	HANDLER(BRANCH_GT) { BRANCH(f[pc->a] > f[pc->b]); }
+	HANDLER(BRANCH_LE) { BRANCH(f[pc->a] <= f[pc->b]); }
+	HANDLER(BRANCH_GE) { BRANCH(f[pc->a] >= f[pc->b]); }
+	HANDLER(BRANCH_EQ) { BRANCH(f[pc->a] == f[pc->b]); }
+	HANDLER(BRANCH_NE) { BRANCH(f[pc->a] != f[pc->b]); }
+	HANDLER(RET) {
+		for (unsigned int i = 0; i < func->output_count; i += 1) {
+			outputs[i] = f[func->outputs[i]];
+		}
+		return true;
+	}
+#ifndef SEADRAGON_INTERP_THREADED
+	default:
+		error = "Internal error: unknown opcode";
+		goto trap;
+	}
+#endif
+fault:
+	error = "Memory access out of bounds";
+trap:
+	fprintf(stderr, "error: Interp: %s in %s, at instruction %u\n", error, func->name, (unsigned int)(pc - code));
+	return false;
+#undef HANDLER
+#undef DISPATCH
+#undef NEXT
+#undef BRANCH
+#undef ADDRESS
+}
+
+#ifdef SEADRAGON_INTERP_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+void seadragon_interp_free(seadragon_interp_t *interp) {
+	for (unsigned int i = 0; i < interp->functions->length; i += 1) {
+		seadragon_interp_function_free(interp->functions->items[i]);
+	}
+	for (unsigned int i = 0; i < interp->buffers->length; i += 1) {
+		seadragon_interp_buffer_t *buffer = interp->buffers->items[i];
+		free(buffer->name);
+		free(buffer);
+	}
+	list_free(interp->functions);
+	list_free(interp->buffers);
+	free(interp->memory);
+	free(interp);
+}
+
+/// Lays buffers out at the end of memory, in the order sema sorted them in.
+static bool seadragon_interp_layout(seadragon_interp_t *interp, list_t *buffers) {
+	uint64_t offset = 0, alignment = 1;
+	for (unsigned int i = 0; i < buffers->length; i += 1) {
+		seadragon_buffer_t *buffer = buffers->items[i];
+		alignment = buffer->alignment > alignment ? buffer->alignment : alignment;
+		offset = (offset + buffer->alignment - 1) & ~(uint64_t)(buffer->alignment - 1);
+		seadragon_interp_buffer_t *placed = malloc(sizeof(seadragon_interp_buffer_t));
+		placed->name = strdup(buffer->name);
+		placed->address = offset;
+		list_add(interp->buffers, placed);
+		offset += buffer->size;
+	}
+	if (offset > interp->size) {
+		fprintf(stderr, "error: Interp: Buffers do not fit in memory\n");
+		return false;
+	}
+	uint64_t base = (interp->size - offset) & ~(alignment - 1);
+	for (unsigned int i = 0; i < interp->buffers->length; i += 1) {
+		((seadragon_interp_buffer_t*)interp->buffers->items[i])->address += base;
+	}
+	return true;
+}
+
+/// Translates every function of ast into ctx->interp. On failure, the
+/// function being translated is left in ctx.
+static bool seadragon_interp_translate(seadragon_interp_ctx_t *ctx, seadragon_ast_t *ast, const void *const *handlers) {
+	if (setjmp(ctx->env) != 0) {
+		return false;
+	}
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_function_t *func = ast->functions->items[i];
+		ctx->func = calloc(1, sizeof(seadragon_interp_function_t));
+		ctx->func->name = strdup(func->name);
+		ctx->variables = map_create();
+		ctx->free->length = 0;
+		ctx->capacity = 0;
+		seadragon_interp_function(ctx, func);
+#ifdef SEADRAGON_INTERP_THREADED
+		for (unsigned int j = 0; j < ctx->func->length; j += 1) {
+			ctx->func->code[j].handler = handlers[ctx->func->code[j].op];
+		}
+#else
+		(void)handlers;
+#endif
+		list_add(ctx->interp->functions, ctx->func);
+		ctx->func = NULL;
+		map_free(ctx->variables);
+		ctx->variables = NULL;
+		free(ctx->blocks);
+		ctx->blocks = NULL;
+	}
+	return true;
+}
+
+seadragon_interp_t *seadragon_interp_compile(seadragon_ast_t *ast, size_t memory_size) {
+	if (!ast || !ast->functions || !ast->buffers || memory_size > (size_t)UINT32_MAX + 1) {
+		return NULL;
+	}
+	seadragon_interp_t *interp = malloc(sizeof(seadragon_interp_t));
+	interp->size = memory_size;
+	interp->memory = calloc(memory_size ? memory_size : 1, 1);
+	interp->functions = list_create();
+	interp->buffers = list_create();
+	if (!interp->memory || !seadragon_interp_layout(interp, ast->buffers)) {
+		seadragon_interp_free(interp);
+		return NULL;
+	}
+	const void *const *handlers;
+	seadragon_interp_execute(interp, NULL, NULL, &handlers);
+	seadragon_interp_ctx_t *ctx = calloc(1, sizeof(seadragon_interp_ctx_t));
+	ctx->interp = interp;
+	ctx->free = list_create();
+	bool success = seadragon_interp_translate(ctx, ast, handlers);
+	if (ctx->func) {
+		seadragon_interp_function_free(ctx->func);
+	}
+	if (ctx->variables) {
+		map_free(ctx->variables);
+	}
+	free(ctx->blocks);
+	free(ctx->kinds);
+	list_free(ctx->free);
+	free(ctx);
+	if (!success) {
+		seadragon_interp_free(interp);
+		return NULL;
+	}
+	return interp;
+}
+
+bool seadragon_interp_lookup(seadragon_interp_t *interp, const char *name, unsigned int *outputs) {
+	seadragon_interp_function_t *func = seadragon_interp_find(interp, name);
+	if (func && outputs) {
+		*outputs = func->output_count;
+	}
+	return func != NULL;
+}
+
+bool seadragon_interp_run(seadragon_interp_t *interp, const char *name, uint32_t *outputs) {
+	seadragon_interp_function_t *func = seadragon_interp_find(interp, name);
+	if (!func) {
+		fprintf(stderr, "error: Interp: Unknown function `%s`\n", name);
+		return false;
+	}
+	return seadragon_interp_execute(interp, func, outputs, NULL);
+}
+
+uint8_t *seadragon_interp_memory(seadragon_interp_t *interp, size_t *size) {
+	if (size) {
+		*size = interp->size;
+	}
+	return interp->memory;
+}
+
+bool seadragon_interp_buffer(seadragon_interp_t *interp, const char *name, uint32_t *address) {
+	for (unsigned int i = 0; i < interp->buffers->length; i += 1) {
+		seadragon_interp_buffer_t *buffer = interp->buffers->items[i];
+		if (!strcmp(buffer->name, name)) {
+			*address = buffer->address;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,39 @@
+#ifndef SEADRAGON_INTERP_H_
+#define SEADRAGON_INTERP_H_
+
+#include "ast.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Runs checked programs directly, without a backend. Each function's blocks
+/// are translated once into three-address code over a frame of 32-bit slots,
+/// holding its variables, temporaries and literals, which is then dispatched
+/// with computed gotos where the compiler supports them.
+///
+/// Memory is a zero-filled array owned by the interpreter, with buffers laid
+/// out at its end. Loads and stores outside of it, and division by zero, stop
+/// the run with an error. Variables start at zero on every call.
+
+/// Memory size used by the command line.
+#define SEADRAGON_INTERP_MEMORY ((size_t)64 << 20)
+
+typedef struct seadragon_interp seadragon_interp_t;
+
+/// Translates an AST that has passed sema, which is only read. memory_size may be up to 4 GiB. Returns NULL on
+/// failure.
+seadragon_interp_t *seadragon_interp_compile(seadragon_ast_t *ast, size_t memory_size);
+void seadragon_interp_free(seadragon_interp_t *interp);
+
+/// Finds a function, and the number of outputs it returns.
+bool seadragon_interp_lookup(seadragon_interp_t *interp, const char *name, unsigned int *outputs);
+/// Calls a function, storing its outputs in declaration order. Frames are
+/// reused between calls, so an interpreter may only run on one thread at a time.
+bool seadragon_interp_run(seadragon_interp_t *interp, const char *name, uint32_t *outputs);
+
+uint8_t *seadragon_interp_memory(seadragon_interp_t *interp, size_t *size);
+/// Finds the address a buffer was placed at.
+bool seadragon_interp_buffer(seadragon_interp_t *interp, const char *name, uint32_t *address);
+
+#endif // SEADRAGON_INTERP_H_
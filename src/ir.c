@@ -0,0 +1,241 @@
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void seadragon_ir_pool_init(seadragon_ir_pool_t *pool) {
+	memset(pool, 0, sizeof(*pool));
+}
+
+void seadragon_ir_pool_deinit(seadragon_ir_pool_t *pool) {
+	free(pool->op);
+	free(pool->left);
+	free(pool->right);
+	free(pool->value);
+	seadragon_ir_pool_init(pool);
+}
+
+/// Makes room for count nodes in total, doubling the capacity.
+static void seadragon_ir_pool_reserve(seadragon_ir_pool_t *pool, uint32_t count) {
+	if (count <= pool->capacity) {
+		return;
+	}
+	uint32_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+	pool->capacity = count > capacity ? count : capacity;
+	pool->op = realloc(pool->op, pool->capacity * sizeof(*pool->op));
+	pool->left = realloc(pool->left, pool->capacity * sizeof(*pool->left));
+	pool->right = realloc(pool->right, pool->capacity * sizeof(*pool->right));
+	pool->value = realloc(pool->value, pool->capacity * sizeof(*pool->value));
+}
+
+void seadragon_ir_pool_copy(seadragon_ir_pool_t *dst, const seadragon_ir_pool_t *src) {
+	seadragon_ir_pool_reserve(dst, src->length);
+	memcpy(dst->op, src->op, src->length * sizeof(*src->op));
+	memcpy(dst->left, src->left, src->length * sizeof(*src->left));
+	memcpy(dst->right, src->right, src->length * sizeof(*src->right));
+	memcpy(dst->value, src->value, src->length * sizeof(*src->value));
+	dst->length = src->length;
+}
+
+uint32_t seadragon_ir_node(seadragon_ir_pool_t *pool, seadragon_operation_t op, uint32_t left, uint32_t right) {
+	seadragon_ir_pool_reserve(pool, pool->length + 1);
+	uint32_t node = pool->length;
+	pool->op[node] = op;
+	pool->left[node] = left;
+	pool->right[node] = right;
+	pool->length += 1;
+	return node;
+}
+
+uint32_t seadragon_ir_value(seadragon_ir_pool_t *pool, seadragon_value_t value) {
+	uint32_t node = seadragon_ir_node(pool, OPERATION_NONE, SEADRAGON_IR_NONE, SEADRAGON_IR_NONE);
+	pool->value[node] = value;
+	return node;
+}
+
+uint32_t seadragon_ir_literal(seadragon_ir_pool_t *pool, uint32_t literal) {
+	return seadragon_ir_value(pool, (seadragon_value_t){ .type = VALUE_TYPE_LITERAL, .u.literal = literal });
+}
+
+uint32_t seadragon_ir_buffer(seadragon_ir_pool_t *pool, seadragon_buffer_t *buffer) {
+	return seadragon_ir_value(pool, (seadragon_value_t){ .type = VALUE_TYPE_BUFFER, .u.buffer = buffer });
+}
+
+uint32_t seadragon_ir_location(seadragon_ir_pool_t *pool, char *name) {
+	return seadragon_ir_value(pool, (seadragon_value_t){ .type = VALUE_TYPE_IDENTIFIER, .u.identifier = name });
+}
+
+uint32_t seadragon_ir_read(seadragon_ir_pool_t *pool, char *name) {
+	return seadragon_ir_node(pool, OPERATION_GLONG, seadragon_ir_location(pool, name), SEADRAGON_IR_NONE);
+}
+
+uint32_t seadragon_ir_assign(seadragon_ir_pool_t *pool, char *name, uint32_t value) {
+	return seadragon_ir_node(pool, OPERATION_SLONG, seadragon_ir_location(pool, name), value);
+}
+
+uint32_t seadragon_ir_clone(seadragon_ir_pool_t *pool, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE) {
+		return SEADRAGON_IR_NONE;
+	}
+	if (pool->op[node] == OPERATION_NONE) {
+		return seadragon_ir_value(pool, pool->value[node]);
+	}
+	uint32_t left = seadragon_ir_clone(pool, pool->left[node]);
+	uint32_t right = seadragon_ir_clone(pool, pool->right[node]);
+	return seadragon_ir_node(pool, pool->op[node], left, right);
+}
+
+void seadragon_ir_insert(seadragon_block_t *block, uint32_t index, uint32_t statement) {
+	if (block->statement_count == block->statement_capacity) {
+		block->statement_capacity = block->statement_capacity ? block->statement_capacity * 2 : 8;
+		block->statements = realloc(block->statements, block->statement_capacity * sizeof(*block->statements));
+	}
+	memmove(&block->statements[index + 1], &block->statements[index], (block->statement_count - index) * sizeof(*block->statements));
+	block->statements[index] = statement;
+	block->statement_count += 1;
+}
+
+/// Whether a statement stores to memory, rather than to a variable.
+static bool seadragon_ir_is_store(const seadragon_ir_pool_t *pool, uint32_t node) {
+	seadragon_operation_t op = pool->op[node];
+	return (op == OPERATION_SLONG || op == OPERATION_SINT || op == OPERATION_SBYTE) && !seadragon_ir_is_location(pool, pool->left[node], NULL);
+}
+
+/// Appends a copy of the tree at node in from to to, in evaluation order.
+static uint32_t seadragon_ir_move(seadragon_ir_pool_t *to, const seadragon_ir_pool_t *from, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE) {
+		return SEADRAGON_IR_NONE;
+	}
+	if (from->op[node] == OPERATION_NONE) {
+		return seadragon_ir_value(to, from->value[node]);
+	}
+	uint32_t left, right;
+	if (seadragon_ir_is_store(from, node)) {
+		right = seadragon_ir_move(to, from, from->right[node]);
+		left = seadragon_ir_move(to, from, from->left[node]);
+	}
+	else {
+		left = seadragon_ir_move(to, from, from->left[node]);
+		right = seadragon_ir_move(to, from, from->right[node]);
+	}
+	return seadragon_ir_node(to, from->op[node], left, right);
+}
+
+void seadragon_ir_linearize(seadragon_function_t *func) {
+	seadragon_ir_pool_t pool;
+	seadragon_ir_pool_init(&pool);
+	// The live nodes fit in what the old pool holds
+	seadragon_ir_pool_reserve(&pool, func->pool.length);
+	for (unsigned int i = 0; i < func->u.blocks->length; i += 1) {
+		seadragon_block_t *block = func->u.blocks->items[i];
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			block->statements[j] = seadragon_ir_move(&pool, &func->pool, block->statements[j]);
+		}
+		block->condition = block->terminator == TERMINATOR_BRANCH ? seadragon_ir_move(&pool, &func->pool, block->condition)
+			: SEADRAGON_IR_NONE;
+	}
+	seadragon_ir_pool_deinit(&func->pool);
+	func->pool = pool;
+}
+
+static void seadragon_ir_free_names(list_t *names) {
+	for (unsigned int i = 0; i < names->length; i += 1) {
+		free(names->items[i]);
+	}
+	list_free(names);
+}
+
+void seadragon_ir_free_function(seadragon_function_t *func) {
+	for (unsigned int i = 0; i < func->u.blocks->length; i += 1) {
+		seadragon_block_t *block = func->u.blocks->items[i];
+		free(block->statements);
+		free(block);
+	}
+	list_free(func->u.blocks);
+	seadragon_ir_pool_deinit(&func->pool);
+	seadragon_ir_free_names(func->inputs);
+	seadragon_ir_free_names(func->outputs);
+	seadragon_ir_free_names(func->autos);
+	free(func->name);
+	free(func);
+}
+
+bool seadragon_ir_equal(const seadragon_ir_pool_t *pool, uint32_t a, uint32_t b) {
+	if (a == SEADRAGON_IR_NONE || b == SEADRAGON_IR_NONE) {
+		return a == b;
+	}
+	if (pool->op[a] != pool->op[b]) {
+		return false;
+	}
+	if (pool->op[a] == OPERATION_NONE) {
+		const seadragon_value_t *x = &pool->value[a], *y = &pool->value[b];
+		if (x->type != y->type) {
+			return false;
+		}
+		switch (x->type) {
+		case VALUE_TYPE_LITERAL:
+			return x->u.literal == y->u.literal;
+		case VALUE_TYPE_BUFFER:
+			return x->u.buffer == y->u.buffer;
+		default:
+			return !strcmp(x->u.identifier, y->u.identifier);
+		}
+	}
+	return seadragon_ir_equal(pool, pool->left[a], pool->left[b]) && seadragon_ir_equal(pool, pool->right[a], pool->right[b]);
+}
+
+bool seadragon_ir_is_literal(const seadragon_ir_pool_t *pool, uint32_t node, uint32_t *literal) {
+	if (node == SEADRAGON_IR_NONE || pool->op[node] != OPERATION_NONE || pool->value[node].type != VALUE_TYPE_LITERAL) {
+		return false;
+	}
+	if (literal) {
+		*literal = pool->value[node].u.literal;
+	}
+	return true;
+}
+
+bool seadragon_ir_is_location(const seadragon_ir_pool_t *pool, uint32_t node, char **name) {
+	if (node == SEADRAGON_IR_NONE || pool->op[node] != OPERATION_NONE || pool->value[node].type != VALUE_TYPE_IDENTIFIER) {
+		return false;
+	}
+	if (name) {
+		*name = pool->value[node].u.identifier;
+	}
+	return true;
+}
+
+bool seadragon_ir_is_read(const seadragon_ir_pool_t *pool, uint32_t node, char **name) {
+	return node != SEADRAGON_IR_NONE && pool->op[node] == OPERATION_GLONG && seadragon_ir_is_location(pool, pool->left[node], name);
+}
+
+bool seadragon_ir_is_assignment(const seadragon_ir_pool_t *pool, uint32_t statement, char **name) {
+	return pool->op[statement] == OPERATION_SLONG && seadragon_ir_is_location(pool, pool->left[statement], name);
+}
+
+bool seadragon_ir_is_comparison(const seadragon_ir_pool_t *pool, uint32_t node) {
+	return node != SEADRAGON_IR_NONE && pool->op[node] >= OPERATION_CLT && pool->op[node] <= OPERATION_NE;
+}
+
+unsigned int seadragon_ir_reads(const seadragon_ir_pool_t *pool, uint32_t node, const char *name) {
+	char *read;
+	if (node == SEADRAGON_IR_NONE || pool->op[node] == OPERATION_NONE) {
+		return 0;
+	}
+	if (seadragon_ir_is_read(pool, node, &read)) {
+		return !strcmp(read, name);
+	}
+	return seadragon_ir_reads(pool, pool->left[node], name) + seadragon_ir_reads(pool, pool->right[node], name);
+}
+
+bool seadragon_ir_loads(const seadragon_ir_pool_t *pool, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE || pool->op[node] == OPERATION_NONE) {
+		return false;
+	}
+	if (seadragon_ir_is_read(pool, node, NULL)) {
+		return false;
+	}
+	if (pool->op[node] >= OPERATION_GLONG && pool->op[node] <= OPERATION_GBYTE) {
+		return true;
+	}
+	return seadragon_ir_loads(pool, pool->left[node]) || seadragon_ir_loads(pool, pool->right[node]);
+}
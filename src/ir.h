@@ -0,0 +1,67 @@
+#ifndef SEADRAGON_IR_H_
+#define SEADRAGON_IR_H_
+
+#include "ast.h"
+
+#include <stdbool.h>
+
+/// Helpers for building and matching the IR that sema produces, shared by the
+/// passes that rewrite it. Nodes are only ever appended: a rewrite builds new
+/// nodes and points their user at them, and the nodes it replaced stay in the
+/// pool, unused, until seadragon_ir_linearize drops them. Appending may move
+/// the arrays, so pointers into them are only valid until the next node is
+/// built.
+
+void seadragon_ir_pool_init(seadragon_ir_pool_t *pool);
+void seadragon_ir_pool_deinit(seadragon_ir_pool_t *pool);
+/// Replaces dst's contents with a copy of src's.
+void seadragon_ir_pool_copy(seadragon_ir_pool_t *dst, const seadragon_ir_pool_t *src);
+
+/// A node holding a copy of value.
+uint32_t seadragon_ir_value(seadragon_ir_pool_t *pool, seadragon_value_t value);
+uint32_t seadragon_ir_literal(seadragon_ir_pool_t *pool, uint32_t literal);
+/// The address of a buffer.
+uint32_t seadragon_ir_buffer(seadragon_ir_pool_t *pool, seadragon_buffer_t *buffer);
+/// The location of a variable; only valid as the LHS of GLONG or SLONG.
+uint32_t seadragon_ir_location(seadragon_ir_pool_t *pool, char *name);
+uint32_t seadragon_ir_node(seadragon_ir_pool_t *pool, seadragon_operation_t op, uint32_t left, uint32_t right);
+/// Builds a read of a variable, `x@`.
+uint32_t seadragon_ir_read(seadragon_ir_pool_t *pool, char *name);
+/// Builds the statement `name = value`.
+uint32_t seadragon_ir_assign(seadragon_ir_pool_t *pool, char *name, uint32_t value);
+/// Deep copies; identifiers are shared, as they are never freed.
+uint32_t seadragon_ir_clone(seadragon_ir_pool_t *pool, uint32_t node);
+
+/// Inserts a statement before the one at index, or appends it if index is the
+/// block's statement_count.
+void seadragon_ir_insert(seadragon_block_t *block, uint32_t index, uint32_t statement);
+
+/// Rebuilds the function's pool in evaluation order, dropping the nodes that
+/// rewrites left behind. The blocks come in layout order, each with its
+/// statements and then its condition, and each of those is a contiguous range
+/// ending in its root. Every node comes right after its operands: the stored
+/// value before the address for stores to memory, and the left operand before
+/// the right one otherwise. Sema leaves functions linearized, and codegen
+/// relies on it, so a pass rewriting a function after sema linearizes it again.
+void seadragon_ir_linearize(seadragon_function_t *func);
+/// Frees a function that has passed sema, and possibly codegen, along with
+/// the names of its variables, which every identifier in its IR points to.
+void seadragon_ir_free_function(seadragon_function_t *func);
+/// Structural equality. Either node may be SEADRAGON_IR_NONE.
+bool seadragon_ir_equal(const seadragon_ir_pool_t *pool, uint32_t a, uint32_t b);
+
+/// The matchers return false for SEADRAGON_IR_NONE; out parameters may be NULL.
+bool seadragon_ir_is_literal(const seadragon_ir_pool_t *pool, uint32_t node, uint32_t *literal);
+/// Matches the location of a variable.
+bool seadragon_ir_is_location(const seadragon_ir_pool_t *pool, uint32_t node, char **name);
+bool seadragon_ir_is_read(const seadragon_ir_pool_t *pool, uint32_t node, char **name);
+/// Matches an assignment to a variable, `v x!`.
+bool seadragon_ir_is_assignment(const seadragon_ir_pool_t *pool, uint32_t statement, char **name);
+bool seadragon_ir_is_comparison(const seadragon_ir_pool_t *pool, uint32_t node);
+/// Counts the reads of a variable in an expression.
+unsigned int seadragon_ir_reads(const seadragon_ir_pool_t *pool, uint32_t node, const char *name);
+/// Whether an expression reads memory; such expressions can't be moved across
+/// stores.
+bool seadragon_ir_loads(const seadragon_ir_pool_t *pool, uint32_t node);
+
+#endif // SEADRAGON_IR_H_
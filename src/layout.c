@@ -0,0 +1,123 @@
+#include "layout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	seadragon_field_t *field;
+	uint64_t group_uses;
+	unsigned int index;
+} seadragon_layout_entry_t;
+
+static uint32_t seadragon_layout_alignment(uint32_t size) {
+	uint32_t alignment = 1;
+	while (alignment < SEADRAGON_LAYOUT_MAX_ALIGNMENT && size % (alignment * 2) == 0) {
+		alignment *= 2;
+	}
+	return alignment;
+}
+
+static int seadragon_layout_compare(const void *_left, const void *_right) {
+	const seadragon_layout_entry_t *left = _left, *right = _right;
+	if (left->group_uses != right->group_uses) {
+		return left->group_uses > right->group_uses ? -1 : 1;
+	}
+	if (left->field->signature != right->field->signature) {
+		return left->field->signature < right->field->signature ? -1 : 1;
+	}
+	if (left->field->alignment != right->field->alignment) {
+		return left->field->alignment > right->field->alignment ? -1 : 1;
+	}
+	return left->index < right->index ? -1 : 1;
+}
+
+static void seadragon_layout_reorder(seadragon_struct_t *structure) {
+	unsigned int count = structure->fields->length;
+	seadragon_layout_entry_t *entries = malloc(sizeof(seadragon_layout_entry_t) * count);
+	for (unsigned int i = 0; i < count; i += 1) {
+		entries[i].field = structure->fields->items[i];
+		entries[i].index = i;
+		entries[i].group_uses = 0;
+	}
+	// Structures are small, so the quadratic grouping is cheaper than hashing.
+	for (unsigned int i = 0; i < count; i += 1) {
+		for (unsigned int j = 0; j < count; j += 1) {
+			if (entries[i].field->signature == entries[j].field->signature) {
+				entries[i].group_uses += entries[j].field->uses;
+			}
+		}
+	}
+	qsort(entries, count, sizeof(seadragon_layout_entry_t), seadragon_layout_compare);
+	for (unsigned int i = 0; i < count; i += 1) {
+		structure->fields->items[i] = entries[i].field;
+	}
+	free(entries);
+}
+
+void seadragon_layout_struct(seadragon_struct_t *structure) {
+	for (unsigned int i = 0; i < structure->fields->length; i += 1) {
+		seadragon_field_t *field = structure->fields->items[i];
+		field->alignment = seadragon_layout_alignment(field->size);
+	}
+	if (structure->reorder) {
+		seadragon_layout_reorder(structure);
+	}
+	uint32_t offset = 0;
+	structure->alignment = 1;
+	for (unsigned int i = 0; i < structure->fields->length; i += 1) {
+		seadragon_field_t *field = structure->fields->items[i];
+		offset = (offset + field->alignment - 1) & ~(field->alignment - 1);
+		field->offset = offset;
+		offset += field->size;
+		if (field->alignment > structure->alignment) {
+			structure->alignment = field->alignment;
+		}
+	}
+	structure->size = (offset + structure->alignment - 1) & ~(structure->alignment - 1);
+}
+
+void seadragon_layout_buffers(list_t *buffers) {
+	for (unsigned int i = 0; i < buffers->length; i += 1) {
+		seadragon_buffer_t *buffer = buffers->items[i];
+		buffer->alignment = seadragon_layout_alignment(buffer->size);
+	}
+	// Insertion sort, which is stable; there are few buffers
+	for (unsigned int i = 1; i < buffers->length; i += 1) {
+		seadragon_buffer_t *buffer = buffers->items[i];
+		unsigned int j = i;
+		while (j > 0 && ((seadragon_buffer_t*)buffers->items[j - 1])->alignment < buffer->alignment) {
+			buffers->items[j] = buffers->items[j - 1];
+			j -= 1;
+		}
+		buffers->items[j] = buffer;
+	}
+}
+
+bool seadragon_layout_lookup(list_t *structures, const char *identifier, uint32_t *value, seadragon_field_t **field) {
+	for (unsigned int i = 0; i < structures->length; i += 1) {
+		seadragon_struct_t *structure = structures->items[i];
+		size_t len = strlen(structure->name);
+		if (strncmp(identifier, structure->name, len) || identifier[len] != '_') {
+			continue;
+		}
+		const char *member = identifier + len + 1;
+		if (!strcmp(member, "SIZEOF")) {
+			*value = structure->size;
+			if (field) {
+				*field = NULL;
+			}
+			return true;
+		}
+		for (unsigned int j = 0; j < structure->fields->length; j += 1) {
+			seadragon_field_t *f = structure->fields->items[j];
+			if (!strcmp(member, f->name)) {
+				*value = f->offset;
+				if (field) {
+					*field = f;
+				}
+				return true;
+			}
+		}
+	}
+	return false;
+}
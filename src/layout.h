@@ -0,0 +1,28 @@
+#ifndef SEADRAGON_LAYOUT_H_
+#define SEADRAGON_LAYOUT_H_
+
+#include "ast.h"
+
+#include <stdbool.h>
+
+/// The strictest alignment any field can require; matches a limn2k long.
+#define SEADRAGON_LAYOUT_MAX_ALIGNMENT 4
+
+/// Computes the alignment and offset of each field, and the size and alignment
+/// of the structure as a whole. Fields are placed in declaration order, unless
+/// the structure opted in to reordering: then fields that are accessed together
+/// (equal signatures) are grouped, hotter groups are placed first, and fields
+/// within a group are sorted by decreasing alignment to minimize padding.
+void seadragon_layout_struct(seadragon_struct_t *structure);
+
+/// Computes the alignment of each buffer from its size, and sorts them by
+/// decreasing alignment, so that they can be placed back to back without
+/// padding. Buffers of equal alignment keep their declaration order.
+void seadragon_layout_buffers(list_t *buffers);
+
+/// Resolves `STRUCT_FIELD` to the field's offset and `STRUCT_SIZEOF` to the
+/// structure's size. If field is non-NULL, it receives the referenced field (or
+/// NULL for `_SIZEOF`). Returns false if the identifier names no such symbol.
+bool seadragon_layout_lookup(list_t *structures, const char *identifier, uint32_t *value, seadragon_field_t **field);
+
+#endif // SEADRAGON_LAYOUT_H_
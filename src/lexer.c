@@ -113,8 +113,28 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 		{
 		case SEADRAGON_LEXER_EOF_: return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_EOF, 0);
 		case '+': return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_ADD, 1);
-		case '<': return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CLT, 1);
-		case '>': return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CGT, 1);
+		case '<':
+			if(seadragon_lexer_peekc_(lexer, 1) == '<')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_LSH, 2);
+			if(seadragon_lexer_peekc_(lexer, 1) == '=')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CLE, 2);
+			return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CLT, 1);
+		case '>':
+			if(seadragon_lexer_peekc_(lexer, 1) == '>')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_RSH, 2);
+			if(seadragon_lexer_peekc_(lexer, 1) == '=')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CGE, 2);
+			return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_CGT, 1);
+		case '=':
+			if(seadragon_lexer_peekc_(lexer, 1) == '=')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_EQ, 2);
+			return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_ERROR, 1);
+		case '~':
+			if(seadragon_lexer_peekc_(lexer, 1) == '=')
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_NE, 2);
+			return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_ERROR, 1);
+		case '&': return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_AND, 1);
+		case '|': return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_OR, 1);
 		case '-': {
 			c = seadragon_lexer_peekc_(lexer, 1);
 			if (c == '-') {
@@ -143,6 +163,16 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 			break;
 		case '0': case '1': case '2': case '3': case '4':
 		case '5': case '6': case '7': case '8': case '9':
+			if(c == '0' && seadragon_lexer_peekc_(lexer, 1) == 'x')
+			{
+				for(i = 2;; i++)
+				{
+					c = seadragon_lexer_peekc_(lexer, i);
+					if(!('0' <= c && c <= '9') && !('A' <= c && c <= 'F') && !('a' <= c && c <= 'f'))
+						break;
+				}
+				return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_INTEGER, i);
+			}
 			for(i = 1; c >= '0' && c <= '9'; i++)
 				c = seadragon_lexer_peekc_(lexer, i);
 			return seadragon_lexer_mktoken_(lexer, SEADRAGON_TK_INTEGER, i - 1);
@@ -159,6 +189,8 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 				lexer->token.kind = SEADRAGON_TK_RETURN;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "if"))
 				lexer->token.kind = SEADRAGON_TK_IF;
+			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "else"))
+				lexer->token.kind = SEADRAGON_TK_ELSE;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "fn"))
 				lexer->token.kind = SEADRAGON_TK_FN;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "end"))
@@ -171,6 +203,12 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 				lexer->token.kind = SEADRAGON_TK_VAR;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "auto"))
 				lexer->token.kind = SEADRAGON_TK_AUTO;
+			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "struct"))
+				lexer->token.kind = SEADRAGON_TK_STRUCT;
+			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "endstruct"))
+				lexer->token.kind = SEADRAGON_TK_ENDSTRUCT;
+			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "const"))
+				lexer->token.kind = SEADRAGON_TK_CONST;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "si"))
 				lexer->token.kind = SEADRAGON_TK_SINT;
 			else if (SEADRAGON_LEXER_ISKEYWORD_(lexer, "sb"))
@@ -183,7 +221,6 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 				lexer->token.kind = SEADRAGON_TK_DROP;
 			return lexer->token;
 
-			fprintf(stderr, "\nlexer error near '%c' (\\x%.2X)\n", c, c);
 			lexer->token.kind = SEADRAGON_TK_ERROR;
 			return lexer->token;
 		}
@@ -191,3 +228,34 @@ seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t catego
 	__builtin_trap();
 }
 
+
+static bool seadragon_lexer_isword_(int c)
+{
+	return ('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z') || c == '_';
+}
+
+size_t seadragon_lexer_split(const char* src, size_t srclen, size_t spacing, seadragon_lexer_split_t* splits, size_t max)
+{
+	seadragon_lexer_t lexer = {.src = (char*)src, .srclen = srclen, .offset = 0};
+	// Same prologue as the first call to seadragon_lexer_next
+	if(srclen >= 3 && !memcmp(src, "\xEF\xBB\xBF", 3))
+		lexer.offset += 3;
+	while(lexer.srclen - lexer.offset >= 2 && !memcmp(&src[lexer.offset], "#!", 2))
+		seadragon_lexer_skip_until_(&lexer, '\n', true);
+
+	size_t count = 0, last = 0;
+	while(count < max && lexer.offset + 2 <= srclen)
+	{
+		size_t i = lexer.offset;
+		// There are no comments or strings, so every standalone `fn` is the keyword
+		if(src[i] == 'f' && src[i + 1] == 'n' && (i == 0 || !seadragon_lexer_isword_((uint8_t)src[i - 1]))
+			&& seadragon_lexer_peekc_(&lexer, 2) != SEADRAGON_LEXER_EOF_ && !seadragon_lexer_isword_(seadragon_lexer_peekc_(&lexer, 2))
+			&& i - last >= spacing && i > 0)
+		{
+			splits[count++] = (seadragon_lexer_split_t){.offset = i, .pos = lexer.pos};
+			last = i;
+		}
+		seadragon_lexer_advancec_(&lexer, 1);
+	}
+	return count;
+}
@@ -23,4 +23,18 @@ void seadragon_lexer_deinit(seadragon_lexer_t* lexer);
 #define SEADRAGON_LEXER_CATEGORY_IGNORABLE   0x80
 seadragon_token_t seadragon_lexer_next(seadragon_lexer_t* lexer, uint32_t categories);
 
+/// A point at which a source may be cut and lexed in pieces: the start of an
+/// `fn` keyword, which only ever begins a top-level definition.
+typedef struct seadragon_lexer_split
+{
+    size_t offset;
+    /// Where a lexer over the whole source would be at offset; a lexer over
+    /// the piece starting here must have its pos set to this.
+    seadragon_source_pos_t pos;
+} seadragon_lexer_split_t;
+
+/// Scans src for split points at least `spacing` bytes apart (and from the
+/// start), storing up to max of them in order. Returns the number stored.
+size_t seadragon_lexer_split(const char* src, size_t srclen, size_t spacing, seadragon_lexer_split_t* splits, size_t max);
+
 #endif /* SEADRAGON_LEXER_H_ */
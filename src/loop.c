@@ -0,0 +1,649 @@
+#include "loop.h"
+#include "cfg.h"
+#include "ir.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// A variable that is advanced by a constant once per iteration.
+typedef struct {
+	char *name;
+	uint32_t step;
+	/// The statement `i = i + step`, and the block holding it
+	uint32_t increment;
+	seadragon_block_t *block;
+} seadragon_loop_iv_t;
+
+/// An expression computed in the preheader, and the variable holding it.
+typedef struct {
+	uint32_t expression;
+	char *name;
+} seadragon_loop_value_t;
+
+/// A statement to insert after an increment once the loop has been walked.
+typedef struct {
+	seadragon_loop_iv_t *iv;
+	uint32_t statement;
+} seadragon_loop_update_t;
+
+typedef struct {
+	seadragon_function_t *func;
+	seadragon_block_t *header;
+	/// The block that runs once before the loop
+	seadragon_block_t *preheader;
+	/// Tests the exit condition before the preheader, if the loop was inverted
+	seadragon_block_t *guard;
+	/// Indexed by block id: blocks in the loop, and blocks that run on every
+	/// iteration (and thus at least once whenever the preheader does).
+	bool *in_loop, *always;
+	unsigned int max;
+	/// Names of the variables assigned in the loop, once per assignment
+	list_t *assigned;
+	/// Whether the loop stores to memory; if so, no load is invariant.
+	bool stores;
+	list_t *ivs;
+	list_t *values;
+	list_t *updates;
+} seadragon_loop_t;
+
+typedef enum {
+	/// The value is used from a register; literals here cost an instruction
+	POSITION_REGISTER,
+	/// The value may be encoded as an immediate if it is a literal
+	POSITION_IMMEDIATE,
+	/// The address of a memory access, which can hold a constant offset
+	POSITION_ADDRESS,
+	/// The root of an assignment or condition; only its operands may move
+	POSITION_ROOT,
+} seadragon_loop_position_t;
+
+static unsigned int seadragon_loop_assignments(seadragon_loop_t *loop, const char *name) {
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < loop->assigned->length; i += 1) {
+		count += !strcmp(loop->assigned->items[i], name);
+	}
+	return count;
+}
+
+/// Returns 0 if the expression may change between iterations, 1 if it is
+/// invariant, and 2 if it is invariant but may fault (loads, division by a
+/// variable), and so may only be hoisted from blocks that run every iteration.
+static int seadragon_loop_invariant(seadragon_loop_t *loop, uint32_t node) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	char *name;
+	if (pool->op[node] == OPERATION_NONE) {
+		return pool->value[node].type != VALUE_TYPE_IDENTIFIER;
+	}
+	if (seadragon_ir_is_read(pool, node, &name)) {
+		return !seadragon_loop_assignments(loop, name);
+	}
+	switch (pool->op[node]) {
+	case OPERATION_GLONG:
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:
+		return !loop->stores && seadragon_loop_invariant(loop, pool->left[node]) ? 2 : 0;
+	case OPERATION_ADD:
+	case OPERATION_SUB:
+	case OPERATION_MUL:
+	case OPERATION_DIV:
+	case OPERATION_AND:
+	case OPERATION_OR:
+	case OPERATION_LSH:
+	case OPERATION_RSH:{
+		int left = seadragon_loop_invariant(loop, pool->left[node]);
+		int right = seadragon_loop_invariant(loop, pool->right[node]);
+		uint32_t divisor;
+		if (!left || !right) {
+			return 0;
+		}
+		if (pool->op[node] == OPERATION_DIV && !(seadragon_ir_is_literal(pool, pool->right[node], &divisor) && divisor)) {
+			return 2;
+		}
+		return left > right ? left : right;}
+	default:
+		return 0;
+	}
+}
+
+static bool seadragon_loop_hoistable(seadragon_loop_t *loop, uint32_t node, bool always) {
+	int invariant = seadragon_loop_invariant(loop, node);
+	return invariant == 1 || (invariant == 2 && always);
+}
+
+/// Finds the blocks of the loop: those on a path from the header back to it.
+static void seadragon_loop_members(seadragon_loop_t *loop) {
+	list_t *blocks = loop->func->u.blocks;
+	free(loop->in_loop);
+	loop->max = seadragon_cfg_max_id(blocks);
+	loop->in_loop = calloc(loop->max + 1, sizeof(bool));
+	bool *reached = calloc(loop->max + 1, sizeof(bool));
+	list_t *worklist = list_create();
+	list_add(worklist, loop->header->target);
+	reached[loop->header->target->id] = true;
+	while (worklist->length) {
+		seadragon_block_t *block = list_pop(worklist);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(block, succ);
+		for (unsigned int i = 0; i < count; i += 1) {
+			if (succ[i] != loop->header && !reached[succ[i]->id]) {
+				reached[succ[i]->id] = true;
+				list_add(worklist, succ[i]);
+			}
+		}
+	}
+	loop->in_loop[loop->header->id] = true;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 0; i < blocks->length; i += 1) {
+			seadragon_block_t *block = blocks->items[i];
+			if (!reached[block->id] || loop->in_loop[block->id]) {
+				continue;
+			}
+			seadragon_block_t *succ[2];
+			unsigned int count = seadragon_cfg_successors(block, succ);
+			for (unsigned int j = 0; j < count; j += 1) {
+				if (loop->in_loop[succ[j]->id]) {
+					loop->in_loop[block->id] = changed = true;
+				}
+			}
+		}
+	}
+	list_free(worklist);
+	free(reached);
+}
+
+/// Whether block can reach itself, i.e. whether it is inside a loop.
+static bool seadragon_loop_cyclic(seadragon_loop_t *loop, seadragon_block_t *block) {
+	bool *reached = calloc(loop->max + 1, sizeof(bool));
+	list_t *worklist = list_create();
+	list_add(worklist, block);
+	while (worklist->length && !reached[block->id]) {
+		seadragon_block_t *next = list_pop(worklist);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(next, succ);
+		for (unsigned int i = 0; i < count; i += 1) {
+			if (!reached[succ[i]->id]) {
+				reached[succ[i]->id] = true;
+				list_add(worklist, succ[i]);
+			}
+		}
+	}
+	bool cyclic = reached[block->id];
+	list_free(worklist);
+	free(reached);
+	return cyclic;
+}
+
+/// A block runs on every iteration if every path from the top of the body
+/// back to the header, or out of the loop, goes through it.
+static bool seadragon_loop_always(seadragon_loop_t *loop, seadragon_block_t *block) {
+	if (block == loop->header || block == loop->header->target) {
+		return true;
+	}
+	bool *visited = calloc(loop->max + 1, sizeof(bool));
+	list_t *worklist = list_create();
+	list_add(worklist, loop->header->target);
+	visited[loop->header->target->id] = true;
+	bool always = true;
+	while (worklist->length && always) {
+		seadragon_block_t *current = list_pop(worklist);
+		seadragon_block_t *succ[2];
+		unsigned int count = seadragon_cfg_successors(current, succ);
+		for (unsigned int i = 0; i < count; i += 1) {
+			if (succ[i] == loop->header || !loop->in_loop[succ[i]->id]) {
+				always = false;
+			}
+			else if (succ[i] != block && !visited[succ[i]->id]) {
+				visited[succ[i]->id] = true;
+				list_add(worklist, succ[i]);
+			}
+		}
+	}
+	list_free(worklist);
+	free(visited);
+	return always;
+}
+
+/// Creates the preheader. When the header only tests the condition, the loop is
+/// inverted: a copy of the test runs first and skips the preheader entirely if
+/// the body would not run, and the original test moves below the body.
+static void seadragon_loop_preheader(seadragon_loop_t *loop) {
+	list_t *blocks = loop->func->u.blocks;
+	list_t *outside = list_create();
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (!loop->in_loop[block->id] && block->terminator != TERMINATOR_RETURN
+				&& (block->target == loop->header || (block->terminator == TERMINATOR_BRANCH && block->fallback == loop->header))) {
+			list_add(outside, block);
+		}
+	}
+	seadragon_block_t *entry = loop->preheader = seadragon_cfg_block(blocks);
+	loop->preheader->terminator = TERMINATOR_JUMP;
+	loop->preheader->target = loop->header;
+	if (!loop->header->statement_count) {
+		entry = loop->guard = seadragon_cfg_block(blocks);
+		loop->guard->terminator = TERMINATOR_BRANCH;
+		loop->guard->condition = seadragon_ir_clone(&loop->func->pool, loop->header->condition);
+		loop->guard->target = loop->preheader;
+		loop->guard->fallback = loop->header->fallback;
+		loop->preheader->target = loop->header->target;
+	}
+	for (unsigned int i = 0; i < outside->length; i += 1) {
+		seadragon_block_t *block = outside->items[i];
+		if (block->target == loop->header) {
+			block->target = entry;
+		}
+		if (block->terminator == TERMINATOR_BRANCH && block->fallback == loop->header) {
+			block->fallback = entry;
+		}
+	}
+	if (blocks->items[0] == loop->header) {
+		// The entry block has no predecessors, so the guard takes its place
+		list_del(blocks, blocks->length - 1);
+		list_insert(blocks, 0, entry);
+	}
+	list_free(outside);
+}
+
+/// Creates a variable for a new value, or returns NULL if there are too many.
+static char *seadragon_loop_variable(seadragon_function_t *func) {
+	if (func->inputs->length + func->outputs->length + func->autos->length >= SEADRAGON_LOOP_MAX_VARIABLES) {
+		return NULL;
+	}
+	// `$` can't appear in source identifiers
+	char *name = malloc(16);
+	snprintf(name, 16, "$%u", func->autos->length);
+	list_add(func->autos, name);
+	return name;
+}
+
+/// Moves the expression in slot to the preheader, or reuses a variable already
+/// holding an equal one, and reads the variable instead. Returns NULL if the
+/// expression was left in place. slot must not point into the pool.
+static char *seadragon_loop_extract(seadragon_loop_t *loop, uint32_t *slot) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	for (unsigned int i = 0; i < loop->values->length; i += 1) {
+		seadragon_loop_value_t *value = loop->values->items[i];
+		if (seadragon_ir_equal(pool, value->expression, *slot)) {
+			*slot = seadragon_ir_read(pool, value->name);
+			return value->name;
+		}
+	}
+	char *name = seadragon_loop_variable(loop->func);
+	if (!name) {
+		return NULL;
+	}
+	seadragon_loop_value_t *value = malloc(sizeof(seadragon_loop_value_t));
+	value->expression = *slot;
+	value->name = name;
+	list_add(loop->values, value);
+	seadragon_ir_insert(loop->preheader, loop->preheader->statement_count, seadragon_ir_assign(pool, name, *slot));
+	*slot = seadragon_ir_read(pool, name);
+	return name;
+}
+
+static seadragon_loop_iv_t *seadragon_loop_iv(seadragon_loop_t *loop, const char *name) {
+	for (unsigned int i = 0; i < loop->ivs->length; i += 1) {
+		seadragon_loop_iv_t *iv = loop->ivs->items[i];
+		if (!strcmp(iv->name, name)) {
+			return iv;
+		}
+	}
+	return NULL;
+}
+
+/// Finds the variables assigned exactly once per iteration, as `i = i + c`.
+static void seadragon_loop_find_ivs(seadragon_loop_t *loop) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	list_t *blocks = loop->func->u.blocks;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (!loop->in_loop[block->id] || !loop->always[block->id]) {
+			continue;
+		}
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			uint32_t statement = block->statements[j];
+			uint32_t value = pool->right[statement];
+			char *name, *read;
+			uint32_t step;
+			if (!seadragon_ir_is_assignment(pool, statement, &name) || seadragon_loop_assignments(loop, name) != 1
+					|| (pool->op[value] != OPERATION_ADD && pool->op[value] != OPERATION_SUB)
+					|| !seadragon_ir_is_read(pool, pool->left[value], &read) || strcmp(read, name)
+					|| !seadragon_ir_is_literal(pool, pool->right[value], &step)) {
+				continue;
+			}
+			seadragon_loop_iv_t *iv = malloc(sizeof(seadragon_loop_iv_t));
+			iv->name = name;
+			iv->step = pool->op[value] == OPERATION_ADD ? step : -step;
+			iv->increment = statement;
+			iv->block = block;
+			list_add(loop->ivs, iv);
+		}
+	}
+}
+
+/// Matches i * c or i << c for an induction variable i, returning it and the
+/// factor c. If plain is set, i itself matches with a factor of one.
+static seadragon_loop_iv_t *seadragon_loop_scaled(seadragon_loop_t *loop, uint32_t node, bool plain, uint32_t *factor) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	char *name;
+	uint32_t c;
+	if (plain && seadragon_ir_is_read(pool, node, &name)) {
+		*factor = 1;
+		return seadragon_loop_iv(loop, name);
+	}
+	if (pool->op[node] == OPERATION_NONE || !seadragon_ir_is_read(pool, pool->left[node], &name)
+			|| !seadragon_ir_is_literal(pool, pool->right[node], &c)) {
+		return NULL;
+	}
+	if (pool->op[node] == OPERATION_MUL) {
+		*factor = c;
+	}
+	else if (pool->op[node] == OPERATION_LSH && c < 32) {
+		*factor = 1u << c;
+	}
+	else {
+		return NULL;
+	}
+	return seadragon_loop_iv(loop, name);
+}
+
+/// Replaces i * c, base + i and base + i * c, with base invariant, by variables
+/// that are advanced alongside i.
+static void seadragon_loop_reduce(seadragon_loop_t *loop, uint32_t *slot, bool always) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	uint32_t node = *slot;
+	if (pool->op[node] == OPERATION_NONE || seadragon_ir_is_read(pool, node, NULL)) {
+		return;
+	}
+	uint32_t factor;
+	seadragon_loop_iv_t *iv = seadragon_loop_scaled(loop, node, false, &factor);
+	// base + i is worth a variable of its own, i + constant is not
+	if (!iv && pool->op[node] == OPERATION_ADD) {
+		uint32_t left = pool->left[node], right = pool->right[node];
+		iv = seadragon_loop_scaled(loop, left, !seadragon_ir_is_literal(pool, right, NULL), &factor);
+		if (!iv || !seadragon_loop_hoistable(loop, right, always)) {
+			iv = seadragon_loop_scaled(loop, right, !seadragon_ir_is_literal(pool, left, NULL), &factor);
+			if (iv && !seadragon_loop_hoistable(loop, left, always)) {
+				iv = NULL;
+			}
+		}
+	}
+	if (iv) {
+		unsigned int known = loop->values->length;
+		char *name = seadragon_loop_extract(loop, slot);
+		if (name && loop->values->length != known) {
+			seadragon_loop_update_t *update = malloc(sizeof(seadragon_loop_update_t));
+			update->iv = iv;
+			uint32_t read = seadragon_ir_read(pool, name);
+			update->statement = seadragon_ir_assign(pool, name, seadragon_ir_node(pool, OPERATION_ADD, read,
+				seadragon_ir_literal(pool, iv->step * factor)));
+			list_add(loop->updates, update);
+		}
+		if (name) {
+			return;
+		}
+	}
+	// Operands are rewritten through copies, as building nodes may move the
+	// pool's arrays
+	uint32_t operand = pool->left[node];
+	seadragon_loop_reduce(loop, &operand, always);
+	pool->left[node] = operand;
+	if (pool->right[node] != SEADRAGON_IR_NONE) {
+		operand = pool->right[node];
+		seadragon_loop_reduce(loop, &operand, always);
+		pool->right[node] = operand;
+	}
+}
+
+/// Rewrites `while (i n <) ... i@ 1 + i! end` to count i down to zero, if
+/// nothing else reads i. The guard has already checked i < n on entry, so the
+/// body runs n - i times either way. Loops nested in another are left alone:
+/// the outer loop may come back to the guard, which would then test the
+/// rewritten i.
+static void seadragon_loop_count_down(seadragon_loop_t *loop) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	uint32_t condition = loop->header->condition;
+	if (!loop->guard || !seadragon_ir_is_comparison(pool, condition) || seadragon_loop_cyclic(loop, loop->guard)) {
+		return;
+	}
+	seadragon_operation_t op = pool->op[condition];
+	uint32_t bound;
+	char *name;
+	if ((op == OPERATION_CLT || op == OPERATION_NE) && seadragon_ir_is_read(pool, pool->left[condition], &name)) {
+		bound = pool->right[condition];
+	}
+	else if ((op == OPERATION_CGT || op == OPERATION_NE) && seadragon_ir_is_read(pool, pool->right[condition], &name)) {
+		bound = pool->left[condition];
+	}
+	else {
+		return;
+	}
+	seadragon_loop_iv_t *iv = seadragon_loop_iv(loop, name);
+	if (!iv || iv->step != 1 || seadragon_loop_invariant(loop, bound) != 1) {
+		return;
+	}
+	// Outputs are observed by the caller
+	for (unsigned int i = 0; i < loop->func->outputs->length; i += 1) {
+		if (!strcmp(loop->func->outputs->items[i], name)) {
+			return;
+		}
+	}
+	// The increment and the exit test must be the only reads of i outside the
+	// preheader and guard, which read it on entry.
+	unsigned int reads = 0;
+	list_t *blocks = loop->func->u.blocks;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (block == loop->guard || block == loop->preheader) {
+			continue;
+		}
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			reads += seadragon_ir_reads(pool, block->statements[j], name);
+		}
+		if (block->terminator == TERMINATOR_BRANCH) {
+			reads += seadragon_ir_reads(pool, block->condition, name);
+		}
+	}
+	if (reads != 2) {
+		return;
+	}
+	uint32_t remaining = seadragon_ir_node(pool, OPERATION_SUB, seadragon_ir_clone(pool, bound), seadragon_ir_read(pool, name));
+	seadragon_ir_insert(loop->preheader, loop->preheader->statement_count, seadragon_ir_assign(pool, name, remaining));
+	uint32_t increment = pool->right[iv->increment];
+	pool->op[increment] = OPERATION_SUB;
+	pool->value[pool->right[increment]].u.literal = 1;
+	iv->step = -1;
+	uint32_t read = seadragon_ir_read(pool, name);
+	loop->header->condition = seadragon_ir_node(pool, OPERATION_NE, read, seadragon_ir_literal(pool, 0));
+}
+
+static void seadragon_loop_hoist(seadragon_loop_t *loop, uint32_t *slot, bool always, seadragon_loop_position_t position);
+
+/// Hoists from the left or right operand of node.
+static void seadragon_loop_hoist_operand(seadragon_loop_t *loop, uint32_t node, bool right, bool always, seadragon_loop_position_t position) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	uint32_t operand = right ? pool->right[node] : pool->left[node];
+	seadragon_loop_hoist(loop, &operand, always, position);
+	if (right) {
+		pool->right[node] = operand;
+	}
+	else {
+		pool->left[node] = operand;
+	}
+}
+
+static void seadragon_loop_hoist(seadragon_loop_t *loop, uint32_t *slot, bool always, seadragon_loop_position_t position) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	uint32_t node = *slot;
+	if (pool->op[node] == OPERATION_NONE) {
+		if (position == POSITION_REGISTER && seadragon_ir_is_literal(pool, node, NULL)) {
+			seadragon_loop_extract(loop, slot);
+		}
+		return;
+	}
+	if (seadragon_ir_is_read(pool, node, NULL)) {
+		return;
+	}
+	uint32_t literal;
+	if (position == POSITION_ADDRESS && pool->op[node] == OPERATION_ADD && seadragon_ir_is_literal(pool, pool->right[node], NULL)) {
+		// The offset is free; only the base is worth computing up front
+		seadragon_loop_hoist_operand(loop, node, false, always, POSITION_REGISTER);
+		return;
+	}
+	if (position != POSITION_ROOT && seadragon_loop_hoistable(loop, node, always) && seadragon_loop_extract(loop, slot)) {
+		return;
+	}
+	switch (pool->op[node]) {
+	case OPERATION_GLONG:
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:
+		seadragon_loop_hoist_operand(loop, node, false, always, POSITION_ADDRESS);
+		break;
+	case OPERATION_CLT:
+	case OPERATION_CGT:
+	case OPERATION_CLE:
+	case OPERATION_CGE:
+	case OPERATION_EQ:
+	case OPERATION_NE:
+		seadragon_loop_hoist_operand(loop, node, false, always, POSITION_REGISTER);
+		// Comparisons against zero don't need a register
+		if (!seadragon_ir_is_literal(pool, pool->right[node], &literal) || literal) {
+			seadragon_loop_hoist_operand(loop, node, true, always, POSITION_REGISTER);
+		}
+		break;
+	default:
+		seadragon_loop_hoist_operand(loop, node, false, always, POSITION_REGISTER);
+		seadragon_loop_hoist_operand(loop, node, true, always, POSITION_IMMEDIATE);
+		break;
+	}
+}
+
+/// Applies fn to every statement operand and branch condition in the loop.
+/// Operands are passed through copies, as fn may build nodes and so move the
+/// pool's arrays.
+static void seadragon_loop_walk(seadragon_loop_t *loop, void (*fn)(seadragon_loop_t*, uint32_t*, bool, seadragon_loop_position_t)) {
+	seadragon_ir_pool_t *pool = &loop->func->pool;
+	list_t *blocks = loop->func->u.blocks;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (!loop->in_loop[block->id]) {
+			continue;
+		}
+		bool always = loop->always[block->id];
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			uint32_t statement = block->statements[j], operand;
+			bool assignment = seadragon_ir_is_assignment(pool, statement, NULL);
+			if (!assignment) {
+				operand = pool->left[statement];
+				fn(loop, &operand, always, POSITION_ADDRESS);
+				pool->left[statement] = operand;
+			}
+			operand = pool->right[statement];
+			fn(loop, &operand, always, assignment ? POSITION_ROOT : POSITION_REGISTER);
+			pool->right[statement] = operand;
+		}
+		if (block->terminator == TERMINATOR_BRANCH) {
+			fn(loop, &block->condition, always,
+				seadragon_ir_is_comparison(pool, block->condition) ? POSITION_ROOT : POSITION_REGISTER);
+		}
+	}
+}
+
+static void seadragon_loop_reduce_operand(seadragon_loop_t *loop, uint32_t *slot, bool always, seadragon_loop_position_t position) {
+	(void)position;
+	seadragon_loop_reduce(loop, slot, always);
+}
+
+static void seadragon_loop_transform(seadragon_function_t *func, seadragon_block_t *header) {
+	seadragon_loop_t loop;
+	memset(&loop, 0, sizeof(loop));
+	loop.func = func;
+	loop.header = header;
+	seadragon_loop_members(&loop);
+	if (!loop.in_loop[header->target->id]) {
+		// The body never comes back around
+		free(loop.in_loop);
+		return;
+	}
+	seadragon_loop_preheader(&loop);
+	seadragon_loop_members(&loop);
+
+	list_t *blocks = func->u.blocks;
+	loop.always = calloc(loop.max + 1, sizeof(bool));
+	loop.assigned = list_create();
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		if (!loop.in_loop[block->id]) {
+			continue;
+		}
+		// Without a guard, only the header is known to run before the loop exits
+		loop.always[block->id] = (loop.guard || block == header) && seadragon_loop_always(&loop, block);
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			char *name;
+			if (seadragon_ir_is_assignment(&func->pool, block->statements[j], &name)) {
+				list_add(loop.assigned, name);
+			}
+			else {
+				loop.stores = true;
+			}
+		}
+	}
+
+	loop.ivs = list_create();
+	loop.values = list_create();
+	loop.updates = list_create();
+	seadragon_loop_find_ivs(&loop);
+	seadragon_loop_walk(&loop, seadragon_loop_reduce_operand);
+	for (unsigned int i = 0; i < loop.updates->length; i += 1) {
+		seadragon_loop_update_t *update = loop.updates->items[i];
+		seadragon_block_t *block = update->iv->block;
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			if (block->statements[j] == update->iv->increment) {
+				seadragon_ir_insert(block, j + 1, update->statement);
+				break;
+			}
+		}
+		free(update);
+	}
+	// The new variables are assigned in the loop too
+	for (unsigned int i = 0; i < loop.values->length; i += 1) {
+		seadragon_loop_value_t *value = loop.values->items[i];
+		list_add(loop.assigned, value->name);
+		free(value);
+	}
+	loop.values->length = 0;
+	seadragon_loop_count_down(&loop);
+	seadragon_loop_walk(&loop, seadragon_loop_hoist);
+
+	for (unsigned int i = 0; i < loop.values->length; i += 1) {
+		free(loop.values->items[i]);
+	}
+	for (unsigned int i = 0; i < loop.ivs->length; i += 1) {
+		free(loop.ivs->items[i]);
+	}
+	list_free(loop.values);
+	list_free(loop.ivs);
+	list_free(loop.updates);
+	list_free(loop.assigned);
+	free(loop.always);
+	free(loop.in_loop);
+}
+
+void seadragon_loop_optimize(seadragon_function_t *func) {
+	list_t *headers = list_create();
+	for (unsigned int i = 0; i < func->u.blocks->length; i += 1) {
+		seadragon_block_t *block = func->u.blocks->items[i];
+		if (block->loop_header && block->terminator == TERMINATOR_BRANCH && block->target != block) {
+			list_add(headers, block);
+		}
+	}
+	// Headers are created in source order, so inner loops come after the loops
+	// containing them.
+	for (unsigned int i = headers->length; i-- > 0;) {
+		seadragon_loop_transform(func, headers->items[i]);
+	}
+	list_free(headers);
+}
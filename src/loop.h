@@ -0,0 +1,22 @@
+#ifndef SEADRAGON_LOOP_H_
+#define SEADRAGON_LOOP_H_
+
+#include "ast.h"
+
+/// Values are only moved out of loops into new variables while the function
+/// has fewer variables than this, leaving registers for temporaries.
+#define SEADRAGON_LOOP_MAX_VARIABLES 20
+
+/// Optimizes the while loops of func, innermost first:
+///  - the exit test is copied in front of the loop, so that the preheader and
+///    the body are only entered if the body runs at least once;
+///  - i * c and base + i * c, for an induction variable i that steps by a
+///    constant, become variables that are advanced by an addition;
+///  - counted loops (`i n <` with i stepping by one and used for nothing else)
+///    count down to zero, so the exit test needs no bound register;
+///  - invariant loads, address computations and constants that would be
+///    materialized into a register are computed once in the preheader.
+/// Runs between seadragon_cfg_simplify and seadragon_cfg_layout.
+void seadragon_loop_optimize(seadragon_function_t *func);
+
+#endif // SEADRAGON_LOOP_H_
@@ -0,0 +1,77 @@
+#include "map.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+map_t *map_create(void) {
+	map_t *map = malloc(sizeof(map_t));
+	map->capacity = 16;
+	map->length = 0;
+	map->keys = calloc(map->capacity, sizeof(char*));
+	map->values = malloc(sizeof(void*) * map->capacity);
+	return map;
+}
+
+void map_free(map_t *map) {
+	if (map == NULL) {
+		return;
+	}
+	free(map->keys);
+	free(map->values);
+	free(map);
+}
+
+static uint32_t map_hash(const char *key) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	while (*key) {
+		hash = (hash ^ (uint8_t)*key++) * 16777619u;
+	}
+	return hash;
+}
+
+/// Returns the slot holding key, or the empty slot where it belongs.
+static unsigned int map_slot(const char **keys, unsigned int capacity, const char *key) {
+	unsigned int i = map_hash(key) & (capacity - 1);
+	while (keys[i] && strcmp(keys[i], key)) {
+		i = (i + 1) & (capacity - 1);
+	}
+	return i;
+}
+
+static void map_resize(map_t *map) {
+	// Keep the load factor under 3/4
+	if ((map->length + 1) * 4 < map->capacity * 3) {
+		return;
+	}
+	unsigned int capacity = map->capacity * 2;
+	const char **keys = calloc(capacity, sizeof(char*));
+	void **values = malloc(sizeof(void*) * capacity);
+	for (unsigned int i = 0; i < map->capacity; i++) {
+		if (map->keys[i]) {
+			unsigned int slot = map_slot(keys, capacity, map->keys[i]);
+			keys[slot] = map->keys[i];
+			values[slot] = map->values[i];
+		}
+	}
+	free(map->keys);
+	free(map->values);
+	map->keys = keys;
+	map->values = values;
+	map->capacity = capacity;
+}
+
+void map_set(map_t *map, const char *key, void *value) {
+	map_resize(map);
+	unsigned int slot = map_slot(map->keys, map->capacity, key);
+	if (!map->keys[slot]) {
+		map->keys[slot] = key;
+		map->length += 1;
+	}
+	map->values[slot] = value;
+}
+
+void *map_get(map_t *map, const char *key) {
+	unsigned int slot = map_slot(map->keys, map->capacity, key);
+	return map->keys[slot] ? map->values[slot] : NULL;
+}
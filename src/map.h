@@ -0,0 +1,19 @@
+#ifndef MAP_H_
+#define MAP_H_
+
+/// String-keyed hash map with open addressing. Keys are borrowed, not copied,
+/// and must outlive the map.
+typedef struct {
+    unsigned int capacity;
+    unsigned int length;
+    const char **keys;
+    void **values;
+} map_t;
+
+map_t *map_create();
+void map_free(map_t *map);
+/// Replaces the value if the key is already present.
+void map_set(map_t *map, const char *key, void *value);
+void *map_get(map_t *map, const char *key);
+
+#endif
@@ -0,0 +1,586 @@
+#include "memops.h"
+#include "layout.h"
+#include "list.h"
+#include "map.h"
+#include "ir.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// A load or store, decomposed as width bytes at base + offset; a base of
+/// SEADRAGON_IR_NONE is an absolute address. For loads, shift is how far the
+/// value is shifted left in the expression using it; for stores, how far right
+/// the stored value is.
+typedef struct {
+	seadragon_operation_t op;
+	unsigned int width;
+	uint32_t base;
+	uint32_t offset, shift;
+	/// The term of an OR / ADD tree (loads), or the statement (stores)
+	uint32_t origin;
+	/// The stored value, with the shift stripped
+	uint32_t value;
+} seadragon_memops_access_t;
+
+/// Lists of nodes hold their indices.
+static void seadragon_memops_add(list_t *nodes, uint32_t node) {
+	list_add(nodes, (void*)(uintptr_t)node);
+}
+
+static uint32_t seadragon_memops_get(list_t *nodes, unsigned int index) {
+	return (uintptr_t)nodes->items[index];
+}
+
+static unsigned int seadragon_memops_width(seadragon_operation_t op) {
+	switch (op) {
+	case OPERATION_GBYTE:
+	case OPERATION_SBYTE:
+		return 1;
+	case OPERATION_GINT:
+	case OPERATION_SINT:
+		return 2;
+	case OPERATION_GLONG:
+	case OPERATION_SLONG:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static seadragon_operation_t seadragon_memops_op(unsigned int width, bool store) {
+	if (store) {
+		return width == 4 ? OPERATION_SLONG : width == 2 ? OPERATION_SINT : OPERATION_SBYTE;
+	}
+	return width == 4 ? OPERATION_GLONG : width == 2 ? OPERATION_GINT : OPERATION_GBYTE;
+}
+
+static unsigned int seadragon_memops_literal_alignment(uint32_t literal) {
+	unsigned int alignment = 1;
+	while (alignment < SEADRAGON_LAYOUT_MAX_ALIGNMENT && !(literal & alignment)) {
+		alignment <<= 1;
+	}
+	return alignment;
+}
+
+/// The largest power of two (up to a long) known to divide the value.
+static unsigned int seadragon_memops_alignment(seadragon_ir_pool_t *pool, map_t *variables, uint32_t node) {
+	uint32_t literal;
+	char *name;
+	if (seadragon_ir_is_literal(pool, node, &literal)) {
+		return seadragon_memops_literal_alignment(literal);
+	}
+	if (seadragon_ir_is_read(pool, node, &name)) {
+		uintptr_t alignment = (uintptr_t)map_get(variables, name);
+		return alignment ? alignment : 1;
+	}
+	if (pool->op[node] == OPERATION_NONE) {
+		return pool->value[node].type == VALUE_TYPE_BUFFER ? pool->value[node].u.buffer->alignment : 1;
+	}
+	uint32_t left_node = pool->left[node], right_node = pool->right[node];
+	unsigned int left, right;
+	switch (pool->op[node]) {
+	case OPERATION_ADD:
+	case OPERATION_SUB:
+	case OPERATION_OR:
+		left = seadragon_memops_alignment(pool, variables, left_node);
+		right = seadragon_memops_alignment(pool, variables, right_node);
+		return left < right ? left : right;
+	case OPERATION_AND:
+		// Clearing the low bits of either operand clears them in the result
+		left = seadragon_memops_alignment(pool, variables, left_node);
+		right = seadragon_memops_alignment(pool, variables, right_node);
+		return left > right ? left : right;
+	case OPERATION_MUL:
+		left = seadragon_memops_alignment(pool, variables, left_node) * seadragon_memops_alignment(pool, variables, right_node);
+		return left < SEADRAGON_LAYOUT_MAX_ALIGNMENT ? left : SEADRAGON_LAYOUT_MAX_ALIGNMENT;
+	case OPERATION_LSH:
+		if (!seadragon_ir_is_literal(pool, right_node, &literal)) {
+			return 1;
+		}
+		left = seadragon_memops_alignment(pool, variables, left_node);
+		while (literal-- && left < SEADRAGON_LAYOUT_MAX_ALIGNMENT) {
+			left <<= 1;
+		}
+		return left;
+	default:
+		return 1;
+	}
+}
+
+/// Finds the alignment of every variable: the alignment of all the values it
+/// is assigned, found by iterating down from the largest alignment.
+static map_t *seadragon_memops_variables(seadragon_function_t *func) {
+	seadragon_ir_pool_t *pool = &func->pool;
+	map_t *variables = map_create();
+	list_t *blocks = func->u.blocks;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			char *name;
+			if (seadragon_ir_is_assignment(pool, block->statements[j], &name)) {
+				map_set(variables, name, (void*)(uintptr_t)SEADRAGON_LAYOUT_MAX_ALIGNMENT);
+			}
+		}
+	}
+	// Inputs hold whatever the caller passed
+	for (unsigned int i = 0; i < func->inputs->length; i += 1) {
+		map_set(variables, func->inputs->items[i], (void*)(uintptr_t)1);
+	}
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 0; i < blocks->length; i += 1) {
+			seadragon_block_t *block = blocks->items[i];
+			for (uint32_t j = 0; j < block->statement_count; j += 1) {
+				uint32_t statement = block->statements[j];
+				char *name;
+				if (!seadragon_ir_is_assignment(pool, statement, &name)) {
+					continue;
+				}
+				uintptr_t alignment = seadragon_memops_alignment(pool, variables, pool->right[statement]);
+				if (alignment < (uintptr_t)map_get(variables, name)) {
+					map_set(variables, name, (void*)alignment);
+					changed = true;
+				}
+			}
+		}
+	}
+	return variables;
+}
+
+static void seadragon_memops_flatten(seadragon_ir_pool_t *pool, uint32_t node, list_t *terms, uint32_t *sum) {
+	uint32_t literal;
+	if (pool->op[node] == OPERATION_ADD) {
+		seadragon_memops_flatten(pool, pool->left[node], terms, sum);
+		seadragon_memops_flatten(pool, pool->right[node], terms, sum);
+	}
+	else if (seadragon_ir_is_literal(pool, node, &literal)) {
+		*sum += literal;
+	}
+	else {
+		seadragon_memops_add(terms, node);
+	}
+}
+
+/// Rewrites an address as (a + b + ...) + constant, so that the whole constant
+/// part becomes the offset of the access.
+static void seadragon_memops_fold(seadragon_ir_pool_t *pool, uint32_t *address) {
+	if (pool->op[*address] != OPERATION_ADD) {
+		return;
+	}
+	list_t *terms = list_create();
+	uint32_t sum = 0;
+	seadragon_memops_flatten(pool, *address, terms, &sum);
+	uint32_t node = terms->length ? seadragon_memops_get(terms, 0) : SEADRAGON_IR_NONE;
+	for (unsigned int i = 1; i < terms->length; i += 1) {
+		node = seadragon_ir_node(pool, OPERATION_ADD, node, seadragon_memops_get(terms, i));
+	}
+	if (node == SEADRAGON_IR_NONE) {
+		node = seadragon_ir_literal(pool, sum);
+	}
+	else if (sum) {
+		node = seadragon_ir_node(pool, OPERATION_ADD, node, seadragon_ir_literal(pool, sum));
+	}
+	*address = node;
+	list_free(terms);
+}
+
+/// Splits a folded address into base and offset.
+static void seadragon_memops_split(seadragon_ir_pool_t *pool, uint32_t address, uint32_t *base, uint32_t *offset) {
+	if (seadragon_ir_is_literal(pool, address, offset)) {
+		*base = SEADRAGON_IR_NONE;
+	}
+	else if (pool->op[address] == OPERATION_ADD && seadragon_ir_is_literal(pool, pool->right[address], offset)) {
+		*base = pool->left[address];
+	}
+	else {
+		*base = address;
+		*offset = 0;
+	}
+}
+
+static uint32_t seadragon_memops_address(seadragon_ir_pool_t *pool, uint32_t base, uint32_t offset) {
+	if (base == SEADRAGON_IR_NONE) {
+		return seadragon_ir_literal(pool, offset);
+	}
+	base = seadragon_ir_clone(pool, base);
+	return offset ? seadragon_ir_node(pool, OPERATION_ADD, base, seadragon_ir_literal(pool, offset)) : base;
+}
+
+/// Whether an access of the given width at base + offset is aligned.
+static bool seadragon_memops_aligned(seadragon_ir_pool_t *pool, map_t *variables, uint32_t base, uint32_t offset, unsigned int width) {
+	if (offset % width) {
+		return false;
+	}
+	return base == SEADRAGON_IR_NONE || seadragon_memops_alignment(pool, variables, base) >= width;
+}
+
+static bool seadragon_memops_same_base(seadragon_ir_pool_t *pool, seadragon_memops_access_t *a, seadragon_memops_access_t *b) {
+	return seadragon_ir_equal(pool, a->base, b->base);
+}
+
+/// Finds accesses covering width bytes at a->offset, each at the shift matching
+/// its offset, and stores them in group. Returns the number found, or 0.
+static unsigned int seadragon_memops_window(seadragon_ir_pool_t *pool, list_t *accesses, seadragon_memops_access_t *a, unsigned int width,
+		bool (*compatible)(seadragon_ir_pool_t *pool, seadragon_memops_access_t *a, seadragon_memops_access_t *b),
+		seadragon_memops_access_t **group) {
+	unsigned int count = 0;
+	uint32_t position = a->offset;
+	group[count++] = a;
+	position += a->width;
+	while (position < a->offset + width) {
+		seadragon_memops_access_t *found = NULL;
+		for (unsigned int i = 0; i < accesses->length && !found; i += 1) {
+			seadragon_memops_access_t *b = accesses->items[i];
+			if (b != a && b->offset == position && b->width <= a->offset + width - position
+					&& b->shift == a->shift + 8 * (position - a->offset) && seadragon_memops_same_base(pool, a, b)
+					&& compatible(pool, a, b)) {
+				found = b;
+			}
+		}
+		if (!found) {
+			return 0;
+		}
+		group[count++] = found;
+		position += found->width;
+	}
+	return count;
+}
+
+static bool seadragon_memops_any(seadragon_ir_pool_t *pool, seadragon_memops_access_t *a, seadragon_memops_access_t *b) {
+	(void)pool;
+	(void)a;
+	(void)b;
+	return true;
+}
+
+/// Finds a group of accesses to widen. Returns the number of accesses in it, or 0.
+static unsigned int seadragon_memops_find(seadragon_ir_pool_t *pool, map_t *variables, list_t *accesses,
+		bool (*compatible)(seadragon_ir_pool_t *pool, seadragon_memops_access_t *a, seadragon_memops_access_t *b),
+		seadragon_memops_access_t **group, unsigned int *width) {
+	for (*width = 2; *width <= 4; *width <<= 1) {
+		for (unsigned int i = 0; i < accesses->length; i += 1) {
+			seadragon_memops_access_t *a = accesses->items[i];
+			if (a->width >= *width || a->shift + 8 * *width > 32 || !seadragon_memops_aligned(pool, variables, a->base, a->offset, *width)) {
+				continue;
+			}
+			unsigned int count = seadragon_memops_window(pool, accesses, a, *width, compatible, group);
+			if (count) {
+				return count;
+			}
+		}
+	}
+	return 0;
+}
+
+static void seadragon_memops_remove(list_t *accesses, seadragon_memops_access_t **group, unsigned int count) {
+	for (unsigned int i = 0; i < count; i += 1) {
+		for (unsigned int j = 0; j < accesses->length; j += 1) {
+			if (accesses->items[j] == group[i]) {
+				list_del(accesses, j);
+				break;
+			}
+		}
+		free(group[i]);
+	}
+}
+
+static void seadragon_memops_terms(seadragon_ir_pool_t *pool, uint32_t node, seadragon_operation_t op, list_t *terms) {
+	if (pool->op[node] == op) {
+		seadragon_memops_terms(pool, pool->left[node], op, terms);
+		seadragon_memops_terms(pool, pool->right[node], op, terms);
+	}
+	else {
+		seadragon_memops_add(terms, node);
+	}
+}
+
+/// Matches a term of the form `load` or `load s <<`.
+static seadragon_memops_access_t *seadragon_memops_load(seadragon_ir_pool_t *pool, uint32_t term) {
+	uint32_t shift = 0;
+	uint32_t load = term;
+	if (pool->op[term] == OPERATION_LSH && seadragon_ir_is_literal(pool, pool->right[term], &shift)) {
+		load = pool->left[term];
+	}
+	if (seadragon_ir_is_read(pool, load, NULL) || pool->op[load] < OPERATION_GLONG || pool->op[load] > OPERATION_GBYTE || shift >= 32) {
+		return NULL;
+	}
+	seadragon_memops_access_t *access = malloc(sizeof(seadragon_memops_access_t));
+	access->op = pool->op[load];
+	access->width = seadragon_memops_width(access->op);
+	access->shift = shift;
+	access->origin = term;
+	access->value = SEADRAGON_IR_NONE;
+	seadragon_memops_split(pool, pool->left[load], &access->base, &access->offset);
+	return access;
+}
+
+/// Combines the loads in an OR / ADD tree, e.g. `p gb p 1 + gb 8 << |`
+/// becomes `p gi`. The bytes of the combined loads don't overlap, so ADD is
+/// equivalent to OR.
+static void seadragon_memops_combine_loads(seadragon_ir_pool_t *pool, map_t *variables, uint32_t *slot) {
+	seadragon_operation_t op = pool->op[*slot];
+	list_t *terms = list_create();
+	list_t *accesses = list_create();
+	seadragon_memops_terms(pool, *slot, op, terms);
+	for (unsigned int i = 0; i < terms->length; i += 1) {
+		seadragon_memops_access_t *access = seadragon_memops_load(pool, seadragon_memops_get(terms, i));
+		if (access) {
+			list_add(accesses, access);
+		}
+	}
+	bool changed = false;
+	seadragon_memops_access_t *group[4];
+	unsigned int width, count;
+	while ((count = seadragon_memops_find(pool, variables, accesses, seadragon_memops_any, group, &width))) {
+		seadragon_memops_access_t *first = group[0];
+		uint32_t address = seadragon_memops_address(pool, first->base, first->offset);
+		uint32_t term = seadragon_ir_node(pool, seadragon_memops_op(width, false), address, SEADRAGON_IR_NONE);
+		if (first->shift) {
+			term = seadragon_ir_node(pool, OPERATION_LSH, term, seadragon_ir_literal(pool, first->shift));
+		}
+		// The new term takes the place of the first; the others are dropped
+		for (unsigned int i = 0; i < terms->length; i += 1) {
+			for (unsigned int j = 0; j < count; j += 1) {
+				if (seadragon_memops_get(terms, i) == group[j]->origin) {
+					terms->items[i] = (void*)(uintptr_t)(j ? SEADRAGON_IR_NONE : term);
+				}
+			}
+		}
+		seadragon_memops_remove(accesses, group, count);
+		list_add(accesses, seadragon_memops_load(pool, term));
+		changed = true;
+	}
+	if (changed) {
+		uint32_t node = SEADRAGON_IR_NONE;
+		for (unsigned int i = 0; i < terms->length; i += 1) {
+			uint32_t term = seadragon_memops_get(terms, i);
+			if (term != SEADRAGON_IR_NONE) {
+				node = node != SEADRAGON_IR_NONE ? seadragon_ir_node(pool, op, node, term) : term;
+			}
+		}
+		*slot = node;
+	}
+	for (unsigned int i = 0; i < accesses->length; i += 1) {
+		free(accesses->items[i]);
+	}
+	list_free(accesses);
+	list_free(terms);
+}
+
+static void seadragon_memops_expression(seadragon_ir_pool_t *pool, map_t *variables, uint32_t *slot);
+
+/// Rewrites the left or right operand of node. Operands are rewritten through
+/// copies, as building nodes may move the pool's arrays.
+static void seadragon_memops_operand(seadragon_ir_pool_t *pool, map_t *variables, uint32_t node, bool right) {
+	uint32_t operand = right ? pool->right[node] : pool->left[node];
+	seadragon_memops_expression(pool, variables, &operand);
+	if (right) {
+		pool->right[node] = operand;
+	}
+	else {
+		pool->left[node] = operand;
+	}
+}
+
+static void seadragon_memops_expression(seadragon_ir_pool_t *pool, map_t *variables, uint32_t *slot) {
+	uint32_t node = *slot;
+	if (node == SEADRAGON_IR_NONE || pool->op[node] == OPERATION_NONE || seadragon_ir_is_read(pool, node, NULL)) {
+		return;
+	}
+	switch (pool->op[node]) {
+	case OPERATION_GLONG:
+	case OPERATION_GINT:
+	case OPERATION_GBYTE:{
+		uint32_t address = pool->left[node];
+		seadragon_memops_fold(pool, &address);
+		pool->left[node] = address;
+		seadragon_memops_operand(pool, variables, node, false);
+		return;}
+	case OPERATION_OR:
+	case OPERATION_ADD:
+		seadragon_memops_operand(pool, variables, node, false);
+		seadragon_memops_operand(pool, variables, node, true);
+		seadragon_memops_combine_loads(pool, variables, slot);
+		return;
+	default:
+		seadragon_memops_operand(pool, variables, node, false);
+		seadragon_memops_operand(pool, variables, node, true);
+		return;
+	}
+}
+
+/// Strips what doesn't affect the low width bytes of a stored value: masks
+/// that keep them, and returns the value and how far it is shifted right.
+static uint32_t seadragon_memops_slice(seadragon_ir_pool_t *pool, uint32_t value, unsigned int width, uint32_t *shift) {
+	uint32_t literal, mask = width == 4 ? UINT32_MAX : (1u << (8 * width)) - 1;
+	while (pool->op[value] == OPERATION_AND && seadragon_ir_is_literal(pool, pool->right[value], &literal) && (literal & mask) == mask) {
+		value = pool->left[value];
+	}
+	*shift = 0;
+	if (pool->op[value] == OPERATION_RSH && seadragon_ir_is_literal(pool, pool->right[value], &literal) && literal < 32) {
+		*shift = literal;
+		value = pool->left[value];
+	}
+	return value;
+}
+
+/// Stores can be combined if they store literals, or slices of the same value.
+static bool seadragon_memops_compatible_stores(seadragon_ir_pool_t *pool, seadragon_memops_access_t *a, seadragon_memops_access_t *b) {
+	if (seadragon_ir_is_literal(pool, a->value, NULL) || seadragon_ir_is_literal(pool, b->value, NULL)) {
+		return seadragon_ir_is_literal(pool, a->value, NULL) && seadragon_ir_is_literal(pool, b->value, NULL);
+	}
+	return seadragon_ir_equal(pool, a->value, b->value);
+}
+
+/// Combines a run of stores to the same base, which is free of loads and of
+/// overlapping stores.
+static void seadragon_memops_combine_stores(seadragon_ir_pool_t *pool, map_t *variables, seadragon_block_t *block, uint32_t start, uint32_t end) {
+	list_t *accesses = list_create();
+	for (uint32_t i = start; i < end; i += 1) {
+		uint32_t statement = block->statements[i];
+		seadragon_memops_access_t *access = malloc(sizeof(seadragon_memops_access_t));
+		access->op = pool->op[statement];
+		access->width = seadragon_memops_width(access->op);
+		access->origin = statement;
+		seadragon_memops_split(pool, pool->left[statement], &access->base, &access->offset);
+		access->value = seadragon_memops_slice(pool, pool->right[statement], access->width, &access->shift);
+		list_add(accesses, access);
+	}
+	// Literal stores are all at shift 0; treat their position as the shift
+	// so that windows line up.
+	seadragon_memops_access_t *group[4];
+	unsigned int width, count;
+	for (unsigned int i = 0; i < accesses->length; i += 1) {
+		seadragon_memops_access_t *access = accesses->items[i];
+		if (seadragon_ir_is_literal(pool, access->value, NULL) && !access->shift) {
+			access->shift = 8 * (access->offset % SEADRAGON_LAYOUT_MAX_ALIGNMENT);
+		}
+	}
+	while ((count = seadragon_memops_find(pool, variables, accesses, seadragon_memops_compatible_stores, group, &width))) {
+		uint32_t first = group[0]->origin;
+		uint32_t value, literal;
+		if (seadragon_ir_is_literal(pool, group[0]->value, NULL)) {
+			uint32_t combined = 0;
+			for (unsigned int i = 0; i < count; i += 1) {
+				seadragon_ir_is_literal(pool, group[i]->value, &literal);
+				uint32_t mask = group[i]->width == 4 ? UINT32_MAX : (1u << (8 * group[i]->width)) - 1;
+				combined |= (literal & mask) << (8 * (group[i]->offset - group[0]->offset));
+			}
+			value = seadragon_ir_literal(pool, combined);
+		}
+		else {
+			value = seadragon_ir_clone(pool, group[0]->value);
+			if (group[0]->shift) {
+				value = seadragon_ir_node(pool, OPERATION_RSH, value, seadragon_ir_literal(pool, group[0]->shift));
+			}
+		}
+		// The widened store replaces the first of the group; the stores don't
+		// overlap and share a base, so their order doesn't matter.
+		uint32_t address = seadragon_memops_address(pool, group[0]->base, group[0]->offset);
+		for (uint32_t i = start; i < end; i += 1) {
+			for (unsigned int j = 1; j < count; j += 1) {
+				if (block->statements[i] == group[j]->origin) {
+					block->statements[i] = SEADRAGON_IR_NONE;
+				}
+			}
+		}
+		pool->op[first] = seadragon_memops_op(width, true);
+		pool->left[first] = address;
+		pool->right[first] = value;
+		seadragon_memops_access_t *wide = group[0];
+		group[0] = NULL;
+		seadragon_memops_remove(accesses, group + 1, count - 1);
+		wide->op = pool->op[first];
+		wide->width = width;
+		seadragon_memops_split(pool, pool->left[first], &wide->base, &wide->offset);
+		wide->value = seadragon_memops_slice(pool, pool->right[first], width, &wide->shift);
+		if (seadragon_ir_is_literal(pool, wide->value, NULL) && !wide->shift) {
+			wide->shift = 8 * (wide->offset % SEADRAGON_LAYOUT_MAX_ALIGNMENT);
+		}
+	}
+	for (unsigned int i = 0; i < accesses->length; i += 1) {
+		free(accesses->items[i]);
+	}
+	list_free(accesses);
+}
+
+static bool seadragon_memops_is_store(seadragon_ir_pool_t *pool, uint32_t statement) {
+	seadragon_operation_t op = pool->op[statement];
+	return (op == OPERATION_SLONG || op == OPERATION_SINT || op == OPERATION_SBYTE) && !seadragon_ir_is_assignment(pool, statement, NULL);
+}
+
+/// Whether two stores in a run may touch the same bytes.
+static bool seadragon_memops_overlap(seadragon_ir_pool_t *pool, seadragon_block_t *block, uint32_t start, uint32_t end) {
+	for (uint32_t i = start; i < end; i += 1) {
+		uint32_t a = block->statements[i];
+		uint32_t base_a, base_b, offset_a, offset_b;
+		seadragon_memops_split(pool, pool->left[a], &base_a, &offset_a);
+		for (uint32_t j = i + 1; j < end; j += 1) {
+			uint32_t b = block->statements[j];
+			seadragon_memops_split(pool, pool->left[b], &base_b, &offset_b);
+			if (offset_a < offset_b + seadragon_memops_width(pool->op[b]) && offset_b < offset_a + seadragon_memops_width(pool->op[a])) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void seadragon_memops_block(seadragon_ir_pool_t *pool, map_t *variables, seadragon_block_t *block) {
+	for (uint32_t i = 0; i < block->statement_count; i += 1) {
+		uint32_t statement = block->statements[i];
+		if (seadragon_memops_is_store(pool, statement)) {
+			uint32_t address = pool->left[statement];
+			seadragon_memops_fold(pool, &address);
+			pool->left[statement] = address;
+			seadragon_memops_operand(pool, variables, statement, false);
+		}
+		seadragon_memops_operand(pool, variables, statement, true);
+	}
+	if (block->terminator == TERMINATOR_BRANCH) {
+		seadragon_memops_expression(pool, variables, &block->condition);
+	}
+
+	// Runs of consecutive stores with the same load-free base and load-free
+	// values can be reordered freely, as long as they don't overlap.
+	for (uint32_t start = 0; start < block->statement_count;) {
+		uint32_t first = block->statements[start];
+		uint32_t base, offset;
+		uint32_t end = start + 1;
+		if (seadragon_memops_is_store(pool, first) && !seadragon_ir_loads(pool, pool->left[first]) && !seadragon_ir_loads(pool, pool->right[first])) {
+			seadragon_memops_split(pool, pool->left[first], &base, &offset);
+			while (end < block->statement_count) {
+				uint32_t next = block->statements[end];
+				uint32_t next_base;
+				if (!seadragon_memops_is_store(pool, next) || seadragon_ir_loads(pool, pool->right[next])) {
+					break;
+				}
+				seadragon_memops_split(pool, pool->left[next], &next_base, &offset);
+				if (!seadragon_ir_equal(pool, base, next_base)) {
+					break;
+				}
+				end += 1;
+			}
+			if (end - start > 1 && !seadragon_memops_overlap(pool, block, start, end)) {
+				seadragon_memops_combine_stores(pool, variables, block, start, end);
+			}
+		}
+		start = end;
+	}
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < block->statement_count; i += 1) {
+		if (block->statements[i] != SEADRAGON_IR_NONE) {
+			block->statements[kept++] = block->statements[i];
+		}
+	}
+	block->statement_count = kept;
+}
+
+void seadragon_memops_combine(seadragon_function_t *func) {
+	map_t *variables = seadragon_memops_variables(func);
+	for (unsigned int i = 0; i < func->u.blocks->length; i += 1) {
+		seadragon_memops_block(&func->pool, variables, func->u.blocks->items[i]);
+	}
+	map_free(variables);
+}
@@ -0,0 +1,18 @@
+#ifndef SEADRAGON_MEMOPS_H_
+#define SEADRAGON_MEMOPS_H_
+
+#include "ast.h"
+
+/// Rewrites the memory accesses of func:
+///  - constant terms of an address are summed and moved to the top of the
+///    expression, so codegen can encode them as the access's offset;
+///  - byte and int loads of adjacent addresses that are ORed (or added)
+///    together at the matching shifts become a single wider load;
+///  - consecutive byte and int stores to adjacent addresses from the same base
+///    become a single wider store, when they store literals or the matching
+///    slices (`v 8 >>`, ...) of one value.
+/// Accesses are only widened when the wider address is provably aligned. The
+/// target is assumed to be little-endian, as limn2k is.
+void seadragon_memops_combine(seadragon_function_t *func);
+
+#endif // SEADRAGON_MEMOPS_H_
@@ -0,0 +1,345 @@
+#include "module.h"
+#include "cfg.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SEADRAGON_MODULE_BYTE_ORDER 0x01020304
+
+/// A table being written: its records, back to back.
+typedef struct {
+	uint8_t *data;
+	uint32_t length, capacity;
+	uint32_t count;
+} seadragon_module_bytes_t;
+
+typedef struct {
+	seadragon_ast_t *ast;
+	seadragon_module_bytes_t constants, structures, fields, buffers, functions, blocks, statements, names, nodes, strings;
+} seadragon_module_writer_t;
+
+/// Appends a record, returning its index.
+static uint32_t seadragon_module_append(seadragon_module_bytes_t *bytes, const void *record, uint32_t size) {
+	if (bytes->length + size > bytes->capacity) {
+		bytes->capacity = (bytes->length + size) * 2;
+		bytes->data = realloc(bytes->data, bytes->capacity);
+	}
+	memcpy(bytes->data + bytes->length, record, size);
+	bytes->length += size;
+	bytes->count += 1;
+	return bytes->count - 1;
+}
+
+static uint32_t seadragon_module_write_string(seadragon_module_writer_t *writer, const char *string) {
+	uint32_t offset = writer->strings.length;
+	seadragon_module_append(&writer->strings, string, strlen(string) + 1);
+	writer->strings.count = writer->strings.length;
+	return offset;
+}
+
+static uint32_t seadragon_module_write_name(seadragon_module_writer_t *writer, const char *name) {
+	uint32_t offset = seadragon_module_write_string(writer, name);
+	return seadragon_module_append(&writer->names, &offset, sizeof(offset));
+}
+
+/// Writes the tree at node, operands first, and returns its index.
+static uint32_t seadragon_module_write_node(seadragon_module_writer_t *writer, const seadragon_ir_pool_t *pool, uint32_t node) {
+	if (node == SEADRAGON_IR_NONE) {
+		return SEADRAGON_MODULE_NONE;
+	}
+	seadragon_module_node_t out = { .b = SEADRAGON_MODULE_NONE };
+	if (pool->op[node] != OPERATION_NONE) {
+		out.type = SEADRAGON_MODULE_NODE_OPERATION;
+		out.op = pool->op[node];
+		out.a = seadragon_module_write_node(writer, pool, pool->left[node]);
+		out.b = seadragon_module_write_node(writer, pool, pool->right[node]);
+		return seadragon_module_append(&writer->nodes, &out, sizeof(out));
+	}
+	const seadragon_value_t *value = &pool->value[node];
+	switch (value->type) {
+	case VALUE_TYPE_LITERAL:
+		out.type = SEADRAGON_MODULE_NODE_LITERAL;
+		out.a = value->u.literal;
+		break;
+	case VALUE_TYPE_IDENTIFIER:
+		out.type = SEADRAGON_MODULE_NODE_VARIABLE;
+		out.a = seadragon_module_write_string(writer, value->u.identifier);
+		break;
+	case VALUE_TYPE_BUFFER:
+		out.type = SEADRAGON_MODULE_NODE_BUFFER;
+		out.a = 0;
+		while (writer->ast->buffers->items[out.a] != value->u.buffer) {
+			out.a += 1;
+		}
+		break;
+	}
+	return seadragon_module_append(&writer->nodes, &out, sizeof(out));
+}
+
+static void seadragon_module_write_function(seadragon_module_writer_t *writer, seadragon_function_t *func) {
+	seadragon_module_function_t record = {
+		.name = seadragon_module_write_string(writer, func->name),
+		.outputs = writer->names.count, .output_count = func->outputs->length,
+	};
+	for (unsigned int i = 0; i < func->outputs->length; i += 1) {
+		seadragon_module_write_name(writer, func->outputs->items[i]);
+	}
+	record.autos = writer->names.count;
+	record.auto_count = func->autos->length;
+	for (unsigned int i = 0; i < func->autos->length; i += 1) {
+		seadragon_module_write_name(writer, func->autos->items[i]);
+	}
+	list_t *blocks = func->u.blocks;
+	unsigned int max = seadragon_cfg_max_id(blocks);
+	uint32_t *index = malloc(sizeof(uint32_t) * (max + 1));
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		index[((seadragon_block_t*)blocks->items[i])->id] = i;
+	}
+	record.blocks = writer->blocks.count;
+	record.block_count = blocks->length;
+	for (unsigned int i = 0; i < blocks->length; i += 1) {
+		seadragon_block_t *block = blocks->items[i];
+		seadragon_module_block_t out = {
+			.id = block->id,
+			.terminator = block->terminator,
+			.flags = (block->loop_header ? SEADRAGON_MODULE_LOOP_HEADER : 0) | (block->early_return ? SEADRAGON_MODULE_EARLY_RETURN : 0)
+				| (block->cold ? SEADRAGON_MODULE_COLD : 0),
+			.condition = SEADRAGON_MODULE_NONE,
+			.target = block->terminator != TERMINATOR_RETURN ? index[block->target->id] : SEADRAGON_MODULE_NONE,
+			.fallback = block->terminator == TERMINATOR_BRANCH ? index[block->fallback->id] : SEADRAGON_MODULE_NONE,
+			.statement_count = block->statement_count,
+		};
+		if (block->terminator == TERMINATOR_BRANCH) {
+			out.condition = seadragon_module_write_node(writer, &func->pool, block->condition);
+		}
+		out.statements = writer->statements.count;
+		for (uint32_t j = 0; j < block->statement_count; j += 1) {
+			uint32_t root = seadragon_module_write_node(writer, &func->pool, block->statements[j]);
+			seadragon_module_append(&writer->statements, &root, sizeof(root));
+		}
+		seadragon_module_append(&writer->blocks, &out, sizeof(out));
+	}
+	free(index);
+	seadragon_module_append(&writer->functions, &record, sizeof(record));
+}
+
+static int seadragon_module_compare_constants(const void *_left, const void *_right) {
+	return strcmp((*(seadragon_constant_t * const*)_left)->name, (*(seadragon_constant_t * const*)_right)->name);
+}
+
+static int seadragon_module_compare_structures(const void *_left, const void *_right) {
+	return strcmp((*(seadragon_struct_t * const*)_left)->name, (*(seadragon_struct_t * const*)_right)->name);
+}
+
+bool seadragon_module_write(seadragon_ast_t *ast, FILE *out) {
+	if (!ast || !out) {
+		return false;
+	}
+	seadragon_module_writer_t writer;
+	memset(&writer, 0, sizeof(writer));
+	writer.ast = ast;
+
+	void **sorted = malloc(sizeof(void*) * (ast->constants->length + ast->structures->length + 1));
+	memcpy(sorted, ast->constants->items, sizeof(void*) * ast->constants->length);
+	qsort(sorted, ast->constants->length, sizeof(void*), seadragon_module_compare_constants);
+	for (unsigned int i = 0; i < ast->constants->length; i += 1) {
+		seadragon_constant_t *constant = sorted[i];
+		seadragon_module_constant_t record = { seadragon_module_write_string(&writer, constant->name), constant->value };
+		seadragon_module_append(&writer.constants, &record, sizeof(record));
+	}
+	memcpy(sorted, ast->structures->items, sizeof(void*) * ast->structures->length);
+	qsort(sorted, ast->structures->length, sizeof(void*), seadragon_module_compare_structures);
+	for (unsigned int i = 0; i < ast->structures->length; i += 1) {
+		seadragon_struct_t *structure = sorted[i];
+		seadragon_module_struct_t record = {
+			seadragon_module_write_string(&writer, structure->name), structure->size, structure->alignment,
+			writer.fields.count, structure->fields->length,
+		};
+		for (unsigned int j = 0; j < structure->fields->length; j += 1) {
+			seadragon_field_t *field = structure->fields->items[j];
+			seadragon_module_field_t out = { seadragon_module_write_string(&writer, field->name), field->size, field->alignment, field->offset };
+			seadragon_module_append(&writer.fields, &out, sizeof(out));
+		}
+		seadragon_module_append(&writer.structures, &record, sizeof(record));
+	}
+	free(sorted);
+	for (unsigned int i = 0; i < ast->buffers->length; i += 1) {
+		seadragon_buffer_t *buffer = ast->buffers->items[i];
+		seadragon_module_buffer_t record = { seadragon_module_write_string(&writer, buffer->name), buffer->size, buffer->alignment };
+		seadragon_module_append(&writer.buffers, &record, sizeof(record));
+	}
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_module_write_function(&writer, ast->functions->items[i]);
+	}
+
+	seadragon_module_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SEADRAGON_MODULE_MAGIC, sizeof(header.magic));
+	header.version = SEADRAGON_MODULE_VERSION;
+	header.byte_order = SEADRAGON_MODULE_BYTE_ORDER;
+	seadragon_module_bytes_t *tables[] = {
+		&writer.constants, &writer.structures, &writer.fields, &writer.buffers, &writer.functions, &writer.blocks,
+		&writer.statements, &writer.names, &writer.nodes, &writer.strings,
+	};
+	seadragon_module_table_t *entries[] = {
+		&header.constants, &header.structures, &header.fields, &header.buffers, &header.functions, &header.blocks,
+		&header.statements, &header.names, &header.nodes, &header.strings,
+	};
+	// Every record is made of words, only the strings need padding
+	static const uint8_t padding[4];
+	uint32_t offset = sizeof(header);
+	for (unsigned int i = 0; i < sizeof(tables) / sizeof(*tables); i += 1) {
+		entries[i]->offset = offset;
+		entries[i]->count = tables[i]->count;
+		offset += tables[i]->length;
+	}
+	header.size = (offset + 3) & ~3u;
+	bool success = fwrite(&header, sizeof(header), 1, out) == 1;
+	for (unsigned int i = 0; i < sizeof(tables) / sizeof(*tables); i += 1) {
+		success = success && fwrite(tables[i]->data, 1, tables[i]->length, out) == tables[i]->length;
+		free(tables[i]->data);
+	}
+	success = success && fwrite(padding, 1, header.size - offset, out) == header.size - offset;
+	return success;
+}
+
+static bool seadragon_module_table_valid(const seadragon_module_t *module, const seadragon_module_table_t *table, size_t size) {
+	return table->offset % 4 == 0 && (uint64_t)table->offset + (uint64_t)table->count * size <= module->size;
+}
+
+bool seadragon_module_open(seadragon_module_t *module, const void *data, size_t size) {
+	module->data = data;
+	module->size = size;
+	module->mapping = NULL;
+	const seadragon_module_header_t *header = data;
+	if (!data || (uintptr_t)data % 4 || size < sizeof(*header) || memcmp(header->magic, SEADRAGON_MODULE_MAGIC, sizeof(header->magic))
+			|| header->version != SEADRAGON_MODULE_VERSION || header->byte_order != SEADRAGON_MODULE_BYTE_ORDER || header->size != size) {
+		return false;
+	}
+	if (!seadragon_module_table_valid(module, &header->constants, sizeof(seadragon_module_constant_t))
+			|| !seadragon_module_table_valid(module, &header->structures, sizeof(seadragon_module_struct_t))
+			|| !seadragon_module_table_valid(module, &header->fields, sizeof(seadragon_module_field_t))
+			|| !seadragon_module_table_valid(module, &header->buffers, sizeof(seadragon_module_buffer_t))
+			|| !seadragon_module_table_valid(module, &header->functions, sizeof(seadragon_module_function_t))
+			|| !seadragon_module_table_valid(module, &header->blocks, sizeof(seadragon_module_block_t))
+			|| !seadragon_module_table_valid(module, &header->statements, sizeof(uint32_t))
+			|| !seadragon_module_table_valid(module, &header->names, sizeof(uint32_t))
+			|| !seadragon_module_table_valid(module, &header->nodes, sizeof(seadragon_module_node_t))
+			|| !seadragon_module_table_valid(module, &header->strings, 1)) {
+		return false;
+	}
+	// Any string offset is then NUL-terminated
+	return !header->strings.count || !module->data[header->strings.offset + header->strings.count - 1];
+}
+
+bool seadragon_module_map(seadragon_module_t *module, const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	void *mapping = MAP_FAILED;
+	if (!fstat(fd, &st) && st.st_size > 0) {
+		mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+	if (!seadragon_module_open(module, mapping, st.st_size)) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+	module->mapping = mapping;
+	return true;
+}
+
+void seadragon_module_unmap(seadragon_module_t *module) {
+	if (module->mapping) {
+		munmap(module->mapping, module->size);
+		module->mapping = NULL;
+	}
+}
+
+const seadragon_module_header_t *seadragon_module_header(const seadragon_module_t *module) {
+	return (const seadragon_module_header_t*)module->data;
+}
+
+const void *seadragon_module_record(const seadragon_module_t *module, const seadragon_module_table_t *table, uint32_t index, size_t size) {
+	if (index >= table->count) {
+		return NULL;
+	}
+	return module->data + table->offset + (size_t)index * size;
+}
+
+const char *seadragon_module_string(const seadragon_module_t *module, uint32_t offset) {
+	const seadragon_module_header_t *header = seadragon_module_header(module);
+	if (offset >= header->strings.count) {
+		return NULL;
+	}
+	return (const char*)module->data + header->strings.offset + offset;
+}
+
+/// Compares a name from the image against the first length bytes of key.
+static int seadragon_module_compare(const char *name, const char *key, size_t length) {
+	if (!name) {
+		return 1;
+	}
+	int order = strncmp(name, key, length);
+	return order ? order : name[length] != 0;
+}
+
+/// Binary search over a table sorted by name, whose records begin with it.
+static const void *seadragon_module_find(const seadragon_module_t *module, const seadragon_module_table_t *table, size_t size,
+		const char *key, size_t length) {
+	uint32_t low = 0, high = table->count;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		const uint32_t *record = seadragon_module_record(module, table, middle, size);
+		int order = seadragon_module_compare(seadragon_module_string(module, *record), key, length);
+		if (!order) {
+			return record;
+		}
+		if (order < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return NULL;
+}
+
+bool seadragon_module_lookup(const seadragon_module_t *module, const char *identifier, uint32_t *value) {
+	const seadragon_module_header_t *header = seadragon_module_header(module);
+	const seadragon_module_constant_t *constant = seadragon_module_find(module, &header->constants, sizeof(*constant), identifier, strlen(identifier));
+	if (constant) {
+		*value = constant->value;
+		return true;
+	}
+	for (const char *separator = strchr(identifier, '_'); separator; separator = strchr(separator + 1, '_')) {
+		const seadragon_module_struct_t *structure = seadragon_module_find(module, &header->structures, sizeof(*structure),
+			identifier, separator - identifier);
+		if (!structure) {
+			continue;
+		}
+		const char *member = separator + 1;
+		if (!strcmp(member, "SIZEOF")) {
+			*value = structure->size;
+			return true;
+		}
+		for (uint32_t i = 0; i < structure->field_count; i += 1) {
+			const seadragon_module_field_t *field = seadragon_module_record(module, &header->fields, structure->fields + i, sizeof(*field));
+			const char *name = field ? seadragon_module_string(module, field->name) : NULL;
+			if (name && !strcmp(name, member)) {
+				*value = field->offset;
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,130 @@
+#ifndef SEADRAGON_MODULE_H_
+#define SEADRAGON_MODULE_H_
+
+#include "ast.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Precompiled modules: a checked AST, serialized so that it can be mapped
+/// and used in place. Every reference inside the image is a byte offset from
+/// its start or an index into one of its tables, so it may be mapped at any
+/// address, and all fields are native-endian 32-bit words, so nothing needs
+/// decoding. Opening an image only validates its header.
+///
+/// The version must be bumped whenever a record or seadragon_operation_t
+/// changes, as operations are stored by value.
+#define SEADRAGON_MODULE_VERSION 1
+#define SEADRAGON_MODULE_MAGIC "SDRAGMOD"
+/// Marks a missing node or block.
+#define SEADRAGON_MODULE_NONE UINT32_MAX
+
+typedef struct {
+	uint32_t offset;
+	uint32_t count;
+} seadragon_module_table_t;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	/// 0x01020304 as written, to reject images from a different byte order
+	uint32_t byte_order;
+	uint32_t size;
+	/// Constants and structures are sorted by name, for binary search.
+	seadragon_module_table_t constants, structures, fields, buffers, functions, blocks;
+	/// Node indices of block statements, and string offsets of variable names
+	seadragon_module_table_t statements, names;
+	seadragon_module_table_t nodes;
+	/// NUL-terminated names; count is in bytes
+	seadragon_module_table_t strings;
+} seadragon_module_header_t;
+
+typedef struct {
+	uint32_t name, value;
+} seadragon_module_constant_t;
+
+typedef struct {
+	uint32_t name, size, alignment;
+	/// Range of the fields table, in memory order
+	uint32_t fields, field_count;
+} seadragon_module_struct_t;
+
+typedef struct {
+	uint32_t name, size, alignment, offset;
+} seadragon_module_field_t;
+
+typedef struct {
+	uint32_t name, size, alignment;
+} seadragon_module_buffer_t;
+
+typedef struct {
+	uint32_t name;
+	/// Ranges of the names table
+	uint32_t outputs, output_count, autos, auto_count;
+	/// Range of the blocks table, in layout order
+	uint32_t blocks, block_count;
+} seadragon_module_function_t;
+
+#define SEADRAGON_MODULE_LOOP_HEADER 1
+#define SEADRAGON_MODULE_EARLY_RETURN 2
+#define SEADRAGON_MODULE_COLD 4
+
+typedef struct {
+	uint32_t id;
+	/// TERMINATOR_*, and SEADRAGON_MODULE_* flags
+	uint32_t terminator, flags;
+	/// Node index, or NONE
+	uint32_t condition;
+	/// Indices into the function's blocks, or NONE
+	uint32_t target, fallback;
+	/// Range of the statements table
+	uint32_t statements, statement_count;
+} seadragon_module_block_t;
+
+typedef enum {
+	/// op is a seadragon_operation_t, a and b are node indices or NONE
+	SEADRAGON_MODULE_NODE_OPERATION,
+	/// a is the literal
+	SEADRAGON_MODULE_NODE_LITERAL,
+	/// a is the string offset of the variable's name
+	SEADRAGON_MODULE_NODE_VARIABLE,
+	/// a is an index into the buffers table
+	SEADRAGON_MODULE_NODE_BUFFER,
+} seadragon_module_node_type_t;
+
+typedef struct {
+	uint32_t type, op, a, b;
+} seadragon_module_node_t;
+
+typedef struct {
+	const uint8_t *data;
+	size_t size;
+	/// Set if the image was mapped by seadragon_module_map
+	void *mapping;
+} seadragon_module_t;
+
+/// Serializes an AST that has passed sema.
+bool seadragon_module_write(seadragon_ast_t *ast, FILE *out);
+
+/// Wraps an image that is already in memory, which must be suitably aligned
+/// for 32-bit reads and outlive the module.
+bool seadragon_module_open(seadragon_module_t *module, const void *data, size_t size);
+
+/// Maps a precompiled module file read-only, and opens it.
+bool seadragon_module_map(seadragon_module_t *module, const char *path);
+void seadragon_module_unmap(seadragon_module_t *module);
+
+/// Returns the record of the given table at index, or NULL if out of bounds.
+/// e.g. `seadragon_module_record(module, &header->nodes, i, sizeof(node))`
+const void *seadragon_module_record(const seadragon_module_t *module, const seadragon_module_table_t *table, uint32_t index, size_t size);
+const seadragon_module_header_t *seadragon_module_header(const seadragon_module_t *module);
+/// Returns the string at offset, or NULL if out of bounds.
+const char *seadragon_module_string(const seadragon_module_t *module, uint32_t offset);
+
+/// Resolves a constant, `STRUCT_FIELD` or `STRUCT_SIZEOF` exported by the
+/// module, as seadragon_layout_lookup does for local structures.
+bool seadragon_module_lookup(const seadragon_module_t *module, const char *identifier, uint32_t *value);
+
+#endif // SEADRAGON_MODULE_H_
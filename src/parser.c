@@ -2,177 +2,479 @@
 #include "list.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <setjmp.h>
 
-#define ERRORF(msg, ...) do { fprintf(stderr, "%s:%d: error: Parser: " msg "\n", __FILE__, __LINE__, __VA_ARGS__); longjmp(env, 1); } while(0);
-#define ERROR(msg) do { fprintf(stderr, "%s:%d: error: Parser: %s\n", __FILE__, __LINE__, msg); longjmp(env, 1); } while(0);
+#define ERRORF(msg, ...) do { seadragon_session_error(session, "%s:%d: error: Parser: " msg, __FILE__, __LINE__, __VA_ARGS__); return false; } while(0);
+#define ERROR(msg) do { seadragon_session_error(session, "%s:%d: error: Parser: %s", __FILE__, __LINE__, msg); return false; } while(0);
+/// Reads the next token of a declaration, failing, and leaving *index at the
+/// EOF token, if the input ends first.
+#define NEXT() do { token = tokens->items[*index]; if (token->kind == SEADRAGON_TK_EOF) ERROR("Unexpected end of input"); *index += 1; } while(0)
 
-seadragon_ast_t *seadragon_parse(seadragon_ast_t *ast, seadragon_lexer_t *lexer) {
-	if (!ast) {
-		return NULL;
+/// Parses a single token of a stack expression into *result, which is NULL if
+/// the token is not an instruction. Returns false on an invalid instruction.
+static bool seadragon_parse_instruction(seadragon_session_t *session, seadragon_token_t *token, seadragon_instruction_t **result) {
+	seadragon_instruction_t *instruction = malloc(sizeof(seadragon_instruction_t));
+	*result = NULL;
+	instruction->argument = NULL;
+	switch (token->kind) {
+	case SEADRAGON_TK_INTEGER:
+		instruction->argument = malloc(sizeof(seadragon_value_t));
+		instruction->type = INSTRUCTION_TYPE_PUSH;
+		instruction->argument->type = VALUE_TYPE_LITERAL;
+		uint64_t val = seadragon_token_read_number(*token);
+		if (val > UINT32_MAX) {
+			free(instruction->argument);
+			free(instruction);
+			ERROR("Integer literal does not fit into 32 bits");
+		}
+		instruction->argument->u.literal = (uint32_t)val;
+		break;
+	case SEADRAGON_TK_IDENT:
+		instruction->argument = malloc(sizeof(seadragon_value_t));
+		instruction->type = INSTRUCTION_TYPE_PUSH;
+		instruction->argument->type = VALUE_TYPE_IDENTIFIER;
+		instruction->argument->u.identifier = seadragon_token_read(*token);
+		break;
+	case SEADRAGON_TK_SLONG:
+		instruction->type = INSTRUCTION_TYPE_SLONG;
+		break;
+	case SEADRAGON_TK_GLONG:
+		instruction->type = INSTRUCTION_TYPE_GLONG;
+		break;
+	case SEADRAGON_TK_SINT:
+		instruction->type = INSTRUCTION_TYPE_SINT;
+		break;
+	case SEADRAGON_TK_GINT:
+		instruction->type = INSTRUCTION_TYPE_GINT;
+		break;
+	case SEADRAGON_TK_SBYTE:
+		instruction->type = INSTRUCTION_TYPE_SBYTE;
+		break;
+	case SEADRAGON_TK_GBYTE:
+		instruction->type = INSTRUCTION_TYPE_GBYTE;
+		break;
+	case SEADRAGON_TK_DROP:
+		instruction->type = INSTRUCTION_TYPE_DROP;
+		break;
+	case SEADRAGON_TK_SUB:
+		instruction->type = INSTRUCTION_TYPE_SUB;
+		break;
+	case SEADRAGON_TK_ADD:
+		instruction->type = INSTRUCTION_TYPE_ADD;
+		break;
+	case SEADRAGON_TK_MUL:
+		instruction->type = INSTRUCTION_TYPE_MUL;
+		break;
+	case SEADRAGON_TK_DIV:
+		instruction->type = INSTRUCTION_TYPE_DIV;
+		break;
+	case SEADRAGON_TK_AND:
+		instruction->type = INSTRUCTION_TYPE_AND;
+		break;
+	case SEADRAGON_TK_OR:
+		instruction->type = INSTRUCTION_TYPE_OR;
+		break;
+	case SEADRAGON_TK_LSH:
+		instruction->type = INSTRUCTION_TYPE_LSH;
+		break;
+	case SEADRAGON_TK_RSH:
+		instruction->type = INSTRUCTION_TYPE_RSH;
+		break;
+	case SEADRAGON_TK_CLT:
+		instruction->type = INSTRUCTION_TYPE_CLT;
+		break;
+	case SEADRAGON_TK_CGT:
+		instruction->type = INSTRUCTION_TYPE_CGT;
+		break;
+	case SEADRAGON_TK_CLE:
+		instruction->type = INSTRUCTION_TYPE_CLE;
+		break;
+	case SEADRAGON_TK_CGE:
+		instruction->type = INSTRUCTION_TYPE_CGE;
+		break;
+	case SEADRAGON_TK_EQ:
+		instruction->type = INSTRUCTION_TYPE_EQ;
+		break;
+	case SEADRAGON_TK_NE:
+		instruction->type = INSTRUCTION_TYPE_NE;
+		break;
+	case SEADRAGON_TK_RETURN:
+		instruction->type = INSTRUCTION_TYPE_RETURN;
+		break;
+	default:
+		free(instruction);
+		return true;
+	}
+	*result = instruction;
+	return true;
+}
+
+static void seadragon_parse_free_instructions(list_t *instructions) {
+	for (unsigned int i = 0; i < instructions->length; i += 1) {
+		seadragon_instruction_t *instruction = instructions->items[i];
+		if (instruction->argument && instruction->argument->type == VALUE_TYPE_IDENTIFIER) {
+			free(instruction->argument->u.identifier);
+		}
+		free(instruction->argument);
+		free(instruction);
+	}
+	list_free(instructions);
+}
+
+static void seadragon_parse_free_names(list_t *names) {
+	for (unsigned int i = 0; i < names->length; i += 1) {
+		free(names->items[i]);
+	}
+	list_free(names);
+}
+
+static void seadragon_parse_free_function(seadragon_function_t *function) {
+	seadragon_parse_free_instructions(function->u.instructions);
+	seadragon_parse_free_names(function->autos);
+	seadragon_parse_free_names(function->inputs);
+	seadragon_parse_free_names(function->outputs);
+	free(function->name);
+	free(function);
+}
+
+static void seadragon_parse_free_constant(seadragon_constant_t *constant) {
+	seadragon_parse_free_instructions(constant->expression);
+	free(constant->name);
+	free(constant);
+}
+
+static void seadragon_parse_free_buffer(seadragon_buffer_t *buffer) {
+	if (buffer->declared_size && buffer->declared_size->type == VALUE_TYPE_IDENTIFIER) {
+		free(buffer->declared_size->u.identifier);
+	}
+	free(buffer->declared_size);
+	free(buffer->name);
+	free(buffer);
+}
+
+static void seadragon_parse_free_struct(seadragon_struct_t *structure) {
+	for (unsigned int i = 0; i < structure->fields->length; i += 1) {
+		seadragon_field_t *field = structure->fields->items[i];
+		free(field->name);
+		free(field);
+	}
+	list_free(structure->fields);
+	free(structure->name);
+	free(structure);
+}
+
+void seadragon_parse_free_declaration(seadragon_token_kind_t kind, void *declaration) {
+	switch (kind) {
+	case SEADRAGON_TK_FN:
+		seadragon_parse_free_function(declaration);
+		break;
+	case SEADRAGON_TK_CONST:
+		seadragon_parse_free_constant(declaration);
+		break;
+	case SEADRAGON_TK_BUFFER:
+		seadragon_parse_free_buffer(declaration);
+		break;
+	case SEADRAGON_TK_STRUCT:
+		seadragon_parse_free_struct(declaration);
+		break;
+	default:
+		break;
 	}
+}
 
+void seadragon_parse_init(seadragon_ast_t *ast) {
 	ast->constants = list_create();
 	ast->functions = list_create();
 	ast->structures = list_create();
+	ast->buffers = list_create();
+	ast->modules = list_create();
+	ast->profile = NULL;
+}
 
-	list_t *tokens = list_create();
-	jmp_buf env;
-
-	// The call to setjmp returns zero. Later, a call to longjmp(N) will jump back
-	// to here with a return value of N.
-	if (setjmp(env) == 0) {
-		while(true) {
-			seadragon_token_t *token = malloc(sizeof(seadragon_token_t));
-			*token = seadragon_lexer_next(lexer, SEADRAGON_LEXER_CATEGORY_PARSER);
-			if (token->kind == SEADRAGON_TK_ERROR) {
-				free(token);
-				ERROR("Lexer error encountered");
+void seadragon_parse_free(seadragon_ast_t *ast) {
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_parse_free_function(ast->functions->items[i]);
+	}
+	for (unsigned int i = 0; i < ast->constants->length; i += 1) {
+		seadragon_parse_free_constant(ast->constants->items[i]);
+	}
+	for (unsigned int i = 0; i < ast->buffers->length; i += 1) {
+		seadragon_parse_free_buffer(ast->buffers->items[i]);
+	}
+	for (unsigned int i = 0; i < ast->structures->length; i += 1) {
+		seadragon_parse_free_struct(ast->structures->items[i]);
+	}
+	list_free(ast->structures);
+	list_free(ast->functions);
+	list_free(ast->constants);
+	list_free(ast->buffers);
+	list_free(ast->modules);
+}
+
+bool seadragon_parse_lex(seadragon_session_t *session, seadragon_lexer_t *lexer, list_t *tokens) {
+	while (true) {
+		seadragon_token_t *token = malloc(sizeof(seadragon_token_t));
+		*token = seadragon_lexer_next(lexer, SEADRAGON_LEXER_CATEGORY_PARSER);
+		if (token->kind == SEADRAGON_TK_ERROR) {
+			seadragon_session_error(session, "%s:%u:%u: error: Lexer: Unexpected character '%c' (\\x%.2X)", lexer->fname,
+				token->range.head.line + 1, token->range.head.col + 1, *token->ptr, (unsigned char)*token->ptr);
+			free(token);
+			return false;
+		}
+		list_add(tokens, token);
+		if (token->kind == SEADRAGON_TK_EOF) {
+			return true;
+		}
+	}
+}
+
+bool seadragon_parse_declaration(seadragon_session_t *session, seadragon_ast_t *ast, list_t *tokens, unsigned int *index) {
+	seadragon_token_t *token;
+	NEXT();
+	// FN IDENT LBRACE [IDENT_1...IDENT_N] DDASH [IDENT_1...IDENT_N] RBRACE [INSTRUCTION_1...INSTRUCTION_N] END
+	if (token->kind == SEADRAGON_TK_FN) {
+		NEXT();
+		if (token->kind != SEADRAGON_TK_IDENT) {
+			ERROR("Expected identifier after `fn`");
+		}
+		seadragon_function_t *function = malloc(sizeof(seadragon_function_t));
+		function->autos = list_create();
+		function->inputs = list_create();
+		function->outputs = list_create();
+		function->u.instructions = list_create();
+		function->profiled = false;
+		function->name = seadragon_token_read(*token);
+		// Added right away, so that it is freed along with the rest on failure
+		list_add(ast->functions, function);
+		NEXT();
+		if (token->kind != SEADRAGON_TK_LBRACE) {
+			ERROR("Expected '{' in function declaration");
+		}
+		NEXT();
+		if (token->kind != SEADRAGON_TK_DDASH) {
+			ERROR("TODO: function inputs");
+		}
+		NEXT();
+		while (token->kind != SEADRAGON_TK_RBRACE) {
+			if (token->kind != SEADRAGON_TK_IDENT) {
+				ERROR("Expected identifier for output name");
 			}
-			if (token->kind == SEADRAGON_TK_EOF) {
+			list_add(function->outputs, seadragon_token_read(*token));
+			NEXT();
+		}
+		NEXT();
+		// Nesting depth of if/while, and whether we're inside a condition
+		unsigned int depth = 0;
+		bool condition = false;
+		while (token->kind != SEADRAGON_TK_END || depth) {
+			seadragon_instruction_type_t control = INSTRUCTION_TYPE_PUSH;
+			switch (token->kind) {
+			case SEADRAGON_TK_IF:
+				control = INSTRUCTION_TYPE_IF;
+				break;
+			case SEADRAGON_TK_WHILE:
+				control = INSTRUCTION_TYPE_WHILE;
+				break;
+			case SEADRAGON_TK_RPAREN:
+				if (!condition) {
+					ERROR("Unexpected ')' outside of a condition");
+				}
+				condition = false;
+				control = INSTRUCTION_TYPE_THEN;
+				break;
+			case SEADRAGON_TK_ELSE:
+				if (!depth || condition) {
+					ERROR("Unexpected `else`");
+				}
+				control = INSTRUCTION_TYPE_ELSE;
+				break;
+			case SEADRAGON_TK_END:
+				if (condition) {
+					ERROR("Unexpected `end` in condition");
+				}
+				depth -= 1;
+				control = INSTRUCTION_TYPE_END;
+				break;
+			default:
 				break;
 			}
-			list_add(tokens, token);
-		}
-
-		for (unsigned int i = 0; i < tokens->length; i += 1) {
-			seadragon_token_t *token = tokens->items[i];
-			seadragon_token_dump_simple_DBG(token, 0);
-			printf(" ");
-		}
-		printf("\n");
-		fflush(stdout);
-
-		// FN IDENT LBRACE [IDENT_1...IDENT_N] DDASH [IDENT_1...IDENT_N] RBRACE [INSTRUCTION_1...INSTRUCTION_N] END
-		{
-			unsigned int i = 0;
-			while (i < tokens->length) {
-				seadragon_token_t *token = tokens->items[i];
-				i += 1;
-				if (token->kind == SEADRAGON_TK_FN) {
-					token = tokens->items[i];
-					i += 1;
-					if (token->kind != SEADRAGON_TK_IDENT) {
-						ERROR("Expected identifier after `fn`");
-					}
-					seadragon_function_t *function = malloc(sizeof(seadragon_function_t));
-					function->autos = list_create();
-					function->inputs = list_create();
-					function->outputs = list_create();
-					function->u.instructions = list_create();
-					function->name = seadragon_token_read(*token);
-					token = tokens->items[i];
-					i += 1;
-					if (token->kind != SEADRAGON_TK_LBRACE) {
-						ERROR("Expected '{' in function declaration");
+			if (control != INSTRUCTION_TYPE_PUSH) {
+				if (control == INSTRUCTION_TYPE_IF || control == INSTRUCTION_TYPE_WHILE) {
+					if (condition) {
+						ERROR("Control flow is not allowed in a condition");
 					}
-					token = tokens->items[i];
-					i += 1;
-					if (token->kind != SEADRAGON_TK_DDASH) {
-						ERROR("TODO: function inputs");
+					NEXT();
+					if (token->kind != SEADRAGON_TK_LPAREN) {
+						ERROR("Expected '(' after `if` or `while`");
 					}
-					token = tokens->items[i];
-					i += 1;
-					while (token->kind != SEADRAGON_TK_RBRACE) {
-						if (token->kind != SEADRAGON_TK_IDENT) {
-							ERROR("Expected identifier for output name");
-						}
-						list_add(function->outputs, seadragon_token_read(*token));
-						token = tokens->items[i];
-						i += 1;
-					}
-					token = tokens->items[i];
-					i += 1;
-					while (token->kind != SEADRAGON_TK_END) {
-						if (token->kind == SEADRAGON_TK_AUTO) {
-							token = tokens->items[i];
-							i += 1;
-							if (token->kind != SEADRAGON_TK_IDENT) {
-								ERROR("Expected identifier after 'auto'");
-							}
-							list_add(function->autos, seadragon_token_read(*token));
-
-							token = tokens->items[i];
-							i += 1;
-							continue;
-						}
-						seadragon_instruction_t *instruction = malloc(sizeof(seadragon_instruction_t));
-						instruction->argument = NULL;
-						switch (token->kind) {
-						case SEADRAGON_TK_INTEGER:
-							instruction->argument = malloc(sizeof(seadragon_value_t));
-							instruction->type = INSTRUCTION_TYPE_PUSH;
-							instruction->argument->type = VALUE_TYPE_LITERAL;
-							uint64_t val = seadragon_token_read_number(*token);
-							if (val > UINT32_MAX) {
-								ERROR("Integer literal does not fit into 32 bits");
-							}
-							instruction->argument->u.literal = (uint32_t)val;
-							break;
-						case SEADRAGON_TK_IDENT:
-							instruction->argument = malloc(sizeof(seadragon_value_t));
-							instruction->type = INSTRUCTION_TYPE_PUSH;
-							instruction->argument->type = VALUE_TYPE_IDENTIFIER;
-							instruction->argument->u.identifier = seadragon_token_read(*token);
-							break;
-						case SEADRAGON_TK_SLONG:
-							instruction->type = INSTRUCTION_TYPE_SLONG;
-							break;
-						case SEADRAGON_TK_GLONG:
-							instruction->type = INSTRUCTION_TYPE_GLONG;
-							break;
-						case SEADRAGON_TK_SINT:
-							instruction->type = INSTRUCTION_TYPE_SINT;
-							break;
-						case SEADRAGON_TK_GINT:
-							instruction->type = INSTRUCTION_TYPE_GINT;
-							break;
-						case SEADRAGON_TK_SBYTE:
-							instruction->type = INSTRUCTION_TYPE_SBYTE;
-							break;
-						case SEADRAGON_TK_GBYTE:
-							instruction->type = INSTRUCTION_TYPE_GBYTE;
-							break;
-						case SEADRAGON_TK_DROP:
-							instruction->type = INSTRUCTION_TYPE_DROP;
-							break;
-						case SEADRAGON_TK_SUB:
-							instruction->type = INSTRUCTION_TYPE_SUB;
-							break;
-						default:
-							ERRORF("TODO: function instruction '%s'", seadragon_token_kind_tostr_DBG(token->kind));
-						}
-						list_add(function->u.instructions, instruction);
-						token = tokens->items[i];
-						i += 1;
-					}
-					list_add(ast->functions, function);
+					depth += 1;
+					condition = true;
 				}
-				else {
-					ERROR("Unknown pattern");
+				seadragon_instruction_t *instruction = malloc(sizeof(seadragon_instruction_t));
+				instruction->type = control;
+				instruction->argument = NULL;
+				list_add(function->u.instructions, instruction);
+				NEXT();
+				continue;
+			}
+			if (token->kind == SEADRAGON_TK_AUTO) {
+				NEXT();
+				if (token->kind != SEADRAGON_TK_IDENT) {
+					ERROR("Expected identifier after 'auto'");
 				}
+				list_add(function->autos, seadragon_token_read(*token));
+
+				NEXT();
+				continue;
+			}
+			seadragon_instruction_t *instruction;
+			if (!seadragon_parse_instruction(session, token, &instruction)) {
+				return false;
 			}
+			if (!instruction) {
+				ERRORF("TODO: function instruction '%s'", seadragon_token_kind_tostr_DBG(token->kind));
+			}
+			list_add(function->u.instructions, instruction);
+			NEXT();
 		}
 	}
-	else {
-		for (unsigned int i = 0; i < tokens->length; i += 1) {
-			free(tokens->items[i]);
+	// CONST IDENT (INTEGER | IDENT | LPAREN [INSTRUCTION_1...INSTRUCTION_N] RPAREN)
+	else if (token->kind == SEADRAGON_TK_CONST) {
+		NEXT();
+		if (token->kind != SEADRAGON_TK_IDENT) {
+			ERROR("Expected identifier after `const`");
+		}
+		seadragon_constant_t *constant = malloc(sizeof(seadragon_constant_t));
+		constant->name = seadragon_token_read(*token);
+		constant->expression = list_create();
+		constant->value = 0;
+		constant->state = CONSTANT_UNEVALUATED;
+		list_add(ast->constants, constant);
+		NEXT();
+		if (token->kind != SEADRAGON_TK_LPAREN) {
+			seadragon_instruction_t *instruction;
+			if (!seadragon_parse_instruction(session, token, &instruction)) {
+				return false;
+			}
+			if (!instruction || instruction->type != INSTRUCTION_TYPE_PUSH) {
+				free(instruction);
+				ERROR("Expected value or '(' in constant declaration");
+			}
+			list_add(constant->expression, instruction);
+			return true;
+		}
+		NEXT();
+		while (token->kind != SEADRAGON_TK_RPAREN) {
+			seadragon_instruction_t *instruction;
+			if (!seadragon_parse_instruction(session, token, &instruction)) {
+				return false;
+			}
+			if (!instruction) {
+				ERRORF("Unexpected '%s' in constant expression", seadragon_token_kind_tostr_DBG(token->kind));
+			}
+			list_add(constant->expression, instruction);
+			NEXT();
+		}
+	}
+	// BUFFER IDENT (INTEGER | IDENT)
+	else if (token->kind == SEADRAGON_TK_BUFFER) {
+		NEXT();
+		if (token->kind != SEADRAGON_TK_IDENT) {
+			ERROR("Expected identifier after `buffer`");
+		}
+		seadragon_buffer_t *buffer = malloc(sizeof(seadragon_buffer_t));
+		buffer->name = seadragon_token_read(*token);
+		buffer->declared_size = NULL;
+		buffer->size = 0;
+		buffer->alignment = 1;
+		list_add(ast->buffers, buffer);
+		NEXT();
+		seadragon_instruction_t *instruction;
+		if (!seadragon_parse_instruction(session, token, &instruction)) {
+			return false;
 		}
-		list_free(tokens);
-		list_free(ast->structures);
-		list_free(ast->functions);
-		list_free(ast->constants);
+		if (!instruction || instruction->type != INSTRUCTION_TYPE_PUSH) {
+			free(instruction);
+			ERROR("Expected size in buffer declaration");
+		}
+		buffer->declared_size = instruction->argument;
+		free(instruction);
+	}
+	// STRUCT IDENT [reorder] [INTEGER_1 IDENT_1...INTEGER_N IDENT_N] ENDSTRUCT
+	else if (token->kind == SEADRAGON_TK_STRUCT) {
+		NEXT();
+		if (token->kind != SEADRAGON_TK_IDENT) {
+			ERROR("Expected identifier after `struct`");
+		}
+		seadragon_struct_t *structure = malloc(sizeof(seadragon_struct_t));
+		structure->name = seadragon_token_read(*token);
+		structure->fields = list_create();
+		structure->size = 0;
+		structure->alignment = 1;
+		structure->reorder = false;
+		list_add(ast->structures, structure);
+		NEXT();
+		if (token->kind == SEADRAGON_TK_IDENT) {
+			char *attribute = seadragon_token_read(*token);
+			bool known = !strcmp(attribute, "reorder");
+			free(attribute);
+			if (!known) {
+				ERROR("Unknown structure attribute");
+			}
+			structure->reorder = true;
+			NEXT();
+		}
+		while (token->kind != SEADRAGON_TK_ENDSTRUCT) {
+			if (token->kind != SEADRAGON_TK_INTEGER) {
+				ERROR("Expected field size in structure");
+			}
+			uint64_t size = seadragon_token_read_number(*token);
+			if (size == 0 || size > UINT32_MAX) {
+				ERROR("Invalid structure field size");
+			}
+			NEXT();
+			if (token->kind != SEADRAGON_TK_IDENT) {
+				ERROR("Expected identifier for field name");
+			}
+			seadragon_field_t *field = malloc(sizeof(seadragon_field_t));
+			field->name = seadragon_token_read(*token);
+			field->size = (uint32_t)size;
+			field->alignment = 1;
+			field->offset = 0;
+			field->uses = 0;
+			field->signature = 0;
+			list_add(structure->fields, field);
+			NEXT();
+		}
+	}
+	else {
+		ERROR("Unknown pattern");
+	}
+	return true;
+}
+
+seadragon_ast_t *seadragon_parse(seadragon_session_t *session, seadragon_ast_t *ast, seadragon_lexer_t *lexer) {
+	if (!ast) {
 		return NULL;
 	}
 
+	seadragon_parse_init(ast);
+	list_t *tokens = list_create();
+	bool success = seadragon_parse_lex(session, lexer, tokens);
+	unsigned int index = 0;
+	while (success && index + 1 < tokens->length) {
+		success = seadragon_parse_declaration(session, ast, tokens, &index);
+	}
+
 	for (unsigned int i = 0; i < tokens->length; i += 1) {
-		seadragon_token_t *token = tokens->items[i];
-		free(token);
+		free(tokens->items[i]);
 	}
 	list_free(tokens);
-
+	if (!success) {
+		seadragon_parse_free(ast);
+		return NULL;
+	}
 	return ast;
 }
-
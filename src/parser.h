@@ -2,8 +2,29 @@
 #define SEADRAGON_PARSER_H_
 
 #include "ast.h"
+#include "session.h"
 
-seadragon_ast_t *seadragon_parse(seadragon_ast_t *ast, seadragon_lexer_t *lexer);
+/// Parses everything the lexer reads into ast, or returns NULL, having freed
+/// whatever was parsed, on error.
+seadragon_ast_t *seadragon_parse(seadragon_session_t *session, seadragon_ast_t *ast, seadragon_lexer_t *lexer);
+
+/// The pieces of seadragon_parse, for parsing a source a declaration at a
+/// time.
+
+/// Reads every token the lexer produces into tokens, up to and including the
+/// EOF token. The caller frees the tokens, including on failure.
+bool seadragon_parse_lex(seadragon_session_t *session, seadragon_lexer_t *lexer, list_t *tokens);
+/// Creates the empty lists of an ast.
+void seadragon_parse_init(seadragon_ast_t *ast);
+/// Parses the top-level declaration starting at tokens->items[*index] into
+/// ast, and advances *index past it. tokens must end with the EOF token. On
+/// failure *index is left just past the offending token, or at the EOF token
+/// if the input ended first, and what was parsed remains in ast.
+bool seadragon_parse_declaration(seadragon_session_t *session, seadragon_ast_t *ast, list_t *tokens, unsigned int *index);
+/// Frees a declaration the parser created, given the keyword it starts with.
+void seadragon_parse_free_declaration(seadragon_token_kind_t kind, void *declaration);
+/// Frees every declaration in ast, and its lists.
+void seadragon_parse_free(seadragon_ast_t *ast);
 
 #endif
 
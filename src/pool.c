@@ -0,0 +1,111 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct seadragon_pool {
+	pthread_mutex_t lock;
+	/// Signalled when a batch starts or the pool stops, and when the last job
+	/// of a batch finishes
+	pthread_cond_t wake, done;
+	pthread_t *workers;
+	unsigned int worker_count;
+	void (*job)(void *context, unsigned int index);
+	void *context;
+	/// Next job to start, number of jobs, and jobs finished in the batch
+	unsigned int next, count, finished;
+	bool stop;
+};
+
+/// Runs jobs of the current batch until none are left. Called with the lock
+/// held, and returns with it held.
+static void seadragon_pool_work(seadragon_pool_t *pool) {
+	while (pool->job && pool->next < pool->count) {
+		unsigned int index = pool->next;
+		pool->next += 1;
+		pthread_mutex_unlock(&pool->lock);
+		pool->job(pool->context, index);
+		pthread_mutex_lock(&pool->lock);
+		pool->finished += 1;
+		if (pool->finished == pool->count) {
+			pthread_cond_broadcast(&pool->done);
+		}
+	}
+}
+
+static void *seadragon_pool_worker(void *_pool) {
+	seadragon_pool_t *pool = _pool;
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		seadragon_pool_work(pool);
+		if (!pool->stop) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+seadragon_pool_t *seadragon_pool_create(unsigned int threads) {
+	if (!threads) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? online : 1;
+	}
+	seadragon_pool_t *pool = malloc(sizeof(seadragon_pool_t));
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->job = NULL;
+	pool->context = NULL;
+	pool->next = pool->count = pool->finished = 0;
+	pool->stop = false;
+	pool->workers = malloc(sizeof(pthread_t) * threads);
+	pool->worker_count = 0;
+	for (unsigned int i = 0; i + 1 < threads; i += 1) {
+		if (pthread_create(&pool->workers[pool->worker_count], NULL, seadragon_pool_worker, pool)) {
+			// Fewer workers only means less parallelism
+			break;
+		}
+		pool->worker_count += 1;
+	}
+	return pool;
+}
+
+void seadragon_pool_destroy(seadragon_pool_t *pool) {
+	if (!pool) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (unsigned int i = 0; i < pool->worker_count; i += 1) {
+		pthread_join(pool->workers[i], NULL);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+void seadragon_pool_run(seadragon_pool_t *pool, unsigned int count, void (*job)(void *context, unsigned int index), void *context) {
+	if (!count) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->job = job;
+	pool->context = context;
+	pool->next = 0;
+	pool->count = count;
+	pool->finished = 0;
+	pthread_cond_broadcast(&pool->wake);
+	seadragon_pool_work(pool);
+	while (pool->finished < pool->count) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pool->job = NULL;
+	pthread_mutex_unlock(&pool->lock);
+}
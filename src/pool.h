@@ -0,0 +1,17 @@
+#ifndef SEADRAGON_POOL_H_
+#define SEADRAGON_POOL_H_
+
+/// A fixed set of worker threads, kept alive between batches of jobs.
+typedef struct seadragon_pool seadragon_pool_t;
+
+/// Starts threads - 1 workers; the thread calling seadragon_pool_run is the
+/// last one. 0 uses one thread per online processor.
+seadragon_pool_t *seadragon_pool_create(unsigned int threads);
+void seadragon_pool_destroy(seadragon_pool_t *pool);
+
+/// Calls job(context, i) for every i < count, spread over the pool, and
+/// returns once all calls have returned. Jobs start in index order. Only one
+/// batch may run on a pool at a time.
+void seadragon_pool_run(seadragon_pool_t *pool, unsigned int count, void (*job)(void *context, unsigned int index), void *context);
+
+#endif // SEADRAGON_POOL_H_
@@ -0,0 +1,174 @@
+#include "profile.h"
+#include "ir.h"
+#include "layout.h"
+#include "map.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	char *name;
+	/// Indexed by block id; blocks past the end never ran
+	uint64_t *counts;
+	unsigned int length;
+} seadragon_profile_function_t;
+
+struct seadragon_profile {
+	/// Function name to seadragon_profile_function_t
+	map_t *functions;
+	list_t *list;
+};
+
+bool seadragon_profile_instrument(seadragon_ast_t *ast, FILE *map) {
+	seadragon_buffer_t *counters = malloc(sizeof(seadragon_buffer_t));
+	counters->name = strdup(SEADRAGON_PROFILE_COUNTERS);
+	counters->declared_size = NULL;
+	uint32_t index = 0;
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_function_t *func = ast->functions->items[i];
+		for (unsigned int j = 0; j < func->u.blocks->length; j += 1) {
+			seadragon_block_t *block = func->u.blocks->items[j];
+			seadragon_ir_pool_t *pool = &func->pool;
+			uint32_t address = seadragon_ir_node(pool, OPERATION_ADD, seadragon_ir_buffer(pool, counters), seadragon_ir_literal(pool, index * 4));
+			uint32_t load = seadragon_ir_node(pool, OPERATION_GLONG, seadragon_ir_clone(pool, address), SEADRAGON_IR_NONE);
+			uint32_t increment = seadragon_ir_node(pool, OPERATION_ADD, load, seadragon_ir_literal(pool, 1));
+			seadragon_ir_insert(block, 0, seadragon_ir_node(pool, OPERATION_SLONG, address, increment));
+			fprintf(map, "%s %u %" PRIu32 "\n", func->name, block->id, index);
+			index += 1;
+		}
+		seadragon_ir_linearize(func);
+	}
+	if (!index) {
+		free(counters->name);
+		free(counters);
+		return !ferror(map);
+	}
+	counters->size = index * 4;
+	list_add(ast->buffers, counters);
+	seadragon_layout_buffers(ast->buffers);
+	return !ferror(map);
+}
+
+/// Reads a `NAME ID NUMBER` line, skipping comments. Returns the name, which
+/// points into line, or NULL at the end or on a malformed line.
+static char *seadragon_profile_line(FILE *in, char **line, size_t *size, unsigned int *id, uint64_t *number, bool *malformed) {
+	while (getline(line, size, in) >= 0) {
+		if (**line == '#' || **line == '\n') {
+			continue;
+		}
+		char *space = strchr(*line, ' ');
+		int end = 0;
+		if (!space || space == *line || sscanf(space, " %u %" SCNu64 " %n", id, number, &end) != 2 || space[end]) {
+			*malformed = true;
+			return NULL;
+		}
+		*space = 0;
+		return *line;
+	}
+	return NULL;
+}
+
+bool seadragon_profile_dump(FILE *map, const uint32_t *counters, size_t count, FILE *out) {
+	char *line = NULL, *name;
+	size_t size = 0;
+	unsigned int id;
+	uint64_t index;
+	bool malformed = false;
+	fprintf(out, "# seadragon profile\n");
+	while ((name = seadragon_profile_line(map, &line, &size, &id, &index, &malformed))) {
+		if (index >= count) {
+			fprintf(stderr, "error: Profile: Counter %" PRIu64 " of `%s` is past the end of the dump\n", index, name);
+			malformed = true;
+			break;
+		}
+		fprintf(out, "%s %u %" PRIu32 "\n", name, id, counters[index]);
+	}
+	free(line);
+	return !malformed && !ferror(out);
+}
+
+seadragon_profile_t *seadragon_profile_read(FILE *in) {
+	seadragon_profile_t *profile = malloc(sizeof(seadragon_profile_t));
+	profile->functions = map_create();
+	profile->list = list_create();
+	char *line = NULL, *name;
+	size_t size = 0;
+	unsigned int id;
+	uint64_t count;
+	bool malformed = false;
+	while ((name = seadragon_profile_line(in, &line, &size, &id, &count, &malformed))) {
+		seadragon_profile_function_t *func = map_get(profile->functions, name);
+		if (!func) {
+			func = calloc(1, sizeof(seadragon_profile_function_t));
+			func->name = strdup(name);
+			map_set(profile->functions, func->name, func);
+			list_add(profile->list, func);
+		}
+		if (id >= func->length) {
+			func->counts = realloc(func->counts, (id + 1) * sizeof(uint64_t));
+			memset(&func->counts[func->length], 0, (id + 1 - func->length) * sizeof(uint64_t));
+			func->length = id + 1;
+		}
+		func->counts[id] += count;
+	}
+	free(line);
+	if (malformed) {
+		fprintf(stderr, "error: Profile: Malformed line\n");
+		seadragon_profile_free(profile);
+		return NULL;
+	}
+	return profile;
+}
+
+void seadragon_profile_free(seadragon_profile_t *profile) {
+	for (unsigned int i = 0; i < profile->list->length; i += 1) {
+		seadragon_profile_function_t *func = profile->list->items[i];
+		free(func->name);
+		free(func->counts);
+		free(func);
+	}
+	list_free(profile->list);
+	map_free(profile->functions);
+	free(profile);
+}
+
+static bool seadragon_profile_ran(seadragon_profile_function_t *func) {
+	for (unsigned int i = 0; i < func->length; i += 1) {
+		if (func->counts[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void seadragon_profile_apply(seadragon_profile_t *profile, seadragon_function_t *func) {
+	seadragon_profile_function_t *counts = map_get(profile->functions, func->name);
+	if (!counts || !seadragon_profile_ran(counts)) {
+		return;
+	}
+	for (unsigned int i = 0; i < func->u.blocks->length; i += 1) {
+		seadragon_block_t *block = func->u.blocks->items[i];
+		block->count = block->id < counts->length ? counts->counts[block->id] : 0;
+	}
+	func->profiled = true;
+}
+
+void seadragon_profile_order(seadragon_profile_t *profile, seadragon_ast_t *ast) {
+	list_t *cold = list_create();
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_function_t *func = ast->functions->items[i];
+		seadragon_profile_function_t *counts = map_get(profile->functions, func->name);
+		if (counts && !seadragon_profile_ran(counts)) {
+			list_add(cold, func);
+		}
+		else {
+			ast->functions->items[kept] = func;
+			kept += 1;
+		}
+	}
+	ast->functions->length = kept;
+	list_cat(ast->functions, cold);
+	list_free(cold);
+}
@@ -0,0 +1,46 @@
+#ifndef SEADRAGON_PROFILE_H_
+#define SEADRAGON_PROFILE_H_
+
+#include "ast.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Profile-guided optimization. An instrumented build counts the runs of each
+/// block in a buffer; whatever runs it (a simulator, or a harness on the
+/// target) dumps that buffer, and seadragon_profile_dump turns the dump into a
+/// profile, which a later compile of the same source optimizes for.
+///
+/// Counter maps and profiles are text, one block per line:
+/// `FUNCTION BLOCK INDEX` and `FUNCTION BLOCK COUNT` respectively, where BLOCK
+/// is the block's id. Lines starting with `#` are ignored.
+
+/// The buffer holding the counters: one 32-bit word per block, in map order.
+#define SEADRAGON_PROFILE_COUNTERS "__profile_counters"
+
+/// Adds a counter increment to the start of every block of every function,
+/// and the counters buffer, and writes the counter map. The ast must have
+/// passed sema, and not codegen.
+bool seadragon_profile_instrument(seadragon_ast_t *ast, FILE *map);
+
+/// Writes the profile of a run, given the counter map of the build and the
+/// contents of its counters buffer afterwards.
+bool seadragon_profile_dump(FILE *map, const uint32_t *counters, size_t count, FILE *out);
+
+/// Reads a profile; counts for the same block are summed, so profiles of
+/// several runs may simply be concatenated. Returns NULL on a malformed line.
+seadragon_profile_t *seadragon_profile_read(FILE *in);
+void seadragon_profile_free(seadragon_profile_t *profile);
+
+/// Copies the counts of the profile into func's blocks and marks it
+/// profiled, unless the profile has no record of it running. Block ids must
+/// match those of the instrumented build, so this runs right before layout.
+void seadragon_profile_apply(seadragon_profile_t *profile, seadragon_function_t *func);
+
+/// Moves the functions that the profile shows never ran after all the others,
+/// keeping the hot code together. Functions it does not know stay in place.
+void seadragon_profile_order(seadragon_profile_t *profile, seadragon_ast_t *ast);
+
+#endif // SEADRAGON_PROFILE_H_
@@ -1,68 +1,559 @@
 #include "sema.h"
+#include "layout.h"
 #include "list.h"
+#include "map.h"
+#include "cfg.h"
+#include "ir.h"
+#include "loop.h"
+#include "memops.h"
+#include "module.h"
+#include "profile.h"
 #include "ast.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define ERROR(msg) do { fprintf(stderr, "%s:%d: error: Sema: %s\n", __FILE__, __LINE__, msg); list_free(value_stack); list_free(instructions); return false; } while(0);
+#define ERROR(msg) do { seadragon_session_error(ctx->session, "%s:%d: error: Sema: %s", __FILE__, __LINE__, msg); list_free(value_stack); list_free(frames); list_free(instructions); return false; } while(0);
 
-bool seadragon_sema(seadragon_ast_t *ast) {
-	if (!ast) {
+/// The value stack holds node indices.
+static void seadragon_sema_push(list_t *value_stack, uint32_t node) {
+	list_add(value_stack, (void*)(uintptr_t)node);
+}
+
+static uint32_t seadragon_sema_pop(list_t *value_stack) {
+	return (uintptr_t)list_pop(value_stack);
+}
+
+/// An open `if` or `while`.
+typedef struct {
+	/// The block ending in the conditional branch, once the condition is known
+	seadragon_block_t *branch;
+	/// The loop header for `while`, NULL for `if`
+	seadragon_block_t *header;
+	/// Where control continues after `end`
+	seadragon_block_t *join;
+	bool has_else;
+} seadragon_sema_frame_t;
+
+/// Evaluates a binary operation on literals. Returns false if the operation
+/// cannot be folded (division by zero).
+static bool seadragon_sema_fold(seadragon_operation_t op, uint32_t a, uint32_t b, uint32_t *result) {
+	switch (op) {
+	case OPERATION_ADD: *result = a + b; return true;
+	case OPERATION_SUB: *result = a - b; return true;
+	case OPERATION_MUL: *result = a * b; return true;
+	case OPERATION_DIV:
+		if (!b) {
+			return false;
+		}
+		*result = a / b;
+		return true;
+	case OPERATION_AND: *result = a & b; return true;
+	case OPERATION_OR: *result = a | b; return true;
+	case OPERATION_LSH: *result = b >= 32 ? 0 : a << b; return true;
+	case OPERATION_RSH: *result = b >= 32 ? 0 : a >> b; return true;
+	case OPERATION_CLT: *result = a < b; return true;
+	case OPERATION_CGT: *result = a > b; return true;
+	case OPERATION_CLE: *result = a <= b; return true;
+	case OPERATION_CGE: *result = a >= b; return true;
+	case OPERATION_EQ: *result = a == b; return true;
+	case OPERATION_NE: *result = a != b; return true;
+	default:
 		return false;
 	}
+}
+
+static seadragon_operation_t seadragon_sema_arith_op(seadragon_instruction_type_t type) {
+	switch (type) {
+	case INSTRUCTION_TYPE_ADD: return OPERATION_ADD;
+	case INSTRUCTION_TYPE_SUB: return OPERATION_SUB;
+	case INSTRUCTION_TYPE_MUL: return OPERATION_MUL;
+	case INSTRUCTION_TYPE_DIV: return OPERATION_DIV;
+	case INSTRUCTION_TYPE_AND: return OPERATION_AND;
+	case INSTRUCTION_TYPE_OR: return OPERATION_OR;
+	case INSTRUCTION_TYPE_LSH: return OPERATION_LSH;
+	case INSTRUCTION_TYPE_RSH: return OPERATION_RSH;
+	case INSTRUCTION_TYPE_CLT: return OPERATION_CLT;
+	case INSTRUCTION_TYPE_CGT: return OPERATION_CGT;
+	case INSTRUCTION_TYPE_CLE: return OPERATION_CLE;
+	case INSTRUCTION_TYPE_CGE: return OPERATION_CGE;
+	case INSTRUCTION_TYPE_EQ: return OPERATION_EQ;
+	case INSTRUCTION_TYPE_NE: return OPERATION_NE;
+	default: return OPERATION_NONE;
+	}
+}
+
+/// Builds an arithmetic node, folding literal operands and reassociating
+/// (x + a) + b into x + (a + b), so that address computations end up in
+/// base + displacement form. Multiplication and division by powers of two
+/// become shifts.
+static uint32_t seadragon_sema_arith(seadragon_ir_pool_t *pool, seadragon_operation_t op, uint32_t left, uint32_t right) {
+	uint32_t a, b, result;
+	bool commutative = op == OPERATION_ADD || op == OPERATION_MUL || op == OPERATION_AND || op == OPERATION_OR
+		|| op == OPERATION_EQ || op == OPERATION_NE;
+	if (commutative && seadragon_ir_is_literal(pool, left, NULL) && !seadragon_ir_is_literal(pool, right, NULL)) {
+		uint32_t tmp = left;
+		left = right;
+		right = tmp;
+	}
+	if (seadragon_ir_is_literal(pool, left, &a) && seadragon_ir_is_literal(pool, right, &b) && seadragon_sema_fold(op, a, b, &result)) {
+		pool->value[left].u.literal = result;
+		return left;
+	}
+	if (op == OPERATION_ADD && seadragon_ir_is_literal(pool, right, &b)) {
+		if (b == 0) {
+			return left;
+		}
+		if (pool->op[left] == OPERATION_ADD && seadragon_ir_is_literal(pool, pool->right[left], &a)) {
+			pool->value[pool->right[left]].u.literal = a + b;
+			return left;
+		}
+	}
+	if (seadragon_ir_is_literal(pool, right, &b)) {
+		// Identities, and multiplication / division by powers of two as shifts
+		bool identity = ((op == OPERATION_MUL || op == OPERATION_DIV) && b == 1)
+			|| ((op == OPERATION_OR || op == OPERATION_LSH || op == OPERATION_RSH || op == OPERATION_SUB) && b == 0)
+			|| (op == OPERATION_AND && b == UINT32_MAX);
+		if (identity) {
+			return left;
+		}
+		if ((op == OPERATION_MUL || op == OPERATION_DIV) && b && !(b & (b - 1))) {
+			uint32_t shift = 0;
+			while (!(b & (1u << shift))) {
+				shift += 1;
+			}
+			pool->value[right].u.literal = shift;
+			return seadragon_sema_arith(pool, op == OPERATION_MUL ? OPERATION_LSH : OPERATION_RSH, left, right);
+		}
+		// (x >> k) << k and (x << k) >> k only clear bits, e.g. `x 8 / 8 *`
+		if ((op == OPERATION_LSH || op == OPERATION_RSH) && b < 32
+				&& pool->op[left] == (op == OPERATION_LSH ? OPERATION_RSH : OPERATION_LSH)
+				&& seadragon_ir_is_literal(pool, pool->right[left], &a) && a == b) {
+			pool->op[left] = OPERATION_AND;
+			pool->value[pool->right[left]].u.literal = op == OPERATION_LSH ? UINT32_MAX << b : UINT32_MAX >> b;
+			return left;
+		}
+	}
+	return seadragon_ir_node(pool, op, left, right);
+}
+
+/// Returns the declaration of a variable, or NULL if identifier names none.
+static char *seadragon_sema_variable(seadragon_function_t *func, const char *identifier) {
+	list_t *lists[] = { func->inputs, func->outputs, func->autos };
+	for (unsigned int i = 0; i < sizeof(lists) / sizeof(*lists); i += 1) {
+		for (unsigned int j = 0; j < lists[i]->length; j += 1) {
+			if (!strcmp(lists[i]->items[j], identifier)) {
+				return lists[i]->items[j];
+			}
+		}
+	}
+	return NULL;
+}
+
+/// Stack values are only evaluated where they are used, so before a store to
+/// target, those it would change are saved into temporaries: values reading
+/// the variable stored to, or for stores to memory, values loading from it.
+static void seadragon_sema_spill(seadragon_function_t *func, seadragon_block_t *block, list_t *value_stack, uint32_t target) {
+	seadragon_ir_pool_t *pool = &func->pool;
+	char *name = NULL;
+	seadragon_ir_is_location(pool, target, &name);
+	for (unsigned int i = 0; i < value_stack->length; i += 1) {
+		uint32_t value = (uintptr_t)value_stack->items[i];
+		if (name ? !seadragon_ir_reads(pool, value, name) : !seadragon_ir_loads(pool, value)) {
+			continue;
+		}
+		// `$` can't appear in source identifiers
+		char *temporary = malloc(16);
+		snprintf(temporary, 16, "$%u", func->autos->length);
+		list_add(func->autos, temporary);
+		seadragon_ir_insert(block, block->statement_count, seadragon_ir_assign(pool, temporary, value));
+		value_stack->items[i] = (void*)(uintptr_t)seadragon_ir_read(pool, temporary);
+	}
+}
+
+/// Records which structure fields each function references, so that layout can
+/// group fields that are accessed together.
+static void seadragon_sema_field_usage(seadragon_ast_t *ast) {
+	list_t *seen = list_create();
 	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
 		seadragon_function_t *func = ast->functions->items[i];
-		list_t *instructions = func->u.instructions;
-		// list of seadragon_value_t
-		list_t *value_stack = list_create();
-		list_t *active_nodes = list_create();
-		list_add(active_nodes, &func->u.root);
-		func->u.root.op = OPERATION_NONE;
-		func->u.root.left = func->u.root.right = NULL;
-		for (unsigned int i = 0; i < instructions->length; i += 1) {
-			seadragon_instruction_t *instruction = instructions->items[i];
-			seadragon_instruction_node_t *current = list_last(active_nodes);
-			if (!current) {
-				ERROR("Internal error: no active node");
-			}
-			if (current->op != OPERATION_NONE) {
-				ERROR("TODO: append leaves to nodes");
-			}
-			seadragon_instruction_node_t *target = current;
-			switch (instruction->type) {
-			case INSTRUCTION_TYPE_PUSH:
-				list_add(value_stack, instruction->argument);
-				break;
-			case INSTRUCTION_TYPE_SLONG:{
-				seadragon_value_t *lhs = list_pop(value_stack);
-				seadragon_value_t *rhs = list_pop(value_stack);
-				if (rhs->type != VALUE_TYPE_LITERAL) {
-					ERROR("TODO: slong nonliteral value");
-				}
-				switch (lhs->type) {
-				case VALUE_TYPE_IDENTIFIER:{
-					target->op = OPERATION_SLONG;
-					target->left = malloc(sizeof(seadragon_instruction_leaf_t));
-					target->right = malloc(sizeof(seadragon_instruction_leaf_t));
-					target->left->type = LEAF_VALUE;
-					target->left->u.value = lhs;
-					target->right->type = LEAF_VALUE;
-					target->right->u.value = rhs;
+		seen->length = 0;
+		for (unsigned int j = 0; j < func->u.instructions->length; j += 1) {
+			seadragon_instruction_t *instruction = func->u.instructions->items[j];
+			if (instruction->type != INSTRUCTION_TYPE_PUSH || instruction->argument->type != VALUE_TYPE_IDENTIFIER) {
+				continue;
+			}
+			uint32_t offset;
+			seadragon_field_t *field;
+			if (!seadragon_layout_lookup(ast->structures, instruction->argument->u.identifier, &offset, &field) || !field) {
+				continue;
+			}
+			field->uses += 1;
+			bool known = false;
+			for (unsigned int k = 0; k < seen->length && !known; k += 1) {
+				known = seen->items[k] == field;
+			}
+			if (!known) {
+				list_add(seen, field);
+				// FNV-1a over the indices of the functions using the field
+				if (!field->signature) {
+					field->signature = 14695981039346656037ULL;
 				}
-					break;
-				case VALUE_TYPE_LITERAL:
-					ERROR("TODO slong literal");
-				default:
-					ERROR("TODO: slong non-identifier");
+				field->signature = (field->signature ^ (i + 1)) * 1099511628211ULL;
+			}
+		}
+	}
+	list_free(seen);
+}
+
+static bool seadragon_sema_constant(seadragon_sema_ctx_t *ctx, seadragon_constant_t *constant);
+
+/// Resolves an identifier that is not a variable to its compile-time value:
+/// a constant, or a structure field offset or size, declared locally or in a
+/// precompiled module.
+static bool seadragon_sema_resolve(seadragon_sema_ctx_t *ctx, const char *identifier, uint32_t *value) {
+	seadragon_ast_t *ast = ctx->ast;
+	seadragon_constant_t *constant = map_get(ctx->constants, identifier);
+	if (constant) {
+		if (!seadragon_sema_constant(ctx, constant)) {
+			return false;
+		}
+		*value = constant->value;
+		return true;
+	}
+	if (seadragon_layout_lookup(ast->structures, identifier, value, NULL)) {
+		return true;
+	}
+	for (unsigned int i = 0; i < ast->modules->length; i += 1) {
+		if (seadragon_module_lookup(ast->modules->items[i], identifier, value)) {
+			return true;
+		}
+	}
+	seadragon_session_error(ctx->session, "%s:%d: error: Sema: Unknown identifier `%s`", __FILE__, __LINE__, identifier);
+	return false;
+}
+
+#define ERROR_CONSTANT(msg) do { seadragon_session_error(ctx->session, "%s:%d: error: Sema: %s in constant `%s`", __FILE__, __LINE__, msg, constant->name); free(stack); return false; } while(0);
+
+/// Evaluates a constant's expression on first use, recursing into the
+/// constants it references.
+static bool seadragon_sema_constant(seadragon_sema_ctx_t *ctx, seadragon_constant_t *constant) {
+	if (constant->state == CONSTANT_EVALUATED) {
+		return true;
+	}
+	uint32_t *stack = NULL;
+	if (constant->state == CONSTANT_EVALUATING) {
+		ERROR_CONSTANT("Circular definition");
+	}
+	constant->state = CONSTANT_EVALUATING;
+	stack = malloc(sizeof(uint32_t) * (constant->expression->length + 1));
+	unsigned int depth = 0;
+	for (unsigned int i = 0; i < constant->expression->length; i += 1) {
+		seadragon_instruction_t *instruction = constant->expression->items[i];
+		if (instruction->type == INSTRUCTION_TYPE_PUSH) {
+			if (instruction->argument->type == VALUE_TYPE_LITERAL) {
+				stack[depth] = instruction->argument->u.literal;
+			}
+			else if (!seadragon_sema_resolve(ctx, instruction->argument->u.identifier, &stack[depth])) {
+				ERROR_CONSTANT("Unresolvable value");
+			}
+			depth += 1;
+			continue;
+		}
+		seadragon_operation_t op = seadragon_sema_arith_op(instruction->type);
+		if (op == OPERATION_NONE) {
+			ERROR_CONSTANT("Only arithmetic is allowed");
+		}
+		if (depth < 2) {
+			ERROR_CONSTANT("Stack underflow");
+		}
+		depth -= 1;
+		if (!seadragon_sema_fold(op, stack[depth - 1], stack[depth], &stack[depth - 1])) {
+			ERROR_CONSTANT("Division by zero");
+		}
+	}
+	if (depth != 1) {
+		ERROR_CONSTANT("Expression must produce exactly one value");
+	}
+	constant->value = stack[0];
+	constant->state = CONSTANT_EVALUATED;
+	free(stack);
+	return true;
+}
+
+void seadragon_sema_init(seadragon_sema_ctx_t *ctx, seadragon_session_t *session, seadragon_ast_t *ast) {
+	ctx->session = session;
+	ctx->ast = ast;
+	ctx->constants = map_create();
+	ctx->buffers = map_create();
+	ctx->structures_checked = ctx->constants_checked = ctx->buffers_checked = 0;
+}
+
+void seadragon_sema_deinit(seadragon_sema_ctx_t *ctx) {
+	map_free(ctx->constants);
+	map_free(ctx->buffers);
+}
+
+bool seadragon_sema_declarations(seadragon_sema_ctx_t *ctx) {
+	seadragon_ast_t *ast = ctx->ast;
+	map_t *constants = ctx->constants, *buffers = ctx->buffers;
+	for (; ctx->structures_checked < ast->structures->length; ctx->structures_checked += 1) {
+		seadragon_layout_struct(ast->structures->items[ctx->structures_checked]);
+	}
+	for (unsigned int i = ctx->constants_checked; i < ast->constants->length; i += 1) {
+		seadragon_constant_t *constant = ast->constants->items[i];
+		if (map_get(constants, constant->name)) {
+			seadragon_session_error(ctx->session, "%s:%d: error: Sema: Duplicate constant `%s`", __FILE__, __LINE__, constant->name);
+			return false;
+		}
+		map_set(constants, constant->name, constant);
+	}
+	for (; ctx->constants_checked < ast->constants->length; ctx->constants_checked += 1) {
+		if (!seadragon_sema_constant(ctx, ast->constants->items[ctx->constants_checked])) {
+			return false;
+		}
+	}
+	for (; ctx->buffers_checked < ast->buffers->length; ctx->buffers_checked += 1) {
+		seadragon_buffer_t *buffer = ast->buffers->items[ctx->buffers_checked];
+		const char *problem = NULL;
+		if (map_get(constants, buffer->name) || map_get(buffers, buffer->name)) {
+			problem = "Duplicate buffer";
+		}
+		else if (buffer->declared_size->type == VALUE_TYPE_LITERAL) {
+			buffer->size = buffer->declared_size->u.literal;
+		}
+		else if (!seadragon_sema_resolve(ctx, buffer->declared_size->u.identifier, &buffer->size)) {
+			problem = "Unresolvable size of buffer";
+		}
+		if (!problem && !buffer->size) {
+			problem = "Empty buffer";
+		}
+		if (problem) {
+			seadragon_session_error(ctx->session, "%s:%d: error: Sema: %s `%s`", __FILE__, __LINE__, problem, buffer->name);
+			return false;
+		}
+		map_set(buffers, buffer->name, buffer);
+	}
+	// Those already sorted stay in place, as the sort is stable
+	seadragon_layout_buffers(ast->buffers);
+	return true;
+}
+
+bool seadragon_sema_function(seadragon_sema_ctx_t *ctx, seadragon_function_t *func) {
+	list_t *instructions = func->u.instructions;
+	seadragon_ir_pool_t *pool = &func->pool;
+	// list of node indices
+	list_t *value_stack = list_create();
+	// list of seadragon_sema_frame_t
+	list_t *frames = list_create();
+	func->u.blocks = list_create();
+	seadragon_ir_pool_init(pool);
+	seadragon_block_t *block = seadragon_cfg_block(func->u.blocks);
+	for (unsigned int i = 0; i < instructions->length; i += 1) {
+		seadragon_instruction_t *instruction = instructions->items[i];
+		switch (instruction->type) {
+		case INSTRUCTION_TYPE_PUSH:{
+			seadragon_value_t *value = instruction->argument;
+			seadragon_buffer_t *buffer;
+			char *variable = value->type == VALUE_TYPE_IDENTIFIER ? seadragon_sema_variable(func, value->u.identifier) : NULL;
+			if (variable) {
+				// Every use shares the declaration's name, so that the function
+				// owns all of its names
+				free(value->u.identifier);
+				value->u.identifier = variable;
+			}
+			else if (value->type == VALUE_TYPE_IDENTIFIER && (buffer = map_get(ctx->buffers, value->u.identifier))) {
+				free(value->u.identifier);
+				value->type = VALUE_TYPE_BUFFER;
+				value->u.buffer = buffer;
+			}
+			else if (value->type == VALUE_TYPE_IDENTIFIER) {
+				uint32_t literal;
+				if (!seadragon_sema_resolve(ctx, value->u.identifier, &literal)) {
+					ERROR("Unresolvable value");
 				}
-				break;}
-			default:
-				ERROR("Unrecognized instruction by sema");
+				free(value->u.identifier);
+				value->type = VALUE_TYPE_LITERAL;
+				value->u.literal = literal;
 			}
+			seadragon_sema_push(value_stack, seadragon_ir_value(pool, *value));
+			free(value);
+			break;}
+		case INSTRUCTION_TYPE_GLONG:
+		case INSTRUCTION_TYPE_GINT:
+		case INSTRUCTION_TYPE_GBYTE:{
+			if (value_stack->length < 1) {
+				ERROR("Stack underflow");
+			}
+			uint32_t address = seadragon_sema_pop(value_stack);
+			if (seadragon_ir_is_comparison(pool, address)) {
+				ERROR("TODO: comparison used as a value");
+			}
+			if (instruction->type != INSTRUCTION_TYPE_GLONG && seadragon_ir_is_location(pool, address, NULL)) {
+				ERROR("TODO: sub-long access to a variable");
+			}
+			seadragon_operation_t op = instruction->type == INSTRUCTION_TYPE_GLONG ? OPERATION_GLONG
+				: instruction->type == INSTRUCTION_TYPE_GINT ? OPERATION_GINT : OPERATION_GBYTE;
+			seadragon_sema_push(value_stack, seadragon_ir_node(pool, op, address, SEADRAGON_IR_NONE));
+			break;}
+		case INSTRUCTION_TYPE_SLONG:
+		case INSTRUCTION_TYPE_SINT:
+		case INSTRUCTION_TYPE_SBYTE:{
+			if (value_stack->length < 2) {
+				ERROR("Stack underflow");
+			}
+			uint32_t lhs = seadragon_sema_pop(value_stack);
+			uint32_t rhs = seadragon_sema_pop(value_stack);
+			if (seadragon_ir_is_location(pool, rhs, NULL)) {
+				ERROR("Taking the address of a variable is not supported");
+			}
+			if (seadragon_ir_is_comparison(pool, lhs) || seadragon_ir_is_comparison(pool, rhs)) {
+				ERROR("TODO: comparison used as a value");
+			}
+			if (instruction->type != INSTRUCTION_TYPE_SLONG && seadragon_ir_is_location(pool, lhs, NULL)) {
+				ERROR("TODO: sub-long access to a variable");
+			}
+			seadragon_sema_spill(func, block, value_stack, lhs);
+			seadragon_operation_t op = instruction->type == INSTRUCTION_TYPE_SLONG ? OPERATION_SLONG
+				: instruction->type == INSTRUCTION_TYPE_SINT ? OPERATION_SINT : OPERATION_SBYTE;
+			seadragon_ir_insert(block, block->statement_count, seadragon_ir_node(pool, op, lhs, rhs));
+			break;}
+		case INSTRUCTION_TYPE_ADD:
+		case INSTRUCTION_TYPE_SUB:
+		case INSTRUCTION_TYPE_MUL:
+		case INSTRUCTION_TYPE_DIV:
+		case INSTRUCTION_TYPE_AND:
+		case INSTRUCTION_TYPE_OR:
+		case INSTRUCTION_TYPE_LSH:
+		case INSTRUCTION_TYPE_RSH:
+		case INSTRUCTION_TYPE_CLT:
+		case INSTRUCTION_TYPE_CGT:
+		case INSTRUCTION_TYPE_CLE:
+		case INSTRUCTION_TYPE_CGE:
+		case INSTRUCTION_TYPE_EQ:
+		case INSTRUCTION_TYPE_NE:{
+			if (value_stack->length < 2) {
+				ERROR("Stack underflow");
+			}
+			uint32_t rhs = seadragon_sema_pop(value_stack);
+			uint32_t lhs = seadragon_sema_pop(value_stack);
+			if (seadragon_ir_is_location(pool, lhs, NULL) || seadragon_ir_is_location(pool, rhs, NULL)) {
+				ERROR("Taking the address of a variable is not supported");
+			}
+			if (seadragon_ir_is_comparison(pool, lhs) || seadragon_ir_is_comparison(pool, rhs)) {
+				ERROR("TODO: comparison used as a value");
+			}
+			seadragon_sema_push(value_stack, seadragon_sema_arith(pool, seadragon_sema_arith_op(instruction->type), lhs, rhs));
+			break;}
+		case INSTRUCTION_TYPE_DROP:
+			if (value_stack->length < 1) {
+				ERROR("Stack underflow");
+			}
+			// Nothing on the value stack has side effects yet
+			list_pop(value_stack);
+			break;
+		case INSTRUCTION_TYPE_IF:
+		case INSTRUCTION_TYPE_WHILE:{
+			if (value_stack->length) {
+				ERROR("TODO: values on the stack across control flow");
+			}
+			seadragon_sema_frame_t *frame = malloc(sizeof(seadragon_sema_frame_t));
+			frame->branch = frame->header = frame->join = NULL;
+			frame->has_else = false;
+			if (instruction->type == INSTRUCTION_TYPE_WHILE) {
+				frame->header = seadragon_cfg_block(func->u.blocks);
+				frame->header->loop_header = true;
+				block->terminator = TERMINATOR_JUMP;
+				block->target = frame->header;
+				block = frame->header;
+			}
+			list_add(frames, frame);
+			break;}
+		case INSTRUCTION_TYPE_THEN:{
+			if (value_stack->length != 1) {
+				ERROR("A condition must produce exactly one value");
+			}
+			uint32_t condition = seadragon_sema_pop(value_stack);
+			if (seadragon_ir_is_location(pool, condition, NULL)) {
+				ERROR("Taking the address of a variable is not supported");
+			}
+			seadragon_sema_frame_t *frame = list_last(frames);
+			block->terminator = TERMINATOR_BRANCH;
+			block->condition = condition;
+			block->target = seadragon_cfg_block(func->u.blocks);
+			block->fallback = frame->join = seadragon_cfg_block(func->u.blocks);
+			frame->branch = block;
+			block = block->target;
+			break;}
+		case INSTRUCTION_TYPE_ELSE:{
+			seadragon_sema_frame_t *frame = list_last(frames);
+			if (frame->header || frame->has_else) {
+				ERROR("Unexpected `else`");
+			}
+			if (value_stack->length) {
+				ERROR("TODO: values on the stack across control flow");
+			}
+			block->terminator = TERMINATOR_JUMP;
+			block->target = frame->join;
+			block = frame->branch->fallback = seadragon_cfg_block(func->u.blocks);
+			frame->has_else = true;
+			break;}
+		case INSTRUCTION_TYPE_END:{
+			if (value_stack->length) {
+				ERROR("TODO: values on the stack across control flow");
+			}
+			seadragon_sema_frame_t *frame = list_pop(frames);
+			block->terminator = TERMINATOR_JUMP;
+			block->target = frame->header ? frame->header : frame->join;
+			block = frame->join;
+			free(frame);
+			break;}
+		case INSTRUCTION_TYPE_RETURN:
+			if (value_stack->length) {
+				ERROR("Values left on the stack at `return`");
+			}
+			block->terminator = TERMINATOR_RETURN;
+			block->early_return = frames->length != 0;
+			// Anything up to the next `end` or `else` is unreachable
+			block = seadragon_cfg_block(func->u.blocks);
+			break;
+		default:
+			ERROR("Unrecognized instruction by sema");
 		}
-		list_free(value_stack);
-		list_free(instructions);
+		free(instruction);
+	}
+	if (value_stack->length) {
+		ERROR("Values left on the stack at end of function");
+	}
+	list_free(value_stack);
+	list_free(frames);
+	list_free(instructions);
+	seadragon_cfg_simplify(func);
+	seadragon_loop_optimize(func);
+	seadragon_memops_combine(func);
+	if (ctx->ast->profile) {
+		seadragon_profile_apply(ctx->ast->profile, func);
 	}
+	seadragon_cfg_layout(func);
+	seadragon_ir_linearize(func);
 	return true;
 }
+
+bool seadragon_sema(seadragon_session_t *session, seadragon_ast_t *ast) {
+	if (!ast) {
+		return false;
+	}
+	seadragon_sema_field_usage(ast);
+	seadragon_sema_ctx_t ctx;
+	seadragon_sema_init(&ctx, session, ast);
+	bool success = seadragon_sema_declarations(&ctx);
+	for (unsigned int i = 0; success && i < ast->functions->length; i += 1) {
+		success = seadragon_sema_function(&ctx, ast->functions->items[i]);
+	}
+	if (success && ast->profile) {
+		seadragon_profile_order(ast->profile, ast);
+	}
+	seadragon_sema_deinit(&ctx);
+	return success;
+}
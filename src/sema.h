@@ -2,9 +2,31 @@
 #define SEADRAGON_SEMA_H_
 
 #include "ast.h"
+#include "map.h"
+#include "session.h"
 #include <stdbool.h>
 
-bool seadragon_sema(seadragon_ast_t *ast);
+bool seadragon_sema(seadragon_session_t *session, seadragon_ast_t *ast);
 
-#endif // SEADRAGON_SEMA_H_
+/// State for checking a program piece by piece, as it is parsed: declarations
+/// appended to ast are checked by seadragon_sema_declarations, after which
+/// functions may be checked one at a time. Functions may then only reference
+/// what has been declared so far, and structures are laid out without knowing
+/// how functions use their fields, so `reorder` only sorts by alignment.
+typedef struct {
+	seadragon_session_t *session;
+	seadragon_ast_t *ast;
+	/// Declarations checked so far, by name
+	map_t *constants, *buffers;
+	unsigned int structures_checked, constants_checked, buffers_checked;
+} seadragon_sema_ctx_t;
+
+void seadragon_sema_init(seadragon_sema_ctx_t *ctx, seadragon_session_t *session, seadragon_ast_t *ast);
+void seadragon_sema_deinit(seadragon_sema_ctx_t *ctx);
+/// Checks the structures, constants and buffers added to ctx->ast since the
+/// last call.
+bool seadragon_sema_declarations(seadragon_sema_ctx_t *ctx);
+/// Lowers a function to blocks and optimizes it. It need not be in ctx->ast.
+bool seadragon_sema_function(seadragon_sema_ctx_t *ctx, seadragon_function_t *func);
 
+#endif // SEADRAGON_SEMA_H_
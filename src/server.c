@@ -0,0 +1,252 @@
+#include "server.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// Longest request accepted: the working directory and arguments.
+#define SEADRAGON_SERVER_REQUEST_MAX (1 << 20)
+
+/// A request is the client's stdin, stdout and stderr, sent alongside the
+/// payload length, then the payload: the working directory and each argument,
+/// NUL-terminated. The reply is the exit status as a 32-bit word.
+#define SEADRAGON_SERVER_FDS 3
+
+static void seadragon_server_error(const char *path, const char *msg) {
+	fprintf(stderr, "%s: error: Server: %s: %s\n", path, msg, strerror(errno));
+}
+
+static bool seadragon_server_address(const char *path, struct sockaddr_un *address) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address->sun_path)) {
+		return false;
+	}
+	strcpy(address->sun_path, path);
+	return true;
+}
+
+static int seadragon_server_connect(const char *path) {
+	struct sockaddr_un address;
+	if (!seadragon_server_address(path, &address)) {
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+static bool seadragon_server_send(int fd, const void *data, size_t size) {
+	const char *bytes = data;
+	while (size) {
+		ssize_t sent = write(fd, bytes, size);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+static bool seadragon_server_receive(int fd, void *data, size_t size) {
+	char *bytes = data;
+	while (size) {
+		ssize_t received = read(fd, bytes, size);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return false;
+		}
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+/// Receives the length of a request along with the client's streams.
+static bool seadragon_server_receive_fds(int fd, uint32_t *length, int fds[SEADRAGON_SERVER_FDS]) {
+	union {
+		struct cmsghdr header;
+		char buffer[CMSG_SPACE(SEADRAGON_SERVER_FDS * sizeof(int))];
+	} control;
+	struct iovec iov = { .iov_base = length, .iov_len = sizeof(*length) };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer) };
+	ssize_t received;
+	do {
+		received = recvmsg(fd, &msg, 0);
+	} while (received < 0 && errno == EINTR);
+	struct cmsghdr *header = CMSG_FIRSTHDR(&msg);
+	if (received < (ssize_t)sizeof(*length) || !header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+			|| header->cmsg_len != CMSG_LEN(SEADRAGON_SERVER_FDS * sizeof(int))) {
+		return false;
+	}
+	memcpy(fds, CMSG_DATA(header), SEADRAGON_SERVER_FDS * sizeof(int));
+	// The length may have arrived in pieces
+	return seadragon_server_receive(fd, (char*)length + received, sizeof(*length) - received);
+}
+
+/// Runs one request in a freshly forked child, and exits.
+static void seadragon_server_child(int fd, seadragon_server_main_t run) {
+	uint32_t length;
+	int fds[SEADRAGON_SERVER_FDS];
+	if (!seadragon_server_receive_fds(fd, &length, fds) || !length || length > SEADRAGON_SERVER_REQUEST_MAX) {
+		_exit(1);
+	}
+	char *payload = malloc(length);
+	if (!payload || !seadragon_server_receive(fd, payload, length) || payload[length - 1]) {
+		_exit(1);
+	}
+	int argc = -1;
+	for (uint32_t i = 0; i < length; i += 1) {
+		argc += !payload[i];
+	}
+	char **argv = calloc(argc + 1, sizeof(char*));
+	char *arg = payload + strlen(payload) + 1;
+	for (int i = 0; i < argc; i += 1) {
+		argv[i] = arg;
+		arg += strlen(arg) + 1;
+	}
+	fflush(stdout);
+	fflush(stderr);
+	for (int i = 0; i < SEADRAGON_SERVER_FDS; i += 1) {
+		if (dup2(fds[i], i) < 0) {
+			_exit(1);
+		}
+		close(fds[i]);
+	}
+	if (argc < 1 || chdir(payload)) {
+		_exit(1);
+	}
+	optind = 1;
+	uint32_t status = run(argc, argv);
+	fflush(stdout);
+	fflush(stderr);
+	seadragon_server_send(fd, &status, sizeof(status));
+	_exit(0);
+}
+
+bool seadragon_server_serve(const char *path, seadragon_server_main_t run) {
+	struct sockaddr_un address;
+	if (!seadragon_server_address(path, &address)) {
+		errno = ENAMETOOLONG;
+		seadragon_server_error(path, "Unable to listen");
+		return false;
+	}
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		seadragon_server_error(path, "Unable to listen");
+		return false;
+	}
+	bool bound = !bind(listener, (struct sockaddr*)&address, sizeof(address));
+	if (!bound && errno == EADDRINUSE) {
+		// Only take over the socket if no server answers on it
+		int other = seadragon_server_connect(path);
+		if (other >= 0) {
+			close(other);
+			errno = EADDRINUSE;
+		}
+		else {
+			bound = !unlink(path) && !bind(listener, (struct sockaddr*)&address, sizeof(address));
+		}
+	}
+	if (!bound || listen(listener, SOMAXCONN)) {
+		seadragon_server_error(path, "Unable to listen");
+		close(listener);
+		return false;
+	}
+	// Children are reaped automatically, and a client hanging up must not
+	// kill the child writing to it
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+	while (true) {
+		int fd = accept(listener, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			seadragon_server_error(path, "Unable to accept");
+			close(listener);
+			return false;
+		}
+		pid_t child = fork();
+		if (child == 0) {
+			close(listener);
+			seadragon_server_child(fd, run);
+		}
+		if (child < 0) {
+			seadragon_server_error(path, "Unable to fork");
+		}
+		close(fd);
+	}
+}
+
+int seadragon_server_forward(const char *path, int argc, char **argv) {
+	int fd = seadragon_server_connect(path);
+	if (fd < 0) {
+		return -1;
+	}
+	size_t capacity = 256;
+	char *cwd = malloc(capacity);
+	while (!getcwd(cwd, capacity) && errno == ERANGE) {
+		capacity *= 2;
+		cwd = realloc(cwd, capacity);
+	}
+	size_t length = strlen(cwd) + 1;
+	for (int i = 0; i < argc; i += 1) {
+		length += strlen(argv[i]) + 1;
+	}
+	char *payload = malloc(length);
+	char *end = payload;
+	strcpy(end, cwd);
+	end += strlen(cwd) + 1;
+	for (int i = 0; i < argc; i += 1) {
+		strcpy(end, argv[i]);
+		end += strlen(argv[i]) + 1;
+	}
+	free(cwd);
+
+	uint32_t size = length, status = 1;
+	int fds[SEADRAGON_SERVER_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	union {
+		struct cmsghdr header;
+		char buffer[CMSG_SPACE(SEADRAGON_SERVER_FDS * sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct iovec iov = { .iov_base = &size, .iov_len = sizeof(size) };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer) };
+	struct cmsghdr *header = CMSG_FIRSTHDR(&msg);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(header), fds, sizeof(fds));
+	// Anything buffered must reach the streams before the server writes to them
+	fflush(stdout);
+	fflush(stderr);
+	ssize_t sent;
+	do {
+		sent = sendmsg(fd, &msg, 0);
+	} while (sent < 0 && errno == EINTR);
+	bool success = sent == (ssize_t)sizeof(size) && seadragon_server_send(fd, payload, length)
+		&& seadragon_server_receive(fd, &status, sizeof(status));
+	free(payload);
+	close(fd);
+	if (!success) {
+		fprintf(stderr, "%s: error: Server: The compile server closed the connection\n", path);
+		return 1;
+	}
+	return status;
+}
@@ -0,0 +1,31 @@
+#ifndef SEADRAGON_SERVER_H_
+#define SEADRAGON_SERVER_H_
+
+#include <stdbool.h>
+
+/// A compile server, so that builds invoking the compiler many times don't
+/// pay for process startup and loading modules on every invocation. The
+/// server listens on a Unix domain socket and forks a child per connection,
+/// which inherits whatever the server loaded before it started serving. A
+/// request carries the client's arguments, working directory and standard
+/// streams, so the child runs the command line exactly as the client would
+/// have, writing output files and diagnostics itself, and the client only
+/// waits for its exit status. Children run concurrently, and because each
+/// exits after its request, nothing one compile allocates or leaks outlives
+/// it.
+
+/// The command line, called in the child with the client's arguments. getopt
+/// is reset before the call.
+typedef int (*seadragon_server_main_t)(int argc, char **argv);
+
+/// Serves requests on the socket at path, replacing a stale socket left by a
+/// server that is no longer running. Only returns, after printing why, if it
+/// cannot listen.
+bool seadragon_server_serve(const char *path, seadragon_server_main_t main);
+
+/// Sends a command line to the server at path and waits for it to run. Returns
+/// its exit status, or -1 without printing anything if no server is running
+/// there, so the caller may run it locally instead.
+int seadragon_server_forward(const char *path, int argc, char **argv);
+
+#endif // SEADRAGON_SERVER_H_
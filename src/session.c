@@ -0,0 +1,38 @@
+#include "session.h"
+#include "driver.h"
+
+#include <stdarg.h>
+
+void seadragon_session_init(seadragon_session_t *session, FILE *diagnostics) {
+	session->diagnostics = diagnostics;
+	session->threads = 0;
+	session->chunk_size = SEADRAGON_DRIVER_CHUNK_SIZE;
+	session->roots = NULL;
+	session->fold = false;
+	session->errors = 0;
+	pthread_mutex_init(&session->lock, NULL);
+}
+
+void seadragon_session_deinit(seadragon_session_t *session) {
+	pthread_mutex_destroy(&session->lock);
+}
+
+void seadragon_session_error(seadragon_session_t *session, const char *format, ...) {
+	pthread_mutex_lock(&session->lock);
+	if (session->diagnostics) {
+		va_list args;
+		va_start(args, format);
+		vfprintf(session->diagnostics, format, args);
+		va_end(args);
+		fputc('\n', session->diagnostics);
+	}
+	session->errors += 1;
+	pthread_mutex_unlock(&session->lock);
+}
+
+bool seadragon_session_failed(seadragon_session_t *session) {
+	pthread_mutex_lock(&session->lock);
+	bool failed = session->errors > 0;
+	pthread_mutex_unlock(&session->lock);
+	return failed;
+}
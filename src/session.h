@@ -0,0 +1,53 @@
+#ifndef SEADRAGON_SESSION_H_
+#define SEADRAGON_SESSION_H_
+
+#include "list.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/// The state of one compilation: its options, where its diagnostics go, and
+/// whether anything has failed. Every phase takes the session first and
+/// reports errors through it, returning false (or NULL) after freeing what it
+/// allocated rather than unwinding. Sessions share no state, so any number of
+/// them may compile at once in one process; the threads of a single compile
+/// may report through the same session.
+typedef struct {
+	/// Where diagnostics are written, one per line. Not closed by the session.
+	FILE *diagnostics;
+	/// Threads the driver parses on (0: one per processor)
+	unsigned int threads;
+	/// Files longer than this are parsed in pieces (0: never split), see
+	/// SEADRAGON_DRIVER_CHUNK_SIZE
+	size_t chunk_size;
+	/// Link-time options, applied by backends that link their output (limn2k)
+	/// once each function's final code is known. Nothing calls a function, so
+	/// the only ones reachable are the roots: when roots, a list of function
+	/// names, is set, every other function is dropped.
+	list_t *roots;
+	/// Functions whose final code and relocations are identical to an earlier
+	/// one's are emitted as aliases of it.
+	bool fold;
+	/// Errors reported so far
+	unsigned int errors;
+	pthread_mutex_t lock;
+} seadragon_session_t;
+
+/// Starts a session reporting to diagnostics, which may be NULL to discard
+/// them, parsing on one thread per processor with the default chunk size, and
+/// keeping every function.
+void seadragon_session_init(seadragon_session_t *session, FILE *diagnostics);
+void seadragon_session_deinit(seadragon_session_t *session);
+
+/// Writes a diagnostic, followed by a newline, and counts it as an error.
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+void seadragon_session_error(seadragon_session_t *session, const char *format, ...);
+
+/// Whether any error has been reported. Phases fail once the session has.
+bool seadragon_session_failed(seadragon_session_t *session);
+
+#endif // SEADRAGON_SESSION_H_
@@ -75,7 +75,8 @@ char *seadragon_token_read(seadragon_token_t token)
 uint64_t seadragon_token_read_number(seadragon_token_t token) {
 	char *buf = seadragon_token_read(token);
 	char *ret;
-	unsigned long result = strtoul(buf, &ret, 10);
+	int base = token.len > 2 && buf[0] == '0' && buf[1] == 'x' ? 16 : 10;
+	unsigned long result = strtoul(buf, &ret, base);
 	if (ret != buf + token.len) {
 		return UINT64_MAX;
 	}
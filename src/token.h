@@ -23,6 +23,14 @@ typedef struct seadragon_source_range
     ITEM(MUL),            \
     ITEM(CGT),            \
     ITEM(CLT),            \
+    ITEM(CGE),            \
+    ITEM(CLE),            \
+    ITEM(EQ),             \
+    ITEM(NE),             \
+    ITEM(AND),            \
+    ITEM(OR),             \
+    ITEM(LSH),            \
+    ITEM(RSH),            \
     \
     ITEM(LPAREN),         \
     ITEM(RPAREN),         \
@@ -43,12 +51,16 @@ typedef struct seadragon_source_range
     ITEM(FN),             \
     ITEM(END),            \
     ITEM(IF),             \
+    ITEM(ELSE),           \
     ITEM(RETURN),         \
     ITEM(WHILE),          \
     \
     ITEM(BUFFER),         \
     ITEM(VAR),            \
     ITEM(AUTO),           \
+    ITEM(STRUCT),         \
+    ITEM(ENDSTRUCT),      \
+    ITEM(CONST),          \
     \
     ITEM(DROP),           \
     \
@@ -3,6 +3,20 @@
 #include "sema.h"
 #include "codegen.h"
 #include "backends/limn2k.h"
+#include "backends/limn2k_peephole.h"
+#include "backends/limn2k_schedule.h"
+#include "backends/c99.h"
+#include "backends/x86_64.h"
+#include "backends/limn2k_sim.h"
+#include "layout.h"
+#include "module.h"
+#include "driver.h"
+#include "profile.h"
+#include "interp.h"
+#include "ir.h"
+#include "server.h"
+#include "session.h"
+#include "document.h"
 
 #define TEST_USE_COLOR 0
 
@@ -11,6 +25,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 static size_t count_lines(const char* str, size_t slen)
 {
@@ -21,6 +39,42 @@ static size_t count_lines(const char* str, size_t slen)
 	return num;
 }
 
+// Parses, checks and generates code for source into buf, which is left
+// NUL-terminated; what was generated is printed if codegen fails. On success
+// the AST is handed back through ast, if given, for the caller to inspect and
+// free, and is freed here otherwise.
+static bool compile_to_string(seadragon_session_t *session, const char *source,
+		seadragon_backend_t *(*backend)(seadragon_session_t*, FILE*), seadragon_ast_t *ast, char *buf, size_t size) {
+	seadragon_ast_t local;
+	if (!ast) {
+		ast = &local;
+	}
+	seadragon_lexer_t lexer;
+	if (!seadragon_lexer_init(&lexer, "<src>", source, strlen(source))) {
+		return false;
+	}
+	bool success = seadragon_parse(session, ast, &lexer) != NULL;
+	seadragon_lexer_deinit(&lexer);
+	if (!success) {
+		return false;
+	}
+	buf[0] = 0;
+	FILE *outfile = fmemopen(buf, size - 1, "w");
+	success = outfile && seadragon_sema(session, ast) && seadragon_cg(session, ast, outfile, backend);
+	if (outfile) {
+		long len = ftell(outfile);
+		fclose(outfile);
+		buf[len < 0 ? 0 : len] = 0;
+	}
+	if (!success) {
+		printf("Generated code: \n========\n%s========\n", buf);
+	}
+	if (!success || ast == &local) {
+		seadragon_parse_free(ast);
+	}
+	return success;
+}
+
 // returned as `int` so that it can be passed directly into printf
 static int num_digits(uint32_t n)
 {
@@ -85,11 +139,13 @@ TEST(lexer)
 }
 
 TEST(parser) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
 	seadragon_lexer_t lexer;
 	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
 
 	seadragon_ast_t ast;
-	ASSERT(seadragon_parse(&ast, &lexer));
+	ASSERT(seadragon_parse(&session, &ast, &lexer));
 	ASSERT_EQ_INT(ast.functions->length, 1);
 	
 	seadragon_function_t *function = ast.functions->items[0];
@@ -112,51 +168,1764 @@ TEST(parser) {
 		seadragon_instruction_t *inst = function->u.instructions->items[i];
 		ASSERT_EQ_UINT(types[i], inst->type);
 	}
-
+	seadragon_session_deinit(&session);
 }
 
 TEST(sema) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
 	static const char src[] = "fn main {-- ret} 0 ret ! end ";
 	seadragon_lexer_t lexer;
 	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
 	seadragon_ast_t ast;
-	ASSERT(seadragon_parse(&ast, &lexer));
-	ASSERT(seadragon_sema(&ast));
+	ASSERT(seadragon_parse(&session, &ast, &lexer));
+	ASSERT(seadragon_sema(&session, &ast));
 	// Functions' instruction lists are no longer valid, tree is now
 	ASSERT_EQ_INT(ast.functions->length, 1);
 	seadragon_function_t *function = ast.functions->items[0];
 	ASSERT(function);
 	char *name = function->outputs->items[0];
 	ASSERT_EQ_STR(name, "ret");
-	seadragon_instruction_node_t tree = function->u.root;
-	ASSERT_EQ_UINT(tree.op, OPERATION_SLONG);
-	ASSERT(tree.right);
-	ASSERT(tree.left);
-	ASSERT_EQ_INT(tree.left->type, LEAF_VALUE);
-	ASSERT_EQ_INT(tree.right->type, LEAF_VALUE);
-	ASSERT_EQ_UINT(tree.left->u.value->type, VALUE_TYPE_IDENTIFIER);
-	ASSERT_EQ_STR(tree.left->u.value->u.identifier, "ret");
-	ASSERT_EQ_UINT(tree.right->u.value->type, VALUE_TYPE_LITERAL);
-	ASSERT_EQ_UINT(tree.right->u.value->u.literal, 0);
+	ASSERT_EQ_UINT(function->u.blocks->length, 1);
+	seadragon_block_t *block = function->u.blocks->items[0];
+	ASSERT_EQ_UINT(block->terminator, TERMINATOR_RETURN);
+	ASSERT_EQ_UINT(block->statement_count, 1);
+	seadragon_ir_pool_t *pool = &function->pool;
+	uint32_t tree = block->statements[0];
+	ASSERT_EQ_UINT(pool->op[tree], OPERATION_SLONG);
+	ASSERT(pool->right[tree] != SEADRAGON_IR_NONE);
+	ASSERT(pool->left[tree] != SEADRAGON_IR_NONE);
+	ASSERT_EQ_INT(pool->op[pool->left[tree]], OPERATION_NONE);
+	ASSERT_EQ_INT(pool->op[pool->right[tree]], OPERATION_NONE);
+	ASSERT_EQ_UINT(pool->value[pool->left[tree]].type, VALUE_TYPE_IDENTIFIER);
+	ASSERT_EQ_STR(pool->value[pool->left[tree]].u.identifier, "ret");
+	ASSERT_EQ_UINT(pool->value[pool->right[tree]].type, VALUE_TYPE_LITERAL);
+	ASSERT_EQ_UINT(pool->value[pool->right[tree]].u.literal, 0);
+	seadragon_session_deinit(&session);
+}
+
+TEST(store_order) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	// Values still on the stack were pushed before the store, and must not see it
+	static const char src[] =
+		"fn variable {-- v} auto x 3 x ! x@ 5 x ! v ! end "
+		"fn memory {-- v} 7 1000 ! 1000 @ 9 1000 ! v ! end "
+		"fn increment {-- w} auto x 3 x ! x@ x@ 1 + x ! w ! end ";
+	static const char *names[] = { "variable", "memory", "increment" };
+	static const uint32_t expected[] = { 3, 7, 3 };
+	seadragon_ast_t ast;
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+
+	uint32_t results[2] = { 0 };
+	seadragon_interp_t *interp = seadragon_interp_compile(&ast, 4096);
+	PRECONDITION(interp != NULL);
+	for (unsigned int i = 0; i < 3; i += 1) {
+		ASSERT(seadragon_interp_run(interp, names[i], results));
+		ASSERT_EQ_UINT(results[0], expected[i]);
+	}
+	seadragon_interp_free(interp);
+
+	seadragon_limn2k_sim_t *sim = seadragon_limn2k_sim_assemble(buf, strlen(buf), 4096, NULL);
+	PRECONDITION(sim != NULL);
+	for (unsigned int i = 0; i < 3; i += 1) {
+		ASSERT(seadragon_limn2k_sim_run(sim, names[i], results));
+		ASSERT_EQ_UINT(results[0], expected[i]);
+	}
+	seadragon_limn2k_sim_free(sim);
+
+	seadragon_jit_t *jit = seadragon_jit_compile(&session, &ast, NULL);
+	uint8_t *host = seadragon_jit_memory();
+	PRECONDITION(jit != NULL && host != NULL);
+	for (unsigned int i = 0; i < 3; i += 1) {
+		seadragon_jit_lookup(jit, names[i])(results, host);
+		ASSERT_EQ_UINT(results[0], expected[i]);
+	}
+	seadragon_jit_memory_free(host);
+	seadragon_jit_free(jit);
+	seadragon_parse_free(&ast);
+	seadragon_session_deinit(&session);
 }
 
 TEST(codegen) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
 	static const char src[] = "fn main {-- ret} 0 ret ! end ";
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, NULL, buf, sizeof(buf)));
+	seadragon_session_deinit(&session);
+}
+
+TEST(structs) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"struct Node 1 Tag 4 Next 2 Len endstruct "
+		"struct Packed reorder 1 Tag 4 Next 2 Len 4 Cold endstruct "
+		"fn main {-- ret} auto p 4096 p ! "
+		"p@ Node_Next + @ ret ! "
+		"ret@ p@ Node_Len + si "
+		"p@ Packed_Tag + gb p@ Packed_Len + gi + ret ! end ";
+	seadragon_ast_t ast;
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	ASSERT_EQ_UINT(ast.structures->length, 2);
+
+	// Declaration order: Tag@0, Next@4, Len@8, size 12 (padded to alignment 4)
+	uint32_t value;
+	ASSERT(seadragon_layout_lookup(ast.structures, "Node_Tag", &value, NULL));
+	ASSERT_EQ_UINT(value, 0);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Node_Next", &value, NULL));
+	ASSERT_EQ_UINT(value, 4);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Node_Len", &value, NULL));
+	ASSERT_EQ_UINT(value, 8);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Node_SIZEOF", &value, NULL));
+	ASSERT_EQ_UINT(value, 12);
+	ASSERT(!seadragon_layout_lookup(ast.structures, "Node_Missing", &value, NULL));
+
+	// Reordered: the fields used together (Tag, Len) come first, sorted by
+	// alignment, followed by the unused ones.
+	ASSERT(seadragon_layout_lookup(ast.structures, "Packed_Len", &value, NULL));
+	ASSERT_EQ_UINT(value, 0);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Packed_Tag", &value, NULL));
+	ASSERT_EQ_UINT(value, 2);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Packed_Next", &value, NULL));
+	ASSERT_EQ_UINT(value, 4);
+	ASSERT(seadragon_layout_lookup(ast.structures, "Packed_SIZEOF", &value, NULL));
+	ASSERT_EQ_UINT(value, 12);
+	seadragon_parse_free(&ast);
+
+	// Field offsets are folded into the memory operand
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tli 1, 4096\n"
+		"\tl.l 10, 1, 4\n"
+		"\ts.i 1, 8, 10\n"
+		"\tl.b 2, 1, 2\n"
+		"\tl.i 3, 1, 0\n"
+		"\tadd 10, 2, 3\n"
+		"\tret\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(constants) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"const PageShift 12 "
+		"const PageMask (PageSize 1 -) "
+		"const PageSize (1 PageShift <<) "
+		"const High 0xFFFF0000 "
+		"struct Entry 4 Base 4 Limit endstruct "
+		"const TableBytes (Entry_SIZEOF 16 *) "
+		"fn main {-- ret} auto p 8192 p ! "
+		"p@ PageMask & TableBytes + ret ! "
+		"High PageSize | ret ! end ";
+	seadragon_ast_t ast;
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	ASSERT_EQ_UINT(ast.constants->length, 5);
+
+	static const uint32_t values[5] = { 12, 4095, 4096, 0xFFFF0000, 128 };
+	for (unsigned int i = 0; i < 5; i += 1) {
+		seadragon_constant_t *constant = ast.constants->items[i];
+		ASSERT_EQ_UINT(constant->state, CONSTANT_EVALUATED);
+		ASSERT_EQ_UINT(constant->value, values[i]);
+	}
+	seadragon_parse_free(&ast);
+
+	// Constants are substituted as immediates; nothing is computed at run time
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tli 1, 8192\n"
+		"\tandi 2, 1, 4095\n"
+		"\taddi 10, 2, 128\n"
+		"\tlui 10, 65535\n"
+		"\tori 10, 10, 4096\n"
+		"\tret\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(constants_cycle) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] = "const A (B 1 +) const B (A 1 +) fn main {-- ret} A ret ! end ";
 	seadragon_lexer_t lexer;
 	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
 	seadragon_ast_t ast;
-	PRECONDITION(seadragon_parse(&ast, &lexer));
-	PRECONDITION(seadragon_sema(&ast));
-	char buf[1024*1024];
-	FILE *outfile = fmemopen(buf, 1024 * 1024, "w+");
-	seadragon_backend_t *(*backend)(jmp_buf*,FILE*) = seadragon_backend_limn2k;
-	bool codegen_success = seadragon_cg(&ast, outfile, backend);
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	ASSERT(!seadragon_sema(&session, &ast));
+	seadragon_session_deinit(&session);
+}
+
+TEST(control_flow) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"fn main {-- ret} auto i auto p "
+		"0 ret ! 0 i ! 4096 p ! "
+		"if (p@ 0 ==) return end "
+		"while (i@ 10 <) "
+			"ret@ p@ gi + ret ! "
+			"p@ 2 + p ! "
+			"i@ 1 + i ! "
+		"end "
+		"if (ret@) 1 ret ! else 2 ret ! end "
+		"end ";
+	seadragon_ast_t ast;
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	seadragon_function_t *function = ast.functions->items[0];
+	seadragon_block_t *error = list_last(function->u.blocks);
+	ASSERT(error->early_return && error->cold);
+	seadragon_parse_free(&ast);
+	// The error path is moved to the end, and the loop is inverted so that each
+	// iteration takes a single branch.
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tli 10, 0\n"
+		"\tli 1, 0\n"
+		"\tli 2, 4096\n"
+		"\tbeq 2, 0, .main.1\n"
+		"\tli 3, 10\n"
+		"\tbge 1, 3, .main.6\n"
+		"\tsub 1, 3, 1\n"
+		".main.5:\n"
+		"\tl.i 3, 2, 0\n"
+		"\taddi 2, 2, 2\n"
+		"\tadd 10, 10, 3\n"
+		"\tsubi 1, 1, 1\n"
+		"\tbne 1, 0, .main.5\n"
+		".main.6:\n"
+		"\tbeq 10, 0, .main.9\n"
+		"\tli 10, 1\n"
+		"\tret\n"
+		".main.9:\n"
+		"\tli 10, 2\n"
+		"\tret\n"
+		".main.1:\n"
+		"\tret\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(loops) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		// Walks a table of longs; the address becomes a pointer stepping by 4
+		"fn sum {-- total} auto i auto table auto n "
+		"0x1000 @ table ! 0x1004 @ n ! 0 total ! 0 i ! "
+		"while (i@ n@ <) "
+			"total@ table@ i@ 4 * + @ + total ! "
+			"i@ 1 + i ! "
+		"end "
+		"end "
+		// The load and the constant don't change between iterations
+		"fn invariant {-- total} auto i auto p auto n "
+		"0x1000 @ p ! 0x1004 @ n ! 0 total ! 0 i ! "
+		"while (i@ n@ ~=) "
+			"1000 total@ - p@ 8 + @ + total ! "
+			"i@ 1 + i ! "
+		"end "
+		"end "
+		// Stores prevent hoisting loads, but not constants
+		"fn fill {--} auto i auto p auto n "
+		"0x1000 @ p ! 0x1004 @ n ! 0 i ! "
+		"while (i@ n@ <) "
+			"7 p@ i@ + sb "
+			"i@ 1 + i ! "
+		"end "
+		"end "
+		"fn shifts {-- y} auto x "
+		"0x1000 @ x ! "
+		"x@ 4 * x@ 2 / + y ! "
+		"x@ 8 / 8 * y@ + y ! "
+		"end ";
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, NULL, buf, sizeof(buf)));
+	ASSERT_EQ_STR(buf,
+		"sum:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.l 2, 0, 4100\n"
+		"\tli 10, 0\n"
+		"\tli 3, 0\n"
+		"\tbge 3, 2, .sum.3\n"
+		"\tlshi 5, 3, 2\n"
+		"\tadd 4, 1, 5\n"
+		"\tsub 3, 2, 3\n"
+		".sum.2:\n"
+		"\tl.l 5, 4, 0\n"
+		"\tsubi 3, 3, 1\n"
+		"\tadd 10, 10, 5\n"
+		"\taddi 4, 4, 4\n"
+		"\tbne 3, 0, .sum.2\n"
+		".sum.3:\n"
+		"\tret\n"
+		"invariant:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.l 2, 0, 4100\n"
+		"\tli 10, 0\n"
+		"\tli 3, 0\n"
+		"\tbeq 3, 2, .invariant.3\n"
+		"\tl.l 5, 1, 8\n"
+		"\tsub 3, 2, 3\n"
+		"\tli 4, 1000\n"
+		".invariant.2:\n"
+		"\tsub 6, 4, 10\n"
+		"\tadd 10, 6, 5\n"
+		"\tsubi 3, 3, 1\n"
+		"\tbne 3, 0, .invariant.2\n"
+		".invariant.3:\n"
+		"\tret\n"
+		"fill:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.l 2, 0, 4100\n"
+		"\tli 3, 0\n"
+		"\tbge 3, 2, .fill.3\n"
+		"\tadd 4, 1, 3\n"
+		"\tsub 3, 2, 3\n"
+		"\tli 5, 7\n"
+		".fill.2:\n"
+		"\ts.b 4, 0, 5\n"
+		"\tsubi 3, 3, 1\n"
+		"\taddi 4, 4, 1\n"
+		"\tbne 3, 0, .fill.2\n"
+		".fill.3:\n"
+		"\tret\n"
+		"shifts:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tlshi 2, 1, 2\n"
+		"\trshi 3, 1, 1\n"
+		"\tadd 10, 2, 3\n"
+		"\tlui 3, 65535\n"
+		"\tori 3, 3, 65528\n"
+		"\tand 2, 1, 3\n"
+		"\tadd 10, 2, 10\n"
+		"\tret\n");
+
+	// i is not reset when the outer loop comes back to the inner loop's
+	// guard, so the inner loop must not count i down
+	static const char nested[] =
+		"fn main {-- ret} auto i auto j "
+		"0 i ! 0 j ! 0 ret ! "
+		"while (j@ 3 <) "
+			"while (i@ 10 <) ret@ 1 + ret ! i@ 1 + i ! end "
+			"j@ 1 + j ! "
+		"end "
+		"end ";
+	seadragon_ast_t ast;
+	ASSERT(compile_to_string(&session, nested, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	seadragon_interp_t *interp = seadragon_interp_compile(&ast, 4096);
+	ASSERT(interp);
+	uint32_t ret;
+	ASSERT(seadragon_interp_run(interp, "main", &ret));
+	ASSERT_EQ_UINT(ret, 10);
+	seadragon_interp_free(interp);
+	seadragon_parse_free(&ast);
+	seadragon_session_deinit(&session);
+}
+
+TEST(memops) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		// A constant base is aligned, so the bytes are read as one long
+		"fn loads {-- v} auto p "
+		"0x1000 p ! "
+		"p@ gb p@ 1 + gb 8 << | p@ 2 + gb 16 << | p@ 3 + gb 24 << | v ! "
+		"end "
+		"fn stores {--} auto p "
+		"0x1000 p ! "
+		"1 p@ sb 2 p@ 1 + sb 3 p@ 2 + sb 4 p@ 3 + sb "
+		"end "
+		"fn slices {--} auto p auto v "
+		"0x1000 p ! 0x2000 @ v ! "
+		"v@ p@ 8 + sb v@ 8 >> p@ 9 + sb v@ 16 >> p@ 10 + sb v@ 24 >> p@ 11 + sb "
+		"end "
+		// Nothing is known about the alignment of a loaded pointer
+		"fn unknown {-- v} auto q "
+		"0x1000 @ q ! "
+		"q@ gb q@ 1 + gb 8 << | v ! "
+		"end "
+		"fn offsets {-- v} auto p auto i "
+		"0x1000 @ p ! 0x1004 @ i ! "
+		"p@ 4 + i@ + @ v ! "
+		"0x12345678 gi v@ + v ! "
+		"end ";
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, NULL, buf, sizeof(buf)));
+	ASSERT_EQ_STR(buf,
+		"loads:\n"
+		"\tli 1, 4096\n"
+		"\tl.l 10, 1, 0\n"
+		"\tret\n"
+		"stores:\n"
+		"\tli 1, 4096\n"
+		"\tlui 2, 1027\n"
+		"\tori 2, 2, 513\n"
+		"\ts.l 1, 0, 2\n"
+		"\tret\n"
+		"slices:\n"
+		"\tl.l 2, 0, 8192\n"
+		"\tli 1, 4096\n"
+		"\ts.l 1, 8, 2\n"
+		"\tret\n"
+		"unknown:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.b 3, 1, 1\n"
+		"\tl.b 2, 1, 0\n"
+		"\tlshi 3, 3, 8\n"
+		"\tor 10, 2, 3\n"
+		"\tret\n"
+		"offsets:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.l 2, 0, 4100\n"
+		"\tlui 4, 4660\n"
+		"\tadd 3, 1, 2\n"
+		"\tl.l 10, 3, 4\n"
+		"\tori 4, 4, 22136\n"
+		"\tl.i 3, 4, 0\n"
+		"\tadd 10, 3, 10\n"
+		"\tret\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(peephole) {
+	static const seadragon_limn2k_insn_t code[] = {
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GLONG, .rd = 1, .ra = 6, .imm = 0 },
+		{ .kind = LIMN2K_INSN_STORE, .op = OPERATION_SBYTE, .ra = 2, .rb = 1, .imm = 4 },
+		// Forwarded from the store, masked to a byte
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GBYTE, .rd = 3, .ra = 2, .imm = 4 },
+		{ .kind = LIMN2K_INSN_STORE, .op = OPERATION_SLONG, .ra = 2, .rb = 3, .imm = 0 },
+		// Forwarded into the register it was stored from, then dropped
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GLONG, .rd = 3, .ra = 2, .imm = 0 },
+		{ .kind = LIMN2K_INSN_LI, .rd = 7, .imm = 10 },
+		{ .kind = LIMN2K_INSN_LI, .rd = 7, .imm = 10 },
+		// Other paths may join here, so the constant is reloaded
+		{ .kind = LIMN2K_INSN_LABEL, .imm = 1 },
+		{ .kind = LIMN2K_INSN_LI, .rd = 7, .imm = 10 },
+		{ .kind = LIMN2K_INSN_LUI, .rd = 4, .imm = 1 },
+		{ .kind = LIMN2K_INSN_ARITH_IMMEDIATE, .op = OPERATION_OR, .rd = 4, .ra = 4, .imm = 5 },
+		{ .kind = LIMN2K_INSN_ARITH, .op = OPERATION_ADD, .rd = 5, .ra = 4, .rb = 7 },
+		// Only seen with a window reaching back to the first pair
+		{ .kind = LIMN2K_INSN_LUI, .rd = 4, .imm = 1 },
+		{ .kind = LIMN2K_INSN_ARITH_IMMEDIATE, .op = OPERATION_OR, .rd = 4, .ra = 4, .imm = 5 },
+		{ .kind = LIMN2K_INSN_RET },
+	};
+	const unsigned int length = sizeof(code) / sizeof(code[0]);
+	seadragon_limn2k_insn_t insns[sizeof(code) / sizeof(code[0])];
+	ASSERT_EQ_UINT(seadragon_limn2k_peephole_rule_count, 3);
+	memcpy(insns, code, sizeof(code));
+	ASSERT_EQ_UINT(seadragon_limn2k_peephole(insns, length, 0, NULL), length);
+	ASSERT_EQ_UINT(seadragon_limn2k_peephole(insns, length, 1, NULL), length - 2);
+
+	unsigned long hits[3] = { 0 };
+	memcpy(insns, code, sizeof(code));
+	ASSERT_EQ_UINT(seadragon_limn2k_peephole(insns, length, SEADRAGON_LIMN2K_PEEPHOLE_WINDOW, hits), length - 4);
+	ASSERT_EQ_UINT(hits[0], 2);
+	ASSERT_EQ_UINT(hits[1], 2);
+	ASSERT_EQ_UINT(hits[2], 1);
+	ASSERT(insns[2].kind == LIMN2K_INSN_ARITH_IMMEDIATE && insns[2].op == OPERATION_AND);
+	ASSERT(insns[2].rd == 3 && insns[2].ra == 1 && insns[2].imm == 0xFF);
+	ASSERT(insns[4].kind == LIMN2K_INSN_LI && insns[5].kind == LIMN2K_INSN_LABEL && insns[6].kind == LIMN2K_INSN_LI);
+	ASSERT(insns[9].kind == LIMN2K_INSN_ARITH && insns[10].kind == LIMN2K_INSN_RET);
+
+	// The backend keeps the counts across the functions it generates
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"fn forward {-- v} 5 0x1000 ! 0x1000 @ v ! end "
+		"fn constant {-- v} 7 0x1000 ! 7 0x1004 ! 0 v ! end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	ASSERT(seadragon_sema(&session, &ast));
+	char buf[4096];
+	FILE *outfile = fmemopen(buf, sizeof(buf), "w");
+	seadragon_cg_ctx_t *cg = seadragon_cg_begin(&session, outfile, seadragon_backend_limn2k);
+	ASSERT(cg != NULL);
+	seadragon_backend_t *backend = seadragon_cg_backend(cg);
+	const unsigned long *backend_hits = seadragon_backend_limn2k_peephole_hits(backend);
+	ASSERT(seadragon_cg_function(cg, ast.functions->items[0]));
+	ASSERT_EQ_UINT(backend_hits[0], 1);
+	ASSERT_EQ_UINT(backend_hits[1], 0);
+	ASSERT(seadragon_cg_function(cg, ast.functions->items[1]));
+	ASSERT(seadragon_cg_end(cg, ast.buffers));
+	fclose(outfile);
+	ASSERT_EQ_UINT(backend_hits[0], 1);
+	ASSERT_EQ_UINT(backend_hits[1], 1);
+	ASSERT_EQ_UINT(backend_hits[2], 0);
+	seadragon_backend_limn2k_deinit(backend);
+	seadragon_parse_free(&ast);
+	seadragon_session_deinit(&session);
+}
+
+TEST(schedule) {
+	static const seadragon_limn2k_insn_t code[] = {
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GLONG, .rd = 1, .ra = 0, .imm = 4096 },
+		{ .kind = LIMN2K_INSN_ARITH, .op = OPERATION_ADD, .rd = 2, .ra = 1, .rb = 1 },
+		// The multiply is on the longer path, so it starts first
+		{ .kind = LIMN2K_INSN_LI, .rd = 3, .imm = 7 },
+		{ .kind = LIMN2K_INSN_ARITH, .op = OPERATION_MUL, .rd = 4, .ra = 3, .rb = 3 },
+		{ .kind = LIMN2K_INSN_ARITH, .op = OPERATION_ADD, .rd = 5, .ra = 4, .rb = 2 },
+		{ .kind = LIMN2K_INSN_LABEL, .imm = 1 },
+		// Loads stay after stores, and r1 is only reused once it has been read
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GLONG, .rd = 1, .ra = 0, .imm = 4096 },
+		{ .kind = LIMN2K_INSN_STORE, .op = OPERATION_SLONG, .ra = 0, .rb = 1, .imm = 4100 },
+		{ .kind = LIMN2K_INSN_LOAD, .op = OPERATION_GLONG, .rd = 6, .ra = 0, .imm = 4100 },
+		{ .kind = LIMN2K_INSN_LI, .rd = 1, .imm = 7 },
+		{ .kind = LIMN2K_INSN_RET },
+	};
+	const unsigned int length = sizeof(code) / sizeof(code[0]);
+	seadragon_limn2k_insn_t insns[sizeof(code) / sizeof(code[0])];
+	memcpy(insns, code, sizeof(code));
+	ASSERT_EQ_UINT(seadragon_limn2k_schedule(insns, length, 0, NULL), 0);
+	ASSERT(!memcmp(insns, code, sizeof(code)));
+	ASSERT_EQ_UINT(seadragon_limn2k_schedule_cycles(insns, 5, NULL), 8);
+
+	ASSERT_EQ_UINT(seadragon_limn2k_schedule(insns, length, SEADRAGON_LIMN2K_SCHEDULE_WINDOW, NULL), 1);
+	ASSERT_EQ_UINT(seadragon_limn2k_schedule_cycles(insns, 5, NULL), 6);
+	ASSERT(insns[0].kind == LIMN2K_INSN_LI && insns[1].kind == LIMN2K_INSN_LOAD);
+	ASSERT(insns[2].op == OPERATION_MUL && insns[3].rd == 2 && insns[4].rd == 5);
+	ASSERT(!memcmp(insns + 5, code + 5, sizeof(code) - 5 * sizeof(code[0])));
+
+	// Stretches longer than the window are scheduled in pieces
+	memcpy(insns, code, sizeof(code));
+	ASSERT_EQ_UINT(seadragon_limn2k_schedule(insns, length, 2, NULL), 0);
+}
+
+TEST(ir_pool) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"fn main {-- ret} auto i "
+		"0 ret ! 0 i ! "
+		"while (i@ 10 <) ret@ i@ 3 * + ret ! i@ 1 + i ! end "
+		"end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	PRECONDITION(seadragon_sema(&session, &ast));
+	seadragon_function_t *function = ast.functions->items[0];
+
+	seadragon_ir_pool_t *pool = &function->pool;
+
+	// Each statement and condition is a contiguous range ending in its root,
+	// in layout order, and nothing else is left in the pool
+	uint32_t cursor = 0, conditions = 0;
+	for (unsigned int i = 0; i < function->u.blocks->length; i += 1) {
+		seadragon_block_t *block = function->u.blocks->items[i];
+		ASSERT((block->condition != SEADRAGON_IR_NONE) == (block->terminator == TERMINATOR_BRANCH));
+		for (uint32_t j = 0; j <= block->statement_count; j += 1) {
+			uint32_t root = j < block->statement_count ? block->statements[j] : block->condition;
+			if (root == SEADRAGON_IR_NONE) {
+				continue;
+			}
+			ASSERT(root >= cursor);
+			// Operands come before the nodes using them, within the range
+			for (uint32_t k = cursor; k <= root; k += 1) {
+				ASSERT(pool->left[k] == SEADRAGON_IR_NONE || (pool->left[k] >= cursor && pool->left[k] < k));
+				ASSERT(pool->right[k] == SEADRAGON_IR_NONE || (pool->right[k] >= cursor && pool->right[k] < k));
+				ASSERT(pool->op[k] != OPERATION_NONE || (pool->left[k] == SEADRAGON_IR_NONE && pool->right[k] == SEADRAGON_IR_NONE));
+			}
+			cursor = root + 1;
+		}
+		conditions += block->terminator == TERMINATOR_BRANCH;
+	}
+	ASSERT_EQ_UINT(cursor, pool->length);
+	ASSERT(conditions > 0);
+	// Stores to memory evaluate the value before the address
+	uint32_t address = seadragon_ir_literal(pool, 4);
+	uint32_t value = seadragon_ir_read(pool, function->outputs->items[0]);
+	seadragon_block_t *block = function->u.blocks->items[0];
+	seadragon_ir_insert(block, 0, seadragon_ir_node(pool, OPERATION_SLONG, address, value));
+	seadragon_ir_linearize(function);
+	ASSERT_EQ_UINT(pool->op[0], OPERATION_NONE);
+	ASSERT_EQ_UINT(pool->value[0].type, VALUE_TYPE_IDENTIFIER);
+	ASSERT_EQ_UINT(pool->op[1], OPERATION_GLONG);
+	ASSERT(seadragon_ir_is_literal(pool, 2, NULL));
+	ASSERT_EQ_UINT(block->statements[0], 3);
+	ASSERT_EQ_UINT(pool->right[3], 1);
+
+	seadragon_ir_pool_t copy;
+	seadragon_ir_pool_init(&copy);
+	seadragon_ir_pool_copy(&copy, pool);
+	ASSERT_EQ_UINT(copy.length, pool->length);
+	ASSERT(!memcmp(copy.op, pool->op, pool->length * sizeof(*pool->op)));
+	ASSERT(!memcmp(copy.left, pool->left, pool->length * sizeof(*pool->left)));
+	ASSERT(!memcmp(copy.right, pool->right, pool->length * sizeof(*pool->right)));
+	// Linearizing again changes nothing
+	seadragon_ir_linearize(function);
+	ASSERT_EQ_UINT(copy.length, pool->length);
+	ASSERT(!memcmp(copy.op, pool->op, pool->length * sizeof(*pool->op)));
+	ASSERT(!memcmp(copy.left, pool->left, pool->length * sizeof(*pool->left)));
+	seadragon_ir_pool_deinit(&copy);
+
+	// Codegen only reads the IR, so it may run again
+	char first[4096], second[4096];
+	char *bufs[2] = { first, second };
+	for (unsigned int i = 0; i < 2; i += 1) {
+		FILE *outfile = fmemopen(bufs[i], sizeof(first), "w+");
+		bool codegen_success = seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k);
+		long len = ftell(outfile);
+		fclose(outfile);
+		ASSERT(codegen_success && len >= 0);
+		bufs[i][len] = 0;
+	}
+	ASSERT_EQ_STR(second, first);
+	seadragon_session_deinit(&session);
+}
+
+TEST(buffers) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"buffer small 6 "
+		"buffer big 0x1000000 "
+		"const N 64 "
+		"buffer table N "
+		"fn main {-- v} "
+		"big @ table 4 + @ + v ! "
+		// small is only aligned to 2, so the bytes are stored as an int
+		"1 small 2 + sb 2 small 3 + sb "
+		"end ";
+	seadragon_ast_t ast;
+	char buf[4096];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	ASSERT_EQ_UINT(ast.buffers->length, 3);
+	seadragon_buffer_t *small = ast.buffers->items[2];
+	ASSERT_EQ_STR(small->name, "small");
+	ASSERT_EQ_UINT(small->size, 6);
+	ASSERT_EQ_UINT(small->alignment, 2);
+	seadragon_parse_free(&ast);
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tla 1, big\n"
+		"\tl.l 1, 1, 0\n"
+		"\tla 2, table\n"
+		"\tl.l 2, 2, 4\n"
+		"\tadd 10, 1, 2\n"
+		"\tli 1, 513\n"
+		"\tla 2, small\n"
+		"\ts.i 2, 2, 1\n"
+		"\tret\n"
+		".section bss\n"
+		".align 4\n"
+		"big:\n"
+		"\t.bytes 16777216 0\n"
+		"table:\n"
+		"\t.bytes 64 0\n"
+		"small:\n"
+		"\t.bytes 6 0\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(module) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char library[] =
+		"const LIMIT 100 "
+		"struct Node 4 next 4 value 1 tag endstruct "
+		"buffer pool 0x10000 "
+		"fn clamp {-- v} auto p "
+		"0x1000 @ p ! p@ Node_value + @ v ! "
+		"if (v@ LIMIT >) LIMIT v ! end "
+		"end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<library>", library, sizeof(library) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	PRECONDITION(seadragon_sema(&session, &ast));
+	char path[] = "/tmp/seadragon-module-XXXXXX";
+	int fd = mkstemp(path);
+	PRECONDITION(fd >= 0);
+	FILE *file = fdopen(fd, "w");
+	ASSERT(seadragon_module_write(&ast, file));
+	fclose(file);
+
+	seadragon_module_t module;
+	bool mapped = seadragon_module_map(&module, path);
+	unlink(path);
+	ASSERT(mapped);
+	const seadragon_module_header_t *header = seadragon_module_header(&module);
+	ASSERT_EQ_UINT(header->constants.count, 1);
+	ASSERT_EQ_UINT(header->structures.count, 1);
+	ASSERT_EQ_UINT(header->buffers.count, 1);
+	ASSERT_EQ_UINT(header->functions.count, 1);
+	uint32_t value;
+	ASSERT(seadragon_module_lookup(&module, "LIMIT", &value));
+	ASSERT_EQ_UINT(value, 100);
+	ASSERT(seadragon_module_lookup(&module, "Node_value", &value));
+	ASSERT_EQ_UINT(value, 4);
+	ASSERT(seadragon_module_lookup(&module, "Node_SIZEOF", &value));
+	ASSERT_EQ_UINT(value, 12);
+	ASSERT(!seadragon_module_lookup(&module, "Node_missing", &value));
+	ASSERT(!seadragon_module_lookup(&module, "LIMITS", &value));
+
+	// The IR is read in place: the entry block starts with `0x1000 @ p !`
+	const seadragon_module_function_t *function = seadragon_module_record(&module, &header->functions, 0, sizeof(*function));
+	ASSERT_EQ_STR(seadragon_module_string(&module, function->name), "clamp");
+	const seadragon_module_block_t *entry = seadragon_module_record(&module, &header->blocks, function->blocks, sizeof(*entry));
+	ASSERT(entry->terminator == TERMINATOR_BRANCH && entry->statement_count == 2);
+	const uint32_t *root = seadragon_module_record(&module, &header->statements, entry->statements, sizeof(*root));
+	const seadragon_module_node_t *node = seadragon_module_record(&module, &header->nodes, *root, sizeof(*node));
+	ASSERT(node->type == SEADRAGON_MODULE_NODE_OPERATION && node->op == OPERATION_SLONG);
+	const seadragon_module_node_t *left = seadragon_module_record(&module, &header->nodes, node->a, sizeof(*left));
+	ASSERT(left->type == SEADRAGON_MODULE_NODE_VARIABLE);
+	ASSERT_EQ_STR(seadragon_module_string(&module, left->a), "p");
+
+	// A dependent program resolves the library's symbols without its source
+	static const char program[] = "fn main {-- v} 0x2000 @ Node_next + @ LIMIT + v ! end ";
+	PRECONDITION(seadragon_lexer_init(&lexer, "<program>", program, sizeof(program) - 1));
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	list_add(ast.modules, &module);
+	ASSERT(seadragon_sema(&session, &ast));
+	char buf[4096];
+	FILE *outfile = fmemopen(buf, sizeof(buf), "w+");
+	bool codegen_success = seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k);
+	long len = ftell(outfile);
+	fclose(outfile);
+	ASSERT(codegen_success && len >= 0);
+	buf[len] = 0;
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tl.l 1, 0, 8192\n"
+		"\tl.l 1, 1, 0\n"
+		"\taddi 10, 1, 100\n"
+		"\tret\n");
+
+	// Images from another version are rejected
+	seadragon_module_header_t empty;
+	memset(&empty, 0, sizeof(empty));
+	memcpy(empty.magic, header->magic, sizeof(empty.magic));
+	empty.version = header->version;
+	empty.byte_order = header->byte_order;
+	empty.size = sizeof(empty);
+	seadragon_module_t other;
+	ASSERT(seadragon_module_open(&other, &empty, sizeof(empty)));
+	empty.version += 1;
+	ASSERT(!seadragon_module_open(&other, &empty, sizeof(empty)));
+	seadragon_module_unmap(&module);
+	seadragon_session_deinit(&session);
+}
+
+TEST(driver) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char a[] = "const N 4 struct P 4 x 4 y endstruct ";
+	static const char b[] = "fn main {-- v} 0x1000 @ P_y + @ N + v ! end ";
+	static const char c[] = "buffer scratch 64 fn other {--} 1 scratch ! end ";
+	seadragon_source_t sources[] = {
+		{ "a.df", a, sizeof(a) - 1 },
+		{ "b.df", b, sizeof(b) - 1 },
+		{ "c.df", c, sizeof(c) - 1 },
+	};
+	char buf[4096];
+	FILE *outfile = fmemopen(buf, sizeof(buf), "w+");
+	session.threads = 3;
+	bool codegen_success = seadragon_driver_compile(&session, sources, 3, outfile, seadragon_backend_limn2k);
+	long len = ftell(outfile);
+	fclose(outfile);
+	ASSERT(codegen_success && len >= 0);
+	buf[len] = 0;
+	// Declarations from every file are visible to the others, in file order
+	ASSERT_EQ_STR(buf,
+		"main:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tl.l 1, 1, 4\n"
+		"\taddi 10, 1, 4\n"
+		"\tret\n"
+		"other:\n"
+		"\tli 1, 1\n"
+		"\tla 2, scratch\n"
+		"\ts.l 2, 0, 1\n"
+		"\tret\n"
+		".section bss\n"
+		".align 4\n"
+		"scratch:\n"
+		"\t.bytes 64 0\n");
+
+	seadragon_source_t duplicate[] = {
+		{ "a.df", a, sizeof(a) - 1 },
+		{ "a2.df", a, sizeof(a) - 1 },
+	};
+	seadragon_ast_t program;
+	session.threads = 2;
+	ASSERT(!seadragon_driver_parse(&session, &program, duplicate, 2));
+	seadragon_session_deinit(&session);
+}
+
+TEST(split_parse) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char source[] =
+		"#!/usr/bin/env seadragon\n"
+		"const N 4\n"
+		"fn first {-- v} auto p\n"
+		"\t0x1000 @ p !\n"
+		"\tp@ N + @ v !\n"
+		"end\n"
+		"struct P 4 x 4 y endstruct buffer scratch 16\n"
+		"fn second {--} 1 scratch P_y + ! end buffer fn_buf 4 fn third {-- v}\n"
+		"  0x2000 @ v !\n"
+		"\twhile (v@ 10 <) v@ 1 + v ! end\n"
+		"end\n"
+		"const M 8 fn fourth {--} M scratch ! end";
+	size_t length = sizeof(source) - 1;
+
+	// Every split starts at an `fn`, and a lexer over the rest of the source
+	// from there produces the same tokens at the same positions
+	seadragon_lexer_split_t splits[8];
+	size_t split_count = seadragon_lexer_split(source, length, 1, splits, 8);
+	ASSERT_EQ_UINT(split_count, 4);
+	seadragon_lexer_t whole;
+	PRECONDITION(seadragon_lexer_init(&whole, "<split>", source, length));
+	for (size_t i = 0; i < split_count; i += 1) {
+		seadragon_token_t token;
+		do {
+			token = seadragon_lexer_next(&whole, SEADRAGON_LEXER_CATEGORY_PARSER);
+		} while (token.ptr - whole.src < (ptrdiff_t)splits[i].offset);
+		seadragon_lexer_t chunk;
+		PRECONDITION(seadragon_lexer_init(&chunk, "<split>", source + splits[i].offset, length - splits[i].offset));
+		chunk.pos = splits[i].pos;
+		for (;;) {
+			seadragon_token_t expected = token, actual = seadragon_lexer_next(&chunk, SEADRAGON_LEXER_CATEGORY_PARSER);
+			ASSERT_EQ_UINT(actual.kind, expected.kind);
+			ASSERT_EQ_UINT(actual.range.head.line, expected.range.head.line);
+			ASSERT_EQ_UINT(actual.range.head.col, expected.range.head.col);
+			ASSERT_EQ_UINT(actual.range.tail.line, expected.range.tail.line);
+			ASSERT_EQ_UINT(actual.range.tail.col, expected.range.tail.col);
+			if (actual.kind == SEADRAGON_TK_EOF) {
+				break;
+			}
+			token = seadragon_lexer_next(&whole, SEADRAGON_LEXER_CATEGORY_PARSER);
+		}
+		seadragon_lexer_deinit(&chunk);
+		seadragon_lexer_deinit(&whole);
+		PRECONDITION(seadragon_lexer_init(&whole, "<split>", source, length));
+	}
+	seadragon_lexer_deinit(&whole);
+
+	// The chunked parse compiles to exactly what the serial one does
+	char serial[4096], chunked[4096];
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<split>", source, length));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	PRECONDITION(seadragon_sema(&session, &ast));
+	FILE *outfile = fmemopen(serial, sizeof(serial), "w+");
+	ASSERT(seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k));
+	long len = ftell(outfile);
+	fclose(outfile);
+	ASSERT(len > 0);
+	serial[len] = 0;
+
+	seadragon_source_t sources[] = { { "<split>", source, length } };
+	session.threads = 4;
+	session.chunk_size = 1;
+	ASSERT(seadragon_driver_parse(&session, &ast, sources, 1));
+	ASSERT_EQ_UINT(ast.functions->length, 4);
+	ASSERT_EQ_STR(((seadragon_function_t*)ast.functions->items[3])->name, "fourth");
+	PRECONDITION(seadragon_sema(&session, &ast));
+	outfile = fmemopen(chunked, sizeof(chunked), "w+");
+	ASSERT(seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k));
+	len = ftell(outfile);
+	fclose(outfile);
+	ASSERT(len > 0);
+	chunked[len] = 0;
+	ASSERT_EQ_STR(chunked, serial);
+	seadragon_session_deinit(&session);
+}
+
+TEST(stream) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char source[] =
+		"const N 4 struct P 4 x 4 y endstruct buffer scratch 16\n"
+		"fn first {-- v} auto p\n"
+		"\t0x1000 @ p ! p@ P_y + @ N + v !\n"
+		"\tif (v@ 10 >) 10 v ! end\n"
+		"end\n"
+		"const M (N 2 *) buffer wide M\n"
+		"fn second {-- v}\n"
+		"\t0 v ! while (v@ M <) v@ 1 + v ! end\n"
+		"\tv@ wide ! 1 scratch P_x + !\n"
+		"end\n";
+	seadragon_source_t sources[] = { { "<stream>", source, sizeof(source) - 1 } };
+	char whole[4096], streamed[4096];
+	FILE *outfile = fmemopen(whole, sizeof(whole), "w+");
+	ASSERT(seadragon_driver_compile(&session, sources, 1, outfile, seadragon_backend_limn2k));
 	long len = ftell(outfile);
-	ASSERT(len >= 0);
+	fclose(outfile);
+	ASSERT(len > 0);
+	whole[len] = 0;
+	outfile = fmemopen(streamed, sizeof(streamed), "w+");
+	ASSERT(seadragon_driver_stream(&session, sources, 1, outfile, seadragon_backend_limn2k));
+	len = ftell(outfile);
+	fclose(outfile);
+	ASSERT(len > 0);
+	streamed[len] = 0;
+	ASSERT_EQ_STR(streamed, whole);
+
+	// Streaming to stdout writes nothing else there, however the functions are parsed
+	FILE *capture = tmpfile();
+	PRECONDITION(capture != NULL);
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	PRECONDITION(saved >= 0 && dup2(fileno(capture), STDOUT_FILENO) >= 0);
+	bool streamed_success = seadragon_driver_stream(&session, sources, 1, stdout, seadragon_backend_limn2k);
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	ASSERT(streamed_success);
+	rewind(capture);
+	len = fread(streamed, 1, sizeof(streamed) - 1, capture);
+	fclose(capture);
+	streamed[len] = 0;
+	ASSERT_EQ_STR(streamed, whole);
+
+	// Declarations must precede the uses in earlier functions
+	static const char late[] = "fn early {-- v} LATE v ! end fn later {--} end const LATE 1";
+	seadragon_source_t forward[] = { { "<late>", late, sizeof(late) - 1 } };
+	outfile = fmemopen(streamed, sizeof(streamed), "w+");
+	ASSERT(!seadragon_driver_stream(&session, forward, 1, outfile, seadragon_backend_limn2k));
+	fclose(outfile);
+	seadragon_session_deinit(&session);
+}
+
+TEST(profile) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char source[] =
+		"fn unused {--} 0 0x2000 ! end "
+		"fn pick {-- v} auto p "
+		"0x1000 @ p ! "
+		"if (p@ 10 >) 1 v ! else 2 v ! end "
+		"end ";
+	char map[256], buf[4096];
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<profile>", source, sizeof(source) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	PRECONDITION(seadragon_sema(&session, &ast));
+	FILE *mapfile = fmemopen(map, sizeof(map), "w+");
+	ASSERT(seadragon_profile_instrument(&ast, mapfile));
+	long len = ftell(mapfile);
+	fclose(mapfile);
+	map[len] = 0;
+	FILE *outfile = fmemopen(buf, sizeof(buf), "w+");
+	ASSERT(seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k));
+	len = ftell(outfile);
 	fclose(outfile);
 	buf[len] = 0;
-	printf("Generated code: \n========\n%s========\n", buf);
-	ASSERT(codegen_success && "delayed assertion so partially generated code prints");
+	// Every block starts by incrementing its counter
+	ASSERT_EQ_STR(buf,
+		"unused:\n"
+		"\tla 1, __profile_counters\n"
+		"\tl.l 1, 1, 0\n"
+		"\tla 2, __profile_counters\n"
+		"\taddi 1, 1, 1\n"
+		"\ts.l 2, 0, 1\n"
+		"\tli 1, 0\n"
+		"\ts.l 0, 8192, 1\n"
+		"\tret\n"
+		"pick:\n"
+		"\tla 1, __profile_counters\n"
+		"\tl.l 1, 1, 4\n"
+		"\tla 2, __profile_counters\n"
+		"\taddi 1, 1, 1\n"
+		"\ts.l 2, 4, 1\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tli 2, 10\n"
+		"\tble 1, 2, .pick.3\n"
+		"\tla 2, __profile_counters\n"
+		"\tl.l 2, 2, 8\n"
+		"\tla 3, __profile_counters\n"
+		"\taddi 2, 2, 1\n"
+		"\ts.l 3, 8, 2\n"
+		"\tli 10, 1\n"
+		"\tb .pick.2\n"
+		".pick.3:\n"
+		"\tla 2, __profile_counters\n"
+		"\tl.l 2, 2, 12\n"
+		"\tla 3, __profile_counters\n"
+		"\taddi 2, 2, 1\n"
+		"\ts.l 3, 12, 2\n"
+		"\tli 10, 2\n"
+		".pick.2:\n"
+		"\tla 2, __profile_counters\n"
+		"\tl.l 2, 2, 16\n"
+		"\tla 3, __profile_counters\n"
+		"\taddi 2, 2, 1\n"
+		"\ts.l 3, 16, 2\n"
+		"\tret\n"
+		".section bss\n"
+		".align 4\n"
+		"__profile_counters:\n"
+		"\t.bytes 20 0\n");
+	ASSERT_EQ_STR(map,
+		"unused 0 0\n"
+		"pick 0 1\n"
+		"pick 1 2\n"
+		"pick 3 3\n"
+		"pick 2 4\n");
+
+	// A run in which the else arm was the hot one, and unused never ran
+	static const uint32_t counters[] = { 0, 5, 1, 4, 5 };
+	char text[256];
+	mapfile = fmemopen(map, strlen(map), "r");
+	FILE *profilefile = fmemopen(text, sizeof(text), "w+");
+	ASSERT(seadragon_profile_dump(mapfile, counters, 5, profilefile));
+	len = ftell(profilefile);
+	fclose(mapfile);
+	fclose(profilefile);
+	text[len] = 0;
+	ASSERT_EQ_STR(text,
+		"# seadragon profile\n"
+		"unused 0 0\n"
+		"pick 0 5\n"
+		"pick 1 1\n"
+		"pick 3 4\n"
+		"pick 2 5\n");
+	profilefile = fmemopen(text, strlen(text), "r");
+	seadragon_profile_t *profile = seadragon_profile_read(profilefile);
+	fclose(profilefile);
+	ASSERT(profile);
+	seadragon_parse_free(&ast);
+
+	PRECONDITION(seadragon_lexer_init(&lexer, "<profile>", source, sizeof(source) - 1));
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	ast.profile = profile;
+	PRECONDITION(seadragon_sema(&session, &ast));
+	outfile = fmemopen(buf, sizeof(buf), "w+");
+	ASSERT(seadragon_cg(&session, &ast, outfile, seadragon_backend_limn2k));
+	len = ftell(outfile);
+	fclose(outfile);
+	buf[len] = 0;
+	seadragon_profile_free(profile);
+	seadragon_parse_free(&ast);
+	// The else arm falls through, and the function that never ran moves last
+	ASSERT_EQ_STR(buf,
+		"pick:\n"
+		"\tl.l 1, 0, 4096\n"
+		"\tli 2, 10\n"
+		"\tbgt 1, 2, .pick.1\n"
+		"\tli 10, 2\n"
+		"\tret\n"
+		".pick.1:\n"
+		"\tli 10, 1\n"
+		"\tret\n"
+		"unused:\n"
+		"\tli 1, 0\n"
+		"\ts.l 0, 8192, 1\n"
+		"\tret\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(c_backend) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"buffer table 16 "
+		"fn main {-- sum} auto i "
+		"0 sum ! 0 i ! "
+		"while (i@ 4 <) "
+			"i@ 3 * table i@ 4 * + ! "
+			"sum@ table i@ 4 * + @ + sum ! "
+			"i@ 1 + i ! "
+		"end "
+		"end ";
+	char buf[8192];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_c99, NULL, buf, sizeof(buf)));
+	char *code = strstr(buf, "\nvoid df_main");
+	ASSERT(code != NULL);
+	ASSERT_EQ_STR(code,
+		"\n"
+		"void df_main(uint32_t *o_sum) {\n"
+		"\textern const uint32_t df_buffer_table;\n"
+		"\tuint32_t l_sum = 0;\n"
+		"\tuint32_t l_i = 0;\n"
+		"\tuint32_t x_1 = 0;\n"
+		"\tuint32_t x_2 = 0;\n"
+		"\tuint32_t t4;\n"
+		"\tuint32_t t5;\n"
+		"\tl_sum = 0u;\n"
+		"\tl_i = 0u;\n"
+		"\tt4 = 4u;\n"
+		"\tif (l_i >= t4) goto L3;\n"
+		"\tt4 = df_buffer_table;\n"
+		"\tt5 = df_lsh(l_i, 2u);\n"
+		"\tx_1 = t4 + t5;\n"
+		"\tx_2 = l_i * 3u;\n"
+		"\tt4 = 4u;\n"
+		"\tl_i = t4 - l_i;\n"
+		"L2:;\n"
+		"\tdf_s_l(x_1, x_2);\n"
+		"\tt4 = df_l_l(x_1);\n"
+		"\tl_sum = l_sum + t4;\n"
+		"\tl_i = l_i - 1u;\n"
+		"\tx_2 = x_2 + 3u;\n"
+		"\tx_1 = x_1 + 4u;\n"
+		"\tif (l_i != 0) goto L2;\n"
+		"L3:;\n"
+		"\t*o_sum = l_sum;\n"
+		"\treturn;\n"
+		"}\n"
+		"\n"
+		"const uint32_t df_buffer_table = SEADRAGON_BSS + 0u;\n");
+	seadragon_session_deinit(&session);
+}
+
+TEST(jit) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"buffer table 16 "
+		"fn sum {-- total} auto i "
+		"0 total ! 0 i ! "
+		"while (i@ 4 <) "
+			"i@ 3 * table i@ 4 * + ! "
+			"total@ table i@ 4 * + @ + total ! "
+			"i@ 1 + i ! "
+		"end "
+		"end "
+		// Enough live values to spill, and the operations x86 treats differently
+		"fn mixed {-- low high} auto a auto b auto c auto d auto e auto f auto g auto h auto i auto j auto k "
+		"table@ 40 + a ! a@ 1 + b ! b@ 1 + c ! c@ 1 + d ! d@ 1 + e ! e@ 1 + f ! "
+		"f@ 1 + g ! g@ 1 + h ! h@ 1 + i ! i@ 1 + j ! j@ 1 + k ! "
+		"0x1234 table 4 + si 0xFF table 7 + sb "
+		"a@ b@ + c@ + d@ + e@ + f@ + g@ + h@ + i@ + j@ + k@ + low ! "
+		"low@ 7 / low@ a@ k@ - / + low ! "
+		"a@ 100 - high ! "
+		"high@ high@ << high@ 8 >> + table 4 + gi + table 7 + gb + high ! "
+		"end "
+		// Variables read before they are written, in registers and in slots
+		"fn fresh {-- v w} auto a auto b auto c auto d auto e auto f auto g auto h auto i auto j auto k "
+		"a@ b@ + c@ + d@ + e@ + f@ + g@ + h@ + i@ + j@ + k@ + v ! "
+		"end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	ASSERT(seadragon_sema(&session, &ast));
+
+	char map[256];
+	FILE *mapfile = fmemopen(map, sizeof(map), "w+");
+	seadragon_jit_t *jit = seadragon_jit_compile(&session, &ast, mapfile);
+	long len = ftell(mapfile);
+	fclose(mapfile);
+	ASSERT(jit != NULL && len >= 0);
+	map[len] = 0;
+	printf("Map: \n========\n%s========\n", map);
+	ASSERT(strstr(map, " sum\n") && strstr(map, " mixed\n"));
+	seadragon_jit_function_t sum = seadragon_jit_lookup(jit, "sum"), mixed = seadragon_jit_lookup(jit, "mixed");
+	uint32_t table;
+	ASSERT(sum && mixed && !seadragon_jit_lookup(jit, "missing"));
+	ASSERT(seadragon_jit_buffer(jit, "table", &table));
+	ASSERT_EQ_UINT(table, SEADRAGON_JIT_BSS);
+
+	uint8_t *memory = seadragon_jit_memory();
+	PRECONDITION(memory != NULL);
+	uint32_t outputs[2] = { 0 };
+	sum(outputs, memory);
+	ASSERT_EQ_UINT(outputs[0], 18);
+	ASSERT_EQ_UINT(memory[table + 8], 6);
+	// table[0] was left at 0 by sum, so a = 40 and k = 50
+	mixed(outputs, memory);
+	ASSERT_EQ_UINT(outputs[0], 495 / 7 + 495 / (uint32_t)-10);
+	ASSERT_EQ_UINT(outputs[1], ((uint32_t)-60 >> 8) + 0x1234 + 0xFF);
+	seadragon_jit_function_t fresh = seadragon_jit_lookup(jit, "fresh");
+	ASSERT(fresh != NULL);
+	outputs[0] = outputs[1] = UINT32_MAX;
+	fresh(outputs, memory);
+	ASSERT_EQ_UINT(outputs[0], 0);
+	ASSERT_EQ_UINT(outputs[1], 0);
+	seadragon_jit_memory_free(memory);
+	seadragon_jit_free(jit);
+	seadragon_session_deinit(&session);
+}
+
+TEST(interp) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"buffer table 16 "
+		"buffer bytes 3 "
+		"fn sum {-- total count} auto i "
+		"0 total ! 0 i ! "
+		"while (i@ 4 <) "
+			"i@ 3 * table i@ 4 * + ! "
+			"total@ table i@ 4 * + @ + total ! "
+			"i@ 1 + i ! "
+		"end "
+		"i@ count ! "
+		"end "
+		"fn mixed {-- low high} auto a auto b "
+		"table 4 + @ 7 - a ! 0x1234 bytes si 0xFF bytes 2 + sb "
+		"a@ 1 - 3 / low ! "
+		"if (a@ 10 >=) a@ a@ << a@ 30 >> + bytes gi + bytes 2 + gb + high ! "
+		"else 1 high ! end "
+		"end "
+		"fn divide {-- q} auto z 0 z ! 5 z@ / q ! end "
+		"fn wild {-- v} 0xFFFFFFFE @ v ! end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	ASSERT(seadragon_sema(&session, &ast));
+
+	seadragon_interp_t *interp = seadragon_interp_compile(&ast, 4096);
+	ASSERT(interp != NULL);
+	unsigned int outputs;
+	ASSERT(seadragon_interp_lookup(interp, "sum", &outputs) && outputs == 2);
+	ASSERT(!seadragon_interp_lookup(interp, "missing", NULL));
+	uint32_t table, bytes;
+	ASSERT(seadragon_interp_buffer(interp, "table", &table) && seadragon_interp_buffer(interp, "bytes", &bytes));
+	// Laid out at the end of memory
+	ASSERT_EQ_UINT(table, 4096 - 20);
+	ASSERT_EQ_UINT(bytes, 4096 - 4);
+
+	uint32_t results[2] = { 0 }, expected[2];
+	ASSERT(seadragon_interp_run(interp, "sum", results));
+	ASSERT_EQ_UINT(results[0], 18);
+	ASSERT_EQ_UINT(results[1], 4);
+	uint8_t *memory = seadragon_interp_memory(interp, NULL);
+	ASSERT_EQ_UINT(memory[table + 8], 6);
+	ASSERT(seadragon_interp_run(interp, "mixed", results));
+	ASSERT_EQ_UINT(results[0], (uint32_t)-5 / 3);
+	ASSERT_EQ_UINT(results[1], ((uint32_t)-4 >> 30) + 0x1234 + 0xFF);
+	ASSERT(!seadragon_interp_run(interp, "divide", results));
+	ASSERT(!seadragon_interp_run(interp, "wild", results));
+
+	// The same IR through the JIT must agree, with memory set up alike
+	memcpy(expected, results, sizeof(expected));
+	ASSERT(seadragon_interp_run(interp, "mixed", expected));
+	seadragon_jit_t *jit = seadragon_jit_compile(&session, &ast, NULL);
+	uint8_t *host = seadragon_jit_memory();
+	PRECONDITION(jit != NULL && host != NULL);
+	seadragon_jit_lookup(jit, "sum")(results, host);
+	seadragon_jit_lookup(jit, "mixed")(results, host);
+	ASSERT_EQ_UINT(results[0], expected[0]);
+	ASSERT_EQ_UINT(results[1], expected[1]);
+	seadragon_jit_memory_free(host);
+	seadragon_jit_free(jit);
+	seadragon_interp_free(interp);
+	seadragon_session_deinit(&session);
+}
+
+TEST(limn2k_sim) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	// A multiply feeding an add stalls for the rest of its latency
+	static const char chain[] =
+		"f:\n"
+		"\tli 1, 6\n"
+		"\tli 2, 3\n"
+		"\tmul 3, 1, 2\n"
+		"\taddi 10, 3, 1\n"
+		"\tret\n";
+	seadragon_limn2k_sim_t *sim = seadragon_limn2k_sim_assemble(chain, sizeof(chain) - 1, 16, NULL);
+	ASSERT(sim != NULL);
+	uint32_t results[2] = { 0 }, expected[2];
+	ASSERT(seadragon_limn2k_sim_run(sim, "f", results));
+	ASSERT_EQ_UINT(results[0], 19);
+	seadragon_limn2k_sim_stats_t stats;
+	ASSERT(seadragon_limn2k_sim_stats(sim, "f", &stats));
+	ASSERT_EQ_UINT(stats.instructions, 5);
+	ASSERT_EQ_UINT(stats.cycles, 7);
+	ASSERT_EQ_UINT(stats.stalls, 2);
+	ASSERT(!seadragon_limn2k_sim_run(sim, "missing", results));
+	seadragon_limn2k_sim_free(sim);
+	ASSERT(seadragon_limn2k_sim_assemble("f:\n\tfrob 1\n", 11, 16, NULL) == NULL);
+	ASSERT(seadragon_limn2k_sim_assemble("f:\n\tb .f.1\n", 11, 16, NULL) == NULL);
+
+	static const char src[] =
+		"buffer table 16 "
+		"buffer bytes 3 "
+		"fn sum {-- total count} auto i "
+		"0 total ! 0 i ! "
+		"while (i@ 4 <) "
+			"i@ 3 * table i@ 4 * + ! "
+			"total@ table i@ 4 * + @ + total ! "
+			"i@ 1 + i ! "
+		"end "
+		"i@ count ! "
+		"end "
+		"fn mixed {-- low high} auto a auto b "
+		"table 4 + @ 7 - a ! 0x1234 bytes si 0xFF bytes 2 + sb "
+		"a@ 1 - 3 / low ! "
+		"if (a@ 10 >=) a@ a@ << a@ 30 >> + bytes gi + bytes 2 + gb + high ! "
+		"else 1 high ! end "
+		"end "
+		"fn divide {-- q} auto z 0 z ! 5 z@ / q ! end ";
+	seadragon_ast_t ast;
+	char buf[8192];
+	ASSERT(compile_to_string(&session, src, seadragon_backend_limn2k, &ast, buf, sizeof(buf)));
+	seadragon_interp_t *interp = seadragon_interp_compile(&ast, 4096);
+	PRECONDITION(interp != NULL);
+	ASSERT(seadragon_interp_run(interp, "sum", results));
+	ASSERT(seadragon_interp_run(interp, "mixed", expected));
+	seadragon_interp_free(interp);
+	seadragon_parse_free(&ast);
+
+	sim = seadragon_limn2k_sim_assemble(buf, strlen(buf), 4096, NULL);
+	ASSERT(sim != NULL);
+	uint32_t table;
+	ASSERT(seadragon_limn2k_sim_symbol(sim, "table", &table));
+	ASSERT_EQ_UINT(table, 4096 - 20);
+
+	// Agrees with the interpreter on results
+	ASSERT(seadragon_limn2k_sim_run(sim, "sum", results));
+	ASSERT_EQ_UINT(results[0], 18);
+	ASSERT_EQ_UINT(results[1], 4);
+	ASSERT(seadragon_limn2k_sim_run(sim, "mixed", results));
+	ASSERT_EQ_UINT(results[0], expected[0]);
+	ASSERT_EQ_UINT(results[1], expected[1]);
+	ASSERT(!seadragon_limn2k_sim_run(sim, "divide", results));
+
+	// Exact counts guard against regressions in the generated code
+	ASSERT(seadragon_limn2k_sim_stats(sim, "sum", &stats));
+	ASSERT_EQ_UINT(stats.instructions, 39);
+	ASSERT_EQ_UINT(stats.cycles, 46);
+	ASSERT(seadragon_limn2k_sim_stats(sim, "mixed", &stats));
+	ASSERT_EQ_UINT(stats.instructions, 23);
+	ASSERT_EQ_UINT(stats.cycles, 25);
+	seadragon_limn2k_sim_report(sim, stdout, 5);
+	seadragon_limn2k_sim_free(sim);
+	seadragon_session_deinit(&session);
+}
+
+/// A compile of its own, in its own session, for running several at once.
+TEST(link) {
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	static const char src[] =
+		"buffer table 16 "
+		"fn first {-- v} table @ 1 + v ! end "
+		"fn second {-- v} table @ 1 + v ! end "
+		"fn other {-- v} table 4 + @ 1 + v ! end "
+		"fn unused {-- v} 7 v ! end "
+		"fn third {-- v} table @ 1 + v ! end ";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	seadragon_ast_t ast;
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	PRECONDITION(seadragon_sema(&session, &ast));
+	list_t *roots = list_create();
+	list_add(roots, "first");
+	list_add(roots, "second");
+	list_add(roots, "other");
+	list_add(roots, "third");
+	session.roots = roots;
+	session.fold = true;
+	char output[4096];
+	FILE *out = fmemopen(output, sizeof(output), "w+");
+	PRECONDITION(out != NULL);
+	ASSERT(seadragon_cg(&session, &ast, out, seadragon_backend_limn2k));
+	long length = ftell(out);
+	fclose(out);
+	PRECONDITION(length > 0);
+	output[length] = 0;
+
+	// Identical bodies become aliases of the first, and unreachable ones go
+	ASSERT(strstr(output, "first:\n"));
+	ASSERT(strstr(output, "other:\n"));
+	ASSERT(strstr(output, ".alias second first\n"));
+	ASSERT(strstr(output, ".alias third first\n"));
+	ASSERT(!strstr(output, "second:"));
+	ASSERT(!strstr(output, "unused"));
+	ASSERT(strstr(output, "; Folded 2 identical functions, saving "));
+	ASSERT(strstr(output, "; Dropped 1 unreachable functions, saving 8 bytes\n"));
+
+	// Aliases run the code they name
+	seadragon_limn2k_sim_t *sim = seadragon_limn2k_sim_assemble(output, length, 4096, NULL);
+	PRECONDITION(sim != NULL);
+	size_t size;
+	uint8_t *memory = seadragon_limn2k_sim_memory(sim, &size);
+	uint32_t table;
+	PRECONDITION(seadragon_limn2k_sim_symbol(sim, "table", &table));
+	memory[table] = 41;
+	uint32_t results[2] = { 0 };
+	ASSERT(seadragon_limn2k_sim_run(sim, "third", results));
+	ASSERT_EQ_UINT(results[0], 42);
+	ASSERT(!seadragon_limn2k_sim_run(sim, "unused", results));
+	seadragon_limn2k_sim_free(sim);
+	ASSERT(seadragon_limn2k_sim_assemble(".alias g f\n", 11, 16, NULL) == NULL);
+	list_free(roots);
+	seadragon_session_deinit(&session);
+}
+
+typedef struct {
+	seadragon_source_t source;
+	char output[4096];
+	bool success;
+} session_job_t;
+
+static void *session_compile(void *context) {
+	session_job_t *job = context;
+	seadragon_session_t session;
+	seadragon_session_init(&session, NULL);
+	session.threads = 1;
+	FILE *out = fmemopen(job->output, sizeof(job->output), "w+");
+	job->success = out && seadragon_driver_compile(&session, &job->source, 1, out, seadragon_backend_limn2k);
+	if (out) {
+		long length = ftell(out);
+		fclose(out);
+		job->output[length < 0 ? 0 : length] = 0;
+	}
+	job->success = job->success && !session.errors;
+	seadragon_session_deinit(&session);
+	return NULL;
+}
+
+TEST(session) {
+	// Diagnostics go to the session's sink, and errors are counted
+	char *log = NULL;
+	size_t log_length = 0;
+	FILE *diagnostics = open_memstream(&log, &log_length);
+	PRECONDITION(diagnostics != NULL);
+	seadragon_session_t session;
+	seadragon_session_init(&session, diagnostics);
+	static const char bad[] = "fn f {-- v}\n\t1 v ! = end";
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "bad.df", bad, sizeof(bad) - 1));
+	seadragon_ast_t ast;
+	ASSERT(!seadragon_parse(&session, &ast, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	ASSERT_EQ_UINT(session.errors, 1);
+	ASSERT(seadragon_session_failed(&session));
+	fflush(diagnostics);
+	ASSERT(strstr(log, "bad.df:2:8: error: Lexer: Unexpected character '='"));
+	seadragon_session_deinit(&session);
+
+	// Backend errors fail codegen without unwinding through it
+	seadragon_session_init(&session, diagnostics);
+	static const char wide[] = "fn three {-- a b c} 1 a ! 2 b ! 3 c ! end";
+	PRECONDITION(seadragon_lexer_init(&lexer, "wide.df", wide, sizeof(wide) - 1));
+	PRECONDITION(seadragon_parse(&session, &ast, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	PRECONDITION(seadragon_sema(&session, &ast));
+	FILE *out = fopen("/dev/null", "w");
+	PRECONDITION(out != NULL);
+	ASSERT(!seadragon_cg(&session, &ast, out, seadragon_backend_limn2k));
+	fclose(out);
+	ASSERT_EQ_UINT(session.errors, 1);
+	fflush(diagnostics);
+	ASSERT(strstr(log, "error: limn2k: TODO: outputs.length > 2"));
+	seadragon_session_deinit(&session);
+	fclose(diagnostics);
+	free(log);
+
+	// Sessions share nothing, so compiles may run on several threads at once
+	static const char program[] = "const N 4 fn main {-- v} auto i "
+		"0 i ! 0 v ! while (i@ N <) v@ i@ + v ! i@ 1 + i ! end end";
+	session_job_t jobs[4];
+	pthread_t threads[4];
+	for (unsigned int i = 0; i < 4; i += 1) {
+		jobs[i].source = (seadragon_source_t){ "<session>", program, sizeof(program) - 1 };
+		PRECONDITION(!pthread_create(&threads[i], NULL, session_compile, &jobs[i]));
+	}
+	for (unsigned int i = 0; i < 4; i += 1) {
+		pthread_join(threads[i], NULL);
+		ASSERT(jobs[i].success);
+		ASSERT_EQ_STR(jobs[i].output, jobs[0].output);
+	}
+	ASSERT(strstr(jobs[0].output, "main:"));
+}
+
+/// Prints the declarations of an ast, to compare parses.
+static char *describe_ast(seadragon_ast_t *ast) {
+	char *text = NULL;
+	size_t length = 0;
+	FILE *out = open_memstream(&text, &length);
+	for (unsigned int i = 0; i < ast->functions->length; i += 1) {
+		seadragon_function_t *function = ast->functions->items[i];
+		fprintf(out, "fn %s {--", function->name);
+		for (unsigned int j = 0; j < function->outputs->length; j += 1) {
+			fprintf(out, " %s", (char*)function->outputs->items[j]);
+		}
+		fprintf(out, "}");
+		for (unsigned int j = 0; j < function->autos->length; j += 1) {
+			fprintf(out, " auto %s", (char*)function->autos->items[j]);
+		}
+		for (unsigned int j = 0; j < function->u.instructions->length; j += 1) {
+			seadragon_instruction_t *instruction = function->u.instructions->items[j];
+			fprintf(out, " %d", instruction->type);
+			if (instruction->argument && instruction->argument->type == VALUE_TYPE_LITERAL) {
+				fprintf(out, ":%u", instruction->argument->u.literal);
+			}
+			else if (instruction->argument) {
+				fprintf(out, ":%s", instruction->argument->u.identifier);
+			}
+		}
+		fprintf(out, "\n");
+	}
+	for (unsigned int i = 0; i < ast->constants->length; i += 1) {
+		seadragon_constant_t *constant = ast->constants->items[i];
+		fprintf(out, "const %s %u\n", constant->name, constant->expression->length);
+	}
+	for (unsigned int i = 0; i < ast->buffers->length; i += 1) {
+		seadragon_buffer_t *buffer = ast->buffers->items[i];
+		fprintf(out, "buffer %s\n", buffer->name);
+	}
+	for (unsigned int i = 0; i < ast->structures->length; i += 1) {
+		seadragon_struct_t *structure = ast->structures->items[i];
+		fprintf(out, "struct %s %u\n", structure->name, structure->fields->length);
+	}
+	fclose(out);
+	return text;
+}
+
+/// Whether a document describes the same as a fresh one loaded from its text.
+static bool document_matches(seadragon_document_t *document, bool parses) {
+	size_t length = seadragon_document_length(document);
+	char *text = malloc(length + 1);
+	seadragon_document_text(document, text);
+	seadragon_session_t session;
+	seadragon_session_init(&session, NULL);
+	seadragon_document_t *fresh = seadragon_document_create("<fresh>");
+	bool matches = seadragon_document_edit(&session, fresh, 0, 0, text, length) == parses;
+	if (matches && parses) {
+		char *expected = describe_ast(seadragon_document_ast(fresh)), *actual = describe_ast(seadragon_document_ast(document));
+		matches = !strcmp(expected, actual);
+		free(expected);
+		free(actual);
+	}
+	seadragon_document_free(fresh);
+	seadragon_session_deinit(&session);
+	free(text);
+	return matches;
+}
+
+TEST(document) {
+	char *log = NULL;
+	size_t log_length = 0;
+	FILE *diagnostics = open_memstream(&log, &log_length);
+	PRECONDITION(diagnostics != NULL);
+	seadragon_session_t session;
+	seadragon_session_init(&session, diagnostics);
+	static const char source[] =
+		"const N 4\n"
+		"struct P 4 x 4 y endstruct buffer scratch 16\n"
+		"fn first {-- v} auto p\n"
+		"\t0x1000 @ p !\n"
+		"\tp@ N + @ v !\n"
+		"end\n"
+		"fn second {-- v}\n"
+		"\twhile (v@ 10 <) v@ 1 + v ! end\n"
+		"end\n"
+		"fn third {-- v} 1 v ! end\n";
+	seadragon_document_t *document = seadragon_document_create("doc.df");
+	PRECONDITION(document != NULL);
+	ASSERT(seadragon_document_edit(&session, document, 0, 0, source, sizeof(source) - 1));
+	seadragon_ast_t *ast = seadragon_document_ast(document);
+	PRECONDITION(ast != NULL);
+	ASSERT_EQ_UINT(ast->functions->length, 3);
+	ASSERT_EQ_UINT(ast->constants->length, 1);
+	ASSERT_EQ_UINT(ast->structures->length, 1);
+	ASSERT_EQ_UINT(ast->buffers->length, 1);
+	// The same declarations as a whole parse
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "doc.df", source, sizeof(source) - 1));
+	seadragon_ast_t whole;
+	PRECONDITION(seadragon_parse(&session, &whole, &lexer));
+	seadragon_lexer_deinit(&lexer);
+	char *expected = describe_ast(&whole), *actual = describe_ast(ast);
+	ASSERT_EQ_STR(actual, expected);
+	free(expected);
+	free(actual);
+	seadragon_parse_free(&whole);
+
+	// Editing one function keeps every other declaration as it was
+	seadragon_function_t *first = ast->functions->items[0], *second = ast->functions->items[1];
+	seadragon_constant_t *constant = ast->constants->items[0];
+	size_t third = strstr(source, "1 v ! end\n") - source;
+	ASSERT(seadragon_document_edit(&session, document, third, 1, "42", 2));
+	ast = seadragon_document_ast(document);
+	PRECONDITION(ast != NULL);
+	ASSERT_EQ_PTR(ast->functions->items[0], first);
+	ASSERT_EQ_PTR(ast->functions->items[1], second);
+	ASSERT_EQ_PTR(ast->constants->items[0], constant);
+	seadragon_instruction_t *instruction = ((seadragon_function_t*)ast->functions->items[2])->u.instructions->items[0];
+	ASSERT_EQ_UINT(instruction->argument->u.literal, 42);
+	ASSERT(document_matches(document, true));
+
+	// Removing an `end` leaves second running on into third, until it is back
+	size_t end = strstr(source, "end\nfn third") - source;
+	ASSERT(!seadragon_document_edit(&session, document, end, 3, "", 0));
+	ASSERT(seadragon_document_ast(document) == NULL);
+	ASSERT(session.errors > 0);
+	ASSERT(seadragon_document_edit(&session, document, end, 0, "end", 3));
+	ast = seadragon_document_ast(document);
+	PRECONDITION(ast != NULL);
+	ASSERT_EQ_PTR(ast->functions->items[0], first);
+	ASSERT_EQ_UINT(ast->functions->length, 3);
+	ASSERT(document_matches(document, true));
+
+	// Tokens joined across a declaration boundary are seen
+	ASSERT(!seadragon_document_edit(&session, document, end + 3, 1, "", 0));
+	ASSERT(seadragon_document_edit(&session, document, end + 3, 0, "\n", 1));
+	ASSERT(document_matches(document, true));
+
+	// Lexer errors point at the line the edit put them on
+	size_t bad = strstr(source, "\twhile") - source;
+	ASSERT(!seadragon_document_edit(&session, document, bad + 1, 0, "= ", 2));
+	fflush(diagnostics);
+	ASSERT(strstr(log, "doc.df:8:2: error: Lexer: Unexpected character '='"));
+	ASSERT(seadragon_document_edit(&session, document, bad + 1, 2, "", 0));
+	ASSERT(!seadragon_document_edit(&session, document, seadragon_document_length(document) + 1, 0, "", 0));
+
+	// Random edits always leave the document as a fresh parse of its text
+	// would
+	static const char *snippets[] = { " ", "\n", "end", "fn", "fn g {-- v} ", "1", "x", "!", "{", "}", "(", ")", "if (",
+		"v@ ", "const K 2 ", "buffer b 8 ", "auto a " };
+	uint32_t state = 1;
+	unsigned int successes = 0;
+	seadragon_session_t quiet;
+	seadragon_session_init(&quiet, NULL);
+	for (unsigned int i = 0; i < 400; i += 1) {
+		state = state * 1103515245 + 12345;
+		size_t length = seadragon_document_length(document);
+		size_t offset = (state >> 8) % (length + 1);
+		size_t removed = (state >> 4) % 4;
+		removed = removed > length - offset ? length - offset : removed;
+		const char *snippet = snippets[(state >> 16) % (sizeof(snippets) / sizeof(snippets[0]))];
+		char *text = malloc(length + 1);
+		seadragon_document_text(document, text);
+		bool parses = seadragon_document_edit(&quiet, document, offset, removed, snippet, strlen(snippet));
+		ASSERT_EQ_INT(parses, seadragon_document_ast(document) != NULL);
+		ASSERT(document_matches(document, parses));
+		// Random text rarely parses again once broken, so edits that break
+		// the document are undone, which must fix it
+		if (!parses) {
+			ASSERT(seadragon_document_edit(&quiet, document, offset, strlen(snippet), text + offset, removed));
+			ASSERT(document_matches(document, true));
+		}
+		free(text);
+		successes += parses;
+	}
+	ASSERT(successes > 50);
+	seadragon_session_deinit(&quiet);
+	seadragon_document_free(document);
+	seadragon_session_deinit(&session);
+	fclose(diagnostics);
+	free(log);
+}
+
+
+/// Stands in for the command line, reporting what reached it in the status.
+static int server_echo(int argc, char **argv) {
+	char cwd[256];
+	bool in_cwd = getcwd(cwd, sizeof(cwd)) && !strcmp(cwd, "/");
+	return argc + (!strcmp(argv[argc - 1], "last") ? 10 : 0) + (in_cwd ? 100 : 0);
+}
+
+TEST(server) {
+	char dir[] = "/tmp/seadragon-server-XXXXXX";
+	PRECONDITION(mkdtemp(dir));
+	char path[64];
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	char *argv[] = { "seadragon", "-x", "last" };
+	// Nothing is listening yet
+	ASSERT_EQ_INT(seadragon_server_forward(path, 3, argv), -1);
+
+	pid_t server = fork();
+	PRECONDITION(server >= 0);
+	if (server == 0) {
+		seadragon_server_serve(path, server_echo);
+		_exit(1);
+	}
+	int status = -1;
+	for (unsigned int i = 0; status < 0 && i < 500; i += 1) {
+		status = seadragon_server_forward(path, 3, argv);
+		if (status < 0) {
+			nanosleep(&(struct timespec){ .tv_nsec = 10000000 }, NULL);
+		}
+	}
+	// Requests run in the client's working directory, which is / here
+	char cwd[256];
+	PRECONDITION(getcwd(cwd, sizeof(cwd)) && !chdir("/"));
+	int rooted = seadragon_server_forward(path, 2, argv);
+	PRECONDITION(!chdir(cwd));
+	kill(server, SIGTERM);
+	waitpid(server, NULL, 0);
+	unlink(path);
+	rmdir(dir);
+	ASSERT_EQ_INT(status, 13);
+	ASSERT_EQ_INT(rooted, 102);
+}
+
+BENCH(lexer_next) {
+	seadragon_lexer_t lexer;
+	PRECONDITION(seadragon_lexer_init(&lexer, "<src>", src, sizeof(src) - 1));
+	size_t offset = lexer.offset;
+	seadragon_source_pos_t pos = lexer.pos;
+	BENCH_SET_BYTES(sizeof(src) - 1);
+	BENCH_LOOP {
+		lexer.offset = offset;
+		lexer.pos = pos;
+		while (seadragon_lexer_next(&lexer, SEADRAGON_LEXER_CATEGORY_PARSER).kind != SEADRAGON_TK_EOF);
+	}
+	seadragon_lexer_deinit(&lexer);
+}
+
+BENCH(list_add) {
+	list_t *list = list_create();
+	BENCH_LOOP {
+		if (list->length == 4096) {
+			list->length = 0;
+		}
+		list_add(list, NULL);
+	}
+	list_free(list);
+}
+
+BENCH(limn2k_register_allocate) {
+	static char *names[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+	FILE *out = fopen("/dev/null", "w");
+	PRECONDITION(out != NULL);
+	seadragon_session_t session;
+	seadragon_session_init(&session, stderr);
+	seadragon_backend_t *backend = seadragon_backend_limn2k(&session, out);
+	seadragon_function_t func = { .name = "f", .outputs = list_create() };
+	backend->begin_function(backend, &func);
+	BENCH_LOOP {
+		backend->register_allocate(backend, names[BENCH_i_ & 7]);
+	}
+	seadragon_backend_limn2k_deinit(backend);
+	list_free(func.outputs);
+	seadragon_session_deinit(&session);
+	fclose(out);
+}
+
+BENCH(document_edit) {
+	// 100k lines, and an edit in the middle of them
+	static const char function[] = "fn f%05u {-- v} auto i\n\t1 i !\n\ti@ 2 + v !\n\tv@\nend\n";
+	size_t capacity = 20000 * sizeof(function) + 1, length = 0, middle = 0;
+	char *text = malloc(capacity);
+	for (unsigned int i = 0; i < 20000; i += 1) {
+		if (i == 10000) {
+			middle = length + strlen("fn f00000 {-- v} auto i\n\t");
+		}
+		length += snprintf(text + length, capacity - length, function, i);
+	}
+	seadragon_session_t session;
+	seadragon_session_init(&session, NULL);
+	seadragon_document_t *document = seadragon_document_create("<bench>");
+	PRECONDITION(seadragon_document_edit(&session, document, 0, 0, text, length));
+	BENCH_LOOP {
+		PRECONDITION(seadragon_document_edit(&session, document, middle, 1, BENCH_i_ & 1 ? "1" : "2", 1));
+		PRECONDITION(seadragon_document_ast(document) != NULL);
+	}
+	seadragon_document_free(document);
+	seadragon_session_deinit(&session);
+	free(text);
 }
 
 int main()
@@ -164,6 +1933,34 @@ int main()
 	TEST_EXEC(lexer);
 	TEST_EXEC(parser);
 	TEST_EXEC(sema);
+	TEST_EXEC(store_order);
 	TEST_EXEC(codegen);
+	TEST_EXEC(structs);
+	TEST_EXEC(constants);
+	TEST_EXEC(constants_cycle);
+	TEST_EXEC(control_flow);
+	TEST_EXEC(loops);
+	TEST_EXEC(memops);
+	TEST_EXEC(peephole);
+	TEST_EXEC(schedule);
+	TEST_EXEC(ir_pool);
+	TEST_EXEC(buffers);
+	TEST_EXEC(module);
+	TEST_EXEC(driver);
+	TEST_EXEC(split_parse);
+	TEST_EXEC(stream);
+	TEST_EXEC(profile);
+	TEST_EXEC(c_backend);
+	TEST_EXEC(jit);
+	TEST_EXEC(interp);
+	TEST_EXEC(limn2k_sim);
+	TEST_EXEC(link);
+	TEST_EXEC(session);
+	TEST_EXEC(document);
+	TEST_EXEC(server);
+	BENCH_EXEC(lexer_next);
+	BENCH_EXEC(list_add);
+	BENCH_EXEC(limn2k_register_allocate);
+	BENCH_EXEC(document_edit);
 	return TEST_REPORT();
 }
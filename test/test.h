@@ -6,6 +6,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Each benchmark sample runs for at least this many seconds
+#ifndef TEST_BENCH_MIN_TIME
+#define TEST_BENCH_MIN_TIME 0.01
+#endif
+#ifndef TEST_BENCH_SAMPLES
+#define TEST_BENCH_SAMPLES  5
+#endif
+#ifndef TEST_BENCH_MAX
+#define TEST_BENCH_MAX      64
+#endif
+
+struct test_bench_result_
+{
+    char name[128];
+    double ns_per_op;
+    // (slowest - fastest) / median sample, as a fraction
+    double spread;
+    uint64_t bytes_per_op;
+    // negative if allocations are not counted
+    double allocs_per_op;
+};
 
 struct test_results_
 {
@@ -21,11 +44,29 @@ struct test_results_
         const char* file;
         int line;
     } context;
+    struct test_bench_result_ benches[TEST_BENCH_MAX];
+    uint32_t nbenches;
 };
 
 // meh, for testing a global is fine IMO
 static struct test_results_ TEST_results;
 
+// Counting allocations replaces malloc, calloc and realloc, which only works
+// against a dynamically linked glibc; define TEST_BENCH_COUNT_ALLOCS to opt in.
+// The count is not atomic, so threads running while benchmarking race on it.
+#if defined(TEST_BENCH_COUNT_ALLOCS) && defined(__GLIBC__)
+static uint64_t TEST_allocs;
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+void* malloc(size_t size) { ++TEST_allocs; return __libc_malloc(size); }
+void* calloc(size_t count, size_t size) { ++TEST_allocs; return __libc_calloc(count, size); }
+void* realloc(void* ptr, size_t size) { ++TEST_allocs; return __libc_realloc(ptr, size); }
+#define TEST_ALLOCS_()  ((int64_t)TEST_allocs)
+#else
+#define TEST_ALLOCS_()  ((int64_t)-1)
+#endif
+
 #define TEST_TOSTRING_(x)   #x
 #define TEST_TOSTRING(x)    TEST_TOSTRING_(x)
 
@@ -113,8 +154,90 @@ static void test_handle_result_(void)
     fflush(stdout);
     fflush(stderr);
 }
+
+struct test_bench_
+{
+    uint64_t iterations;
+    uint64_t bytes_per_op;
+    struct timespec start;
+    double elapsed;
+    int64_t allocs_start, allocs;
+};
+static uint64_t test_bench_begin_(struct test_bench_* bench)
+{
+    bench->allocs_start = TEST_ALLOCS_();
+    clock_gettime(CLOCK_MONOTONIC, &bench->start);
+    return 0;
+}
+static bool test_bench_end_(struct test_bench_* bench)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench->allocs = TEST_ALLOCS_() - bench->allocs_start;
+    bench->elapsed = (end.tv_sec - bench->start.tv_sec) + (end.tv_nsec - bench->start.tv_nsec) / 1e9;
+    return true;
+}
+static int test_bench_compare_(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+static void test_bench_print_(const struct test_bench_result_* result)
+{
+    printf("%-24s %12.2f ns/op %14.0f ops/s", result->name, result->ns_per_op, 1e9 / result->ns_per_op);
+    if(result->bytes_per_op)
+        printf(" %8" PRIu64 " B/op %9.2f MB/s", result->bytes_per_op, result->bytes_per_op * 1e3 / result->ns_per_op);
+    if(result->allocs_per_op >= 0)
+        printf(" %8.2f allocs/op", result->allocs_per_op);
+    printf("  +/-%.1f%%\n", result->spread * 50);
+}
+// Grows the iteration count until a run takes TEST_BENCH_MIN_TIME, which also
+// warms up caches and branch predictors, then keeps the median of the samples.
+// Returns false if the benchmark failed an assertion.
+static bool test_bench_run_(void (*fn)(struct test_bench_*), const char* name)
+{
+    struct test_bench_ bench = { .iterations = 1 };
+    for(;;)
+    {
+        fn(&bench);
+        if(TEST_results.status != 'P')
+            return false;
+        if(bench.elapsed >= TEST_BENCH_MIN_TIME || bench.iterations >= UINT64_C(1) << 40)
+            break;
+        double scale = bench.elapsed > 0 ? TEST_BENCH_MIN_TIME * 1.2 / bench.elapsed : 100;
+        scale = scale < 2 ? 2 : scale > 100 ? 100 : scale;
+        bench.iterations = (uint64_t)(bench.iterations * scale);
+    }
+    double samples[TEST_BENCH_SAMPLES];
+    int64_t allocs = 0;
+    for(int i = 0; i < TEST_BENCH_SAMPLES; i++)
+    {
+        fn(&bench);
+        if(TEST_results.status != 'P')
+            return false;
+        samples[i] = bench.elapsed * 1e9 / bench.iterations;
+        allocs += bench.allocs;
+    }
+    qsort(samples, TEST_BENCH_SAMPLES, sizeof(double), test_bench_compare_);
+    struct test_bench_result_ result = { .ns_per_op = samples[TEST_BENCH_SAMPLES / 2], .bytes_per_op = bench.bytes_per_op };
+    strncpy(result.name, name, sizeof(result.name));
+    result.name[sizeof(result.name)-1] = 0;
+    result.spread = result.ns_per_op > 0 ? (samples[TEST_BENCH_SAMPLES - 1] - samples[0]) / result.ns_per_op : 0;
+    result.allocs_per_op = TEST_ALLOCS_() < 0 ? -1 : (double)allocs / (bench.iterations * TEST_BENCH_SAMPLES);
+    if(TEST_results.nbenches < TEST_BENCH_MAX)
+        TEST_results.benches[TEST_results.nbenches++] = result;
+    printf("BENCH: ");
+    test_bench_print_(&result);
+    return true;
+}
 static int test_report_(void)
 {
+    if(TEST_results.nbenches)
+    {
+        printf("----------\n");
+        for(uint32_t i = 0; i < TEST_results.nbenches; i++)
+            test_bench_print_(&TEST_results.benches[i]);
+    }
     printf("----------\n");
     uint32_t all = TEST_results.stats.pass + TEST_results.stats.skip + TEST_results.stats.todo + TEST_results.stats.fail + TEST_results.stats.unknown;
     if (TEST_results.stats.pass > 0)
@@ -161,6 +284,24 @@ static int test_report_(void)
     } while(0)
 #define TEST_REPORT()       test_report_()
 
+// A benchmark's body sets up, then times one operation in a BENCH_LOOP, which
+// runs it as many times as the harness asks; don't `break` out of it.
+#define BENCH(NAME)             static void bench_##NAME(struct test_bench_* BENCH_state_)
+#define BENCH_LOOP              for(uint64_t BENCH_i_ = test_bench_begin_(BENCH_state_); BENCH_i_ < BENCH_state_->iterations || !test_bench_end_(BENCH_state_); BENCH_i_++)
+// Bytes processed per operation, for reporting throughput
+#define BENCH_SET_BYTES(N)      (BENCH_state_->bytes_per_op = (N))
+#define BENCH_EXEC(NAME)                                                \
+    do {                                                                \
+        TEST_results.status = 'P';                                      \
+        strncpy(TEST_results.name, #NAME, sizeof(TEST_results.name));   \
+        TEST_results.name[sizeof(TEST_results.name)-1] = 0;             \
+        TEST_results.error[0] = 0;                                      \
+        TEST_results.context.file = NULL;                               \
+        TEST_results.context.line = 0;                                  \
+        if(!test_bench_run_(bench_##NAME, #NAME))                       \
+            test_handle_result_();                                      \
+    } while(0)
+
 bool test_assert_eq_ptr_(const void* x, const void* y, const char* msg, const char* file, int line)
 {
     if(x == y)